@@ -58,6 +58,7 @@ ObjectID NativeTaskSubmitter::Submit(InvocationSpec &invocation,
   options.resources = call_options.resources;
   std::optional<std::vector<rpc::ObjectReference>> return_refs;
   if (invocation.task_type == TaskType::ACTOR_TASK) {
+    core_worker.WaitForActorQueueRoom(invocation.actor_id);
     return_refs = core_worker.SubmitActorTask(
         invocation.actor_id, BuildRayFunction(invocation), invocation.args, options);
     if (!return_refs.has_value()) {
@@ -0,0 +1,123 @@
+"""A fork server that starts Python workers without paying the interpreter
+startup and import cost for each of them.
+
+The raylet starts one zygote per job with the same command line as a worker,
+plus ``--zygote-socket``. The zygote imports everything a worker needs, then
+listens on an abstract unix socket. For every request line, which holds the
+startup token of a new worker, it forks a child and replies with the child's
+pid. The child returns from ``serve`` and continues as a regular worker with
+that startup token. The zygote exits when the raylet disconnects or dies.
+"""
+
+import ctypes
+import ctypes.util
+import importlib
+import logging
+import os
+import signal
+import socket
+import struct
+import sys
+
+logger = logging.getLogger(__name__)
+
+# How often to check that the raylet is alive while waiting for it to connect.
+_ACCEPT_TIMEOUT_S = 1.0
+# From linux/prctl.h.
+_PR_SET_PDEATHSIG = 1
+
+
+def _preload(modules):
+    for module in modules.split(","):
+        module = module.strip()
+        if not module:
+            continue
+        try:
+            importlib.import_module(module)
+        except Exception:
+            logger.exception(f"Worker zygote failed to preload {module}.")
+
+
+def _die_with_parent():
+    """Ask the kernel to kill this process when the raylet dies.
+
+    The setting is not inherited by the forked workers.
+    """
+    if not sys.platform.startswith("linux"):
+        return
+    try:
+        libc = ctypes.CDLL(ctypes.util.find_library("c"), use_errno=True)
+        if libc.prctl(_PR_SET_PDEATHSIG, signal.SIGKILL) != 0:
+            raise OSError(ctypes.get_errno(), "prctl failed")
+    except Exception:
+        logger.exception("Worker zygote failed to set its parent death "
+                         "signal.")
+
+
+def _check_peer(conn, raylet_pid):
+    """Only accept requests from the raylet that started this zygote."""
+    ucred = conn.getsockopt(socket.SOL_SOCKET, socket.SO_PEERCRED,
+                            struct.calcsize("3i"))
+    pid, _, _ = struct.unpack("3i", ucred)
+    return pid == raylet_pid
+
+
+def serve(socket_name, preload_modules=""):
+    """Fork workers on request until the raylet disconnects.
+
+    Args:
+        socket_name (str): The name of the abstract unix socket to listen on.
+        preload_modules (str): Comma separated modules to import before
+            serving.
+
+    Returns:
+        The startup token of the worker, in a forked child. The zygote process
+        itself exits instead of returning.
+    """
+    # The raylet starts the zygote directly, so it is the parent process.
+    raylet_pid = os.getppid()
+    _die_with_parent()
+    _preload(preload_modules)
+
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    # A leading null byte puts the socket in the abstract namespace.
+    server.bind("\0" + socket_name)
+    server.listen(1)
+    server.settimeout(_ACCEPT_TIMEOUT_S)
+    # Let the kernel reap the forked workers, the raylet tracks them by pid.
+    signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+
+    while True:
+        # Don't wait for a connection from a raylet that died, e.g., where the
+        # parent death signal is not supported.
+        if os.getppid() != raylet_pid:
+            os._exit(0)
+        try:
+            conn, _ = server.accept()
+        except socket.timeout:
+            continue
+        conn.setblocking(True)
+        if _check_peer(conn, raylet_pid):
+            break
+        logger.warning("Worker zygote rejected a connection that is not "
+                       "from its raylet.")
+        conn.close()
+    server.close()
+
+    requests = conn.makefile("rb")
+    for line in requests:
+        startup_token = int(line)
+        try:
+            pid = os.fork()
+        except OSError:
+            logger.exception("Worker zygote failed to fork a worker.")
+            pid = -1
+        if pid == 0:
+            requests.close()
+            conn.close()
+            signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+            return startup_token
+        conn.sendall(f"{pid}\n".encode())
+
+    # The raylet closed the connection, e.g., because the job finished.
+    os._exit(0)
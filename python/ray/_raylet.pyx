@@ -1642,6 +1642,7 @@ cdef class CoreWorker:
             CRayFunction ray_function
             c_vector[unique_ptr[CTaskArg]] args_vector
             optional[c_vector[CObjectReference]] return_refs
+            c_bool has_room
 
         with self.profile_event(b"submit_task"):
             if num_method_cpus > 0:
@@ -1651,15 +1652,27 @@ cdef class CoreWorker:
             prepare_args(
                 self, language, args, &args_vector, function_descriptor)
 
-            # NOTE(edoakes): releasing the GIL while calling this method causes
-            # segfaults. See relevant issue for details:
-            # https://github.com/ray-project/ray/pull/12803
-            return_refs = CCoreWorkerProcess.GetCoreWorker().SubmitActorTask(
-                c_actor_id,
-                ray_function,
-                args_vector,
-                CTaskOptions(
-                    name, num_returns, c_resources, concurrency_group_name))
+            while True:
+                # Wait for room under the actor's max_pending_calls without the
+                # GIL, since processing the replies of the actor's tasks, which
+                # makes room, may need the GIL.
+                with nogil:
+                    has_room = (CCoreWorkerProcess.GetCoreWorker()
+                                .WaitForActorQueueRoom(c_actor_id))
+                # NOTE(edoakes): releasing the GIL while calling this method
+                # causes segfaults. See relevant issue for details:
+                # https://github.com/ray-project/ray/pull/12803
+                return_refs = CCoreWorkerProcess.GetCoreWorker() \
+                    .SubmitActorTask(
+                        c_actor_id,
+                        ray_function,
+                        args_vector,
+                        CTaskOptions(name, num_returns, c_resources,
+                                     concurrency_group_name))
+                # If there was room, another thread took it before this one
+                # submitted, so wait again.
+                if return_refs.has_value() or not has_room:
+                    break
             if return_refs.has_value():
                 return VectorToObjectRefs(return_refs.value())
             else:
@@ -5,6 +5,7 @@ import shutil
 import random
 import time
 import urllib
+import zlib
 from collections import namedtuple
 from typing import List, IO, Tuple
 
@@ -15,6 +16,23 @@ from ray._raylet import ObjectRef
 ParsedURL = namedtuple("ParsedURL", "base_url, offset, size")
 logger = logging.getLogger(__name__)
 
+# Compression codecs for the data payload of spilled objects. The codec is
+# stored in the top byte of the address length header field, so objects
+# spilled without compression keep the original format. Must be kept in sync
+# with SpilledObjectCodec in src/ray/object_manager/spilled_object_reader.h.
+CODEC_NONE = 0
+CODEC_ZLIB = 1
+_CODEC_SHIFT = 56
+_ADDRESS_LEN_MASK = (1 << _CODEC_SHIFT) - 1
+_COMPRESSION_CODECS = {None: CODEC_NONE, "zlib": CODEC_ZLIB}
+# Compressed objects are split into blocks that are compressed independently,
+# so that remote reads can inflate only the chunks they need. This should
+# divide object_manager_default_chunk_size.
+DEFAULT_COMPRESSION_BLOCK_SIZE = 1024 * 1024
+# Objects whose first block does not shrink below this ratio are spilled
+# uncompressed.
+DEFAULT_MIN_COMPRESSION_RATIO = 0.9
+
 
 def create_url_with_offset(*, url: str, offset: int, size: int) -> str:
     """Methods to create a URL with offset.
@@ -86,6 +104,63 @@ class ExternalStorage(metaclass=abc.ABCMeta):
 
     HEADER_LENGTH = 24
 
+    # Compression settings. Subclasses enable compression through
+    # `_setup_compression`.
+    _codec = CODEC_NONE
+    _compression_block_size = DEFAULT_COMPRESSION_BLOCK_SIZE
+    _min_compression_ratio = DEFAULT_MIN_COMPRESSION_RATIO
+
+    def _setup_compression(self, compression, compression_block_size,
+                           min_compression_ratio):
+        """Configure compression of the spilled data payloads.
+
+        Args:
+            compression(str): Codec name, either None or "zlib".
+            compression_block_size(int): Uncompressed size of each
+                independently compressed block.
+            min_compression_ratio(float): Objects that compress worse than
+                this ratio are spilled uncompressed.
+        """
+        if compression not in _COMPRESSION_CODECS:
+            raise ValueError(f"Unknown spilling compression: {compression}. "
+                             "Supported values are None and 'zlib'.")
+        if compression_block_size <= 0:
+            raise ValueError("compression_block_size must be positive, got "
+                             f"{compression_block_size}.")
+        self._codec = _COMPRESSION_CODECS[compression]
+        self._compression_block_size = compression_block_size
+        self._min_compression_ratio = min_compression_ratio
+
+    def _compress_data(self, buf) -> Tuple[int, List[bytes]]:
+        """Compress the data payload of an object if it's worth it.
+
+        Returns:
+            The codec used and the list of payload pieces to write. For
+            compressed objects, the pieces are the block header followed by
+            the compressed blocks.
+        """
+        view = memoryview(buf).cast("B")
+        block_size = self._compression_block_size
+        if self._codec == CODEC_NONE or len(view) == 0:
+            return CODEC_NONE, [view]
+        blocks = [zlib.compress(view[:block_size])]
+        # Sample the first block so incompressible objects (e.g., already
+        # compressed images) are skipped without paying for the whole object.
+        if len(blocks[0]) > self._min_compression_ratio * min(
+                len(view), block_size):
+            return CODEC_NONE, [view]
+        for begin in range(block_size, len(view), block_size):
+            blocks.append(zlib.compress(view[begin:begin + block_size]))
+        if sum(len(block) for block in blocks) > \
+                self._min_compression_ratio * len(view):
+            return CODEC_NONE, [view]
+        header = block_size.to_bytes(8, byteorder="little") + \
+            len(blocks).to_bytes(8, byteorder="little") + \
+            b"".join(
+                len(block).to_bytes(8, byteorder="little")
+                for block in blocks)
+        return self._codec, [header] + blocks
+
     def _get_objects_from_store(self, object_refs):
         worker = ray.worker.global_worker
         # Since the object should always exist in the plasma store before
@@ -133,13 +208,15 @@ class ExternalStorage(metaclass=abc.ABCMeta):
                     error += " This is probably since its owner has failed."
                 raise ValueError(error)
             buf_len = len(buf)
-            payload = address_len.to_bytes(8, byteorder="little") + \
+            codec, data_payload = self._compress_data(buf)
+            payload = ((codec << _CODEC_SHIFT) | address_len).to_bytes(
+                8, byteorder="little") + \
                 metadata_len.to_bytes(8, byteorder="little") + \
                 buf_len.to_bytes(8, byteorder="little") + \
-                owner_address + metadata + memoryview(buf)
+                owner_address + metadata + b"".join(data_payload)
             # 24 bytes to store owner address, metadata, and buffer lengths.
-            assert self.HEADER_LENGTH + address_len + metadata_len + buf_len \
-                == len(payload)
+            assert self.HEADER_LENGTH + address_len + metadata_len + sum(
+                len(piece) for piece in data_payload) == len(payload)
             written_bytes = f.write(payload)
             url_with_offset = create_url_with_offset(
                 url=url, offset=offset, size=written_bytes)
@@ -147,6 +224,42 @@ class ExternalStorage(metaclass=abc.ABCMeta):
             offset = f.tell()
         return keys
 
+    def _restore_object_from_file(self, f, object_ref, obtained_data_size):
+        """Restore an object from a file handle positioned at its header.
+
+        Returns:
+            The number of bytes of the restored data.
+        """
+        address_field = int.from_bytes(f.read(8), byteorder="little")
+        codec = address_field >> _CODEC_SHIFT
+        address_len = address_field & _ADDRESS_LEN_MASK
+        metadata_len = int.from_bytes(f.read(8), byteorder="little")
+        buf_len = int.from_bytes(f.read(8), byteorder="little")
+        owner_address = f.read(address_len)
+        metadata = f.read(metadata_len)
+        if codec == CODEC_NONE:
+            self._size_check(address_len, metadata_len, buf_len,
+                             obtained_data_size)
+            # read remaining data to our buffer
+            self._put_object_to_store(metadata, buf_len, f, object_ref,
+                                      owner_address)
+            return buf_len
+        if codec != CODEC_ZLIB:
+            raise ValueError(f"Unknown spilled object codec {codec}.")
+        f.read(8)  # The block size is only needed for ranged reads.
+        num_blocks = int.from_bytes(f.read(8), byteorder="little")
+        block_sizes = [
+            int.from_bytes(f.read(8), byteorder="little")
+            for _ in range(num_blocks)
+        ]
+        self._size_check(address_len, metadata_len,
+                         8 * (2 + num_blocks) + sum(block_sizes),
+                         obtained_data_size)
+        self._put_object_to_store(metadata, buf_len,
+                                  _DecompressingReader(f, block_sizes),
+                                  object_ref, owner_address)
+        return buf_len
+
     def _size_check(self, address_len, metadata_len, buffer_len,
                     obtained_data_size):
         """Check whether or not the obtained_data_size is as expected.
@@ -212,6 +325,25 @@ class ExternalStorage(metaclass=abc.ABCMeta):
         """
 
 
+class _DecompressingReader:
+    """File-like object that inflates the compressed blocks of a spilled
+    object as they are consumed through `readinto`."""
+
+    def __init__(self, f: IO, block_sizes: List[int]):
+        self._f = f
+        self._block_sizes = iter(block_sizes)
+        self._pending = memoryview(b"")
+
+    def readinto(self, view) -> int:
+        if len(self._pending) == 0:
+            self._pending = memoryview(
+                zlib.decompress(self._f.read(next(self._block_sizes))))
+        size = min(len(view), len(self._pending))
+        view[:size] = self._pending[:size]
+        self._pending = self._pending[size:]
+        return size
+
+
 class NullStorage(ExternalStorage):
     """The class that represents an uninitialized external storage."""
 
@@ -231,12 +363,25 @@ class NullStorage(ExternalStorage):
 class FileSystemStorage(ExternalStorage):
     """The class for filesystem-like external storage.
 
+    Args:
+        directory_path(str|list): Directories to spill objects to.
+        compression(str): Compression codec for the spilled data.
+            Either None (default) or "zlib".
+        compression_block_size(int): Uncompressed size of each
+            independently compressed block.
+        min_compression_ratio(float): Objects that don't compress below
+            this ratio are spilled uncompressed.
+
     Raises:
         ValueError: Raises directory path to
             spill objects doesn't exist.
     """
 
-    def __init__(self, directory_path):
+    def __init__(self,
+                 directory_path,
+                 compression: str = None,
+                 compression_block_size: int = DEFAULT_COMPRESSION_BLOCK_SIZE,
+                 min_compression_ratio: float = DEFAULT_MIN_COMPRESSION_RATIO):
         # -- sub directory name --
         self._spill_dir_name = DEFAULT_OBJECT_PREFIX
         # -- A list of directory paths to spill objects --
@@ -267,6 +412,8 @@ class FileSystemStorage(ExternalStorage):
         # mounted at different point.
         self._current_directory_index = random.randrange(
             0, len(self._directory_paths))
+        self._setup_compression(compression, compression_block_size,
+                                min_compression_ratio)
 
     def spill_objects(self, object_refs, owner_addresses) -> List[str]:
         if len(object_refs) == 0:
@@ -297,17 +444,8 @@ class FileSystemStorage(ExternalStorage):
             # Read a part of the file and recover the object.
             with open(base_url, "rb") as f:
                 f.seek(offset)
-                address_len = int.from_bytes(f.read(8), byteorder="little")
-                metadata_len = int.from_bytes(f.read(8), byteorder="little")
-                buf_len = int.from_bytes(f.read(8), byteorder="little")
-                self._size_check(address_len, metadata_len, buf_len,
-                                 parsed_result.size)
-                total += buf_len
-                owner_address = f.read(address_len)
-                metadata = f.read(metadata_len)
-                # read remaining data to our buffer
-                self._put_object_to_store(metadata, buf_len, f, object_ref,
-                                          owner_address)
+                total += self._restore_object_from_file(
+                    f, object_ref, parsed_result.size)
         return total
 
     def delete_spilled_objects(self, urls: List[str]):
@@ -354,6 +492,12 @@ class ExternalStorageSmartOpenImpl(ExternalStorage):
         prefix(str): Prefix of objects that are stored.
         override_transport_params(dict): Overriding the default value of
             transport_params for smart-open library.
+        compression(str): Compression codec for the spilled data.
+            Either None (default) or "zlib".
+        compression_block_size(int): Uncompressed size of each
+            independently compressed block.
+        min_compression_ratio(float): Objects that don't compress below
+            this ratio are spilled uncompressed.
 
     Raises:
         ModuleNotFoundError: If it fails to setup.
@@ -364,7 +508,10 @@ class ExternalStorageSmartOpenImpl(ExternalStorage):
     def __init__(self,
                  uri: str,
                  prefix: str = DEFAULT_OBJECT_PREFIX,
-                 override_transport_params: dict = None):
+                 override_transport_params: dict = None,
+                 compression: str = None,
+                 compression_block_size: int = DEFAULT_COMPRESSION_BLOCK_SIZE,
+                 min_compression_ratio: float = DEFAULT_MIN_COMPRESSION_RATIO):
         try:
             from smart_open import open  # noqa
         except ModuleNotFoundError as e:
@@ -393,6 +540,8 @@ class ExternalStorageSmartOpenImpl(ExternalStorage):
             self.transport_params = {}
 
         self.transport_params.update(self.override_transport_params)
+        self._setup_compression(compression, compression_block_size,
+                                min_compression_ratio)
 
     def spill_objects(self, object_refs, owner_addresses) -> List[str]:
         if len(object_refs) == 0:
@@ -427,17 +576,8 @@ class ExternalStorageSmartOpenImpl(ExternalStorage):
                 # smart open seek reads the file from offset-end_of_the_file
                 # when the seek is called.
                 f.seek(offset)
-                address_len = int.from_bytes(f.read(8), byteorder="little")
-                metadata_len = int.from_bytes(f.read(8), byteorder="little")
-                buf_len = int.from_bytes(f.read(8), byteorder="little")
-                self._size_check(address_len, metadata_len, buf_len,
-                                 parsed_result.size)
-                owner_address = f.read(address_len)
-                total += buf_len
-                metadata = f.read(metadata_len)
-                # read remaining data to our buffer
-                self._put_object_to_store(metadata, buf_len, f, object_ref,
-                                          owner_address)
+                total += self._restore_object_from_file(
+                    f, object_ref, parsed_result.size)
         return total
 
     def delete_spilled_objects(self, urls: List[str]):
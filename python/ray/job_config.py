@@ -18,6 +18,11 @@ class JobConfig:
             ``runtime_env.py`` for detailed documentation).
         client_job (bool): A boolean represent the source of the job.
         default_actor_lifetime (str): The default value of actor lifetime.
+        scheduling_weight (float): The weight of the job's share of the
+            workers of each node when raylets dispatch tasks by job fair
+            sharing.
+        min_scheduling_share (int): The number of running tasks per node the
+            job gets before the workers are shared by weight.
     """
 
     def __init__(self,
@@ -28,7 +33,9 @@ class JobConfig:
                  client_job=False,
                  metadata=None,
                  ray_namespace=None,
-                 default_actor_lifetime="non_detached"):
+                 default_actor_lifetime="non_detached",
+                 scheduling_weight=1.0,
+                 min_scheduling_share=0):
         self.num_java_workers_per_process = num_java_workers_per_process
         self.jvm_options = jvm_options or []
         self.code_search_path = code_search_path or []
@@ -40,6 +47,8 @@ class JobConfig:
         self.client_job = client_job
         self.metadata = metadata or {}
         self.ray_namespace = ray_namespace
+        self.scheduling_weight = scheduling_weight
+        self.min_scheduling_share = min_scheduling_share
         self.set_runtime_env(runtime_env)
         self.set_default_actor_lifetime(default_actor_lifetime)
 
@@ -102,6 +111,8 @@ class JobConfig:
             pb.num_java_workers_per_process = self.num_java_workers_per_process
             pb.jvm_options.extend(self.jvm_options)
             pb.code_search_path.extend(self.code_search_path)
+            pb.scheduling_weight = self.scheduling_weight
+            pb.min_scheduling_share = self.min_scheduling_share
             for k, v in self.metadata.items():
                 pb.metadata[k] = v
 
@@ -139,4 +150,7 @@ class JobConfig:
             runtime_env=job_config_json.get("runtime_env", None),
             client_job=job_config_json.get("client_job", False),
             metadata=job_config_json.get("metadata", None),
-            ray_namespace=job_config_json.get("ray_namespace", None))
+            ray_namespace=job_config_json.get("ray_namespace", None),
+            scheduling_weight=job_config_json.get("scheduling_weight", 1.0),
+            min_scheduling_share=job_config_json.get("min_scheduling_share",
+                                                     0))
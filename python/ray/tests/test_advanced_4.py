@@ -2,6 +2,8 @@ import pytest
 import ray
 import subprocess
 import sys
+import threading
+import time
 
 from ray._private.test_utils import (Semaphore, client_test_enabled,
                                      wait_for_condition)
@@ -134,6 +136,39 @@ def test_back_pressure(shutdown_only_with_initialization_check):
     ray.shutdown()
 
 
+def test_back_pressure_wait(shutdown_only_with_initialization_check):
+    # Submissions wait for room under max_pending_calls instead of failing.
+    ray.init(_system_config={"actor_submit_backpressure_wait_ms": 60000})
+
+    @ray.remote(max_pending_calls=2)
+    class Actor:
+        def f(self, i):
+            time.sleep(0.01)
+            return i
+
+    actor = Actor.remote()
+    num_tasks = 50
+    refs = []
+    futures = []
+
+    def submit():
+        for i in range(num_tasks):
+            ref = actor.f.remote(i)
+            refs.append(ref)
+            # The future's callback runs when the reply is processed, and needs
+            # the GIL, so the replies can only make room while the submitting
+            # thread waits without holding the GIL.
+            futures.append(ref.future())
+
+    thread = threading.Thread(target=submit)
+    thread.start()
+    thread.join(timeout=60)
+    assert not thread.is_alive()
+    assert ray.get(refs) == list(range(num_tasks))
+    assert [future.result(timeout=10) for future in futures] == list(
+        range(num_tasks))
+
+
 def test_local_mode_deadlock(shutdown_only_with_initialization_check):
     ray.init(local_mode=True)
 
@@ -554,6 +554,65 @@ def test_pull_spilled_object(ray_start_cluster,
         assert hash_value == hash_value1
 
 
+@pytest.mark.skipif(
+    platform.system() == "Windows", reason="Failing on Windows.")
+def test_spill_objects_with_compression(ray_start_cluster, tmp_path):
+    cluster = ray_start_cluster
+    spill_dir = tmp_path / "spill"
+    spill_dir.mkdir()
+    object_spilling_config = json.dumps({
+        "type": "filesystem",
+        "params": {
+            "directory_path": str(spill_dir),
+            "compression": "zlib",
+        }
+    })
+    # Head node.
+    cluster.add_node(
+        num_cpus=1,
+        resources={"custom": 0},
+        object_store_memory=75 * 1024 * 1024,
+        _system_config={
+            "max_io_workers": 2,
+            "min_spilling_size": 0,
+            "automatic_object_spilling_enabled": True,
+            "object_store_full_delay_ms": 100,
+            "object_spilling_config": object_spilling_config,
+        })
+    ray.init(cluster.address)
+    cluster.add_node(
+        num_cpus=1,
+        resources={"custom": 1},
+        object_store_memory=75 * 1024 * 1024)
+    cluster.wait_for_nodes()
+
+    # Compressible objects interleaved with incompressible ones, which are
+    # spilled uncompressed.
+    arrays = [
+        np.zeros(10 * 1024 * 1024, dtype=np.uint8)
+        if i % 2 == 0 else np.random.randint(
+            0, 255, 10 * 1024 * 1024, dtype=np.uint8) for i in range(10)
+    ]
+    refs = [ray.put(arr) for arr in arrays]
+    s = memory_summary(address=cluster.address, stats_only=True)
+    spilled_mib = int(s.split("Spilled ")[1].split(" MiB")[0])
+    spilled_file_bytes = sum(
+        f.stat().st_size for f in spill_dir.glob("**/*") if f.is_file())
+    assert 0 < spilled_file_bytes < spilled_mib * 1024 * 1024, s
+
+    @ray.remote(num_cpus=1, resources={"custom": 1})
+    def get_remote_hash(arr):
+        return zlib.crc32(arr.tobytes())
+
+    # Spilled objects are pulled from the filesystem by the remote node.
+    for arr, ref in zip(arrays, refs):
+        assert ray.get(get_remote_hash.remote(ref)) == zlib.crc32(
+            arr.tobytes())
+    # Spilled objects are restored locally.
+    for arr, ref in zip(arrays, refs):
+        assert np.array_equal(ray.get(ref), arr)
+
+
 # TODO(chenshen): fix error handling when spilled file
 # missing/corrupted
 @pytest.mark.skipif(True, reason="Currently hangs.")
@@ -131,14 +131,29 @@ parser.add_argument(
     help="The PID of the process for setup worker runtime env.")
 parser.add_argument(
     "--startup-token",
-    required=True,
+    required=False,
     type=int,
-    help="The startup token assigned to this worker process by the raylet.")
+    default=None,
+    help="The startup token assigned to this worker process by the raylet. "
+    "A zygote gets one for each worker it forks instead.")
 parser.add_argument(
     "--ray-debugger-external",
     default=False,
     action="store_true",
     help="True if Ray debugger is made available externally.")
+parser.add_argument(
+    "--zygote-socket",
+    required=False,
+    type=str,
+    default=None,
+    help="If set, run as a zygote that forks workers on requests from the "
+    "raylet on this abstract unix socket.")
+parser.add_argument(
+    "--zygote-preload-modules",
+    required=False,
+    type=str,
+    default="",
+    help="Comma separated modules for the zygote to import before forking.")
 
 if __name__ == "__main__":
     # NOTE(sang): For some reason, if we move the code below
@@ -149,6 +164,14 @@ if __name__ == "__main__":
     ray._private.ray_logging.setup_logger(args.logging_level,
                                           args.logging_format)
 
+    if args.zygote_socket:
+        # Only forked workers return from here, with their own startup token.
+        from ray._private import worker_zygote
+        args.startup_token = worker_zygote.serve(args.zygote_socket,
+                                                 args.zygote_preload_modules)
+    elif args.startup_token is None:
+        parser.error("--startup-token is required.")
+
     if args.worker_type == "WORKER":
         mode = ray.WORKER_MODE
     elif args.worker_type == "SPILL_WORKER":
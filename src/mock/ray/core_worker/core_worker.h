@@ -57,6 +57,11 @@ class MockCoreWorker : public CoreWorker {
                rpc::GetObjectStatusReply *reply,
                rpc::SendReplyCallback send_reply_callback),
               (override));
+  MOCK_METHOD(void, HandleGetObjectStatuses,
+              (const rpc::GetObjectStatusesRequest &request,
+               rpc::GetObjectStatusesReply *reply,
+               rpc::SendReplyCallback send_reply_callback),
+              (override));
   MOCK_METHOD(void, HandleWaitForActorOutOfScope,
               (const rpc::WaitForActorOutOfScopeRequest &request,
                rpc::WaitForActorOutOfScopeReply *reply,
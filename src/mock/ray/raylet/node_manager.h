@@ -76,6 +76,10 @@ class MockNodeManager : public NodeManager {
               (const rpc::ReturnWorkerRequest &request, rpc::ReturnWorkerReply *reply,
                rpc::SendReplyCallback send_reply_callback),
               (override));
+  MOCK_METHOD(void, HandleReturnWorkers,
+              (const rpc::ReturnWorkersRequest &request, rpc::ReturnWorkersReply *reply,
+               rpc::SendReplyCallback send_reply_callback),
+              (override));
   MOCK_METHOD(void, HandleReleaseUnusedWorkers,
               (const rpc::ReleaseUnusedWorkersRequest &request,
                rpc::ReleaseUnusedWorkersReply *reply,
@@ -39,6 +39,11 @@ class MockClusterTaskManagerInterface : public ClusterTaskManagerInterface {
               (const RayTask &task, rpc::RequestWorkerLeaseReply *reply,
                rpc::SendReplyCallback send_reply_callback),
               (override));
+  MOCK_METHOD(void, QueueAndScheduleLeases,
+              (const RayTask &task, bool grant_or_reject, int64_t max_leases,
+               rpc::RequestWorkerLeaseReply *reply,
+               rpc::SendReplyCallback send_reply_callback),
+              (override));
   MOCK_METHOD(bool, AnyPendingTasksForResourceAcquisition,
               (RayTask * exemplar, bool *any_pending, int *num_pending_actor_creation,
                int *num_pending_tasks),
@@ -46,6 +51,11 @@ class MockClusterTaskManagerInterface : public ClusterTaskManagerInterface {
   MOCK_METHOD(std::string, DebugStr, (), (const, override));
   MOCK_METHOD(void, RecordMetrics, (), (override));
   MOCK_METHOD(ResourceSet, CalcNormalTaskResources, (), (const, override));
+  MOCK_METHOD(int64_t, TotalBacklogSize, (SchedulingClass scheduling_class),
+              (const, override));
+  MOCK_METHOD(void, HandleJobStarted,
+              (const JobID &job_id, const rpc::JobConfig &job_config), (override));
+  MOCK_METHOD(void, HandleJobFinished, (const JobID &job_id), (override));
 };
 
 }  // namespace raylet
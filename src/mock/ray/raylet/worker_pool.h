@@ -21,6 +21,8 @@ class MockWorkerPoolInterface : public WorkerPoolInterface {
               (const TaskSpecification &task_spec, const PopWorkerCallback &callback,
                const std::string &allocated_instances_serialized_json),
               (override));
+  MOCK_METHOD(size_t, NumIdleWorkersForTask, (const TaskSpecification &task_spec),
+              (override));
   MOCK_METHOD(void, PushWorker, (const std::shared_ptr<WorkerInterface> &worker),
               (override));
   MOCK_METHOD(const std::vector<std::shared_ptr<WorkerInterface>>,
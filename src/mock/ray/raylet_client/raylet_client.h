@@ -41,9 +41,20 @@ class MockWorkerLeaseInterface : public WorkerLeaseInterface {
        const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
        const int64_t backlog_size),
       (override));
+  MOCK_METHOD(
+      void, RequestWorkerLeases,
+      (const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+       int64_t max_leases,
+       const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
+       const int64_t backlog_size, uint64_t reservation_token),
+      (override));
   MOCK_METHOD(ray::Status, ReturnWorker,
               (int worker_port, const WorkerID &worker_id, bool disconnect_worker),
               (override));
+  MOCK_METHOD(ray::Status, ReturnWorkers,
+              ((const std::vector<std::pair<int, WorkerID>> &workers),
+               bool disconnect_worker),
+              (override));
   MOCK_METHOD(void, ReleaseUnusedWorkers,
               (const std::vector<WorkerID> &workers_in_use,
                const rpc::ClientCallback<rpc::ReleaseUnusedWorkersReply> &callback),
@@ -132,10 +143,21 @@ class MockRayletClientInterface : public RayletClientInterface {
        const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
        const int64_t backlog_size),
       (override));
+  MOCK_METHOD(
+      void, RequestWorkerLeases,
+      (const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+       int64_t max_leases,
+       const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
+       const int64_t backlog_size, uint64_t reservation_token),
+      (override));
 
   MOCK_METHOD(ray::Status, ReturnWorker,
               (int worker_port, const WorkerID &worker_id, bool disconnect_worker),
               (override));
+  MOCK_METHOD(ray::Status, ReturnWorkers,
+              ((const std::vector<std::pair<int, WorkerID>> &workers),
+               bool disconnect_worker),
+              (override));
   MOCK_METHOD(void, ReleaseUnusedWorkers,
               (const std::vector<WorkerID> &workers_in_use,
                const rpc::ClientCallback<rpc::ReleaseUnusedWorkersReply> &callback),
@@ -49,6 +49,10 @@ class MockCoreWorkerClientInterface : public ray::pubsub::MockSubscriberClientIn
               (const GetObjectStatusRequest &request,
                const ClientCallback<GetObjectStatusReply> &callback),
               (override));
+  MOCK_METHOD(void, GetObjectStatuses,
+              (const GetObjectStatusesRequest &request,
+               const ClientCallback<GetObjectStatusesReply> &callback),
+              (override));
   MOCK_METHOD(void, WaitForActorOutOfScope,
               (const WaitForActorOutOfScopeRequest &request,
                const ClientCallback<WaitForActorOutOfScopeReply> &callback),
@@ -148,6 +148,29 @@ RAY_CONFIG(uint64_t, actor_creation_min_retries, 3)
 /// It likely indicates a bug in the user code.
 RAY_CONFIG(int64_t, actor_excess_queueing_warn_threshold, 5000)
 
+/// Maximum number of tasks that a caller pushes to an actor before their replies come
+/// back. The remaining tasks stay in the caller's submit queue, and each reply lets one
+/// more task through. A value <=0 disables the limit.
+RAY_CONFIG(int64_t, actor_task_max_in_flight, -1)
+
+/// How long in milliseconds an actor task submission waits for the actor's
+/// max_pending_calls limit to free up before it fails with a backpressure error. 0
+/// fails right away, and a negative value waits until there is room. The frontends
+/// wait before submitting, and Python releases the GIL while it waits. This is read by
+/// each caller, so it can be set per process with the RAY_ environment variable.
+RAY_CONFIG(int64_t, actor_submit_backpressure_wait_ms, 0)
+
+/// Maximum number of queued actor tasks a caller pushes to an actor in one RPC. A value
+/// >1 enables batching: tasks that are queued behind the RPCs in flight are coalesced
+/// into one PushTasks RPC, and at most actor_task_max_rpcs_in_flight RPCs are in flight
+/// to an actor at once. The actor streams back the reply of each task of a batch as
+/// soon as it finishes.
+RAY_CONFIG(uint32_t, max_actor_tasks_per_push_task_batch, 1)
+
+/// Maximum number of PushTask(s) RPCs in flight from a caller to an actor when actor
+/// task batching is enabled.
+RAY_CONFIG(int64_t, actor_task_max_rpcs_in_flight, 16)
+
 /// When trying to resolve an object, the initial period that the raylet will
 /// wait before contacting the object's owner to check if the object is still
 /// available. This is a lower bound on the time to report the loss of an
@@ -202,6 +225,19 @@ RAY_CONFIG(int64_t, kill_worker_timeout_milliseconds, 100)
 /// starting_worker_timeout_callback() is called.
 RAY_CONFIG(int64_t, worker_register_timeout_seconds, 30)
 
+/// Whether to fork Python workers from a per-job zygote process that has already
+/// imported Ray, instead of starting a new interpreter for every worker. Only
+/// supported on Linux.
+RAY_CONFIG(bool, worker_zygote_enabled, false)
+
+/// Comma separated list of modules that worker zygotes import before forking workers,
+/// in addition to Ray.
+RAY_CONFIG(std::string, worker_zygote_preload_modules, "")
+
+/// The timeout for a worker zygote to fork a worker. Workers of the job are started
+/// without the zygote after it times out.
+RAY_CONFIG(int64_t, worker_zygote_fork_timeout_ms, 1000)
+
 /// The maximum number of workers to iterate whenever we analyze the resources usage.
 RAY_CONFIG(uint32_t, worker_max_resource_analysis_iteration, 128);
 
@@ -331,9 +367,33 @@ RAY_CONFIG(int64_t, task_rpc_inlined_bytes_limit, 10 * 1024 * 1024)
 /// pipelining task submission.
 RAY_CONFIG(uint32_t, max_tasks_in_flight_per_worker, 1)
 
+/// Maximum number of queued tasks an owner pushes to a leased worker in one RPC. A
+/// value >1 enables batched task submission, which only takes effect if
+/// max_tasks_in_flight_per_worker is >1 as well, since a batch never holds more tasks
+/// than can be in flight to the worker. The worker streams back the reply of each task
+/// of a batch as soon as it finishes.
+RAY_CONFIG(uint32_t, max_tasks_per_push_task_batch, 1)
+
+/// How long a worker keeps the replies to a batch of pushed tasks while the caller
+/// doesn't ask for them, e.g., because the caller died. The caller of an actor whose
+/// requests for the replies fail keeps asking for twice as long, until the actor has
+/// forgotten them, before it fails the tasks that weren't replied to.
+RAY_CONFIG(int64_t, push_tasks_batch_poll_timeout_ms, 60000)
+
+/// How long the caller of an actor waits before it asks for the replies to a batch of
+/// pushed tasks again, after the request for them failed.
+RAY_CONFIG(int64_t, push_tasks_batch_repoll_delay_ms, 100)
+
 /// Maximum number of pending lease requests per scheduling category
 RAY_CONFIG(uint64_t, max_pending_lease_requests_per_scheduling_category, 10)
 
+/// Maximum number of workers a lease request may ask for. If greater than 1, a worker
+/// asks for a worker for each of its queued tasks of a scheduling category that doesn't
+/// have a pending lease yet, up to this number per request. The raylet grants the
+/// additional workers only from its idle workers, in the same reply. See
+/// cluster_task_manager_benchmark for the lease throughput per value.
+RAY_CONFIG(uint64_t, max_leases_per_lease_request, 1)
+
 /// Interval to restart dashboard agent after the process exit.
 RAY_CONFIG(uint32_t, agent_restart_interval_ms, 1000)
 
@@ -364,6 +424,27 @@ RAY_CONFIG(uint64_t, kill_idle_workers_interval_ms, 200)
 /// The idle time threshold for an idle worker to be killed.
 RAY_CONFIG(int64_t, idle_worker_killing_time_threshold_ms, 1000)
 
+/// The maximum number of idle workers to keep warm for each job and runtime env.
+/// Idle workers with a runtime env beyond this are killed least recently used first,
+/// even if the soft limit of workers is not reached. Value of 0 means no limit, which
+/// is the default.
+RAY_CONFIG(int64_t, max_idle_workers_per_runtime_env, 0)
+
+/// Whether to size the pool of idle workers of each job by its predicted demand. If
+/// enabled, the worker pool predicts the peak number of workers that the job leases at
+/// once per `worker_demand_estimation_interval_ms`, prestarts idle workers up to that
+/// number minus the workers already leased, keeps that many workers idle, and kills
+/// the idle workers beyond it even if the soft limit of workers is not reached. This
+/// only applies to workers without a runtime env.
+RAY_CONFIG(bool, worker_demand_prediction_enabled, false)
+
+/// The interval over which the peak number of leased workers is taken to predict the
+/// demand.
+RAY_CONFIG(int64_t, worker_demand_estimation_interval_ms, 1000)
+
+/// The weight of the latest interval in the moving average of leased worker peaks.
+RAY_CONFIG(double, worker_demand_ewma_alpha, 0.3)
+
 /// The soft limit of the number of workers.
 /// -1 means using num_cpus instead.
 RAY_CONFIG(int64_t, num_workers_soft_limit, -1)
@@ -442,6 +523,21 @@ RAY_CONFIG(int, publish_batch_size, 5000)
 /// The maximum command batch size.
 RAY_CONFIG(int64_t, max_command_batch_size, 2000)
 
+/// The window in milliseconds within which a borrower coalesces the ref removed
+/// messages for the objects of the same owner into one message. Set to 0 to send
+/// one message per object as soon as it is no longer borrowed, which is the default.
+RAY_CONFIG(uint64_t, ref_removed_flush_window_ms, 0)
+
+/// The window in milliseconds within which a borrower coalesces the requests for the
+/// status of objects of the same owner into one GetObjectStatuses request. The owner
+/// also waits this long after the first of the objects is ready before it replies, to
+/// send more of them at once. Set to 0 to send one GetObjectStatus request per object,
+/// which is the default.
+RAY_CONFIG(uint64_t, object_status_batch_window_ms, 0)
+
+/// The maximum number of objects in one GetObjectStatuses request.
+RAY_CONFIG(uint64_t, object_status_max_batch_size, 500)
+
 /// The maximum batch size for OBOD report.
 RAY_CONFIG(int64_t, max_object_report_batch_size, 2000)
 
@@ -517,6 +613,47 @@ RAY_CONFIG(std::string, event_level, "warning")
 /// Whether to avoid scheduling cpu requests on gpu nodes
 RAY_CONFIG(bool, scheduler_avoid_gpu_nodes, true)
 
+/// Whether the hybrid scheduling policy evaluates requests against a columnar copy of
+/// the cluster's resources instead of the per-node resource maps.
+RAY_CONFIG(bool, scheduler_use_columnar_resource_table, true)
+
+/// The maximum number of resource shapes for which the scheduler keeps an incrementally
+/// updated ranking of the nodes. Requires scheduler_use_columnar_resource_table. Each
+/// change of a node's resources, including local allocations, re-ranks the node for
+/// every indexed shape. Value of 0 disables the index, so every scheduling decision
+/// scores all nodes, which is the default.
+RAY_CONFIG(uint64_t, scheduler_candidate_index_max_shapes, 0)
+
+/// Whether the raylet schedules runs of identical pending tasks with a single
+/// multi-node decision instead of running the scheduling policy once per task.
+RAY_CONFIG(bool, scheduler_batch_pending_tasks, true)
+
+/// If greater than 0, the raylet picks nodes by scoring the local node and this many
+/// randomly sampled remote nodes instead of traversing the whole cluster on every
+/// scheduling decision. Requires scheduler_use_columnar_resource_table.
+RAY_CONFIG(uint64_t, scheduler_power_of_d_choices, 0)
+
+/// How long a raylet keeps the resources of a task it spilled back reserved in its view
+/// of the target node if the target doesn't report that it handled the lease request.
+/// Until then, reserved resources are subtracted from the node's resource reports, so
+/// that reports sent before the task arrived don't cause more spillbacks to the node.
+/// Set to 0 to only subtract the resources until the next report, which is the
+/// default.
+RAY_CONFIG(uint64_t, scheduler_spillback_reservation_timeout_ms, 0)
+
+/// Whether raylets dispatch the queued tasks of different jobs by weighted fair sharing
+/// instead of by scheduling class. Jobs get a share of the workers of each node that
+/// is proportional to the `scheduling_weight` in their job config, after their
+/// `min_scheduling_share`.
+RAY_CONFIG(bool, scheduler_job_fair_sharing, false)
+
+/// Whether task specs built by the core worker are allocated from a per-spec protobuf
+/// arena, which turns the many small allocations of building and destroying a spec
+/// into a few block allocations. This speeds up submitting tasks with args, but each
+/// spec holds somewhat more memory while its task is in flight, see
+/// task_spec_benchmark.
+RAY_CONFIG(bool, task_spec_arena_enabled, false)
+
 /// Whether to skip running local GC in runtime env.
 RAY_CONFIG(bool, runtime_env_skip_local_gc, false)
 
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "absl/time/clock.h"
 #include "absl/types/optional.h"
 #include "ray/common/buffer.h"
@@ -61,6 +63,24 @@ class RayObject {
   /// \param[in] ray_error_info The error information that this object body contains.
   RayObject(rpc::ErrorType error_type, const rpc::RayErrorInfo *ray_error_info = nullptr);
 
+  RayObject(const RayObject &other)
+      : data_(other.data_),
+        metadata_(other.metadata_),
+        nested_refs_(other.nested_refs_),
+        has_data_copy_(other.has_data_copy_),
+        accessed_(other.WasAccessed()),
+        creation_time_nanos_(other.creation_time_nanos_) {}
+
+  RayObject &operator=(const RayObject &other) {
+    data_ = other.data_;
+    metadata_ = other.metadata_;
+    nested_refs_ = other.nested_refs_;
+    has_data_copy_ = other.has_data_copy_;
+    accessed_.store(other.WasAccessed(), std::memory_order_relaxed);
+    creation_time_nanos_ = other.creation_time_nanos_;
+    return *this;
+  }
+
   /// Return the data of the ray object.
   const std::shared_ptr<Buffer> &GetData() const { return data_; }
 
@@ -90,11 +110,11 @@ class RayObject {
   /// large to return directly as part of a gRPC response).
   bool IsInPlasmaError() const;
 
-  /// Mark this object as accessed before.
-  void SetAccessed() { accessed_ = true; };
+  /// Mark this object as accessed before. This is thread-safe.
+  void SetAccessed() { accessed_.store(true, std::memory_order_relaxed); };
 
-  /// Check if this object was accessed before.
-  bool WasAccessed() const { return accessed_; }
+  /// Check if this object was accessed before. This is thread-safe.
+  bool WasAccessed() const { return accessed_.load(std::memory_order_relaxed); }
 
   /// Return the absl time in nanoseconds when this object was created.
   int64_t CreationTimeNanos() const { return creation_time_nanos_; }
@@ -131,8 +151,9 @@ class RayObject {
   std::vector<rpc::ObjectReference> nested_refs_;
   /// Whether this class holds a data copy.
   bool has_data_copy_;
-  /// Whether this object was accessed.
-  bool accessed_ = false;
+  /// Whether this object was accessed. Readers of an object may set this without
+  /// holding the lock of the store that holds the object, so it is atomic.
+  std::atomic<bool> accessed_{false};
   /// The timestamp at which this object was created locally.
   int64_t creation_time_nanos_;
 };
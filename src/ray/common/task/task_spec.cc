@@ -14,6 +14,10 @@
 
 #include "ray/common/task/task_spec.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
 #include <boost/functional/hash.hpp>
 #include <sstream>
 
@@ -22,40 +26,48 @@
 
 namespace ray {
 
-absl::Mutex TaskSpecification::mutex_;
-absl::flat_hash_map<SchedulingClassDescriptor, SchedulingClass>
-    TaskSpecification::sched_cls_to_id_;
-absl::flat_hash_map<SchedulingClass, SchedulingClassDescriptor>
-    TaskSpecification::sched_id_to_cls_;
-int TaskSpecification::next_sched_id_;
+namespace {
+
+/// Append the message to `output`, serializing map fields in key order, so that equal
+/// specs always serialize to equal bytes.
+void AppendDeterministic(const rpc::TaskSpec &message, std::string *output) {
+  google::protobuf::io::StringOutputStream stream(output);
+  google::protobuf::io::CodedOutputStream coded_stream(&stream);
+  coded_stream.SetSerializationDeterministic(true);
+  message.SerializeToCodedStream(&coded_stream);
+}
+
+}  // namespace
 
-SchedulingClassDescriptor &TaskSpecification::GetSchedulingClassDescriptor(
+InternTable<SchedulingClassDescriptor> TaskSpecification::sched_cls_table_;
+InternTable<ResourceSet> TaskSpecification::resource_set_table_;
+
+const ResourceSet *TaskSpecification::InternResourceSet(
+    const google::protobuf::Map<std::string, double> &resources) {
+  if (resources.empty()) {
+    // A static nil object is used here to avoid allocating the empty object every time.
+    return ResourceSet::Nil().get();
+  }
+  int64_t id = resource_set_table_.GetOrInsert(ResourceSet(MapFromProtobuf(resources)));
+  return &resource_set_table_.Get(id);
+}
+
+const SchedulingClassDescriptor &TaskSpecification::GetSchedulingClassDescriptor(
     SchedulingClass id) {
-  absl::MutexLock lock(&mutex_);
-  auto it = sched_id_to_cls_.find(id);
-  RAY_CHECK(it != sched_id_to_cls_.end()) << "invalid id: " << id;
-  return it->second;
+  return sched_cls_table_.Get(id);
 }
 
 SchedulingClass TaskSpecification::GetSchedulingClass(
     const SchedulingClassDescriptor &sched_cls) {
-  SchedulingClass sched_cls_id;
-  absl::MutexLock lock(&mutex_);
-  auto it = sched_cls_to_id_.find(sched_cls);
-  if (it == sched_cls_to_id_.end()) {
-    sched_cls_id = ++next_sched_id_;
-    // TODO(ekl) we might want to try cleaning up task types in these cases
-    if (sched_cls_id > 100) {
-      RAY_LOG(WARNING) << "More than " << sched_cls_id
-                       << " types of tasks seen, this may reduce performance.";
-    } else if (sched_cls_id > 1000) {
-      RAY_LOG(ERROR) << "More than " << sched_cls_id
+  bool inserted;
+  SchedulingClass sched_cls_id = sched_cls_table_.GetOrInsert(sched_cls, &inserted);
+  // TODO(ekl) we might want to try cleaning up task types in these cases
+  if (inserted && sched_cls_id > 100) {
+    RAY_LOG(WARNING) << "More than " << sched_cls_id
                      << " types of tasks seen, this may reduce performance.";
-    }
-    sched_cls_to_id_[sched_cls] = sched_cls_id;
-    sched_id_to_cls_.emplace(sched_cls_id, sched_cls);
-  } else {
-    sched_cls_id = it->second;
+  } else if (inserted && sched_cls_id > 1000) {
+    RAY_LOG(ERROR) << "More than " << sched_cls_id
+                   << " types of tasks seen, this may reduce performance.";
   }
   return sched_cls_id;
 }
@@ -90,23 +102,16 @@ bool TaskSpecification::PlacementGroupCaptureChildTasks() const {
 
 void TaskSpecification::ComputeResources() {
   auto &required_resources = message_->required_resources();
+  required_resources_ = InternResourceSet(required_resources);
 
-  if (required_resources.empty()) {
-    // A static nil object is used here to avoid allocating the empty object every time.
-    required_resources_ = ResourceSet::Nil();
+  if (message_->required_placement_resources().empty()) {
+    // Alias the interned set, which outlives the spec, without owning it.
+    required_placement_resources_ =
+        std::shared_ptr<const ResourceSet>(std::shared_ptr<const ResourceSet>(),
+                                           required_resources_);
   } else {
-    required_resources_.reset(new ResourceSet(MapFromProtobuf(required_resources)));
-  }
-
-  auto &required_placement_resources = message_->required_placement_resources().empty()
-                                           ? required_resources
-                                           : message_->required_placement_resources();
-
-  if (required_placement_resources.empty()) {
-    required_placement_resources_ = ResourceSet::Nil();
-  } else {
-    required_placement_resources_.reset(
-        new ResourceSet(MapFromProtobuf(required_placement_resources)));
+    required_placement_resources_ = std::make_shared<const ResourceSet>(
+        MapFromProtobuf(message_->required_placement_resources()));
   }
 
   if (!IsActorTask()) {
@@ -115,13 +120,54 @@ void TaskSpecification::ComputeResources() {
     const auto &resource_set = GetRequiredResources();
     const auto &function_descriptor = FunctionDescriptor();
     auto depth = GetDepth();
-    auto sched_cls_desc =
-        SchedulingClassDescriptor(resource_set, function_descriptor, depth);
+    const int runtime_env_hash = HasRuntimeEnv() ? GetRuntimeEnvHash() : 0;
+    auto sched_cls_desc = SchedulingClassDescriptor(resource_set, function_descriptor,
+                                                    depth, runtime_env_hash);
     // Map the scheduling class descriptor to an integer for performance.
     sched_cls_id_ = GetSchedulingClass(sched_cls_desc);
   }
 }
 
+rpc::TaskSpec &TaskSpecification::GetMutableMessage() {
+  if (serialized_message_ != nullptr) {
+    absl::MutexLock lock(&serialized_message_->mutex);
+    serialized_message_->valid = false;
+    serialized_message_->bytes.clear();
+    serialized_message_->bytes.shrink_to_fit();
+  }
+  return *message_;
+}
+
+void TaskSpecification::AppendSerializedMessage(std::string *output) const {
+  if (serialized_message_ == nullptr) {
+    AppendDeterministic(*message_, output);
+    return;
+  }
+  uint64_t attempt_number;
+  {
+    absl::MutexLock lock(&serialized_message_->mutex);
+    if (!serialized_message_->valid) {
+      serialized_message_->bytes.clear();
+      AppendDeterministic(*message_, &serialized_message_->bytes);
+      serialized_message_->attempt_number = message_->attempt_number();
+      serialized_message_->valid = true;
+    }
+    output->append(serialized_message_->bytes);
+    attempt_number = serialized_message_->attempt_number;
+  }
+  if (message_->attempt_number() != attempt_number) {
+    google::protobuf::io::StringOutputStream stream(output);
+    google::protobuf::io::CodedOutputStream coded_stream(&stream);
+    google::protobuf::internal::WireFormatLite::WriteUInt64(
+        rpc::TaskSpec::kAttemptNumberFieldNumber, message_->attempt_number(),
+        &coded_stream);
+  }
+}
+
+void TaskSpecification::SetAttemptNumber(uint64_t attempt_number) {
+  message_->set_attempt_number(attempt_number);
+}
+
 // Task specification getter methods.
 TaskID TaskSpecification::TaskId() const {
   if (message_->task_id().empty() /* e.g., empty proto default */) {
@@ -152,6 +198,11 @@ TaskID TaskSpecification::ParentTaskId() const {
 size_t TaskSpecification::ParentCounter() const { return message_->parent_counter(); }
 
 ray::FunctionDescriptor TaskSpecification::FunctionDescriptor() const {
+  if (sched_cls_id_ > 0) {
+    // Tasks of the same scheduling class have equal function descriptors, so share
+    // the interned one instead of rebuilding it from the proto on every call.
+    return sched_cls_table_.Get(sched_cls_id_).function_descriptor;
+  }
   return ray::FunctionDescriptorBuilder::FromProto(message_->function_descriptor());
 }
 
@@ -170,6 +221,9 @@ bool TaskSpecification::HasRuntimeEnv() const {
 uint64_t TaskSpecification::AttemptNumber() const { return message_->attempt_number(); }
 
 int TaskSpecification::GetRuntimeEnvHash() const {
+  if (sched_cls_id_ > 0 && HasRuntimeEnv()) {
+    return sched_cls_table_.Get(sched_cls_id_).runtime_env_hash;
+  }
   absl::flat_hash_map<std::string, double> required_resource;
   if (RayConfig::instance().worker_resource_limits_enabled()) {
     required_resource = GetRequiredResources().GetResourceMap();
@@ -19,12 +19,14 @@
 #include <unordered_map>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "ray/common/function_descriptor.h"
 #include "ray/common/grpc_util.h"
 #include "ray/common/id.h"
 #include "ray/common/task/scheduling_resources.h"
 #include "ray/common/task/task_common.h"
+#include "ray/util/intern_table.h"
 
 extern "C" {
 #include "ray/thirdparty/sha256.h"
@@ -34,14 +36,28 @@ typedef int SchedulingClass;
 
 struct SchedulingClassDescriptor {
  public:
-  explicit SchedulingClassDescriptor(ResourceSet rs, FunctionDescriptor fd, int64_t d)
-      : resource_set(std::move(rs)), function_descriptor(std::move(fd)), depth(d) {}
-  ResourceSet resource_set;
-  FunctionDescriptor function_descriptor;
-  int64_t depth;
+  explicit SchedulingClassDescriptor(ResourceSet rs, FunctionDescriptor fd, int64_t d,
+                                     int runtime_env_hash = 0)
+      : resource_set(std::move(rs)),
+        function_descriptor(std::move(fd)),
+        depth(d),
+        runtime_env_hash(runtime_env_hash),
+        hash(ComputeHash(resource_set, function_descriptor, depth, runtime_env_hash)) {}
+  // The fields are const so that the cached hash stays valid.
+  const ResourceSet resource_set;
+  const FunctionDescriptor function_descriptor;
+  const int64_t depth;
+  /// The hash of the runtime env, or 0 if there is none. Tasks with different
+  /// runtime envs need different workers, so they are in different classes.
+  const int runtime_env_hash;
+  /// Cached hash of the fields above, since descriptors are hashed on every task
+  /// construction.
+  const size_t hash;
 
   bool operator==(const SchedulingClassDescriptor &other) const {
-    return depth == other.depth && resource_set == other.resource_set &&
+    return hash == other.hash && depth == other.depth &&
+           runtime_env_hash == other.runtime_env_hash &&
+           resource_set == other.resource_set &&
            function_descriptor == other.function_descriptor;
   }
 
@@ -49,6 +65,7 @@ struct SchedulingClassDescriptor {
     std::stringstream buffer;
     buffer << "{"
            << "depth=" << depth << " "
+           << "runtime_env_hash=" << runtime_env_hash << " "
            << "function_descriptor=" << function_descriptor->ToString() << " "
            << "resource_set="
            << "{";
@@ -58,6 +75,17 @@ struct SchedulingClassDescriptor {
     buffer << "}}";
     return buffer.str();
   }
+
+ private:
+  static size_t ComputeHash(const ResourceSet &resource_set,
+                            const FunctionDescriptor &function_descriptor, int64_t depth,
+                            int runtime_env_hash) {
+    size_t hash = std::hash<ResourceSet>()(resource_set);
+    hash ^= function_descriptor->Hash();
+    hash ^= depth;
+    hash ^= std::hash<int>()(runtime_env_hash) << 1;
+    return hash;
+  }
 };
 }  // namespace ray
 
@@ -65,10 +93,7 @@ namespace std {
 template <>
 struct hash<ray::SchedulingClassDescriptor> {
   size_t operator()(const ray::SchedulingClassDescriptor &sched_cls) const {
-    size_t hash = std::hash<ray::ResourceSet>()(sched_cls.resource_set);
-    hash ^= sched_cls.function_descriptor->Hash();
-    hash ^= sched_cls.depth;
-    return hash;
+    return sched_cls.hash;
   }
 };
 }  // namespace std
@@ -120,11 +145,14 @@ class TaskSpecification : public MessageWrapper<rpc::TaskSpec> {
   ///
   /// \param message The protobuf message.
   explicit TaskSpecification(rpc::TaskSpec &&message)
-      : MessageWrapper(std::move(message)) {
+      : MessageWrapper(std::move(message)),
+        serialized_message_(std::make_shared<SerializedMessage>()) {
     ComputeResources();
   }
 
-  explicit TaskSpecification(const rpc::TaskSpec &message) : MessageWrapper(message) {
+  explicit TaskSpecification(const rpc::TaskSpec &message)
+      : MessageWrapper(message),
+        serialized_message_(std::make_shared<SerializedMessage>()) {
     ComputeResources();
   }
 
@@ -132,7 +160,8 @@ class TaskSpecification : public MessageWrapper<rpc::TaskSpec> {
   ///
   /// \param message The protobuf message.
   explicit TaskSpecification(std::shared_ptr<rpc::TaskSpec> message)
-      : MessageWrapper(message) {
+      : MessageWrapper(message),
+        serialized_message_(std::make_shared<SerializedMessage>()) {
     ComputeResources();
   }
 
@@ -140,10 +169,31 @@ class TaskSpecification : public MessageWrapper<rpc::TaskSpec> {
   ///
   /// \param serialized_binary Protobuf-serialized binary.
   explicit TaskSpecification(const std::string &serialized_binary)
-      : MessageWrapper(serialized_binary) {
+      : MessageWrapper(serialized_binary),
+        serialized_message_(std::make_shared<SerializedMessage>()) {
     ComputeResources();
   }
 
+  /// Get a mutable reference to the message. This drops the serialized message
+  /// cached by `AppendSerializedMessage`, since the caller may change any field.
+  rpc::TaskSpec &GetMutableMessage();
+
+  /// Append the serialized message to `output`, as it would be serialized in a
+  /// `TaskSpec` field of an RPC request. The message is serialized on the first call
+  /// only, and the bytes are shared by all copies of this spec, so that pushing the
+  /// task again when it is retried or stolen doesn't copy and serialize the whole spec
+  /// again. A changed attempt number is patched in by appending the field to the
+  /// cached bytes, since the last value of a field wins when the message is parsed.
+  /// Map fields are serialized in key order, so that equal specs serialize to equal
+  /// bytes, which lineage compaction relies on to share their common fields.
+  ///
+  /// \param[out] output The string to append the serialized message to.
+  void AppendSerializedMessage(std::string *output) const;
+
+  /// Set the attempt number of the task. Unlike other changes to the message, this
+  /// keeps the cached serialized message.
+  void SetAttemptNumber(uint64_t attempt_number);
+
   // TODO(swang): Finalize and document these methods.
   TaskID TaskId() const;
 
@@ -290,7 +340,8 @@ class TaskSpecification : public MessageWrapper<rpc::TaskSpec> {
   std::string CallSiteString() const;
 
   // Lookup the resource shape that corresponds to the static key.
-  static SchedulingClassDescriptor &GetSchedulingClassDescriptor(SchedulingClass id);
+  static const SchedulingClassDescriptor &GetSchedulingClassDescriptor(
+      SchedulingClass id);
 
   // Compute a static key that represents the given resource shape.
   static SchedulingClass GetSchedulingClass(const SchedulingClassDescriptor &sched_cls);
@@ -311,24 +362,42 @@ class TaskSpecification : public MessageWrapper<rpc::TaskSpec> {
  private:
   void ComputeResources();
 
-  /// Field storing required resources. Initialized in constructor.
-  /// TODO(ekl) consider optimizing the representation of ResourceSet for fast copies
-  /// instead of keeping shared pointers here.
-  std::shared_ptr<ResourceSet> required_resources_;
-  /// Field storing required placement resources. Initialized in constructor.
-  std::shared_ptr<ResourceSet> required_placement_resources_;
+  /// Return the interned resource set equal to the given resource map. The
+  /// returned pointer stays valid for the lifetime of the process.
+  static const ResourceSet *InternResourceSet(
+      const google::protobuf::Map<std::string, double> &resources);
+
+  /// Field storing required resources. Initialized in constructor. Points into
+  /// `resource_set_table_`, so tasks with the same resource demand share one set.
+  const ResourceSet *required_resources_ = nullptr;
+  /// Field storing required placement resources. Initialized in constructor. These
+  /// are not interned, because they name the placement group bundles of actors, so
+  /// they are rarely shared and an interned copy would never be freed. Tasks that
+  /// don't set them share `required_resources_` instead.
+  std::shared_ptr<const ResourceSet> required_placement_resources_;
   /// Cached scheduling class of this task.
   SchedulingClass sched_cls_id_ = 0;
 
-  /// Below static fields could be mutated in `ComputeResources` concurrently due to
-  /// multi-threading, we need a mutex to protect it.
-  static absl::Mutex mutex_;
-  /// Keep global static id mappings for SchedulingClass for performance.
-  static absl::flat_hash_map<SchedulingClassDescriptor, SchedulingClass> sched_cls_to_id_
-      GUARDED_BY(mutex_);
-  static absl::flat_hash_map<SchedulingClass, SchedulingClassDescriptor> sched_id_to_cls_
-      GUARDED_BY(mutex_);
-  static int next_sched_id_ GUARDED_BY(mutex_);
+  /// The serialized message, cached by `AppendSerializedMessage`.
+  struct SerializedMessage {
+    absl::Mutex mutex;
+    /// Whether `bytes` holds the serialized message.
+    bool valid GUARDED_BY(mutex) = false;
+    std::string bytes GUARDED_BY(mutex);
+    /// The attempt number that was serialized in `bytes`.
+    uint64_t attempt_number GUARDED_BY(mutex) = 0;
+  };
+  /// Shared by the copies of this spec, which share its message. This is null for a
+  /// default-constructed spec, which isn't cached.
+  std::shared_ptr<SerializedMessage> serialized_message_;
+
+  /// Keep global static id mappings for SchedulingClass for performance. Tasks are
+  /// constructed concurrently from many threads, so lookups of known scheduling
+  /// classes are wait-free and only new classes take a lock.
+  static InternTable<SchedulingClassDescriptor> sched_cls_table_;
+  /// Interned resource sets. Millions of queued tasks typically carry only a
+  /// handful of distinct resource demands.
+  static InternTable<ResourceSet> resource_set_table_;
 };
 
 /// \class WorkerCacheKey
@@ -14,7 +14,15 @@
 
 #pragma once
 
+#include <google/protobuf/arena.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "ray/common/buffer.h"
+#include "ray/common/ray_config.h"
 #include "ray/common/ray_object.h"
 #include "ray/common/task/task_spec.h"
 #include "src/ray/protobuf/common.pb.h"
@@ -81,13 +89,89 @@ class TaskArgByValue : public TaskArg {
   const std::shared_ptr<RayObject> value_;
 };
 
+/// Interns immutable protobuf messages that many task specs carry unchanged, such as
+/// the function descriptor and the caller address, so that the specs can point to one
+/// copy of each instead of holding their own. An interned message is freed with the
+/// last spec that points to it.
+///
+/// This class is thread safe.
+template <typename Message>
+class SharedMessageTable {
+ public:
+  /// Get the shared copy of a message.
+  ///
+  /// \param message The message to look up.
+  /// \return The copy of the message that is shared by all callers that pass an equal
+  /// message. It must not be modified.
+  static std::shared_ptr<const Message> Get(const Message &message) {
+    std::string key = message.SerializeAsString();
+    // A thread usually builds many specs with the same fields in a row, so the last
+    // message it got is checked without taking the lock. This keeps that message
+    // alive until the thread gets another one.
+    thread_local std::string last_key;
+    thread_local std::shared_ptr<const Message> last_message;
+    if (last_message != nullptr && key == last_key) {
+      return last_message;
+    }
+    static SharedMessageTable table;
+    last_message = table.GetOrInsert(key, message);
+    last_key = std::move(key);
+    return last_message;
+  }
+
+ private:
+  std::shared_ptr<const Message> GetOrInsert(const std::string &key,
+                                             const Message &message) {
+    absl::MutexLock lock(&mutex_);
+    auto &entry = messages_[key];
+    auto shared = entry.lock();
+    if (shared == nullptr) {
+      shared = std::make_shared<const Message>(message);
+      entry = shared;
+      if (messages_.size() > 2 * num_messages_after_cleanup_ + kMinCleanupSize) {
+        RemoveFreedMessages();
+      }
+    }
+    return shared;
+  }
+
+  /// Remove the entries of the messages that are no longer used by any spec.
+  void RemoveFreedMessages() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    for (auto it = messages_.begin(); it != messages_.end();) {
+      if (it->second.expired()) {
+        messages_.erase(it++);
+      } else {
+        it++;
+      }
+    }
+    num_messages_after_cleanup_ = messages_.size();
+  }
+
+  static constexpr size_t kMinCleanupSize = 64;
+
+  absl::Mutex mutex_;
+
+  /// The interned messages by their serialized bytes.
+  absl::flat_hash_map<std::string, std::weak_ptr<const Message>> messages_
+      GUARDED_BY(mutex_);
+
+  /// The number of entries after freed messages were last removed.
+  size_t num_messages_after_cleanup_ GUARDED_BY(mutex_) = 0;
+};
+
 /// Helper class for building a `TaskSpecification` object.
 class TaskSpecBuilder {
  public:
-  TaskSpecBuilder() : message_(std::make_shared<rpc::TaskSpec>()) {}
+  TaskSpecBuilder()
+      : storage_(NewTaskSpecStorage()), message_(storage_, storage_->message) {}
 
   /// Build the `TaskSpecification` object.
-  TaskSpecification Build() { return TaskSpecification(message_); }
+  TaskSpecification Build() {
+    if (auto *arena = message_->GetArena()) {
+      RecordArenaBytesUsed(arena->SpaceUsed());
+    }
+    return TaskSpecification(message_);
+  }
 
   /// Get a reference to the internal protobuf message object.
   const rpc::TaskSpec &GetMessage() const { return *message_; }
@@ -110,13 +194,13 @@ class TaskSpecBuilder {
     message_->set_type(TaskType::NORMAL_TASK);
     message_->set_name(name);
     message_->set_language(language);
-    *message_->mutable_function_descriptor() = function_descriptor->GetMessage();
+    SetFunctionDescriptor(function_descriptor->GetMessage());
     message_->set_job_id(job_id.Binary());
     message_->set_task_id(task_id.Binary());
     message_->set_parent_task_id(parent_task_id.Binary());
     message_->set_parent_counter(parent_counter);
     message_->set_caller_id(caller_id.Binary());
-    message_->mutable_caller_address()->CopyFrom(caller_address);
+    SetCallerAddress(caller_address);
     message_->set_num_returns(num_returns);
     message_->mutable_required_resources()->insert(required_resources.begin(),
                                                    required_resources.end());
@@ -124,11 +208,12 @@ class TaskSpecBuilder {
         required_placement_resources.begin(), required_placement_resources.end());
     message_->set_debugger_breakpoint(debugger_breakpoint);
     message_->set_depth(depth);
-    message_->mutable_runtime_env_info()->set_serialized_runtime_env(
-        serialized_runtime_env);
+    rpc::RuntimeEnvInfo runtime_env_info;
+    runtime_env_info.set_serialized_runtime_env(serialized_runtime_env);
     for (const std::string &uri : runtime_env_uris) {
-      message_->mutable_runtime_env_info()->add_uris(uri);
+      runtime_env_info.add_uris(uri);
     }
+    SetRuntimeEnvInfo(runtime_env_info);
     message_->set_concurrency_group_name(concurrency_group_name);
     return *this;
   }
@@ -156,7 +241,7 @@ class TaskSpecBuilder {
     message_->set_parent_task_id(parent_task_id.Binary());
     message_->set_parent_counter(0);
     message_->set_caller_id(caller_id.Binary());
-    message_->mutable_caller_address()->CopyFrom(caller_address);
+    SetCallerAddress(caller_address);
     message_->set_num_returns(0);
     return *this;
   }
@@ -231,6 +316,127 @@ class TaskSpecBuilder {
   }
 
  private:
+  /// The message of a spec, and the messages that it shares with other specs. The
+  /// message points to the shared messages but doesn't own them.
+  struct TaskSpecStorage {
+    ~TaskSpecStorage() {
+      if (arena == nullptr) {
+        // Take the shared messages out before the message deletes its fields.
+        if (function_descriptor != nullptr) {
+          message->unsafe_arena_release_function_descriptor();
+        }
+        if (caller_address != nullptr) {
+          message->unsafe_arena_release_caller_address();
+        }
+        if (runtime_env_info != nullptr) {
+          message->unsafe_arena_release_runtime_env_info();
+        }
+        delete message;
+      }
+    }
+
+    std::shared_ptr<const rpc::FunctionDescriptor> function_descriptor;
+    std::shared_ptr<const rpc::Address> caller_address;
+    std::shared_ptr<const rpc::RuntimeEnvInfo> runtime_env_info;
+    /// The arena that the message is allocated from, or null if it's on the heap. This
+    /// is destroyed before the shared messages.
+    std::unique_ptr<google::protobuf::Arena> arena;
+    rpc::TaskSpec *message = nullptr;
+  };
+
+  /// Allocate the storage of a task spec message. When `task_spec_arena_enabled` is
+  /// set, the message and all the args, strings and addresses nested in it are bump
+  /// allocated from an arena, so the whole spec is freed at once when the last
+  /// `TaskSpecification` sharing it goes away.
+  static std::shared_ptr<TaskSpecStorage> NewTaskSpecStorage() {
+    auto storage = std::make_shared<TaskSpecStorage>();
+    if (!RayConfig::instance().task_spec_arena_enabled()) {
+      storage->message = new rpc::TaskSpec();
+      return storage;
+    }
+    google::protobuf::ArenaOptions options;
+    // The unused rest of the first block is held for as long as the spec, so size it
+    // to fit the specs built recently rather than to a fixed size.
+    options.start_block_size = ExpectedArenaBytes().load(std::memory_order_relaxed);
+    storage->arena = std::make_unique<google::protobuf::Arena>(options);
+    storage->message =
+        google::protobuf::Arena::CreateMessage<rpc::TaskSpec>(storage->arena.get());
+    return storage;
+  }
+
+  // The unsafe allocating in the setters below is safe because the storage keeps the
+  // shared messages alive for as long as the spec, and takes them out of the message
+  // before it is deleted. Nothing modifies these fields of a spec after it is built.
+
+  void SetFunctionDescriptor(const rpc::FunctionDescriptor &function_descriptor) {
+    auto shared = SharedMessageTable<rpc::FunctionDescriptor>::Get(function_descriptor);
+    if (storage_->function_descriptor != nullptr) {
+      message_->unsafe_arena_release_function_descriptor();
+    }
+    message_->unsafe_arena_set_allocated_function_descriptor(
+        const_cast<rpc::FunctionDescriptor *>(shared.get()));
+    storage_->function_descriptor = std::move(shared);
+  }
+
+  void SetCallerAddress(const rpc::Address &caller_address) {
+    auto shared = SharedMessageTable<rpc::Address>::Get(caller_address);
+    if (storage_->caller_address != nullptr) {
+      message_->unsafe_arena_release_caller_address();
+    }
+    message_->unsafe_arena_set_allocated_caller_address(
+        const_cast<rpc::Address *>(shared.get()));
+    storage_->caller_address = std::move(shared);
+  }
+
+  void SetRuntimeEnvInfo(const rpc::RuntimeEnvInfo &runtime_env_info) {
+    auto shared = SharedMessageTable<rpc::RuntimeEnvInfo>::Get(runtime_env_info);
+    if (storage_->runtime_env_info != nullptr) {
+      message_->unsafe_arena_release_runtime_env_info();
+    }
+    message_->unsafe_arena_set_allocated_runtime_env_info(
+        const_cast<rpc::RuntimeEnvInfo *>(shared.get()));
+    storage_->runtime_env_info = std::move(shared);
+  }
+
+  /// The size of the first arena block of the next spec. This follows the largest
+  /// spec built recently, so that the specs of a workload with a few shapes of tasks
+  /// usually fit in a single block, and decays slowly when the specs get smaller.
+  static std::atomic<size_t> &ExpectedArenaBytes() {
+    static std::atomic<size_t> expected_bytes(kMinArenaBlockSize);
+    return expected_bytes;
+  }
+
+  /// Update the size of the first arena block after a spec was built.
+  ///
+  /// \param bytes_used The bytes that the spec took in its arena.
+  static void RecordArenaBytesUsed(size_t bytes_used) {
+    // Besides the spec, the block holds the arena's own state and the arrays of the
+    // repeated fields that were outgrown while the spec was built, which take up to a
+    // fifth of the spec. A spec that doesn't fit gets a second block twice the size
+    // of the first, so leave some room for that.
+    size_t needed = bytes_used + bytes_used / 4 + kArenaBlockOverhead;
+    needed = std::min(std::max(needed, kMinArenaBlockSize), kMaxArenaBlockSize);
+    auto &expected_bytes = ExpectedArenaBytes();
+    const size_t expected = expected_bytes.load(std::memory_order_relaxed);
+    if (needed > expected) {
+      expected_bytes.store(needed, std::memory_order_relaxed);
+    } else if (needed < expected) {
+      expected_bytes.store(expected - (expected - needed) / 16,
+                           std::memory_order_relaxed);
+    }
+  }
+
+  /// The bounds of the first arena block size. Specs larger than the maximum, such as
+  /// specs with many args, are allocated in several blocks.
+  static constexpr size_t kMinArenaBlockSize = 256;
+  static constexpr size_t kMaxArenaBlockSize = 32 * 1024;
+
+  /// The bytes of the arena's own state in the first block.
+  static constexpr size_t kArenaBlockOverhead = 384;
+
+  std::shared_ptr<TaskSpecStorage> storage_;
+
+  /// The message in `storage_`.
   std::shared_ptr<rpc::TaskSpec> message_;
 };
 
@@ -0,0 +1,292 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how many task specs per second the submission path can build, push and
+// release, with and without `task_spec_arena_enabled`, depending on the number of args
+// of the tasks and on the number of submitting threads. Also measures the heap bytes
+// that each spec holds while its task is in flight, since arena blocks that are larger
+// than the spec cost memory for as long as the spec is alive. Finally, measures how
+// many scheduling class lookups per second up to 32 threads do at once, compared with
+// a map guarded by a mutex.
+//
+// Usage: task_spec_benchmark --num_tasks=200000 --num_tasks_in_flight=1000
+//            --num_lookups=1000000
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
+#include "ray/common/ray_config.h"
+#include "ray/common/task/task_spec.h"
+#include "ray/common/task/task_util.h"
+#include "src/ray/protobuf/core_worker.pb.h"
+
+DEFINE_int64(num_tasks, 200000, "The number of tasks that each thread submits.");
+DEFINE_int64(num_tasks_in_flight, 1000,
+             "The number of submitted specs that each thread keeps alive, as the task "
+             "manager does until the tasks finish.");
+DEFINE_int64(num_lookups, 1000000,
+             "The number of scheduling class lookups that each thread does.");
+
+namespace {
+
+/// The heap bytes currently allocated through operator new by this thread. This is
+/// thread local so that counting doesn't add contention to the throughput runs.
+thread_local int64_t allocated_bytes = 0;
+
+/// The bytes that malloc reserved for an allocation, which are more than were
+/// requested. This counts the rounding of many small allocations against the specs
+/// that are built without the arena, and the unused rest of an arena block against
+/// the specs that are built with it.
+size_t AllocationSize(void *ptr) {
+#if defined(__APPLE__)
+  return malloc_size(ptr);
+#elif defined(_WIN32)
+  return _msize(ptr);
+#else
+  return malloc_usable_size(ptr);
+#endif
+}
+
+}  // namespace
+
+void *operator new(size_t size) {
+  void *ptr = std::malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  allocated_bytes += AllocationSize(ptr);
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  allocated_bytes -= AllocationSize(ptr);
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+
+namespace ray {
+
+/// Build the spec of a task as the core worker does.
+TaskSpecification BuildTaskSpec(const JobID &job_id,
+                                const FunctionDescriptor &function_descriptor,
+                                const rpc::Address &owner_address,
+                                const std::vector<ObjectID> &arg_ids) {
+  TaskSpecBuilder builder;
+  const auto task_id = TaskID::FromRandom(job_id);
+  builder.SetCommonTaskSpec(task_id, "f", Language::PYTHON, function_descriptor, job_id,
+                            TaskID::Nil(), 0, TaskID::Nil(), owner_address, 1,
+                            {{"CPU", 1}}, {}, "", 0);
+  for (const auto &arg_id : arg_ids) {
+    builder.AddArg(TaskArgByReference(arg_id, owner_address, "call_site"));
+  }
+  return builder.Build();
+}
+
+rpc::Address BenchmarkOwnerAddress() {
+  rpc::Address owner_address;
+  owner_address.set_ip_address("127.0.0.1");
+  owner_address.set_port(10000);
+  owner_address.set_worker_id(WorkerID::FromRandom().Binary());
+  return owner_address;
+}
+
+/// Each thread submits tasks as the core worker does: it builds the spec, pushes a
+/// copy of it in a PushTaskRequest, and keeps the spec until the task finishes, which
+/// is `num_tasks_in_flight` submissions later. Returns the number of tasks submitted
+/// per second over all threads.
+double RunSubmissionBenchmark(bool arena_enabled, int num_args, int num_threads) {
+  RayConfig::instance().initialize(std::string(R"({"task_spec_arena_enabled": )") +
+                                   (arena_enabled ? "true" : "false") + "}");
+  const rpc::Address owner_address = BenchmarkOwnerAddress();
+  const JobID job_id = JobID::FromInt(1);
+  const auto function_descriptor =
+      FunctionDescriptorBuilder::BuildPython("benchmark_module", "", "f", "");
+
+  auto run = [&]() {
+    std::vector<ObjectID> arg_ids;
+    for (int i = 0; i < num_args; i++) {
+      arg_ids.push_back(ObjectID::FromRandom());
+    }
+    std::deque<TaskSpecification> tasks_in_flight;
+    for (int64_t i = 0; i < FLAGS_num_tasks; i++) {
+      TaskSpecification task_spec =
+          BuildTaskSpec(job_id, function_descriptor, owner_address, arg_ids);
+      rpc::PushTaskRequest request;
+      request.mutable_task_spec()->CopyFrom(task_spec.GetMessage());
+      tasks_in_flight.push_back(std::move(task_spec));
+      if (static_cast<int64_t>(tasks_in_flight.size()) > FLAGS_num_tasks_in_flight) {
+        tasks_in_flight.pop_front();
+      }
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return FLAGS_num_tasks * num_threads / seconds;
+}
+
+/// Measure the heap bytes per spec that `num_tasks_in_flight` specs hold, after as
+/// many specs were built and released, as in the steady state of a submission loop.
+double RunMemoryBenchmark(bool arena_enabled, int num_args) {
+  RayConfig::instance().initialize(std::string(R"({"task_spec_arena_enabled": )") +
+                                   (arena_enabled ? "true" : "false") + "}");
+  const rpc::Address owner_address = BenchmarkOwnerAddress();
+  const JobID job_id = JobID::FromInt(1);
+  const auto function_descriptor =
+      FunctionDescriptorBuilder::BuildPython("benchmark_module", "", "f", "");
+  std::vector<ObjectID> arg_ids;
+  for (int i = 0; i < num_args; i++) {
+    arg_ids.push_back(ObjectID::FromRandom());
+  }
+
+  std::vector<TaskSpecification> tasks_in_flight;
+  tasks_in_flight.reserve(FLAGS_num_tasks_in_flight);
+  for (int64_t i = 0; i < FLAGS_num_tasks_in_flight; i++) {
+    tasks_in_flight.push_back(
+        BuildTaskSpec(job_id, function_descriptor, owner_address, arg_ids));
+  }
+  tasks_in_flight.clear();
+
+  const int64_t start_bytes = allocated_bytes;
+  for (int64_t i = 0; i < FLAGS_num_tasks_in_flight; i++) {
+    tasks_in_flight.push_back(
+        BuildTaskSpec(job_id, function_descriptor, owner_address, arg_ids));
+  }
+  return static_cast<double>(allocated_bytes - start_bytes) / FLAGS_num_tasks_in_flight;
+}
+
+/// Each thread looks up the scheduling classes of a few functions, as constructing a
+/// TaskSpecification does. Returns the number of lookups per second over all threads.
+///
+/// \param mutex_guarded Whether to look up the classes in a map guarded by a mutex, as
+/// TaskSpecification did before it used an InternTable.
+double RunSchedulingClassBenchmark(bool mutex_guarded, int num_threads) {
+  const int num_functions = 8;
+  std::vector<SchedulingClassDescriptor> descriptors;
+  for (int i = 0; i < num_functions; i++) {
+    descriptors.emplace_back(
+        ResourceSet(absl::flat_hash_map<std::string, double>{{"CPU", 1}}),
+        FunctionDescriptorBuilder::BuildPython("benchmark_module", "",
+                                               "f_" + std::to_string(i), ""),
+        /*depth=*/1);
+  }
+  absl::Mutex mutex;
+  absl::flat_hash_map<SchedulingClassDescriptor, SchedulingClass> map;
+  for (const auto &descriptor : descriptors) {
+    map.emplace(descriptor, TaskSpecification::GetSchedulingClass(descriptor));
+  }
+
+  auto run = [&]() {
+    for (int64_t i = 0; i < FLAGS_num_lookups; i++) {
+      const auto &descriptor = descriptors[i % num_functions];
+      SchedulingClass scheduling_class;
+      if (mutex_guarded) {
+        absl::MutexLock lock(&mutex);
+        scheduling_class = map.find(descriptor)->second;
+      } else {
+        scheduling_class = TaskSpecification::GetSchedulingClass(descriptor);
+      }
+      RAY_CHECK(scheduling_class > 0);
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return FLAGS_num_lookups * num_threads / seconds;
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::cout << std::setw(8) << "args" << std::setw(10) << "threads" << std::setw(18)
+            << "no arena tasks/s" << std::setw(18) << "arena tasks/s" << std::setw(10)
+            << "speedup" << std::endl;
+  for (int num_args : {0, 4, 16}) {
+    for (int num_threads : {1, 4, 8, 32}) {
+      const double without_arena =
+          ray::RunSubmissionBenchmark(/*arena_enabled=*/false, num_args, num_threads);
+      const double with_arena =
+          ray::RunSubmissionBenchmark(/*arena_enabled=*/true, num_args, num_threads);
+      std::cout << std::setw(8) << num_args << std::setw(10) << num_threads
+                << std::setw(18) << std::fixed << std::setprecision(0) << without_arena
+                << std::setw(18) << with_arena << std::setw(10) << std::setprecision(2)
+                << with_arena / without_arena << std::endl;
+    }
+  }
+
+  std::cout << std::endl
+            << std::setw(8) << "args" << std::setw(18) << "no arena B/task"
+            << std::setw(18) << "arena B/task" << std::setw(10) << "ratio" << std::endl;
+  for (int num_args : {0, 4, 16}) {
+    const double without_arena =
+        ray::RunMemoryBenchmark(/*arena_enabled=*/false, num_args);
+    const double with_arena = ray::RunMemoryBenchmark(/*arena_enabled=*/true, num_args);
+    std::cout << std::setw(8) << num_args << std::setw(18) << std::fixed
+              << std::setprecision(0) << without_arena << std::setw(18) << with_arena
+              << std::setw(10) << std::setprecision(2) << with_arena / without_arena
+              << std::endl;
+  }
+
+  std::cout << std::endl
+            << std::setw(10) << "threads" << std::setw(18) << "mutex lookups/s"
+            << std::setw(18) << "table lookups/s" << std::setw(10) << "speedup"
+            << std::endl;
+  for (int num_threads : {1, 4, 8, 32}) {
+    const double mutex_guarded =
+        ray::RunSchedulingClassBenchmark(/*mutex_guarded=*/true, num_threads);
+    const double intern_table =
+        ray::RunSchedulingClassBenchmark(/*mutex_guarded=*/false, num_threads);
+    std::cout << std::setw(10) << num_threads << std::setw(18) << std::fixed
+              << std::setprecision(0) << mutex_guarded << std::setw(18) << intern_table
+              << std::setw(10) << std::setprecision(2) << intern_table / mutex_guarded
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,209 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the heap memory that queued task specs hold.
+//
+// First, the resource sets derived from the messages. Before resource sets were
+// interned, each spec allocated its own required and placement resource sets. This
+// compares that to the memory the specs hold now, depending on the number of queued
+// tasks and of distinct resource demands among them.
+//
+// Second, the whole specs built by `TaskSpecBuilder`, which shares the function
+// descriptor, caller address and runtime env of the specs that have the same ones.
+// This compares specs that hold their own copy of these fields to the specs as built,
+// depending on the size of the serialized runtime env.
+//
+// Usage: task_spec_memory_benchmark --num_resources=4 --num_tasks=100000
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "ray/common/grpc_util.h"
+#include "ray/common/task/task_spec.h"
+#include "ray/common/task/task_util.h"
+
+DEFINE_int64(num_resources, 4, "The number of resources that each task requires.");
+DEFINE_int64(num_tasks, 100000, "The number of queued tasks built by TaskSpecBuilder.");
+
+namespace {
+
+/// The bytes currently allocated through operator new.
+std::atomic<int64_t> allocated_bytes(0);
+
+/// Each allocation is prefixed with its size, padded to keep the alignment.
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+}  // namespace
+
+void *operator new(size_t size) {
+  void *ptr = std::malloc(size + kHeaderSize);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  *static_cast<size_t *>(ptr) = size;
+  allocated_bytes += size;
+  return static_cast<char *>(ptr) + kHeaderSize;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  void *header = static_cast<char *>(ptr) - kHeaderSize;
+  allocated_bytes -= *static_cast<size_t *>(header);
+  std::free(header);
+}
+
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+
+namespace ray {
+
+struct MemoryBenchmarkResult {
+  int64_t bytes_before = 0;
+  int64_t bytes_after = 0;
+};
+
+/// Build the messages of `num_tasks` tasks with `num_shapes` distinct resource
+/// demands. The resource names are unique to the run, so that the demands are not
+/// interned yet.
+std::vector<std::shared_ptr<rpc::TaskSpec>> BuildMessages(int64_t num_tasks,
+                                                         int64_t num_shapes, int run) {
+  std::vector<std::shared_ptr<rpc::TaskSpec>> messages;
+  for (int64_t i = 0; i < num_tasks; i++) {
+    auto message = std::make_shared<rpc::TaskSpec>();
+    message->set_type(TaskType::NORMAL_TASK);
+    message->set_language(Language::PYTHON);
+    message->mutable_function_descriptor()
+        ->mutable_python_function_descriptor()
+        ->set_function_name("f");
+    auto &resources = *message->mutable_required_resources();
+    resources["CPU"] = 1 + i % num_shapes;
+    for (int64_t j = 1; j < FLAGS_num_resources; j++) {
+      resources["custom_" + std::to_string(run) + "_" + std::to_string(j)] = 1;
+    }
+    messages.push_back(std::move(message));
+  }
+  return messages;
+}
+
+/// Measure the bytes that the derived resource sets of the queued tasks take, with a
+/// set allocated per task and per field as before interning, and as the specs hold
+/// them now.
+MemoryBenchmarkResult RunMemoryBenchmark(int64_t num_tasks, int64_t num_shapes,
+                                         int run) {
+  const auto messages = BuildMessages(num_tasks, num_shapes, run);
+  MemoryBenchmarkResult result;
+
+  std::vector<std::pair<std::shared_ptr<ResourceSet>, std::shared_ptr<ResourceSet>>>
+      per_task_resource_sets;
+  per_task_resource_sets.reserve(num_tasks);
+  int64_t start_bytes = allocated_bytes;
+  for (const auto &message : messages) {
+    per_task_resource_sets.emplace_back(
+        std::make_shared<ResourceSet>(MapFromProtobuf(message->required_resources())),
+        std::make_shared<ResourceSet>(MapFromProtobuf(message->required_resources())));
+  }
+  result.bytes_before = allocated_bytes - start_bytes;
+  per_task_resource_sets.clear();
+
+  std::vector<TaskSpecification> tasks;
+  tasks.reserve(num_tasks);
+  start_bytes = allocated_bytes;
+  for (const auto &message : messages) {
+    tasks.emplace_back(message);
+  }
+  result.bytes_after = allocated_bytes - start_bytes;
+  return result;
+}
+
+/// Measure the bytes per spec of `FLAGS_num_tasks` queued specs of the same function
+/// and runtime env, built by `TaskSpecBuilder`, when each spec holds a copy of its
+/// message as before the fields were shared, and as built.
+MemoryBenchmarkResult RunSpecMemoryBenchmark(size_t runtime_env_size) {
+  rpc::Address caller_address;
+  caller_address.set_raylet_id(NodeID::FromRandom().Binary());
+  caller_address.set_ip_address("127.0.0.1");
+  caller_address.set_port(10000);
+  caller_address.set_worker_id(WorkerID::FromRandom().Binary());
+  const JobID job_id = JobID::FromInt(1);
+  const auto function_descriptor =
+      FunctionDescriptorBuilder::BuildPython("benchmark_module", "", "f", "");
+  const std::string serialized_runtime_env =
+      R"({"env_vars": {"PAYLOAD": ")" + std::string(runtime_env_size, 'x') + R"("}})";
+  const ObjectID arg_id = ObjectID::FromRandom();
+  auto build = [&]() {
+    TaskSpecBuilder builder;
+    builder.SetCommonTaskSpec(TaskID::FromRandom(job_id), "f", Language::PYTHON,
+                              function_descriptor, job_id, TaskID::Nil(), 0,
+                              TaskID::Nil(), caller_address, 1, {{"CPU", 1}}, {}, "", 0,
+                              serialized_runtime_env);
+    builder.AddArg(TaskArgByReference(arg_id, caller_address, "call_site"));
+    return builder.Build();
+  };
+  MemoryBenchmarkResult result;
+
+  std::vector<TaskSpecification> tasks;
+  tasks.reserve(FLAGS_num_tasks);
+  int64_t start_bytes = allocated_bytes;
+  for (int64_t i = 0; i < FLAGS_num_tasks; i++) {
+    tasks.emplace_back(std::make_shared<rpc::TaskSpec>(build().GetMessage()));
+  }
+  result.bytes_before = (allocated_bytes - start_bytes) / FLAGS_num_tasks;
+  tasks.clear();
+
+  start_bytes = allocated_bytes;
+  for (int64_t i = 0; i < FLAGS_num_tasks; i++) {
+    tasks.push_back(build());
+  }
+  result.bytes_after = (allocated_bytes - start_bytes) / FLAGS_num_tasks;
+  return result;
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::cout << std::setw(10) << "tasks" << std::setw(10) << "shapes" << std::setw(16)
+            << "bytes before" << std::setw(16) << "bytes after" << std::setw(18)
+            << "before/task" << std::setw(18) << "after/task" << std::endl;
+  int run = 0;
+  for (int64_t num_tasks : {1000, 10000, 100000}) {
+    for (int64_t num_shapes : {1, 16}) {
+      const auto result = ray::RunMemoryBenchmark(num_tasks, num_shapes, run++);
+      std::cout << std::setw(10) << num_tasks << std::setw(10) << num_shapes
+                << std::setw(16) << result.bytes_before << std::setw(16)
+                << result.bytes_after << std::setw(18) << std::fixed
+                << std::setprecision(1)
+                << static_cast<double>(result.bytes_before) / num_tasks
+                << std::setw(18) << static_cast<double>(result.bytes_after) / num_tasks
+                << std::endl;
+    }
+  }
+
+  std::cout << std::endl
+            << std::setw(10) << "env bytes" << std::setw(18) << "copied B/task"
+            << std::setw(18) << "shared B/task" << std::endl;
+  for (size_t runtime_env_size : {0, 1000, 10000}) {
+    const auto result = ray::RunSpecMemoryBenchmark(runtime_env_size);
+    std::cout << std::setw(10) << runtime_env_size << std::setw(18)
+              << result.bytes_before << std::setw(18) << result.bytes_after
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,265 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/common/task/task_spec.h"
+
+#include <thread>
+
+#include "absl/container/flat_hash_set.h"
+#include "gtest/gtest.h"
+#include "ray/common/task/task_util.h"
+
+namespace ray {
+
+namespace {
+
+rpc::TaskSpec BuildTaskSpec(const std::string &function_name, double num_cpus,
+                            uint64_t depth,
+                            const std::string &serialized_runtime_env = "{}") {
+  TaskSpecBuilder builder;
+  rpc::Address address;
+  const JobID job_id = JobID::FromInt(1);
+  builder.SetCommonTaskSpec(
+      TaskID::FromRandom(job_id), "dummy_task", Language::PYTHON,
+      FunctionDescriptorBuilder::BuildPython("module", "", function_name, ""), job_id,
+      TaskID::Nil(), 0, TaskID::Nil(), address, 1, {{"CPU", num_cpus}}, {}, "", depth,
+      serialized_runtime_env);
+  return builder.Build().GetMessage();
+}
+
+}  // namespace
+
+TEST(TaskSpecTest, TestSchedulingClass) {
+  TaskSpecification f(BuildTaskSpec("f", 1, 0));
+  TaskSpecification f_again(BuildTaskSpec("f", 1, 0));
+  TaskSpecification g(BuildTaskSpec("g", 1, 0));
+  TaskSpecification f_2_cpus(BuildTaskSpec("f", 2, 0));
+  TaskSpecification f_nested(BuildTaskSpec("f", 1, 1));
+  TaskSpecification f_env(BuildTaskSpec("f", 1, 0, R"({"env_vars": {"A": "1"}})"));
+  TaskSpecification f_empty_env(BuildTaskSpec("f", 1, 0, ""));
+  ASSERT_EQ(f.GetSchedulingClass(), f_again.GetSchedulingClass());
+  ASSERT_NE(f.GetSchedulingClass(), g.GetSchedulingClass());
+  ASSERT_NE(f.GetSchedulingClass(), f_2_cpus.GetSchedulingClass());
+  ASSERT_NE(f.GetSchedulingClass(), f_nested.GetSchedulingClass());
+  ASSERT_NE(f.GetSchedulingClass(), f_env.GetSchedulingClass());
+  ASSERT_EQ(f.GetSchedulingClass(), f_empty_env.GetSchedulingClass());
+
+  const auto &descriptor =
+      TaskSpecification::GetSchedulingClassDescriptor(f_2_cpus.GetSchedulingClass());
+  ASSERT_EQ(descriptor.resource_set, f_2_cpus.GetRequiredResources());
+  ASSERT_EQ(descriptor.function_descriptor, f_2_cpus.FunctionDescriptor());
+  ASSERT_EQ(descriptor.depth, 0);
+  ASSERT_EQ(descriptor.runtime_env_hash, 0);
+  ASSERT_EQ(
+      TaskSpecification::GetSchedulingClassDescriptor(f_env.GetSchedulingClass())
+          .runtime_env_hash,
+      f_env.GetRuntimeEnvHash());
+}
+
+TEST(TaskSpecTest, TestSharedTaskSpecFields) {
+  // Queued tasks with the same resource demand and function share one copy of
+  // the derived resource sets and function descriptor.
+  const int num_tasks = 10000;
+  std::vector<TaskSpecification> tasks;
+  for (int i = 0; i < num_tasks; i++) {
+    tasks.emplace_back(BuildTaskSpec("shared", 1, 0));
+  }
+  TaskSpecification other(BuildTaskSpec("shared", 2, 0));
+  absl::flat_hash_set<const ResourceSet *> resource_sets;
+  absl::flat_hash_set<const FunctionDescriptorInterface *> function_descriptors;
+  for (const auto &task : tasks) {
+    resource_sets.insert(&task.GetRequiredResources());
+    resource_sets.insert(&task.GetRequiredPlacementResources());
+    function_descriptors.insert(task.FunctionDescriptor().get());
+  }
+  ASSERT_EQ(resource_sets.size(), 1);
+  ASSERT_EQ(function_descriptors.size(), 1);
+  ASSERT_NE(&other.GetRequiredResources(), &tasks[0].GetRequiredResources());
+  ASSERT_EQ(other.GetRequiredResources().GetNumCpusAsDouble(), 2);
+
+  // Placement resources name placement group bundles, so each task keeps its own.
+  rpc::TaskSpec message = tasks[0].GetMessage();
+  (*message.mutable_required_placement_resources())["CPU_group_0_abc"] = 1;
+  TaskSpecification placed(message);
+  TaskSpecification placed_again(message);
+  ASSERT_NE(&placed.GetRequiredPlacementResources(),
+            &placed_again.GetRequiredPlacementResources());
+  ASSERT_EQ(
+      placed.GetRequiredPlacementResources().GetResourceMap().at("CPU_group_0_abc"), 1);
+  ASSERT_EQ(&placed.GetRequiredResources(), &tasks[0].GetRequiredResources());
+}
+
+TEST(TaskSpecTest, TestBuilderSharesMessageFields) {
+  // Specs built for the same function and caller point to one copy of the function
+  // descriptor, caller address and runtime env, with and without arena allocation.
+  rpc::Address caller_address;
+  caller_address.set_ip_address("127.0.0.1");
+  caller_address.set_worker_id(WorkerID::FromRandom().Binary());
+  const JobID job_id = JobID::FromInt(1);
+  const std::string serialized_runtime_env = R"({"env_vars": {"A": "B"}})";
+  auto build = [&](const std::string &function_name) {
+    TaskSpecBuilder builder;
+    builder.SetCommonTaskSpec(
+        TaskID::FromRandom(job_id), function_name, Language::PYTHON,
+        FunctionDescriptorBuilder::BuildPython("module", "", function_name, ""), job_id,
+        TaskID::Nil(), 0, TaskID::Nil(), caller_address, 1, {{"CPU", 1}}, {}, "", 0,
+        serialized_runtime_env, {"uri"});
+    return builder.Build();
+  };
+
+  for (bool arena_enabled : {false, true}) {
+    RayConfig::instance().initialize(
+        std::string(R"({"task_spec_arena_enabled": )") +
+        (arena_enabled ? "true" : "false") + "}");
+    std::vector<TaskSpecification> tasks;
+    for (int i = 0; i < 10; i++) {
+      tasks.push_back(build(i % 2 == 0 ? "f" : "g"));
+    }
+    const auto &f = tasks[0].GetMessage();
+    const auto &g = tasks[1].GetMessage();
+    ASSERT_EQ(&tasks[8].GetMessage().function_descriptor(), &f.function_descriptor());
+    ASSERT_EQ(&tasks[9].GetMessage().function_descriptor(), &g.function_descriptor());
+    ASSERT_NE(&f.function_descriptor(), &g.function_descriptor());
+    ASSERT_EQ(&f.caller_address(), &g.caller_address());
+    ASSERT_EQ(&f.runtime_env_info(), &g.runtime_env_info());
+    ASSERT_EQ(f.function_descriptor().python_function_descriptor().function_name(), "f");
+    ASSERT_EQ(f.caller_address().worker_id(), caller_address.worker_id());
+    ASSERT_EQ(f.runtime_env_info().serialized_runtime_env(), serialized_runtime_env);
+    ASSERT_EQ(f.runtime_env_info().uris(0), "uri");
+
+    // A copy of the message holds its own fields, and serializes the same.
+    rpc::TaskSpec copy = f;
+    ASSERT_NE(&copy.caller_address(), &f.caller_address());
+    ASSERT_EQ(copy.SerializeAsString(), f.SerializeAsString());
+  }
+  // Reset the global config.
+  RayConfig::instance().initialize(R"({"task_spec_arena_enabled": false})");
+}
+
+TEST(TaskSpecTest, TestArenaTaskSpecBuild) {
+  // Build task specs with a few by-reference args, as a driver submitting tasks does,
+  // with and without arena allocation.
+  rpc::Address owner_address;
+  owner_address.set_ip_address("127.0.0.1");
+  owner_address.set_worker_id(WorkerID::FromRandom().Binary());
+  std::vector<ObjectID> arg_ids;
+  for (int i = 0; i < 4; i++) {
+    arg_ids.push_back(ObjectID::FromRandom());
+  }
+  const JobID job_id = JobID::FromInt(1);
+  const auto function_descriptor =
+      FunctionDescriptorBuilder::BuildPython("module", "", "f", "");
+  auto build = [&]() {
+    TaskSpecBuilder builder;
+    builder.SetCommonTaskSpec(TaskID::FromRandom(job_id), "f", Language::PYTHON,
+                              function_descriptor, job_id, TaskID::Nil(), 0,
+                              TaskID::Nil(), owner_address, 1, {{"CPU", 1}}, {}, "",
+                              0);
+    for (const auto &arg_id : arg_ids) {
+      builder.AddArg(TaskArgByReference(arg_id, owner_address, "call_site"));
+    }
+    return builder.Build();
+  };
+
+  for (bool arena_enabled : {false, true}) {
+    RayConfig::instance().initialize(
+        std::string(R"({"task_spec_arena_enabled": )") +
+        (arena_enabled ? "true" : "false") + "}");
+    TaskSpecification task = build();
+    ASSERT_EQ(task.GetMessage().GetArena() != nullptr, arena_enabled);
+    ASSERT_EQ(task.NumArgs(), arg_ids.size());
+    ASSERT_EQ(task.ArgId(3), arg_ids[3]);
+    ASSERT_EQ(task.GetRequiredResources().GetNumCpusAsDouble(), 1);
+  }
+
+  // The first arena block is sized to fit the specs built recently, so that a spec
+  // doesn't hold much more memory than it uses.
+  for (int i = 0; i < 10; i++) {
+    build();
+  }
+  TaskSpecification task = build();
+  const auto *arena = task.GetMessage().GetArena();
+  ASSERT_LE(arena->SpaceAllocated(), 2 * arena->SpaceUsed());
+  // Reset the global config.
+  RayConfig::instance().initialize(R"({"task_spec_arena_enabled": false})");
+}
+
+TEST(TaskSpecTest, TestSerializedMessageCache) {
+  auto message = std::make_shared<rpc::TaskSpec>(BuildTaskSpec("f", 1, 0));
+  message->add_args()->set_data(std::string(1024, 'x'));
+  TaskSpecification task(message);
+  std::string first;
+  task.AppendSerializedMessage(&first);
+  ASSERT_EQ(first, message->SerializeAsString());
+
+  // A copy of the spec, as the task manager keeps for retries, reuses the cached bytes
+  // instead of serializing the message again. The name changed without going through
+  // the spec is therefore not sent, but the new attempt number is.
+  TaskSpecification retry = task;
+  message->set_name("changed_out_of_band");
+  retry.SetAttemptNumber(2);
+  std::string second;
+  retry.AppendSerializedMessage(&second);
+  ASSERT_EQ(second.compare(0, first.size(), first), 0);
+  rpc::TaskSpec parsed;
+  ASSERT_TRUE(parsed.ParseFromString(second));
+  ASSERT_EQ(parsed.attempt_number(), 2);
+  ASSERT_EQ(parsed.name(), "dummy_task");
+  ASSERT_EQ(parsed.args(0).data(), std::string(1024, 'x'));
+
+  // Changing the message through the spec drops the cached bytes.
+  retry.GetMutableMessage().set_name("changed");
+  std::string third;
+  task.AppendSerializedMessage(&third);
+  ASSERT_EQ(third, message->SerializeAsString());
+  ASSERT_TRUE(parsed.ParseFromString(third));
+  ASSERT_EQ(parsed.name(), "changed");
+  ASSERT_EQ(parsed.attempt_number(), 2);
+}
+
+TEST(TaskSpecTest, TestConcurrentSchedulingClassLookups) {
+  // Construct tasks of a few scheduling classes from many threads at once, as a
+  // multi-threaded driver does.
+  const int num_threads = 8;
+  const int num_tasks = 1000;
+  const int num_functions = 8;
+  std::vector<rpc::TaskSpec> messages;
+  for (int i = 0; i < num_functions; i++) {
+    messages.push_back(BuildTaskSpec("concurrent_" + std::to_string(i), 1, 0));
+  }
+  std::vector<SchedulingClass> expected;
+  for (const auto &message : messages) {
+    expected.push_back(TaskSpecification(message).GetSchedulingClass());
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < num_tasks; i++) {
+        TaskSpecification task(messages[i % num_functions]);
+        ASSERT_EQ(task.GetSchedulingClass(), expected[i % num_functions]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -17,6 +17,7 @@
 #include <google/protobuf/util/json_util.h>
 
 #include "boost/fiber/all.hpp"
+#include "ray/common/asio/asio_util.h"
 #include "ray/common/bundle_spec.h"
 #include "ray/common/ray_config.h"
 #include "ray/common/task/task_util.h"
@@ -79,6 +80,8 @@ CoreWorker::CoreWorker(const CoreWorkerOptions &options, const WorkerID &worker_
       periodical_runner_(io_service_),
       task_queue_length_(0),
       num_executed_tasks_(0),
+      pushed_task_batches_(RayConfig::instance().push_tasks_batch_poll_timeout_ms(),
+                           []() { return current_time_ms(); }),
       resource_ids_(new ResourceMappingType()),
       grpc_service_(io_service_, *this),
       task_execution_service_work_(task_execution_service_) {
@@ -222,10 +225,19 @@ CoreWorker::CoreWorker(const CoreWorkerOptions &options, const WorkerID &worker_
       rpc_address_,
       /*object_info_publisher=*/object_info_publisher_.get(),
       /*object_info_subscriber=*/object_info_subscriber_.get(),
-      RayConfig::instance().lineage_pinning_enabled(), [this](const rpc::Address &addr) {
+      RayConfig::instance().lineage_pinning_enabled(),
+      [this](const rpc::Address &addr) {
         return std::shared_ptr<rpc::CoreWorkerClient>(
             new rpc::CoreWorkerClient(addr, *client_call_manager_));
-      });
+      },
+      /*coalesce_ref_removed_messages=*/
+      RayConfig::instance().ref_removed_flush_window_ms() > 0);
+
+  if (RayConfig::instance().ref_removed_flush_window_ms() > 0) {
+    periodical_runner_.RunFnPeriodically(
+        [this] { reference_counter_->FlushRefRemovedMessages(); },
+        RayConfig::instance().ref_removed_flush_window_ms());
+  }
 
   if (options_.worker_type == WorkerType::WORKER) {
     periodical_runner_.RunFnPeriodically(
@@ -280,7 +292,7 @@ CoreWorker::CoreWorker(const CoreWorkerOptions &options, const WorkerID &worker_
       },
       /* retry_task_callback= */
       [this](TaskSpecification &spec, bool delay) {
-        spec.GetMutableMessage().set_attempt_number(spec.AttemptNumber() + 1);
+        spec.SetAttemptNumber(spec.AttemptNumber() + 1);
         if (delay) {
           // Retry after a delay to emulate the existing Raylet reconstruction
           // behaviour. TODO(ekl) backoff exponentially.
@@ -379,9 +391,11 @@ CoreWorker::CoreWorker(const CoreWorkerOptions &options, const WorkerID &worker_
              uint64_t object_size) {
         reference_counter_->ReportLocalityData(object_id, locations, object_size);
       };
-  future_resolver_.reset(new FutureResolver(memory_store_, reference_counter_,
-                                            std::move(report_locality_data_callback),
-                                            core_worker_client_pool_, rpc_address_));
+  future_resolver_.reset(new FutureResolver(
+      memory_store_, reference_counter_, std::move(report_locality_data_callback),
+      core_worker_client_pool_, rpc_address_, io_service_,
+      RayConfig::instance().object_status_batch_window_ms(),
+      RayConfig::instance().object_status_max_batch_size()));
 
   // Unfortunately the raylet client has to be constructed after the receivers.
   if (direct_task_receiver_ != nullptr) {
@@ -720,8 +734,13 @@ void CoreWorker::InternalHeartbeat() {
   // Check timeout tasks that are waiting for death info.
   if (direct_actor_submitter_ != nullptr) {
     direct_actor_submitter_->CheckTimeoutTasks();
+    direct_actor_submitter_->RecordMetrics();
   }
 
+  // Forget the replies to the batches of pushed tasks that their callers stopped asking
+  // for, e.g., because they died.
+  pushed_task_batches_.ForgetUnpolledBatches();
+
   // Periodically report the lastest backlog so that
   // local raylet will have the eventually consistent view of worker backlogs
   // even in cases where backlog reports from direct_task_transport
@@ -1780,7 +1799,7 @@ std::optional<std::vector<rpc::ObjectReference>> CoreWorker::SubmitActorTask(
     const std::vector<std::unique_ptr<TaskArg>> &args, const TaskOptions &task_options) {
   absl::ReleasableMutexLock lock(&actor_task_mutex_);
   /// Check whether backpressure may happen at the very beginning of submitting a task.
-  if (direct_actor_submitter_->PendingTasksFull(actor_id)) {
+  if (!direct_actor_submitter_->WaitUntilPendingTasksNotFull(actor_id, 0)) {
     RAY_LOG(DEBUG) << "Back pressure occurred while submitting the task to " << actor_id
                    << ". " << direct_actor_submitter_->DebugString(actor_id);
     return std::nullopt;
@@ -1878,6 +1897,13 @@ Status CoreWorker::CancelChildren(const TaskID &task_id, bool force_kill) {
   }
 }
 
+bool CoreWorker::WaitForActorQueueRoom(const ActorID &actor_id) {
+  // This doesn't hold actor_task_mutex_, so that tasks for other actors can still be
+  // submitted meanwhile.
+  return direct_actor_submitter_->WaitUntilPendingTasksNotFull(
+      actor_id, RayConfig::instance().actor_submit_backpressure_wait_ms());
+}
+
 Status CoreWorker::KillActor(const ActorID &actor_id, bool force_kill, bool no_restart) {
   if (options_.is_local_mode) {
     return KillActorLocalMode(actor_id);
@@ -2449,6 +2475,61 @@ void CoreWorker::HandlePushTask(const rpc::PushTaskRequest &request,
   }
 }
 
+void CoreWorker::HandlePushTasks(const rpc::PushTasksRequest &request,
+                                 rpc::PushTasksReply *reply,
+                                 rpc::SendReplyCallback send_reply_callback) {
+  if (HandleWrongRecipient(WorkerID::FromBinary(request.intended_worker_id()),
+                           send_reply_callback)) {
+    return;
+  }
+  if (request.batch_id() != 0) {
+    // The caller waits for more replies to a batch that it pushed before.
+    pushed_task_batches_.WaitForReplies(request.batch_id(), reply,
+                                        std::move(send_reply_callback));
+    return;
+  }
+  if (request.requests().empty()) {
+    send_reply_callback(Status::OK(), nullptr, nullptr);
+    return;
+  }
+
+  auto batch = pushed_task_batches_.AddBatch(request.requests_size(), reply,
+                                             std::move(send_reply_callback));
+  const int64_t batch_id = batch->id;
+  for (int i = 0; i < request.requests_size(); i++) {
+    const auto &task_request = request.requests(i);
+    const TaskID task_id = TaskID::FromBinary(task_request.task_spec().task_id());
+    auto reply_to_task = [this, batch, i](const Status &status, bool canceled) {
+      pushed_task_batches_.ReplyToTask(*batch, i, status, canceled);
+    };
+    {
+      absl::MutexLock lock(&batched_tasks_mutex_);
+      batched_task_cancel_callbacks_[task_id][batch_id] = [reply_to_task]() {
+        reply_to_task(Status::OK(), /*canceled=*/true);
+      };
+    }
+    // The task is replied to at most once, whether it is executed, stolen or canceled.
+    // Whoever removes its cancel callback replies to it.
+    HandlePushTask(
+        task_request, batch->task_replies[i].mutable_reply(),
+        [this, task_id, batch_id, reply_to_task](
+            Status status, std::function<void()> success, std::function<void()> failure) {
+          {
+            absl::MutexLock lock(&batched_tasks_mutex_);
+            auto it = batched_task_cancel_callbacks_.find(task_id);
+            if (it == batched_task_cancel_callbacks_.end() ||
+                it->second.erase(batch_id) == 0) {
+              return;
+            }
+            if (it->second.empty()) {
+              batched_task_cancel_callbacks_.erase(it);
+            }
+          }
+          reply_to_task(status, /*canceled=*/false);
+        });
+  }
+}
+
 void CoreWorker::HandleStealTasks(const rpc::StealTasksRequest &request,
                                   rpc::StealTasksReply *reply,
                                   rpc::SendReplyCallback send_reply_callback) {
@@ -2488,6 +2569,111 @@ void CoreWorker::HandleGetObjectStatus(const rpc::GetObjectStatusRequest &reques
 
   ObjectID object_id = ObjectID::FromBinary(request.object_id());
   RAY_LOG(DEBUG) << "Received GetObjectStatus " << object_id;
+  GetObjectStatusAsync(object_id, [this, object_id, reply, send_reply_callback](
+                                      rpc::GetObjectStatusReply::ObjectStatus status,
+                                      std::shared_ptr<RayObject> obj) {
+    if (status == rpc::GetObjectStatusReply::CREATED) {
+      PopulateObjectStatus(object_id, obj, reply);
+    } else {
+      reply->set_status(status);
+    }
+    send_reply_callback(Status::OK(), nullptr, nullptr);
+  });
+}
+
+void CoreWorker::HandleGetObjectStatuses(const rpc::GetObjectStatusesRequest &request,
+                                         rpc::GetObjectStatusesReply *reply,
+                                         rpc::SendReplyCallback send_reply_callback) {
+  if (HandleWrongRecipient(WorkerID::FromBinary(request.owner_worker_id()),
+                           send_reply_callback)) {
+    RAY_LOG(INFO) << "Handling GetObjectStatuses for objects produced by a previous "
+                     "worker with the same address";
+    return;
+  }
+  RAY_LOG(DEBUG) << "Received GetObjectStatuses for " << request.object_ids_size()
+                 << " objects";
+
+  // The state of the reply, shared by the callbacks of the objects. All fields are
+  // guarded by the mutex.
+  struct BatchState {
+    absl::Mutex mu;
+    // Whether we are still registering the callbacks of the objects. Objects that
+    // are ready right away are all sent in the first reply.
+    bool registering = true;
+    bool replied = false;
+    bool timer_started = false;
+    int num_pending = 0;
+  };
+  auto state = std::make_shared<BatchState>();
+  state->num_pending = request.object_ids_size();
+
+  // Reply once all of the objects are ready, or once the batch window has passed since
+  // the first of them was ready. Objects that become ready after the reply are asked
+  // for again by the borrower. Must be called with the mutex held.
+  const int64_t window_ms = RayConfig::instance().object_status_batch_window_ms();
+  auto reply_if_needed = [this, state, send_reply_callback, window_ms]() {
+    if (state->replied) {
+      return;
+    }
+    if (state->num_pending == 0 || window_ms == 0) {
+      state->replied = true;
+      send_reply_callback(Status::OK(), nullptr, nullptr);
+    } else if (!state->timer_started) {
+      state->timer_started = true;
+      execute_after(
+          io_service_,
+          [state, send_reply_callback]() {
+            absl::MutexLock lock(&state->mu);
+            if (!state->replied) {
+              state->replied = true;
+              send_reply_callback(Status::OK(), nullptr, nullptr);
+            }
+          },
+          window_ms);
+    }
+  };
+
+  for (const auto &object_id_binary : request.object_ids()) {
+    const auto object_id = ObjectID::FromBinary(object_id_binary);
+    ObjectStatusWaiter waiter;
+    waiter.is_stale = [state]() {
+      absl::MutexLock lock(&state->mu);
+      return state->replied;
+    };
+    waiter.callback = [this, state, object_id, reply, reply_if_needed](
+                          rpc::GetObjectStatusReply::ObjectStatus status,
+                          std::shared_ptr<RayObject> obj) {
+      absl::MutexLock lock(&state->mu);
+      if (state->replied) {
+        return;
+      }
+      state->num_pending--;
+      reply->add_object_ids(object_id.Binary());
+      auto *object_status = reply->add_statuses();
+      if (status == rpc::GetObjectStatusReply::CREATED) {
+        PopulateObjectStatus(object_id, obj, object_status);
+      } else {
+        object_status->set_status(status);
+      }
+      if (!state->registering) {
+        reply_if_needed();
+      }
+    };
+    WaitForObjectStatus(object_id, std::move(waiter));
+  }
+
+  absl::MutexLock lock(&state->mu);
+  state->registering = false;
+  if (state->num_pending == 0 || reply->object_ids_size() > 0) {
+    reply_if_needed();
+  }
+}
+
+void CoreWorker::GetObjectStatusAsync(
+    const ObjectID &object_id,
+    std::function<void(rpc::GetObjectStatusReply::ObjectStatus status,
+                       std::shared_ptr<RayObject> obj)>
+        callback) {
   // Acquire a reference to the object. This prevents the object from being
   // evicted out from under us while we check the object status and start the
   // Get.
@@ -2497,29 +2683,64 @@ void CoreWorker::HandleGetObjectStatus(const rpc::GetObjectStatusRequest &reques
   auto has_owner = reference_counter_->GetOwner(object_id, &owner_address);
   if (!has_owner) {
     // We owned this object, but the object has gone out of scope.
-    reply->set_status(rpc::GetObjectStatusReply::OUT_OF_SCOPE);
-    send_reply_callback(Status::OK(), nullptr, nullptr);
+    callback(rpc::GetObjectStatusReply::OUT_OF_SCOPE, nullptr);
   } else {
-    RAY_CHECK(owner_address.worker_id() == request.owner_worker_id());
+    RAY_CHECK(owner_address.worker_id() == rpc_address_.worker_id());
     bool is_freed = reference_counter_->IsPlasmaObjectFreed(object_id);
 
-    // Send the reply once the value has become available. The value is
+    // Call back once the value has become available. The value is
     // guaranteed to become available eventually because we own the object and
     // its ref count is > 0.
-    memory_store_->GetAsync(object_id, [this, object_id, reply, send_reply_callback,
+    memory_store_->GetAsync(object_id, [callback = std::move(callback),
                                         is_freed](std::shared_ptr<RayObject> obj) {
       if (is_freed) {
-        reply->set_status(rpc::GetObjectStatusReply::FREED);
+        callback(rpc::GetObjectStatusReply::FREED, nullptr);
       } else {
-        PopulateObjectStatus(object_id, obj, reply);
+        callback(rpc::GetObjectStatusReply::CREATED, std::move(obj));
       }
-      send_reply_callback(Status::OK(), nullptr, nullptr);
     });
   }
 
   RemoveLocalReference(object_id);
 }
 
+void CoreWorker::WaitForObjectStatus(const ObjectID &object_id,
+                                     ObjectStatusWaiter waiter) {
+  {
+    absl::MutexLock lock(&object_status_waiters_mutex_);
+    auto it = object_status_waiters_.find(object_id);
+    if (it != object_status_waiters_.end()) {
+      // The object is already being waited for, e.g. because the borrower asked for it
+      // in a request that was replied to before the object was ready.
+      auto &waiters = it->second;
+      waiters.erase(std::remove_if(waiters.begin(), waiters.end(),
+                                   [](const ObjectStatusWaiter &waiter) {
+                                     return waiter.is_stale();
+                                   }),
+                    waiters.end());
+      waiters.push_back(std::move(waiter));
+      return;
+    }
+    object_status_waiters_[object_id].push_back(std::move(waiter));
+  }
+
+  GetObjectStatusAsync(object_id, [this, object_id](
+                                      rpc::GetObjectStatusReply::ObjectStatus status,
+                                      std::shared_ptr<RayObject> obj) {
+    std::vector<ObjectStatusWaiter> waiters;
+    {
+      absl::MutexLock lock(&object_status_waiters_mutex_);
+      auto it = object_status_waiters_.find(object_id);
+      RAY_CHECK(it != object_status_waiters_.end());
+      waiters = std::move(it->second);
+      object_status_waiters_.erase(it);
+    }
+    for (auto &waiter : waiters) {
+      waiter.callback(status, obj);
+    }
+  });
+}
+
 void CoreWorker::PopulateObjectStatus(const ObjectID &object_id,
                                       std::shared_ptr<RayObject> obj,
                                       rpc::GetObjectStatusReply *reply) {
@@ -2813,6 +3034,29 @@ void CoreWorker::HandleCancelTask(const rpc::CancelTaskRequest &request,
     // If the task is not currently running, check if it is in the worker's queue of
     // normal tasks, and remove it if found.
     success = direct_task_receiver_->CancelQueuedNormalTask(task_id);
+    if (success) {
+      // If the task was pushed in a batch, reply to it so that the caller stops waiting
+      // for it. The queue removes the last pushed copy of the task, which belongs to the
+      // last batch.
+      std::function<void()> cancel_callback;
+      {
+        absl::MutexLock lock(&batched_tasks_mutex_);
+        auto it = batched_task_cancel_callbacks_.find(task_id);
+        if (it != batched_task_cancel_callbacks_.end()) {
+          auto last = std::prev(it->second.end());
+          cancel_callback = std::move(last->second);
+          it->second.erase(last);
+          if (it->second.empty()) {
+            batched_task_cancel_callbacks_.erase(it);
+          }
+        }
+      }
+      if (cancel_callback) {
+        // Reply without holding mutex_.
+        io_service_.post(std::move(cancel_callback),
+                         "CoreWorker.ReplyToCanceledBatchedTask");
+      }
+    }
   }
   if (request.recursive()) {
     auto recursive_cancel = CancelChildren(task_id, request.force_kill());
@@ -2922,6 +3166,10 @@ void CoreWorker::HandleGetCoreWorkerStats(const rpc::GetCoreWorkerStatsRequest &
   if (request.include_memory_info()) {
     reference_counter_->AddObjectRefStats(plasma_store_provider_->UsedObjectsList(),
                                           stats);
+    for (auto &object_ref : *stats->mutable_object_refs()) {
+      object_ref.set_lineage_bytes(task_manager_->LineageFootprintBytes(
+          ObjectID::FromBinary(object_ref.object_id()).TaskId()));
+    }
   }
 
   send_reply_callback(Status::OK(), nullptr, nullptr);
@@ -35,6 +35,7 @@
 #include "ray/core_worker/store_provider/plasma_store_provider.h"
 #include "ray/core_worker/transport/direct_actor_transport.h"
 #include "ray/core_worker/transport/direct_task_transport.h"
+#include "ray/core_worker/transport/pushed_task_batches.h"
 #include "ray/gcs/gcs_client/gcs_client.h"
 #include "ray/pubsub/publisher.h"
 #include "ray/pubsub/subscriber.h"
@@ -485,11 +486,24 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
   /// \param[in] function The remote function to execute.
   /// \param[in] args Arguments of this task.
   /// \param[in] task_options Options for this task.
-  /// \return ObjectRefs returned by this task.
+  /// \return ObjectRefs returned by this task, or nullopt if the actor already has
+  /// max_pending_calls tasks pending. This doesn't wait for them to finish, see
+  /// `WaitForActorQueueRoom`.
   std::optional<std::vector<rpc::ObjectReference>> SubmitActorTask(
       const ActorID &actor_id, const RayFunction &function,
       const std::vector<std::unique_ptr<TaskArg>> &args, const TaskOptions &task_options);
 
+  /// Wait until an actor has fewer than max_pending_calls tasks pending, for up to
+  /// `actor_submit_backpressure_wait_ms`. Call this before `SubmitActorTask` to wait
+  /// for backpressure to clear rather than failing. The tasks of the actor only finish
+  /// if their replies can be processed, so the caller must not hold any lock that the
+  /// reply path needs, such as the Python GIL.
+  ///
+  /// \param[in] actor_id ID of the actor to submit to.
+  /// \return Whether the actor has room for another task. Another thread may take the
+  /// room before this one submits its task.
+  bool WaitForActorQueueRoom(const ActorID &actor_id);
+
   /// Tell an actor to exit immediately, without completing outstanding work.
   ///
   /// \param[in] actor_id ID of the actor to kill.
@@ -640,6 +654,10 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
   void HandlePushTask(const rpc::PushTaskRequest &request, rpc::PushTaskReply *reply,
                       rpc::SendReplyCallback send_reply_callback) override;
 
+  /// Implements gRPC server handler.
+  void HandlePushTasks(const rpc::PushTasksRequest &request, rpc::PushTasksReply *reply,
+                       rpc::SendReplyCallback send_reply_callback) override;
+
   /// Implements gRPC server handler.
   void HandleStealTasks(const rpc::StealTasksRequest &request,
                         rpc::StealTasksReply *reply,
@@ -656,6 +674,11 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
                              rpc::GetObjectStatusReply *reply,
                              rpc::SendReplyCallback send_reply_callback) override;
 
+  /// Implements gRPC server handler.
+  void HandleGetObjectStatuses(const rpc::GetObjectStatusesRequest &request,
+                               rpc::GetObjectStatusesReply *reply,
+                               rpc::SendReplyCallback send_reply_callback) override;
+
   /// Implements gRPC server handler.
   void HandleWaitForActorOutOfScope(const rpc::WaitForActorOutOfScopeRequest &request,
                                     rpc::WaitForActorOutOfScopeReply *reply,
@@ -830,6 +853,30 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
   void PopulateObjectStatus(const ObjectID &object_id, std::shared_ptr<RayObject> obj,
                             rpc::GetObjectStatusReply *reply);
 
+  /// Call the callback with the status of an object that we own once the object's
+  /// value is available, or right away if the object has gone out of scope. The object
+  /// is only set if the status is CREATED.
+  void GetObjectStatusAsync(
+      const ObjectID &object_id,
+      std::function<void(rpc::GetObjectStatusReply::ObjectStatus status,
+                         std::shared_ptr<RayObject> obj)>
+          callback);
+
+  /// A GetObjectStatuses request waiting for the status of an object that we own.
+  struct ObjectStatusWaiter {
+    /// Whether the request no longer needs the status, because it has been replied to.
+    std::function<bool()> is_stale;
+    std::function<void(rpc::GetObjectStatusReply::ObjectStatus status,
+                       std::shared_ptr<RayObject> obj)>
+        callback;
+  };
+
+  /// Like GetObjectStatusAsync, but an object that is already being waited for is not
+  /// waited for again. A borrower asks again for the objects that were not ready by
+  /// the time of the reply, so this keeps a single callback per object in the memory
+  /// store across the re-asks. Stale waiters are dropped when the object is asked for.
+  void WaitForObjectStatus(const ObjectID &object_id, ObjectStatusWaiter waiter);
+
   ///
   /// Private methods related to task submission.
   ///
@@ -1129,6 +1176,19 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
   /// Number of executed tasks.
   std::atomic<int64_t> num_executed_tasks_;
 
+  /// The replies to the batches of tasks pushed to this worker.
+  PushedTaskBatches pushed_task_batches_;
+
+  /// Protects the callbacks to reply to batched tasks.
+  absl::Mutex batched_tasks_mutex_;
+
+  /// Callbacks to reply to the queued tasks that were pushed in a batch, keyed by task
+  /// ID and then by the ID of the batch. A batch is waited on until all of its tasks are
+  /// replied to, so a batched task that is removed from the queue by cancellation must
+  /// still be replied to.
+  absl::flat_hash_map<TaskID, std::map<int64_t, std::function<void()>>>
+      batched_task_cancel_callbacks_ GUARDED_BY(batched_tasks_mutex_);
+
   /// Profiler including a background thread that pushes profiling events to the GCS.
   std::shared_ptr<worker::Profiler> profiler_;
 
@@ -1169,6 +1229,13 @@ class CoreWorker : public rpc::CoreWorkerServiceHandler {
   absl::flat_hash_map<ObjectID, std::vector<std::function<void(void)>>>
       async_plasma_callbacks_ GUARDED_BY(plasma_mutex_);
 
+  // Guard for `object_status_waiters_` map.
+  absl::Mutex object_status_waiters_mutex_;
+
+  /// The GetObjectStatuses requests waiting for each object that we own.
+  absl::flat_hash_map<ObjectID, std::vector<ObjectStatusWaiter>> object_status_waiters_
+      GUARDED_BY(object_status_waiters_mutex_);
+
   // Fallback for when GetAsync cannot directly get the requested object.
   void PlasmaCallback(SetResultCallback success, std::shared_ptr<RayObject> ray_object,
                       ObjectID object_id, void *py_future);
@@ -14,6 +14,9 @@
 
 #include "ray/core_worker/future_resolver.h"
 
+#include "absl/container/flat_hash_set.h"
+#include "ray/common/asio/asio_util.h"
+
 namespace ray {
 namespace core {
 
@@ -24,15 +27,91 @@ void FutureResolver::ResolveFutureAsync(const ObjectID &object_id,
     // with a borrowed reference executes on the object's owning worker.
     return;
   }
+  if (batch_window_ms_ == 0) {
+    auto conn = owner_clients_->GetOrConnect(owner_address);
+
+    rpc::GetObjectStatusRequest request;
+    request.set_object_id(object_id.Binary());
+    request.set_owner_worker_id(owner_address.worker_id());
+    conn->GetObjectStatus(request, [this, object_id, owner_address](
+                                       const Status &status,
+                                       const rpc::GetObjectStatusReply &reply) {
+      ProcessResolvedObject(object_id, owner_address, status, reply);
+    });
+    return;
+  }
+
+  const auto owner_id = WorkerID::FromBinary(owner_address.worker_id());
+  std::vector<ObjectID> full_batch;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = pending_batches_.find(owner_id);
+    if (it == pending_batches_.end()) {
+      it = pending_batches_.emplace(owner_id, PendingBatch{owner_address, {}}).first;
+      execute_after(
+          io_service_, [this, owner_id]() { FlushBatch(owner_id); }, batch_window_ms_);
+    }
+    it->second.object_ids.push_back(object_id);
+    if (it->second.object_ids.size() >= max_batch_size_) {
+      full_batch = std::move(it->second.object_ids);
+      pending_batches_.erase(it);
+    }
+  }
+  if (!full_batch.empty()) {
+    SendBatch(owner_address, std::move(full_batch));
+  }
+}
+
+void FutureResolver::FlushBatch(const WorkerID &owner_id) {
+  PendingBatch batch;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = pending_batches_.find(owner_id);
+    if (it == pending_batches_.end()) {
+      // The batch was already sent because it was full.
+      return;
+    }
+    batch = std::move(it->second);
+    pending_batches_.erase(it);
+  }
+  SendBatch(batch.owner_address, std::move(batch.object_ids));
+}
+
+void FutureResolver::SendBatch(const rpc::Address &owner_address,
+                               std::vector<ObjectID> object_ids) {
   auto conn = owner_clients_->GetOrConnect(owner_address);
 
-  rpc::GetObjectStatusRequest request;
-  request.set_object_id(object_id.Binary());
+  rpc::GetObjectStatusesRequest request;
   request.set_owner_worker_id(owner_address.worker_id());
-  conn->GetObjectStatus(
-      request, [this, object_id, owner_address](const Status &status,
-                                                const rpc::GetObjectStatusReply &reply) {
-        ProcessResolvedObject(object_id, owner_address, status, reply);
+  for (const auto &object_id : object_ids) {
+    request.add_object_ids(object_id.Binary());
+  }
+  conn->GetObjectStatuses(
+      request, [this, owner_address, object_ids = std::move(object_ids)](
+                   const Status &status, const rpc::GetObjectStatusesReply &reply) {
+        if (!status.ok()) {
+          for (const auto &object_id : object_ids) {
+            ProcessResolvedObject(object_id, owner_address, status,
+                                  rpc::GetObjectStatusReply());
+          }
+          return;
+        }
+        absl::flat_hash_set<ObjectID> resolved;
+        for (int i = 0; i < reply.object_ids_size(); i++) {
+          const auto object_id = ObjectID::FromBinary(reply.object_ids(i));
+          resolved.insert(object_id);
+          ProcessResolvedObject(object_id, owner_address, status, reply.statuses(i));
+        }
+        std::vector<ObjectID> remaining;
+        for (const auto &object_id : object_ids) {
+          if (!resolved.contains(object_id)) {
+            remaining.push_back(object_id);
+          }
+        }
+        if (!remaining.empty()) {
+          // Ask again for the objects that were not ready yet.
+          SendBatch(owner_address, std::move(remaining));
+        }
       });
 }
 
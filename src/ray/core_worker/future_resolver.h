@@ -16,6 +16,9 @@
 
 #include <memory>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "ray/common/asio/instrumented_io_context.h"
 #include "ray/common/grpc_util.h"
 #include "ray/common/id.h"
 #include "ray/core_worker/store_provider/memory_store/memory_store.h"
@@ -37,17 +40,22 @@ class FutureResolver {
                  std::shared_ptr<ReferenceCounter> ref_counter,
                  ReportLocalityDataCallback report_locality_data_callback,
                  std::shared_ptr<rpc::CoreWorkerClientPool> core_worker_client_pool,
-                 const rpc::Address &rpc_address)
+                 const rpc::Address &rpc_address, instrumented_io_context &io_service,
+                 uint64_t batch_window_ms = 0, size_t max_batch_size = 1)
       : in_memory_store_(store),
         reference_counter_(ref_counter),
         report_locality_data_callback_(std::move(report_locality_data_callback)),
         owner_clients_(core_worker_client_pool),
-        rpc_address_(rpc_address) {}
+        rpc_address_(rpc_address),
+        io_service_(io_service),
+        batch_window_ms_(batch_window_ms),
+        max_batch_size_(max_batch_size) {}
 
   /// Resolve the value for a future. This will periodically contact the given
   /// owner until the owner dies or the owner has finished creating the object.
   /// In either case, this will put an OBJECT_IN_PLASMA error as the future's
-  /// value.
+  /// value. If batching is enabled, the requests for objects of the same owner
+  /// are sent together once the batch window has passed.
   ///
   /// \param[in] object_id The ID of the future to resolve.
   /// \param[in] owner_address The address of the task or actor that owns the
@@ -65,6 +73,14 @@ class FutureResolver {
                              const rpc::GetObjectStatusReply &object_status);
 
  private:
+  /// Send the batch of requests pending for the given owner, if any.
+  void FlushBatch(const WorkerID &owner_id) LOCKS_EXCLUDED(mu_);
+
+  /// Ask the owner for the status of a batch of objects. The objects that are not
+  /// ready when the owner replies are asked for again, until all of them are resolved.
+  void SendBatch(const rpc::Address &owner_address, std::vector<ObjectID> object_ids)
+      LOCKS_EXCLUDED(mu_);
+
   /// Used to store values of resolved futures.
   std::shared_ptr<CoreWorkerMemoryStore> in_memory_store_;
 
@@ -81,6 +97,29 @@ class FutureResolver {
   /// address, so the owner can contact us to ask when our reference to the
   /// object has gone out of scope.
   const rpc::Address rpc_address_;
+
+  /// Used to flush batches once their window has passed.
+  instrumented_io_context &io_service_;
+
+  /// The window within which the requests for objects of the same owner are
+  /// batched. If 0, one GetObjectStatus request is sent per object.
+  const uint64_t batch_window_ms_;
+
+  /// The maximum number of objects in one batch request.
+  const size_t max_batch_size_;
+
+  /// Protects the batches below. Futures are resolved from multiple threads, such as
+  /// the task execution thread while deserializing args.
+  absl::Mutex mu_;
+
+  /// A batch of objects to request the status of from the same owner.
+  struct PendingBatch {
+    rpc::Address owner_address;
+    std::vector<ObjectID> object_ids;
+  };
+
+  /// The batches that have not been sent yet, by owner.
+  absl::flat_hash_map<WorkerID, PendingBatch> pending_batches_ GUARDED_BY(mu_);
 };
 
 }  // namespace core
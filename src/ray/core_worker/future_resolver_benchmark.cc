@@ -0,0 +1,199 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how many object status RPCs a task that borrows many objects of the same
+// owner sends to resolve them, and how long each object takes to resolve after it is
+// ready, depending on `object_status_batch_window_ms` and
+// `object_status_max_batch_size`. The owner is simulated: it creates the objects over
+// time and replies to the requests as CoreWorker does, after a fixed network latency.
+//
+// Usage: future_resolver_benchmark --num_objects=10000 --ready_spread_ms=100
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+// clang-format off
+#include "absl/container/flat_hash_map.h"
+#include "gflags/gflags.h"
+#include "ray/core_worker/future_resolver.h"
+#include "ray/common/asio/asio_util.h"
+// clang-format on
+
+DEFINE_int64(num_objects, 10000, "The number of objects that the task borrows.");
+DEFINE_int64(ready_spread_ms, 100,
+             "The objects become ready one after the other over this many ms.");
+DEFINE_int64(rpc_latency_us, 200, "The one-way latency of an RPC to the owner.");
+
+namespace ray {
+namespace core {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t MicrosSince(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start)
+      .count();
+}
+
+/// An owner that creates its objects at fixed times, and replies to status requests
+/// once the objects are ready. Batch requests are answered as CoreWorker does: once
+/// all of their objects are ready, or once the batch window has passed since the
+/// first of them was ready.
+class SimulatedOwner : public rpc::CoreWorkerClientInterface {
+ public:
+  SimulatedOwner(instrumented_io_context &io_service, Clock::time_point start,
+                 int64_t batch_window_ms)
+      : io_service_(io_service),
+        start_(start),
+        batch_window_us_(batch_window_ms * 1000) {}
+
+  void AddObject(const ObjectID &object_id, int64_t ready_us) {
+    ready_us_[object_id] = ready_us;
+  }
+
+  void GetObjectStatus(
+      const rpc::GetObjectStatusRequest &request,
+      const rpc::ClientCallback<rpc::GetObjectStatusReply> &callback) override {
+    num_rpcs_++;
+    const int64_t ready_us = ready_us_.at(ObjectID::FromBinary(request.object_id()));
+    const int64_t arrival_us = MicrosSince(start_) + FLAGS_rpc_latency_us;
+    const int64_t reply_us = std::max(arrival_us, ready_us);
+    ReplyAt(reply_us, [callback]() {
+      rpc::GetObjectStatusReply reply;
+      reply.set_status(rpc::GetObjectStatusReply::CREATED);
+      reply.mutable_object()->set_data("value");
+      callback(Status::OK(), reply);
+    });
+  }
+
+  void GetObjectStatuses(
+      const rpc::GetObjectStatusesRequest &request,
+      const rpc::ClientCallback<rpc::GetObjectStatusesReply> &callback) override {
+    num_rpcs_++;
+    const int64_t arrival_us = MicrosSince(start_) + FLAGS_rpc_latency_us;
+    int64_t first_ready_us = std::numeric_limits<int64_t>::max();
+    int64_t last_ready_us = 0;
+    for (const auto &object_id_binary : request.object_ids()) {
+      const int64_t ready_us = ready_us_.at(ObjectID::FromBinary(object_id_binary));
+      first_ready_us = std::min(first_ready_us, ready_us);
+      last_ready_us = std::max(last_ready_us, ready_us);
+    }
+    const int64_t reply_us =
+        std::max(arrival_us, std::min(last_ready_us,
+                                      std::max(arrival_us, first_ready_us) +
+                                          batch_window_us_));
+    rpc::GetObjectStatusesReply reply;
+    for (const auto &object_id_binary : request.object_ids()) {
+      if (ready_us_.at(ObjectID::FromBinary(object_id_binary)) <= reply_us) {
+        reply.add_object_ids(object_id_binary);
+        auto *object_status = reply.add_statuses();
+        object_status->set_status(rpc::GetObjectStatusReply::CREATED);
+        object_status->mutable_object()->set_data("value");
+      }
+    }
+    ReplyAt(reply_us, [callback, reply]() { callback(Status::OK(), reply); });
+  }
+
+  int64_t NumRpcs() const { return num_rpcs_; }
+
+ private:
+  /// Deliver a reply that the owner sends at the given time.
+  void ReplyAt(int64_t reply_us, std::function<void()> deliver) {
+    const int64_t delay_us =
+        std::max<int64_t>(reply_us + FLAGS_rpc_latency_us - MicrosSince(start_), 0);
+    execute_after_us(io_service_, std::move(deliver), delay_us);
+  }
+
+  instrumented_io_context &io_service_;
+  const Clock::time_point start_;
+  const int64_t batch_window_us_;
+  absl::flat_hash_map<ObjectID, int64_t> ready_us_;
+  int64_t num_rpcs_ = 0;
+};
+
+struct FanInBenchmarkResult {
+  int64_t num_rpcs = 0;
+  double mean_delay_us = 0;
+  double total_ms = 0;
+};
+
+/// Resolve `num_objects` borrowed objects of one owner, which become ready evenly
+/// over `ready_spread_ms`. The delay of an object is the time from when it is ready
+/// until it is resolved in the borrower's memory store.
+FanInBenchmarkResult RunFanInBenchmark(int64_t batch_window_ms, int64_t max_batch_size) {
+  instrumented_io_context io_service;
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  const auto start = Clock::now();
+  auto owner = std::make_shared<SimulatedOwner>(io_service, start, batch_window_ms);
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &) { return owner; });
+  rpc::Address owner_address;
+  owner_address.set_worker_id(WorkerID::FromRandom().Binary());
+  rpc::Address rpc_address;
+  rpc_address.set_worker_id(WorkerID::FromRandom().Binary());
+  FutureResolver resolver(
+      store, nullptr,
+      [](const ObjectID &, const absl::flat_hash_set<NodeID> &, uint64_t) {},
+      client_pool, rpc_address, io_service, batch_window_ms, max_batch_size);
+
+  int64_t num_resolved = 0;
+  int64_t total_delay_us = 0;
+  for (int64_t i = 0; i < FLAGS_num_objects; i++) {
+    const ObjectID object_id = ObjectID::FromRandom();
+    const int64_t ready_us = i * FLAGS_ready_spread_ms * 1000 / FLAGS_num_objects;
+    owner->AddObject(object_id, ready_us);
+    store->GetAsync(object_id, [&, ready_us, start](std::shared_ptr<RayObject>) {
+      total_delay_us += std::max<int64_t>(MicrosSince(start) - ready_us, 0);
+      if (++num_resolved == FLAGS_num_objects) {
+        io_service.stop();
+      }
+    });
+    resolver.ResolveFutureAsync(object_id, owner_address);
+  }
+  io_service.run();
+
+  FanInBenchmarkResult result;
+  result.num_rpcs = owner->NumRpcs();
+  result.mean_delay_us = static_cast<double>(total_delay_us) / FLAGS_num_objects;
+  result.total_ms = MicrosSince(start) / 1000.0;
+  return result;
+}
+
+}  // namespace core
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::cout << std::setw(12) << "window_ms" << std::setw(12) << "batch_size"
+            << std::setw(10) << "rpcs" << std::setw(18) << "mean_delay_us"
+            << std::setw(12) << "total_ms" << std::endl;
+  for (int64_t batch_window_ms : {0, 1, 2, 5, 10}) {
+    for (int64_t max_batch_size : {100, 500, 2000}) {
+      if (batch_window_ms == 0 && max_batch_size != 100) {
+        // Without a window, one request is sent per object.
+        continue;
+      }
+      const auto result =
+          ray::core::RunFanInBenchmark(batch_window_ms, max_batch_size);
+      std::cout << std::setw(12) << batch_window_ms << std::setw(12)
+                << (batch_window_ms == 0 ? 1 : max_batch_size) << std::setw(10)
+                << result.num_rpcs << std::setw(18) << std::fixed
+                << std::setprecision(0) << result.mean_delay_us << std::setw(12)
+                << std::setprecision(1) << result.total_ms << std::endl;
+    }
+  }
+  return 0;
+}
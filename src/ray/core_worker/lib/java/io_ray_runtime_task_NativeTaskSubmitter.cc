@@ -380,6 +380,7 @@ Java_io_ray_runtime_task_NativeTaskSubmitter_nativeSubmitActorTask(
   RAY_CHECK(callOptions != nullptr);
   auto task_options = ToTaskOptions(env, numReturns, callOptions);
 
+  CoreWorkerProcess::GetCoreWorker().WaitForActorQueueRoom(actor_id);
   auto return_refs = CoreWorkerProcess::GetCoreWorker().SubmitActorTask(
       actor_id, ray_function, task_args, task_options);
   if (!return_refs.has_value()) {
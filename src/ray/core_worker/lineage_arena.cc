@@ -0,0 +1,97 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/core_worker/lineage_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ray/util/logging.h"
+
+namespace ray {
+namespace core {
+
+LineageArena::Span LineageArena::Add(absl::string_view data) {
+  auto it = chunks_.find(current_chunk_id_);
+  if (it == chunks_.end() || it->second.capacity - it->second.used < data.size()) {
+    // The current chunk is full. It is kept until its last entry is removed.
+    if (it != chunks_.end() && it->second.live == 0) {
+      allocated_bytes_ -= it->second.capacity;
+      chunks_.erase(it);
+    }
+    current_chunk_id_ = next_chunk_id_++;
+    const size_t capacity = std::max(chunk_size_, data.size());
+    it = chunks_.emplace(current_chunk_id_, Chunk(capacity)).first;
+    allocated_bytes_ += capacity;
+  }
+  auto &chunk = it->second;
+  Span span;
+  span.chunk_id = current_chunk_id_;
+  span.offset = chunk.used;
+  span.size = data.size();
+  std::memcpy(chunk.data.get() + chunk.used, data.data(), data.size());
+  chunk.used += data.size();
+  chunk.live += data.size();
+  live_bytes_ += data.size();
+  return span;
+}
+
+absl::string_view LineageArena::Get(const Span &span) const {
+  auto it = chunks_.find(span.chunk_id);
+  RAY_CHECK(it != chunks_.end());
+  return absl::string_view(it->second.data.get() + span.offset, span.size);
+}
+
+void LineageArena::Remove(const Span &span) {
+  auto it = chunks_.find(span.chunk_id);
+  RAY_CHECK(it != chunks_.end());
+  RAY_CHECK(it->second.live >= span.size);
+  it->second.live -= span.size;
+  live_bytes_ -= span.size;
+  if (it->second.live == 0) {
+    if (span.chunk_id == current_chunk_id_) {
+      // Keep adding to the current chunk from its start.
+      it->second.used = 0;
+    } else {
+      allocated_bytes_ -= it->second.capacity;
+      chunks_.erase(it);
+    }
+  }
+}
+
+bool LineageArena::NeedsRelocation() const {
+  return allocated_bytes_ > 2 * live_bytes_ + static_cast<int64_t>(chunk_size_);
+}
+
+void LineageArena::StartNewChunk() {
+  auto it = chunks_.find(current_chunk_id_);
+  if (it != chunks_.end() && it->second.live == 0) {
+    allocated_bytes_ -= it->second.capacity;
+    chunks_.erase(it);
+  }
+  current_chunk_id_ = -1;
+}
+
+LineageArena::Span LineageArena::Relocate(const Span &span) {
+  if (span.chunk_id == current_chunk_id_) {
+    return span;
+  }
+  // Add the copy before removing the entry, which may free its chunk.
+  const Span relocated = Add(Get(span));
+  Remove(span);
+  return relocated;
+}
+
+}  // namespace core
+}  // namespace ray
@@ -0,0 +1,103 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+
+namespace ray {
+namespace core {
+
+/// Stores byte strings back to back in large chunks, instead of in one heap
+/// allocation each. This is used for the serialized lineage of finished tasks, of
+/// which a driver may pin millions.
+///
+/// A chunk is freed once all of its entries are removed. Entries that outlive the rest
+/// of their chunk can keep it alive, so once less than half of the allocated bytes are
+/// in use, the owner should move all entries into new chunks with `Relocate`. This
+/// keeps the allocated bytes below twice the bytes in use plus one chunk.
+///
+/// This class is not thread-safe.
+class LineageArena {
+ public:
+  /// The location of an entry.
+  struct Span {
+    int64_t chunk_id = -1;
+    size_t offset = 0;
+    size_t size = 0;
+  };
+
+  /// \param chunk_size The size of each chunk. Larger entries get a chunk of their own.
+  explicit LineageArena(size_t chunk_size = 64 * 1024) : chunk_size_(chunk_size) {}
+
+  /// Copy the data into the arena.
+  ///
+  /// \return The location of the entry.
+  Span Add(absl::string_view data);
+
+  /// Return the data of an entry. This is valid until the entry is removed or moved.
+  absl::string_view Get(const Span &span) const;
+
+  /// Remove an entry. Its chunk is freed if it was the last entry in it.
+  void Remove(const Span &span);
+
+  /// Whether more than half of the allocated bytes are of removed entries.
+  bool NeedsRelocation() const;
+
+  /// Start a new chunk for the entries added next. Call this before moving the entries
+  /// with `Relocate`, so that they are not moved into a chunk that is mostly unused.
+  void StartNewChunk();
+
+  /// Move an entry to the current chunk.
+  ///
+  /// \return The new location of the entry.
+  Span Relocate(const Span &span);
+
+  /// The bytes of all allocated chunks.
+  int64_t AllocatedBytes() const { return allocated_bytes_; }
+
+  /// The bytes of the entries that were not removed.
+  int64_t LiveBytes() const { return live_bytes_; }
+
+ private:
+  struct Chunk {
+    explicit Chunk(size_t capacity) : data(new char[capacity]), capacity(capacity) {}
+    std::unique_ptr<char[]> data;
+    size_t capacity;
+    /// The bytes at the start of the chunk that were handed out.
+    size_t used = 0;
+    /// The bytes of the entries in the chunk that were not removed.
+    size_t live = 0;
+  };
+
+  const size_t chunk_size_;
+
+  absl::flat_hash_map<int64_t, Chunk> chunks_;
+
+  /// The chunk that entries are added to, or -1 if there is none.
+  int64_t current_chunk_id_ = -1;
+
+  int64_t next_chunk_id_ = 0;
+
+  int64_t allocated_bytes_ = 0;
+
+  int64_t live_bytes_ = 0;
+};
+
+}  // namespace core
+}  // namespace ray
@@ -14,6 +14,8 @@
 
 #include "ray/core_worker/reference_count.h"
 
+#include <algorithm>
+
 #define PRINT_REF_COUNT(it)                                                              \
   RAY_LOG(DEBUG) << "REF " << it->first << " borrowers: " << it->second.borrowers.size() \
                  << " local_ref_count: " << it->second.local_ref_count                   \
@@ -30,13 +32,68 @@ namespace {}  // namespace
 namespace ray {
 namespace core {
 
+ReferenceCounter::ShardLock::ShardLock(const ReferenceCounter &reference_counter,
+                                       const ObjectID &object_id)
+    : reference_counter_(reference_counter) {
+  shard_indices_.push_back(ShardIndex(object_id));
+  Lock();
+}
+
+ReferenceCounter::ShardLock::ShardLock(const ReferenceCounter &reference_counter,
+                                       const std::vector<ObjectID> &object_ids)
+    : ShardLock(reference_counter, object_ids, {}) {}
+
+ReferenceCounter::ShardLock::ShardLock(const ReferenceCounter &reference_counter,
+                                       const std::vector<ObjectID> &return_ids,
+                                       const std::vector<ObjectID> &argument_ids)
+    : reference_counter_(reference_counter) {
+  for (const auto &object_id : return_ids) {
+    shard_indices_.push_back(ShardIndex(object_id));
+  }
+  for (const auto &object_id : argument_ids) {
+    shard_indices_.push_back(ShardIndex(object_id));
+  }
+  std::sort(shard_indices_.begin(), shard_indices_.end());
+  shard_indices_.erase(std::unique(shard_indices_.begin(), shard_indices_.end()),
+                       shard_indices_.end());
+  Lock();
+}
+
+void ReferenceCounter::ShardLock::Lock() {
+  for (size_t shard_index : shard_indices_) {
+    reference_counter_.shard_mutexes_[shard_index].Lock();
+  }
+}
+
+ReferenceCounter::ShardLock::~ShardLock() {
+  for (auto it = shard_indices_.rbegin(); it != shard_indices_.rend(); it++) {
+    reference_counter_.shard_mutexes_[*it].Unlock();
+  }
+}
+
+ReferenceCounter::ExclusiveLock::ExclusiveLock(const ReferenceCounter &reference_counter)
+    : reference_counter_(reference_counter) {
+  reference_counter_.mutex_.Lock();
+  for (auto &shard_mutex : reference_counter_.shard_mutexes_) {
+    shard_mutex.Lock();
+  }
+}
+
+ReferenceCounter::ExclusiveLock::~ExclusiveLock() {
+  for (auto it = reference_counter_.shard_mutexes_.rbegin();
+       it != reference_counter_.shard_mutexes_.rend(); it++) {
+    it->Unlock();
+  }
+  reference_counter_.mutex_.Unlock();
+}
+
 bool ReferenceCounter::OwnObjects() const {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   return !object_id_refs_.empty();
 }
 
 bool ReferenceCounter::OwnedByUs(const ObjectID &object_id) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it != object_id_refs_.end()) {
     return it->second.owned_by_us;
@@ -45,8 +102,8 @@ bool ReferenceCounter::OwnedByUs(const ObjectID &object_id) const {
 }
 
 void ReferenceCounter::DrainAndShutdown(std::function<void()> shutdown) {
-  absl::MutexLock lock(&mutex_);
-  if (object_id_refs_.empty()) {
+  ExclusiveLock lock(*this);
+  if (object_id_refs_.empty() && pending_ref_removed_messages_.empty()) {
     shutdown();
   } else {
     RAY_LOG(WARNING)
@@ -57,10 +114,15 @@ void ReferenceCounter::DrainAndShutdown(std::function<void()> shutdown) {
 }
 
 void ReferenceCounter::ShutdownIfNeeded() {
-  if (shutdown_hook_ && object_id_refs_.empty()) {
+  if (shutdown_hook_ && object_id_refs_.empty() &&
+      pending_ref_removed_messages_.empty()) {
     RAY_LOG(WARNING)
         << "All object references have gone out of scope, shutting down worker.";
-    shutdown_hook_();
+    // References in different shards may be deleted concurrently and both find the
+    // table empty afterwards, so make sure that we only shut down once.
+    auto shutdown = std::move(shutdown_hook_);
+    shutdown_hook_ = nullptr;
+    shutdown();
   }
 }
 
@@ -87,11 +149,39 @@ bool ReferenceCounter::AddBorrowedObject(const ObjectID &object_id,
                                          const ObjectID &outer_id,
                                          const rpc::Address &owner_address,
                                          bool foreign_owner_already_monitoring) {
-  absl::MutexLock lock(&mutex_);
+  ShardDeletions deletions;
+  if (outer_id.IsNil() && AddBorrowedObjectInShard(object_id, owner_address,
+                                                   foreign_owner_already_monitoring,
+                                                   &deletions)) {
+    FinishShardDeletions(&deletions);
+    return true;
+  }
+  ExclusiveLock lock(*this);
   return AddBorrowedObjectInternal(object_id, outer_id, owner_address,
                                    foreign_owner_already_monitoring);
 }
 
+bool ReferenceCounter::AddBorrowedObjectInShard(const ObjectID &object_id,
+                                                const rpc::Address &owner_address,
+                                                bool foreign_owner_already_monitoring,
+                                                ShardDeletions *deletions) {
+  ShardLock lock(*this, object_id);
+  auto it = object_id_refs_.find(object_id);
+  if (it == object_id_refs_.end()) {
+    it = object_id_refs_.emplace(object_id, Reference()).first;
+  } else if (it->second.RefCount() == 0 && !CanDeleteInShard(it->second)) {
+    return false;
+  }
+
+  RAY_LOG(DEBUG) << "Adding borrowed object " << object_id;
+  it->second.owner_address = owner_address;
+  it->second.foreign_owner_already_monitoring |= foreign_owner_already_monitoring;
+  if (it->second.RefCount() == 0) {
+    DeleteReferenceInShard(it, nullptr, deletions);
+  }
+  return true;
+}
+
 bool ReferenceCounter::AddBorrowedObjectInternal(const ObjectID &object_id,
                                                  const ObjectID &outer_id,
                                                  const rpc::Address &owner_address,
@@ -129,7 +219,7 @@ bool ReferenceCounter::AddBorrowedObjectInternal(const ObjectID &object_id,
 void ReferenceCounter::AddObjectRefStats(
     const absl::flat_hash_map<ObjectID, std::pair<int64_t, std::string>> pinned_objects,
     rpc::CoreWorkerStats *stats) const {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   for (const auto &ref : object_id_refs_) {
     auto ref_proto = stats->add_object_refs();
     ref_proto->set_object_id(ref.first.Binary());
@@ -171,7 +261,24 @@ void ReferenceCounter::AddOwnedObject(const ObjectID &object_id,
                                       const int64_t object_size, bool is_reconstructable,
                                       const absl::optional<NodeID> &pinned_at_raylet_id) {
   RAY_LOG(DEBUG) << "Adding owned object " << object_id;
-  absl::MutexLock lock(&mutex_);
+  if (inner_ids.empty()) {
+    ShardLock lock(*this, object_id);
+    AddOwnedObjectInternal(object_id, owner_address, call_site, object_size,
+                           is_reconstructable, pinned_at_raylet_id);
+    return;
+  }
+  ExclusiveLock lock(*this);
+  AddOwnedObjectInternal(object_id, owner_address, call_site, object_size,
+                         is_reconstructable, pinned_at_raylet_id);
+  // Mark that this object ID contains other inner IDs. Then, we will not GC
+  // the inner objects until the outer object ID goes out of scope.
+  AddNestedObjectIdsInternal(object_id, inner_ids, rpc_address_);
+}
+
+void ReferenceCounter::AddOwnedObjectInternal(
+    const ObjectID &object_id, const rpc::Address &owner_address,
+    const std::string &call_site, const int64_t object_size, bool is_reconstructable,
+    const absl::optional<NodeID> &pinned_at_raylet_id) {
   RAY_CHECK(object_id_refs_.count(object_id) == 0)
       << "Tried to create an owned object that already exists: " << object_id;
   // If the entry doesn't exist, we initialize the direct reference count to zero
@@ -183,24 +290,29 @@ void ReferenceCounter::AddOwnedObject(const ObjectID &object_id,
                 .emplace(object_id, Reference(owner_address, call_site, object_size,
                                               is_reconstructable, pinned_at_raylet_id))
                 .first;
-  if (!inner_ids.empty()) {
-    // Mark that this object ID contains other inner IDs. Then, we will not GC
-    // the inner objects until the outer object ID goes out of scope.
-    AddNestedObjectIdsInternal(object_id, inner_ids, rpc_address_);
-  }
   if (pinned_at_raylet_id.has_value()) {
     // We eagerly add the pinned location to the set of object locations.
     AddObjectLocationInternal(it, pinned_at_raylet_id.value());
   }
 
+  absl::MutexLock lock(&reconstructable_owned_objects_mutex_);
   reconstructable_owned_objects_.emplace_back(object_id);
   auto back_it = reconstructable_owned_objects_.end();
   back_it--;
   RAY_CHECK(reconstructable_owned_objects_index_.emplace(object_id, back_it).second);
 }
 
+void ReferenceCounter::RemoveReconstructableOwnedObject(const ObjectID &object_id) {
+  absl::MutexLock lock(&reconstructable_owned_objects_mutex_);
+  auto index_it = reconstructable_owned_objects_index_.find(object_id);
+  if (index_it != reconstructable_owned_objects_index_.end()) {
+    reconstructable_owned_objects_.erase(index_it->second);
+    reconstructable_owned_objects_index_.erase(index_it);
+  }
+}
+
 void ReferenceCounter::RemoveOwnedObject(const ObjectID &object_id) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   auto it = object_id_refs_.find(object_id);
   RAY_CHECK(it != object_id_refs_.end())
       << "Tried to remove reference for nonexistent owned object " << object_id
@@ -214,7 +326,7 @@ void ReferenceCounter::RemoveOwnedObject(const ObjectID &object_id) {
 }
 
 void ReferenceCounter::UpdateObjectSize(const ObjectID &object_id, int64_t object_size) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it != object_id_refs_.end()) {
     it->second.object_size = object_size;
@@ -224,10 +336,10 @@ void ReferenceCounter::UpdateObjectSize(const ObjectID &object_id, int64_t objec
 
 void ReferenceCounter::AddLocalReference(const ObjectID &object_id,
                                          const std::string &call_site) {
-  if (object_id.IsNil()) {
+  if (object_id.IsNil() || AddLocalReferenceInShard(object_id, call_site)) {
     return;
   }
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     // NOTE: ownership info for these objects must be added later via AddBorrowedObject.
@@ -242,7 +354,27 @@ void ReferenceCounter::AddLocalReference(const ObjectID &object_id,
   }
 }
 
-void ReferenceCounter::SetNestedRefInUseRecursive(ReferenceTable::iterator inner_ref_it) {
+bool ReferenceCounter::AddLocalReferenceInShard(const ObjectID &object_id,
+                                                const std::string &call_site) {
+  ShardLock lock(*this, object_id);
+  auto it = object_id_refs_.find(object_id);
+  if (it == object_id_refs_.end()) {
+    // NOTE: ownership info for these objects must be added later via AddBorrowedObject.
+    it = object_id_refs_.emplace(object_id, Reference(call_site, -1)).first;
+  } else if (it->second.RefCount() == 0 &&
+             !it->second.contained_in_borrowed_ids.empty()) {
+    // A reference nested in borrowed objects that comes into use must be reported
+    // to the owners of the outer objects, which needs the exclusive lock.
+    return false;
+  }
+  it->second.local_ref_count++;
+  RAY_LOG(DEBUG) << "Add local reference " << object_id;
+  PRINT_REF_COUNT(it);
+  return true;
+}
+
+void ReferenceCounter::SetNestedRefInUseRecursive(
+    ShardedReferenceTable::iterator inner_ref_it) {
   for (const auto &contained_in_borrowed_id :
        inner_ref_it->second.contained_in_borrowed_ids) {
     auto contained_in_it = object_id_refs_.find(contained_in_borrowed_id);
@@ -255,7 +387,7 @@ void ReferenceCounter::SetNestedRefInUseRecursive(ReferenceTable::iterator inner
 }
 
 void ReferenceCounter::ReleaseAllLocalReferences() {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   std::vector<ObjectID> refs_to_remove;
   for (auto &ref : object_id_refs_) {
     for (int i = ref.second.local_ref_count; i > 0; --i) {
@@ -272,10 +404,33 @@ void ReferenceCounter::RemoveLocalReference(const ObjectID &object_id,
   if (object_id.IsNil()) {
     return;
   }
-  absl::MutexLock lock(&mutex_);
+  ShardDeletions deletions;
+  if (RemoveLocalReferenceInShard(object_id, deleted, &deletions)) {
+    FinishShardDeletions(&deletions);
+    return;
+  }
+  ExclusiveLock lock(*this);
   RemoveLocalReferenceInternal(object_id, deleted);
 }
 
+bool ReferenceCounter::RemoveLocalReferenceInShard(const ObjectID &object_id,
+                                                   std::vector<ObjectID> *deleted,
+                                                   ShardDeletions *deletions) {
+  ShardLock lock(*this, object_id);
+  auto it = object_id_refs_.find(object_id);
+  if (it == object_id_refs_.end() || it->second.local_ref_count == 0 ||
+      (it->second.RefCount() == 1 && !CanDeleteInShard(it->second))) {
+    return false;
+  }
+  it->second.local_ref_count--;
+  RAY_LOG(DEBUG) << "Remove local reference " << object_id;
+  PRINT_REF_COUNT(it);
+  if (it->second.RefCount() == 0) {
+    DeleteReferenceInShard(it, deleted, deletions);
+  }
+  return true;
+}
+
 void ReferenceCounter::RemoveLocalReferenceInternal(const ObjectID &object_id,
                                                     std::vector<ObjectID> *deleted) {
   RAY_CHECK(!object_id.IsNil());
@@ -305,7 +460,11 @@ void ReferenceCounter::UpdateSubmittedTaskReferences(
     const std::vector<ObjectID> return_ids,
     const std::vector<ObjectID> &argument_ids_to_add,
     const std::vector<ObjectID> &argument_ids_to_remove, std::vector<ObjectID> *deleted) {
-  absl::MutexLock lock(&mutex_);
+  if (argument_ids_to_remove.empty() &&
+      UpdateSubmittedTaskReferencesInShards(return_ids, argument_ids_to_add)) {
+    return;
+  }
+  ExclusiveLock lock(*this);
   for (const auto &return_id : return_ids) {
     UpdateObjectPendingCreation(return_id, true);
   }
@@ -332,9 +491,35 @@ void ReferenceCounter::UpdateSubmittedTaskReferences(
                                 deleted);
 }
 
+bool ReferenceCounter::UpdateSubmittedTaskReferencesInShards(
+    const std::vector<ObjectID> &return_ids, const std::vector<ObjectID> &argument_ids) {
+  ShardLock lock(*this, return_ids, argument_ids);
+  // Arguments nested in borrowed objects that come into use must be reported to the
+  // owners of the outer objects, which needs the exclusive lock.
+  for (const ObjectID &argument_id : argument_ids) {
+    auto it = object_id_refs_.find(argument_id);
+    if (it != object_id_refs_.end() && it->second.RefCount() == 0 &&
+        !it->second.contained_in_borrowed_ids.empty()) {
+      return false;
+    }
+  }
+  for (const auto &return_id : return_ids) {
+    UpdateObjectPendingCreation(return_id, true);
+  }
+  for (const ObjectID &argument_id : argument_ids) {
+    RAY_LOG(DEBUG) << "Increment ref count for submitted task argument " << argument_id;
+    // The argument has no reference yet if a large argument is transparently passed
+    // by reference because we don't hold a Python reference to its ObjectID.
+    auto &ref = object_id_refs_.emplace(argument_id, Reference()).first->second;
+    ref.submitted_task_ref_count++;
+    ref.lineage_ref_count++;
+  }
+  return true;
+}
+
 void ReferenceCounter::UpdateResubmittedTaskReferences(
     const std::vector<ObjectID> return_ids, const std::vector<ObjectID> &argument_ids) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   for (const auto &return_id : return_ids) {
     UpdateObjectPendingCreation(return_id, true);
   }
@@ -353,7 +538,17 @@ void ReferenceCounter::UpdateFinishedTaskReferences(
     const std::vector<ObjectID> return_ids, const std::vector<ObjectID> &argument_ids,
     bool release_lineage, const rpc::Address &worker_addr,
     const ReferenceTableProto &borrowed_refs, std::vector<ObjectID> *deleted) {
-  absl::MutexLock lock(&mutex_);
+  const auto refs = ReferenceTableFromProto(borrowed_refs);
+  if (!refs.empty()) {
+    RAY_CHECK(!WorkerID::FromBinary(worker_addr.worker_id()).IsNil());
+  }
+  ShardDeletions deletions;
+  if (UpdateFinishedTaskReferencesInShards(return_ids, argument_ids, release_lineage,
+                                           refs, deleted, &deletions)) {
+    FinishShardDeletions(&deletions);
+    return;
+  }
+  ExclusiveLock lock(*this);
   for (const auto &return_id : return_ids) {
     UpdateObjectPendingCreation(return_id, false);
   }
@@ -361,10 +556,6 @@ void ReferenceCounter::UpdateFinishedTaskReferences(
   // to make sure that for serialized IDs, we increment the borrower count for
   // the inner ID before decrementing the submitted_task_ref_count for the
   // outer ID.
-  const auto refs = ReferenceTableFromProto(borrowed_refs);
-  if (!refs.empty()) {
-    RAY_CHECK(!WorkerID::FromBinary(worker_addr.worker_id()).IsNil());
-  }
   for (const ObjectID &argument_id : argument_ids) {
     MergeRemoteBorrowers(argument_id, worker_addr, refs);
   }
@@ -372,12 +563,61 @@ void ReferenceCounter::UpdateFinishedTaskReferences(
   RemoveSubmittedTaskReferences(argument_ids, release_lineage, deleted);
 }
 
-int64_t ReferenceCounter::ReleaseLineageReferences(ReferenceTable::iterator ref) {
+bool ReferenceCounter::UpdateFinishedTaskReferencesInShards(
+    const std::vector<ObjectID> &return_ids, const std::vector<ObjectID> &argument_ids,
+    bool release_lineage, const ReferenceTable &borrowed_refs,
+    std::vector<ObjectID> *deleted, ShardDeletions *deletions) {
+  ShardLock lock(*this, return_ids, argument_ids);
+  // An argument may be passed to the task more than once.
+  absl::flat_hash_map<ObjectID, size_t> num_refs_to_remove;
+  for (const ObjectID &argument_id : argument_ids) {
+    num_refs_to_remove[argument_id]++;
+  }
+  for (const auto &entry : num_refs_to_remove) {
+    auto it = object_id_refs_.find(entry.first);
+    if (it == object_id_refs_.end() ||
+        it->second.submitted_task_ref_count < entry.second ||
+        (it->second.RefCount() == entry.second && !CanDeleteInShard(it->second))) {
+      return false;
+    }
+    // Merging the refs that the worker borrowed needs the exclusive lock, unless the
+    // worker stopped using the argument without passing it on or nesting it, which
+    // is what most tasks do.
+    auto borrower_it = borrowed_refs.find(entry.first);
+    if (borrower_it != borrowed_refs.end()) {
+      const auto &borrower_ref = borrower_it->second;
+      if (borrower_ref.RefCount() > 0 || !borrower_ref.borrowers.empty() ||
+          !borrower_ref.stored_in_objects.empty() ||
+          !borrower_ref.contained_in_borrowed_ids.empty() ||
+          !borrower_ref.contains.empty() ||
+          !it->second.contained_in_borrowed_ids.empty()) {
+        return false;
+      }
+    }
+  }
+  for (const auto &return_id : return_ids) {
+    UpdateObjectPendingCreation(return_id, false);
+  }
+  for (const ObjectID &argument_id : argument_ids) {
+    RAY_LOG(DEBUG) << "Releasing ref for submitted task argument " << argument_id;
+    auto it = object_id_refs_.find(argument_id);
+    it->second.submitted_task_ref_count--;
+    if (release_lineage && it->second.lineage_ref_count > 0) {
+      it->second.lineage_ref_count--;
+    }
+    if (it->second.RefCount() == 0) {
+      DeleteReferenceInShard(it, deleted, deletions);
+    }
+  }
+  return true;
+}
+
+int64_t ReferenceCounter::ReleaseTaskLineage(ShardedReferenceTable::iterator ref,
+                                             std::vector<ObjectID> *argument_ids) {
   int64_t lineage_bytes_evicted = 0;
-  std::vector<ObjectID> argument_ids;
   if (on_lineage_released_ && ref->second.owned_by_us) {
     RAY_LOG(DEBUG) << "Releasing lineage for object " << ref->first;
-    lineage_bytes_evicted += on_lineage_released_(ref->first, &argument_ids);
+    lineage_bytes_evicted += on_lineage_released_(ref->first, argument_ids);
     // The object is still in scope by the application and it was
     // reconstructable with lineage. Mark that its lineage has been evicted so
     // we can return the right error during reconstruction.
@@ -387,6 +627,12 @@ int64_t ReferenceCounter::ReleaseLineageReferences(ReferenceTable::iterator ref)
       ref->second.is_reconstructable = false;
     }
   }
+  return lineage_bytes_evicted;
+}
+
+int64_t ReferenceCounter::ReleaseLineageReferences(ShardedReferenceTable::iterator ref) {
+  std::vector<ObjectID> argument_ids;
+  int64_t lineage_bytes_evicted = ReleaseTaskLineage(ref, &argument_ids);
 
   for (const ObjectID &argument_id : argument_ids) {
     auto arg_it = object_id_refs_.find(argument_id);
@@ -437,7 +683,7 @@ void ReferenceCounter::RemoveSubmittedTaskReferences(
 
 bool ReferenceCounter::GetOwner(const ObjectID &object_id,
                                 rpc::Address *owner_address) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   return GetOwnerInternal(object_id, owner_address);
 }
 
@@ -458,7 +704,7 @@ bool ReferenceCounter::GetOwnerInternal(const ObjectID &object_id,
 
 std::vector<rpc::Address> ReferenceCounter::GetOwnerAddresses(
     const std::vector<ObjectID> object_ids) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_ids);
   std::vector<rpc::Address> owner_addresses;
   for (const auto &object_id : object_ids) {
     rpc::Address owner_addr;
@@ -482,12 +728,12 @@ std::vector<rpc::Address> ReferenceCounter::GetOwnerAddresses(
 }
 
 bool ReferenceCounter::IsPlasmaObjectFreed(const ObjectID &object_id) const {
-  absl::MutexLock lock(&mutex_);
-  return freed_objects_.find(object_id) != freed_objects_.end();
+  ShardLock lock(*this, object_id);
+  return freed_objects_[ShardIndex(object_id)].contains(object_id);
 }
 
 void ReferenceCounter::FreePlasmaObjects(const std::vector<ObjectID> &object_ids) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_ids);
   for (const ObjectID &object_id : object_ids) {
     auto it = object_id_refs_.find(object_id);
     if (it == object_id_refs_.end()) {
@@ -497,7 +743,7 @@ void ReferenceCounter::FreePlasmaObjects(const std::vector<ObjectID> &object_ids
     }
     // The object is still in scope. It will be removed from this set
     // once its Reference has been deleted.
-    freed_objects_.insert(object_id);
+    freed_objects_[ShardIndex(object_id)].insert(object_id);
     if (!it->second.owned_by_us) {
       RAY_LOG(WARNING)
           << "Tried to free an object " << object_id
@@ -510,7 +756,7 @@ void ReferenceCounter::FreePlasmaObjects(const std::vector<ObjectID> &object_ids
   }
 }
 
-void ReferenceCounter::DeleteReferenceInternal(ReferenceTable::iterator it,
+void ReferenceCounter::DeleteReferenceInternal(ShardedReferenceTable::iterator it,
                                                std::vector<ObjectID> *deleted) {
   const ObjectID id = it->first;
   RAY_LOG(DEBUG) << "Attempting to delete object " << id;
@@ -543,12 +789,7 @@ void ReferenceCounter::DeleteReferenceInternal(ReferenceTable::iterator it,
     if (deleted) {
       deleted->push_back(id);
     }
-
-    auto index_it = reconstructable_owned_objects_index_.find(id);
-    if (index_it != reconstructable_owned_objects_index_.end()) {
-      reconstructable_owned_objects_.erase(index_it->second);
-      reconstructable_owned_objects_index_.erase(index_it);
-    }
+    RemoveReconstructableOwnedObject(id);
   }
 
   if (it->second.ShouldDelete(lineage_pinning_enabled_)) {
@@ -559,31 +800,89 @@ void ReferenceCounter::DeleteReferenceInternal(ReferenceTable::iterator it,
   }
 }
 
-void ReferenceCounter::EraseReference(ReferenceTable::iterator it) {
+void ReferenceCounter::DeleteReferenceInShard(ShardedReferenceTable::iterator it,
+                                              std::vector<ObjectID> *deleted,
+                                              ShardDeletions *deletions) {
+  const ObjectID id = it->first;
+  RAY_LOG(DEBUG) << "Attempting to delete object " << id;
+  PRINT_REF_COUNT(it);
+  if (it->second.OutOfScope(lineage_pinning_enabled_)) {
+    ReleasePlasmaObject(it);
+    if (deleted) {
+      deleted->push_back(id);
+    }
+    RemoveReconstructableOwnedObject(id);
+  }
+
+  if (it->second.ShouldDelete(lineage_pinning_enabled_)) {
+    RAY_LOG(DEBUG) << "Deleting Reference to object " << id;
+    ReleaseTaskLineage(it, &deletions->released_argument_ids);
+    EraseReferenceInShard(it);
+    // The shutdown hook is only set under the exclusive lock, which includes the
+    // lock of this shard.
+    deletions->shutdown_scheduled |= shutdown_hook_ != nullptr;
+  }
+}
+
+void ReferenceCounter::FinishShardDeletions(ShardDeletions *deletions) {
+  while (!deletions->released_argument_ids.empty()) {
+    const auto argument_ids = std::move(deletions->released_argument_ids);
+    deletions->released_argument_ids.clear();
+    ShardLock lock(*this, argument_ids);
+    for (const ObjectID &argument_id : argument_ids) {
+      auto arg_it = object_id_refs_.find(argument_id);
+      if (arg_it == object_id_refs_.end() || arg_it->second.lineage_ref_count == 0) {
+        continue;
+      }
+      RAY_LOG(DEBUG) << "Releasing lineage internal for argument " << argument_id;
+      arg_it->second.lineage_ref_count--;
+      if (arg_it->second.ShouldDelete(lineage_pinning_enabled_)) {
+        // We only decremented the lineage ref count, so the argument value
+        // should already be released.
+        RAY_CHECK(arg_it->second.on_ref_removed == nullptr);
+        ReleaseTaskLineage(arg_it, &deletions->released_argument_ids);
+        EraseReferenceInShard(arg_it);
+        deletions->shutdown_scheduled |= shutdown_hook_ != nullptr;
+      }
+    }
+  }
+  if (deletions->shutdown_scheduled) {
+    ExclusiveLock lock(*this);
+    ShutdownIfNeeded();
+  }
+}
+
+void ReferenceCounter::EraseReference(ShardedReferenceTable::iterator it) {
+  EraseReferenceInShard(it);
+  ShutdownIfNeeded();
+}
+
+void ReferenceCounter::EraseReferenceInShard(ShardedReferenceTable::iterator it) {
   // NOTE(swang): We have to publish failure to subscribers in case they
   // subscribe after the ref is already deleted.
   object_info_publisher_->PublishFailure(
       rpc::ChannelType::WORKER_OBJECT_LOCATIONS_CHANNEL, it->first.Binary());
 
   RAY_CHECK(it->second.ShouldDelete(lineage_pinning_enabled_));
-  auto index_it = reconstructable_owned_objects_index_.find(it->first);
-  if (index_it != reconstructable_owned_objects_index_.end()) {
-    reconstructable_owned_objects_.erase(index_it->second);
-    reconstructable_owned_objects_index_.erase(index_it);
-  }
-  freed_objects_.erase(it->first);
+  RemoveReconstructableOwnedObject(it->first);
+  freed_objects_[ShardIndex(it->first)].erase(it->first);
   object_id_refs_.erase(it);
-  ShutdownIfNeeded();
 }
 
 int64_t ReferenceCounter::EvictLineage(int64_t min_bytes_to_evict) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   int64_t lineage_bytes_evicted = 0;
-  while (!reconstructable_owned_objects_.empty() &&
-         lineage_bytes_evicted < min_bytes_to_evict) {
-    ObjectID object_id = std::move(reconstructable_owned_objects_.front());
-    reconstructable_owned_objects_.pop_front();
-    reconstructable_owned_objects_index_.erase(object_id);
+  while (lineage_bytes_evicted < min_bytes_to_evict) {
+    ObjectID object_id;
+    {
+      absl::MutexLock queue_lock(&reconstructable_owned_objects_mutex_);
+      if (reconstructable_owned_objects_.empty()) {
+        break;
+      }
+      object_id = std::move(reconstructable_owned_objects_.front());
+      reconstructable_owned_objects_.pop_front();
+      reconstructable_owned_objects_index_.erase(object_id);
+    }
 
     auto it = object_id_refs_.find(object_id);
     RAY_CHECK(it != object_id_refs_.end());
@@ -592,7 +891,7 @@ int64_t ReferenceCounter::EvictLineage(int64_t min_bytes_to_evict) {
   return lineage_bytes_evicted;
 }
 
-void ReferenceCounter::ReleasePlasmaObject(ReferenceTable::iterator it) {
+void ReferenceCounter::ReleasePlasmaObject(ShardedReferenceTable::iterator it) {
   if (it->second.on_delete) {
     RAY_LOG(DEBUG) << "Calling on_delete for object " << it->first;
     it->second.on_delete(it->first);
@@ -603,7 +902,7 @@ void ReferenceCounter::ReleasePlasmaObject(ReferenceTable::iterator it) {
 
 bool ReferenceCounter::SetDeleteCallback(
     const ObjectID &object_id, const std::function<void(const ObjectID &)> callback) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     return false;
@@ -612,7 +911,7 @@ bool ReferenceCounter::SetDeleteCallback(
     // The object has already gone out of scope but cannot be deleted yet. Do
     // not set the deletion callback because it may never get called.
     return false;
-  } else if (freed_objects_.count(object_id) > 0) {
+  } else if (freed_objects_[ShardIndex(object_id)].count(object_id) > 0) {
     // The object has been freed by the language frontend, so it
     // should be deleted immediately.
     return false;
@@ -630,7 +929,7 @@ bool ReferenceCounter::SetDeleteCallback(
 
 std::vector<ObjectID> ReferenceCounter::ResetObjectsOnRemovedNode(
     const NodeID &raylet_id) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   std::vector<ObjectID> lost_objects;
   for (auto it = object_id_refs_.begin(); it != object_id_refs_.end(); it++) {
     const auto &object_id = it->first;
@@ -645,10 +944,10 @@ std::vector<ObjectID> ReferenceCounter::ResetObjectsOnRemovedNode(
 
 void ReferenceCounter::UpdateObjectPinnedAtRaylet(const ObjectID &object_id,
                                                   const NodeID &raylet_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it != object_id_refs_.end()) {
-    if (freed_objects_.count(object_id) > 0) {
+    if (freed_objects_[ShardIndex(object_id)].count(object_id) > 0) {
       // The object has been freed by the language frontend.
       return;
     }
@@ -674,7 +973,7 @@ void ReferenceCounter::UpdateObjectPinnedAtRaylet(const ObjectID &object_id,
 bool ReferenceCounter::IsPlasmaObjectPinnedOrSpilled(const ObjectID &object_id,
                                                      bool *owned_by_us, NodeID *pinned_at,
                                                      bool *spilled) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it != object_id_refs_.end()) {
     if (it->second.owned_by_us) {
@@ -688,17 +987,17 @@ bool ReferenceCounter::IsPlasmaObjectPinnedOrSpilled(const ObjectID &object_id,
 }
 
 bool ReferenceCounter::HasReference(const ObjectID &object_id) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   return object_id_refs_.find(object_id) != object_id_refs_.end();
 }
 
 size_t ReferenceCounter::NumObjectIDsInScope() const {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   return object_id_refs_.size();
 }
 
 std::unordered_set<ObjectID> ReferenceCounter::GetAllInScopeObjectIDs() const {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   std::unordered_set<ObjectID> in_scope_object_ids;
   in_scope_object_ids.reserve(object_id_refs_.size());
   for (auto it : object_id_refs_) {
@@ -709,7 +1008,7 @@ std::unordered_set<ObjectID> ReferenceCounter::GetAllInScopeObjectIDs() const {
 
 std::unordered_map<ObjectID, std::pair<size_t, size_t>>
 ReferenceCounter::GetAllReferenceCounts() const {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   std::unordered_map<ObjectID, std::pair<size_t, size_t>> all_ref_counts;
   all_ref_counts.reserve(object_id_refs_.size());
   for (auto it : object_id_refs_) {
@@ -723,7 +1022,7 @@ ReferenceCounter::GetAllReferenceCounts() const {
 void ReferenceCounter::PopAndClearLocalBorrowers(
     const std::vector<ObjectID> &borrowed_ids,
     ReferenceCounter::ReferenceTableProto *proto, std::vector<ObjectID> *deleted) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   ReferenceTable borrowed_refs;
   for (const auto &borrowed_id : borrowed_ids) {
     RAY_CHECK(GetAndClearLocalBorrowersInternal(borrowed_id,
@@ -887,18 +1186,46 @@ void ReferenceCounter::MergeRemoteBorrowers(const ObjectID &object_id,
 void ReferenceCounter::CleanupBorrowersOnRefRemoved(
     const ReferenceTable &new_borrower_refs, const ObjectID &object_id,
     const rpc::WorkerAddress &borrower_addr) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
+  CleanupBorrowersOnRefRemovedInternal(new_borrower_refs, object_id, borrower_addr);
+}
+
+void ReferenceCounter::CleanupBorrowersOnRefRemoved(
+    const rpc::WorkerRefRemovedMessage &message, const ObjectID &object_id,
+    const rpc::WorkerAddress &borrower_addr) {
+  ExclusiveLock lock(*this);
+  CleanupBorrowersOnRefRemovedInternal(ReferenceTableFromProto(message.borrowed_refs()),
+                                       object_id, borrower_addr);
+  for (const auto &coalesced : message.coalesced_refs()) {
+    CleanupBorrowersOnRefRemovedInternal(
+        ReferenceTableFromProto(coalesced.borrowed_refs()),
+        ObjectID::FromBinary(coalesced.object_id()), borrower_addr);
+  }
+}
+
+void ReferenceCounter::CleanupBorrowersOnRefRemovedInternal(
+    const ReferenceTable &new_borrower_refs, const ObjectID &object_id,
+    const rpc::WorkerAddress &borrower_addr) {
+  auto it = object_id_refs_.find(object_id);
+  if (it == object_id_refs_.end() || !it->second.borrowers.contains(borrower_addr)) {
+    // The borrower failed after publishing a message that covers this object,
+    // and the failure was handled after the message. The borrower had nothing
+    // new to report after the message, so there is nothing left to clean up.
+    RAY_LOG(DEBUG) << "Borrower " << borrower_addr.worker_id
+                   << " was already removed for " << object_id;
+    return;
+  }
   // Merge in any new borrowers that the previous borrower learned of.
   MergeRemoteBorrowers(object_id, borrower_addr, new_borrower_refs);
 
-  // Erase the previous borrower.
-  auto it = object_id_refs_.find(object_id);
+  // Erase the previous borrower. Merging may have rehashed the table.
+  it = object_id_refs_.find(object_id);
   RAY_CHECK(it != object_id_refs_.end()) << object_id;
   RAY_CHECK(it->second.borrowers.erase(borrower_addr));
   DeleteReferenceInternal(it, nullptr);
 }
 
-void ReferenceCounter::WaitForRefRemoved(const ReferenceTable::iterator &ref_it,
+void ReferenceCounter::WaitForRefRemoved(const ShardedReferenceTable::iterator &ref_it,
                                          const rpc::WorkerAddress &addr,
                                          const ObjectID &contained_in_id) {
   const ObjectID &object_id = ref_it->first;
@@ -918,16 +1245,23 @@ void ReferenceCounter::WaitForRefRemoved(const ReferenceTable::iterator &ref_it,
   const auto message_published_callback = [this, addr,
                                            object_id](const rpc::PubMessage &msg) {
     RAY_CHECK(msg.has_worker_ref_removed_message());
-    const ReferenceTable new_borrower_refs =
-        ReferenceTableFromProto(msg.worker_ref_removed_message().borrowed_refs());
-    RAY_LOG(DEBUG) << "WaitForRefRemoved returned for " << object_id
-                   << ", dest=" << addr.worker_id;
+    const auto &ref_removed_message = msg.worker_ref_removed_message();
+    RAY_LOG(DEBUG) << "WaitForRefRemoved returned for " << object_id << " and "
+                   << ref_removed_message.coalesced_refs_size()
+                   << " coalesced objects, dest=" << addr.worker_id;
 
-    CleanupBorrowersOnRefRemoved(new_borrower_refs, object_id, addr);
+    CleanupBorrowersOnRefRemoved(ref_removed_message, object_id, addr);
     // Unsubscribe the object once the message is published.
     RAY_CHECK(
         object_info_subscriber_->Unsubscribe(rpc::ChannelType::WORKER_REF_REMOVED_CHANNEL,
                                              addr.ToProto(), object_id.Binary()));
+    // The borrower will not publish separate messages for the coalesced objects.
+    // Their subscriptions may already be gone if the borrower has failed.
+    for (const auto &coalesced : ref_removed_message.coalesced_refs()) {
+      RAY_UNUSED(object_info_subscriber_->Unsubscribe(
+          rpc::ChannelType::WORKER_REF_REMOVED_CHANNEL, addr.ToProto(),
+          coalesced.object_id()));
+    }
   };
 
   // If the borrower is failed, this callback will be called.
@@ -938,7 +1272,7 @@ void ReferenceCounter::WaitForRefRemoved(const ReferenceTable::iterator &ref_it,
     const auto object_id = ObjectID::FromBinary(object_id_binary);
     RAY_LOG(DEBUG) << "WaitForRefRemoved failed for " << object_id
                    << ", dest=" << addr.worker_id;
-    CleanupBorrowersOnRefRemoved({}, object_id, addr);
+    CleanupBorrowersOnRefRemoved(ReferenceTable{}, object_id, addr);
   };
 
   RAY_CHECK(object_info_subscriber_->Subscribe(
@@ -950,7 +1284,7 @@ void ReferenceCounter::WaitForRefRemoved(const ReferenceTable::iterator &ref_it,
 void ReferenceCounter::AddNestedObjectIds(const ObjectID &object_id,
                                           const std::vector<ObjectID> &inner_ids,
                                           const rpc::WorkerAddress &owner_address) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   AddNestedObjectIdsInternal(object_id, inner_ids, owner_address);
 }
 
@@ -1027,6 +1361,28 @@ void ReferenceCounter::HandleRefRemoved(const ObjectID &object_id) {
                    << " borrowers, stored in " << pair.second.stored_in_objects.size();
   }
 
+  if (coalesce_ref_removed_messages_ && it != object_id_refs_.end() &&
+      it->second.owner_address.has_value()) {
+    // Coalesce the message with the others to the same owner until the next flush.
+    const auto owner_id = WorkerID::FromBinary(it->second.owner_address->worker_id());
+    auto pending_it = pending_ref_removed_messages_.find(owner_id);
+    if (pending_it == pending_ref_removed_messages_.end()) {
+      rpc::PubMessage pub_message;
+      pub_message.set_key_id(object_id.Binary());
+      pub_message.set_channel_type(rpc::ChannelType::WORKER_REF_REMOVED_CHANNEL);
+      ReferenceTableToProto(
+          borrowed_refs,
+          pub_message.mutable_worker_ref_removed_message()->mutable_borrowed_refs());
+      pending_ref_removed_messages_.emplace(owner_id, std::move(pub_message));
+    } else {
+      auto *coalesced = pending_it->second.mutable_worker_ref_removed_message()
+                            ->add_coalesced_refs();
+      coalesced->set_object_id(object_id.Binary());
+      ReferenceTableToProto(borrowed_refs, coalesced->mutable_borrowed_refs());
+    }
+    return;
+  }
+
   // Send the owner information about any new borrowers.
   rpc::PubMessage pub_message;
   pub_message.set_key_id(object_id.Binary());
@@ -1041,11 +1397,26 @@ void ReferenceCounter::HandleRefRemoved(const ObjectID &object_id) {
   object_info_publisher_->Publish(pub_message);
 }
 
+void ReferenceCounter::FlushRefRemovedMessages() {
+  ExclusiveLock lock(*this);
+  if (pending_ref_removed_messages_.empty()) {
+    return;
+  }
+  for (const auto &entry : pending_ref_removed_messages_) {
+    RAY_LOG(DEBUG) << "Publishing WaitForRefRemoved message for "
+                   << entry.second.worker_ref_removed_message().coalesced_refs_size() + 1
+                   << " objects to owner " << entry.first;
+    object_info_publisher_->Publish(entry.second);
+  }
+  pending_ref_removed_messages_.clear();
+  ShutdownIfNeeded();
+}
+
 void ReferenceCounter::SetRefRemovedCallback(
     const ObjectID &object_id, const ObjectID &contained_in_id,
     const rpc::Address &owner_address,
     const ReferenceCounter::ReferenceRemovedCallback &ref_removed_callback) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   RAY_LOG(DEBUG) << "Received WaitForRefRemoved " << object_id << " contained in "
                  << contained_in_id;
 
@@ -1093,7 +1464,7 @@ void ReferenceCounter::SetReleaseLineageCallback(
 
 bool ReferenceCounter::AddObjectLocation(const ObjectID &object_id,
                                          const NodeID &node_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(DEBUG) << "Tried to add an object location for an object " << object_id
@@ -1105,7 +1476,7 @@ bool ReferenceCounter::AddObjectLocation(const ObjectID &object_id,
   return true;
 }
 
-void ReferenceCounter::AddObjectLocationInternal(ReferenceTable::iterator it,
+void ReferenceCounter::AddObjectLocationInternal(ShardedReferenceTable::iterator it,
                                                  const NodeID &node_id) {
   RAY_LOG(DEBUG) << "Adding location " << node_id << " for object " << it->first;
   if (it->second.locations.emplace(node_id).second) {
@@ -1118,7 +1489,7 @@ void ReferenceCounter::AddObjectLocationInternal(ReferenceTable::iterator it,
 
 bool ReferenceCounter::RemoveObjectLocation(const ObjectID &object_id,
                                             const NodeID &node_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   RAY_LOG(DEBUG) << "Removing location " << node_id << " for object " << object_id;
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
@@ -1131,7 +1502,7 @@ bool ReferenceCounter::RemoveObjectLocation(const ObjectID &object_id,
   return true;
 }
 
-void ReferenceCounter::RemoveObjectLocationInternal(ReferenceTable::iterator it,
+void ReferenceCounter::RemoveObjectLocationInternal(ShardedReferenceTable::iterator it,
                                                     const NodeID &node_id) {
   it->second.locations.erase(node_id);
   PushToLocationSubscribers(it);
@@ -1152,7 +1523,7 @@ void ReferenceCounter::UpdateObjectPendingCreation(const ObjectID &object_id,
 
 absl::optional<absl::flat_hash_set<NodeID>> ReferenceCounter::GetObjectLocations(
     const ObjectID &object_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(DEBUG) << "Tried to get the object locations for an object " << object_id
@@ -1163,7 +1534,7 @@ absl::optional<absl::flat_hash_set<NodeID>> ReferenceCounter::GetObjectLocations
 }
 
 size_t ReferenceCounter::GetObjectSize(const ObjectID &object_id) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     return 0;
@@ -1175,7 +1546,7 @@ bool ReferenceCounter::HandleObjectSpilled(const ObjectID &object_id,
                                            const std::string spilled_url,
                                            const NodeID &spilled_node_id, int64_t size,
                                            bool release) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(WARNING) << "Spilled object " << object_id << " already out of scope";
@@ -1197,12 +1568,27 @@ bool ReferenceCounter::HandleObjectSpilled(const ObjectID &object_id,
     // Release the primary plasma copy, if any.
     ReleasePlasmaObject(it);
   }
+  if (lineage_pinning_enabled_ && it->second.owned_by_us &&
+      it->second.is_reconstructable && it->second.spilled_node_id.IsNil() &&
+      !it->second.spilled_url.empty()) {
+    // The object was spilled to distributed external storage, so it can be
+    // restored from its spill URL even if all nodes that had it fail. We no
+    // longer need to re-execute its lineage to recover it, which also means
+    // that the lineage of the task's arguments can be released.
+    RAY_LOG(DEBUG) << "Collapsing the lineage of " << object_id << ", spilled to "
+                   << it->second.spilled_url;
+    RemoveReconstructableOwnedObject(object_id);
+    ReleaseLineageReferences(it);
+    // The object is no longer reconstructable through lineage, but its lineage
+    // was not evicted. Recovery will restore it from the spill URL instead.
+    it->second.lineage_evicted = false;
+  }
   return true;
 }
 
 absl::optional<LocalityData> ReferenceCounter::GetLocalityData(
     const ObjectID &object_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   // Uses the reference table to return locality data for an object.
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
@@ -1239,7 +1625,7 @@ absl::optional<LocalityData> ReferenceCounter::GetLocalityData(
 bool ReferenceCounter::ReportLocalityData(const ObjectID &object_id,
                                           const absl::flat_hash_set<NodeID> &locations,
                                           uint64_t object_size) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(DEBUG) << "Tried to report locality data for an object " << object_id
@@ -1260,7 +1646,7 @@ bool ReferenceCounter::ReportLocalityData(const ObjectID &object_id,
 
 void ReferenceCounter::AddBorrowerAddress(const ObjectID &object_id,
                                           const rpc::Address &borrower_address) {
-  absl::MutexLock lock(&mutex_);
+  ExclusiveLock lock(*this);
   auto it = object_id_refs_.find(object_id);
   RAY_CHECK(it != object_id_refs_.end());
 
@@ -1284,7 +1670,7 @@ bool ReferenceCounter::IsObjectReconstructable(const ObjectID &object_id,
   if (!lineage_pinning_enabled_) {
     return false;
   }
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     return false;
@@ -1294,7 +1680,7 @@ bool ReferenceCounter::IsObjectReconstructable(const ObjectID &object_id,
 }
 
 bool ReferenceCounter::IsObjectPendingCreation(const ObjectID &object_id) const {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     return false;
@@ -1302,7 +1688,7 @@ bool ReferenceCounter::IsObjectPendingCreation(const ObjectID &object_id) const
   return it->second.pending_creation;
 }
 
-void ReferenceCounter::PushToLocationSubscribers(ReferenceTable::iterator it) {
+void ReferenceCounter::PushToLocationSubscribers(ShardedReferenceTable::iterator it) {
   const auto &object_id = it->first;
   const auto &locations = it->second.locations;
   auto object_size = it->second.object_size;
@@ -1328,7 +1714,7 @@ void ReferenceCounter::PushToLocationSubscribers(ReferenceTable::iterator it) {
 Status ReferenceCounter::FillObjectInformation(
     const ObjectID &object_id, rpc::WorkerObjectLocationsPubMessage *object_info) {
   RAY_CHECK(object_info != nullptr);
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(WARNING) << "Object locations requested for " << object_id
@@ -1342,7 +1728,8 @@ Status ReferenceCounter::FillObjectInformation(
 }
 
 void ReferenceCounter::FillObjectInformationInternal(
-    ReferenceTable::iterator it, rpc::WorkerObjectLocationsPubMessage *object_info) {
+    ShardedReferenceTable::iterator it,
+    rpc::WorkerObjectLocationsPubMessage *object_info) {
   for (const auto &node_id : it->second.locations) {
     object_info->add_node_ids(node_id.Binary());
   }
@@ -1355,7 +1742,7 @@ void ReferenceCounter::FillObjectInformationInternal(
 }
 
 void ReferenceCounter::PublishObjectLocationSnapshot(const ObjectID &object_id) {
-  absl::MutexLock lock(&mutex_);
+  ShardLock lock(*this, object_id);
   auto it = object_id_refs_.find(object_id);
   if (it == object_id_refs_.end()) {
     RAY_LOG(WARNING) << "Object locations requested for " << object_id
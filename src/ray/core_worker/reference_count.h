@@ -14,9 +14,12 @@
 
 #pragma once
 
+#include <array>
+
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/synchronization/mutex.h"
 #include "ray/common/id.h"
 #include "ray/core_worker/lease_policy.h"
@@ -67,9 +70,11 @@ class ReferenceCounter : public ReferenceCounterInterface,
                    pubsub::PublisherInterface *object_info_publisher,
                    pubsub::SubscriberInterface *object_info_subscriber,
                    bool lineage_pinning_enabled = false,
-                   rpc::ClientFactoryFn client_factory = nullptr)
+                   rpc::ClientFactoryFn client_factory = nullptr,
+                   bool coalesce_ref_removed_messages = false)
       : rpc_address_(rpc_address),
         lineage_pinning_enabled_(lineage_pinning_enabled),
+        coalesce_ref_removed_messages_(coalesce_ref_removed_messages),
         borrower_pool_(client_factory),
         object_info_publisher_(object_info_publisher),
         object_info_subscriber_(object_info_subscriber) {}
@@ -269,11 +274,17 @@ class ReferenceCounter : public ReferenceCounterInterface,
 
   /// Respond to the object's owner once we are no longer borrowing it.  The
   /// sender is the owner of the object ID. We will send the reply when our
-  /// RefCount() for the object ID goes to 0.
+  /// RefCount() for the object ID goes to 0. If the ref removed messages are
+  /// coalesced, the reply is sent by the next FlushRefRemovedMessages.
   ///
   /// \param[in] object_id The object that we were borrowing.
   void HandleRefRemoved(const ObjectID &object_id) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  /// Send the ref removed messages that were coalesced by HandleRefRemoved since
+  /// the last flush, one message per owner. This should be called periodically
+  /// if the ref removed messages are coalesced.
+  void FlushRefRemovedMessages() LOCKS_EXCLUDED(mutex_);
+
   /// Returns the total number of ObjectIDs currently in scope.
   size_t NumObjectIDsInScope() const LOCKS_EXCLUDED(mutex_);
 
@@ -654,16 +665,183 @@ class ReferenceCounter : public ReferenceCounterInterface,
 
   using ReferenceTable = absl::flat_hash_map<ObjectID, Reference>;
 
-  void SetNestedRefInUseRecursive(ReferenceTable::iterator inner_ref_it)
+  /// The number of shards that the reference table is split into.
+  static constexpr size_t kNumShards = 64;
+
+  /// Get the shard of an object's reference.
+  static size_t ShardIndex(const ObjectID &object_id) {
+    return object_id.Hash() % kNumShards;
+  }
+
+  /// A ReferenceTable that is split into shards by the hash of the object ID, so that
+  /// references in different shards can be looked up, added, updated and erased
+  /// concurrently, each under the lock of its shard. Iteration visits the shards in
+  /// order, so it needs the locks of all shards.
+  class ShardedReferenceTable {
+   public:
+    template <typename Shards, typename ShardIterator>
+    class Iterator {
+     public:
+      Iterator() = default;
+      Iterator(Shards *shards, size_t shard_index, ShardIterator it)
+          : shards_(shards), shard_index_(shard_index), it_(it) {}
+
+      auto &operator*() const { return *it_; }
+      auto *operator->() const { return &*it_; }
+
+      Iterator &operator++() {
+        ++it_;
+        SkipEmptyShards();
+        return *this;
+      }
+      Iterator operator++(int) {
+        Iterator it = *this;
+        ++*this;
+        return it;
+      }
+
+      bool operator==(const Iterator &other) const {
+        return shard_index_ == other.shard_index_ &&
+               (shard_index_ == kNumShards || it_ == other.it_);
+      }
+      bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+     private:
+      friend class ShardedReferenceTable;
+
+      /// Move to the first reference of the next non-empty shard, if the iterator
+      /// is at the end of its shard.
+      void SkipEmptyShards() {
+        while (shard_index_ < kNumShards && it_ == (*shards_)[shard_index_].end()) {
+          shard_index_++;
+          if (shard_index_ < kNumShards) {
+            it_ = (*shards_)[shard_index_].begin();
+          }
+        }
+      }
+
+      Shards *shards_ = nullptr;
+      size_t shard_index_ = kNumShards;
+      ShardIterator it_;
+    };
+
+    using Shards = std::array<ReferenceTable, kNumShards>;
+    using iterator = Iterator<Shards, ReferenceTable::iterator>;
+    using const_iterator = Iterator<const Shards, ReferenceTable::const_iterator>;
+
+    iterator find(const ObjectID &object_id) {
+      auto &shard = shards_[ShardIndex(object_id)];
+      auto it = shard.find(object_id);
+      return it == shard.end() ? end() : iterator(&shards_, ShardIndex(object_id), it);
+    }
+    const_iterator find(const ObjectID &object_id) const {
+      const auto &shard = shards_[ShardIndex(object_id)];
+      auto it = shard.find(object_id);
+      return it == shard.end() ? end()
+                               : const_iterator(&shards_, ShardIndex(object_id), it);
+    }
+    size_t count(const ObjectID &object_id) const {
+      return shards_[ShardIndex(object_id)].count(object_id);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const ObjectID &object_id, Args &&... args) {
+      const size_t shard_index = ShardIndex(object_id);
+      auto inserted =
+          shards_[shard_index].emplace(object_id, std::forward<Args>(args)...);
+      return {iterator(&shards_, shard_index, inserted.first), inserted.second};
+    }
+    void erase(iterator it) { shards_[it.shard_index_].erase(it.it_); }
+
+    iterator begin() {
+      iterator it(&shards_, 0, shards_[0].begin());
+      it.SkipEmptyShards();
+      return it;
+    }
+    const_iterator begin() const {
+      const_iterator it(&shards_, 0, shards_[0].begin());
+      it.SkipEmptyShards();
+      return it;
+    }
+    iterator end() { return iterator(&shards_, kNumShards, {}); }
+    const_iterator end() const { return const_iterator(&shards_, kNumShards, {}); }
+
+    size_t size() const {
+      size_t size = 0;
+      for (const auto &shard : shards_) {
+        size += shard.size();
+      }
+      return size;
+    }
+    bool empty() const {
+      for (const auto &shard : shards_) {
+        if (!shard.empty()) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+   private:
+    Shards shards_;
+  };
+
+  /// Locks the shards of the given objects in increasing order, so that operations
+  /// on overlapping sets of objects can't deadlock. This is enough to look up, add,
+  /// update and erase the references of these objects, as long as that doesn't
+  /// change any other reference.
+  class ShardLock {
+   public:
+    ShardLock(const ReferenceCounter &reference_counter, const ObjectID &object_id);
+    ShardLock(const ReferenceCounter &reference_counter,
+              const std::vector<ObjectID> &object_ids);
+    ShardLock(const ReferenceCounter &reference_counter,
+              const std::vector<ObjectID> &return_ids,
+              const std::vector<ObjectID> &argument_ids);
+    ~ShardLock();
+
+   private:
+    void Lock();
+
+    const ReferenceCounter &reference_counter_;
+    absl::InlinedVector<size_t, 4> shard_indices_;
+  };
+
+  /// Locks the whole reference table: `mutex_`, and then the locks of all shards in
+  /// increasing order. This is needed to change references that link to other
+  /// references, e.g., nested references and borrowers, to iterate the table, and to
+  /// access the state of this class that isn't per reference.
+  class ABSL_SCOPED_LOCKABLE ExclusiveLock {
+   public:
+    explicit ExclusiveLock(const ReferenceCounter &reference_counter)
+        ABSL_EXCLUSIVE_LOCK_FUNCTION(reference_counter.mutex_);
+    ~ExclusiveLock() ABSL_UNLOCK_FUNCTION();
+
+   private:
+    const ReferenceCounter &reference_counter_;
+  };
+
+  /// The work that is left after references were deleted under the locks of their
+  /// shards only. See FinishShardDeletions.
+  struct ShardDeletions {
+    /// The arguments of the tasks whose lineage was released when the references of
+    /// the tasks' return objects were deleted. Their lineage refs must be released.
+    std::vector<ObjectID> released_argument_ids;
+    /// Whether a shutdown was scheduled when the references were deleted, so the
+    /// table may have become empty.
+    bool shutdown_scheduled = false;
+  };
+
+  void SetNestedRefInUseRecursive(ShardedReferenceTable::iterator inner_ref_it)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  /// The caller must hold the lock of the object's shard.
   bool GetOwnerInternal(const ObjectID &object_id,
-                        rpc::Address *owner_address = nullptr) const
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+                        rpc::Address *owner_address = nullptr) const;
 
   /// Release the pinned plasma object, if any. Also unsets the raylet address
   /// that the object was pinned at, if the address was set.
-  void ReleasePlasmaObject(ReferenceTable::iterator it);
+  void ReleasePlasmaObject(ShardedReferenceTable::iterator it);
 
   /// Shutdown if all references have gone out of scope and shutdown
   /// is scheduled.
@@ -747,7 +925,7 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// ID. This is used in cases where we return an object ID that we own inside
   /// an object that we do not own. Then, we must notify the owner of the outer
   /// object that they are borrowing the inner.
-  void WaitForRefRemoved(const ReferenceTable::iterator &reference_it,
+  void WaitForRefRemoved(const ShardedReferenceTable::iterator &reference_it,
                          const rpc::WorkerAddress &addr,
                          const ObjectID &contained_in_id = ObjectID::Nil())
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -767,62 +945,147 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// Helper method to delete an entry from the reference map and run any necessary
   /// callbacks. Assumes that the entry is in object_id_refs_ and invalidates the
   /// iterator.
-  void DeleteReferenceInternal(ReferenceTable::iterator entry,
+  void DeleteReferenceInternal(ShardedReferenceTable::iterator entry,
                                std::vector<ObjectID> *deleted)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   /// Erase the Reference from the table. Assumes that the entry has no more
   /// references, normal or lineage.
-  void EraseReference(ReferenceTable::iterator entry) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EraseReference(ShardedReferenceTable::iterator entry)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  /// Same as EraseReference, but without shutting down if the table becomes empty.
+  /// The caller must hold the lock of the entry's shard.
+  void EraseReferenceInShard(ShardedReferenceTable::iterator entry);
 
   /// Helper method to garbage-collect all out-of-scope References in the
   /// lineage for this object.
-  int64_t ReleaseLineageReferences(ReferenceTable::iterator entry)
+  int64_t ReleaseLineageReferences(ShardedReferenceTable::iterator entry)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  /// Release the lineage of the task that created the object, if we own it. The
+  /// caller must hold the lock of the object's shard, and must release the lineage
+  /// refs of the task's arguments, which are appended to `argument_ids`.
+  ///
+  /// \return The amount of lineage in bytes released.
+  int64_t ReleaseTaskLineage(ShardedReferenceTable::iterator entry,
+                             std::vector<ObjectID> *argument_ids);
+
   /// Add a new location for the given object. The owner must have the object ref in
-  /// scope, and the caller must have already acquired mutex_.
+  /// scope, and the caller must hold the lock of the object's shard.
   ///
   /// \param[in] it The reference iterator for the object.
   /// \param[in] node_id The new object location to be added.
-  void AddObjectLocationInternal(ReferenceTable::iterator it, const NodeID &node_id)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void AddObjectLocationInternal(ShardedReferenceTable::iterator it,
+                                 const NodeID &node_id);
 
   /// Remove a location for the given object. The owner must have the object ref in
-  /// scope, and the caller must have already acquired mutex_.
+  /// scope, and the caller must hold the lock of the object's shard.
   ///
   /// \param[in] it The reference iterator for the object.
   /// \param[in] node_id The object location to be removed.
-  void RemoveObjectLocationInternal(ReferenceTable::iterator it, const NodeID &node_id)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RemoveObjectLocationInternal(ShardedReferenceTable::iterator it,
+                                    const NodeID &node_id);
 
-  void UpdateObjectPendingCreation(const ObjectID &object_id, bool pending_creation)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  /// The caller must hold the lock of the object's shard.
+  void UpdateObjectPendingCreation(const ObjectID &object_id, bool pending_creation);
 
-  /// Publish object locations to all subscribers.
+  /// Publish object locations to all subscribers. The caller must hold the lock of
+  /// the object's shard.
   ///
   /// \param[in] it The reference iterator for the object.
-  void PushToLocationSubscribers(ReferenceTable::iterator it)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void PushToLocationSubscribers(ShardedReferenceTable::iterator it);
 
-  /// Fill up the object information for the given iterator.
-  void FillObjectInformationInternal(ReferenceTable::iterator it,
-                                     rpc::WorkerObjectLocationsPubMessage *object_info)
-      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  /// Fill up the object information for the given iterator. The caller must hold the
+  /// lock of the object's shard.
+  void FillObjectInformationInternal(ShardedReferenceTable::iterator it,
+                                     rpc::WorkerObjectLocationsPubMessage *object_info);
 
   /// Clean up borrowers and references when the reference is removed from borrowers.
   /// It should be used as a WaitForRefRemoved callback.
   void CleanupBorrowersOnRefRemoved(const ReferenceTable &new_borrower_refs,
                                     const ObjectID &object_id,
-                                    const rpc::WorkerAddress &borrower_addr);
+                                    const rpc::WorkerAddress &borrower_addr)
+      LOCKS_EXCLUDED(mutex_);
+
+  /// Same as above, but for the object of a ref removed message and all the
+  /// objects coalesced into it, under one acquisition of the lock.
+  void CleanupBorrowersOnRefRemoved(const rpc::WorkerRefRemovedMessage &message,
+                                    const ObjectID &object_id,
+                                    const rpc::WorkerAddress &borrower_addr)
+      LOCKS_EXCLUDED(mutex_);
+
+  void CleanupBorrowersOnRefRemovedInternal(const ReferenceTable &new_borrower_refs,
+                                            const ObjectID &object_id,
+                                            const rpc::WorkerAddress &borrower_addr)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   /// Decrease the local reference count for the ObjectID by one.
-  /// This method is internal and not thread-safe. mutex_ lock must be held before
-  /// calling this method.
+  /// This method is internal and not thread-safe. The ExclusiveLock must be held
+  /// before calling this method.
   void RemoveLocalReferenceInternal(const ObjectID &object_id,
                                     std::vector<ObjectID> *deleted)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  /// The following methods are the fast paths of the public methods of the same
+  /// name. They only hold a ShardLock, so they return false without changing
+  /// anything if the update may need to change other references, e.g., because a
+  /// reference that is nested in a borrowed object comes into use, or a reference
+  /// that contains other references goes out of scope. The caller must then retry
+  /// with the ExclusiveLock, and otherwise call FinishShardDeletions.
+  bool AddLocalReferenceInShard(const ObjectID &object_id, const std::string &call_site);
+
+  bool AddBorrowedObjectInShard(const ObjectID &object_id,
+                                const rpc::Address &owner_address,
+                                bool foreign_owner_already_monitoring,
+                                ShardDeletions *deletions);
+
+  bool RemoveLocalReferenceInShard(const ObjectID &object_id,
+                                   std::vector<ObjectID> *deleted,
+                                   ShardDeletions *deletions);
+
+  bool UpdateSubmittedTaskReferencesInShards(const std::vector<ObjectID> &return_ids,
+                                             const std::vector<ObjectID> &argument_ids);
+
+  bool UpdateFinishedTaskReferencesInShards(const std::vector<ObjectID> &return_ids,
+                                            const std::vector<ObjectID> &argument_ids,
+                                            bool release_lineage,
+                                            const ReferenceTable &borrowed_refs,
+                                            std::vector<ObjectID> *deleted,
+                                            ShardDeletions *deletions);
+
+  /// Whether a reference that has no references left can be deleted under the lock
+  /// of its shard only: it contains no other references, and no owner is waiting
+  /// for us to stop borrowing it.
+  static bool CanDeleteInShard(const Reference &reference) {
+    return reference.contains.empty() && reference.on_ref_removed == nullptr;
+  }
+
+  /// Same as DeleteReferenceInternal, for a reference that CanDeleteInShard, under
+  /// the lock of its shard only. The lineage refs of the arguments of the task that
+  /// created the object are released afterwards, by FinishShardDeletions.
+  void DeleteReferenceInShard(ShardedReferenceTable::iterator it,
+                              std::vector<ObjectID> *deleted, ShardDeletions *deletions)
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+
+  /// Release the lineage refs that deleted references held on the arguments of their
+  /// tasks, deleting the arguments that this takes out of scope, and shut down if
+  /// the table became empty and a shutdown was scheduled. This must be called without
+  /// any lock held, after the deletions of a fast path.
+  void FinishShardDeletions(ShardDeletions *deletions) ABSL_NO_THREAD_SAFETY_ANALYSIS;
+
+  /// Add the reference of an object that we own, without nested references. The
+  /// caller must hold the lock of the object's shard.
+  void AddOwnedObjectInternal(const ObjectID &object_id,
+                              const rpc::Address &owner_address,
+                              const std::string &call_site, const int64_t object_size,
+                              bool is_reconstructable,
+                              const absl::optional<NodeID> &pinned_at_raylet_id);
+
+  /// Remove an object from the queue of objects whose lineage may be evicted.
+  void RemoveReconstructableOwnedObject(const ObjectID &object_id)
+      LOCKS_EXCLUDED(reconstructable_owned_objects_mutex_);
+
   /// Address of our RPC server. This is used to determine whether we own a
   /// given object or not, by comparing our WorkerID with the WorkerID of the
   /// object's owner.
@@ -834,6 +1097,10 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// tasks that depend on that object that may be retried in the future.
   const bool lineage_pinning_enabled_;
 
+  /// Whether to coalesce the ref removed messages to the same owner until the
+  /// next FlushRefRemovedMessages, instead of publishing them one by one.
+  const bool coalesce_ref_removed_messages_;
+
   /// Factory for producing new core worker clients.
   rpc::ClientFactoryFn client_factory_;
 
@@ -842,17 +1109,23 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// borrower's ref count for the ID goes to 0.
   rpc::CoreWorkerClientPool borrower_pool_;
 
-  /// Protects access to the reference counting state.
+  /// Protects the state of this class that isn't per reference. It is only held
+  /// together with the locks of all shards, by the ExclusiveLock, so the state it
+  /// guards may also be read under the lock of any one shard.
   mutable absl::Mutex mutex_;
 
+  /// The locks of the shards of the reference table.
+  mutable std::array<absl::Mutex, kNumShards> shard_mutexes_;
+
   /// Holds all reference counts and dependency information for tracked ObjectIDs.
-  ReferenceTable object_id_refs_ GUARDED_BY(mutex_);
+  /// Each shard is guarded by its lock in `shard_mutexes_`.
+  ShardedReferenceTable object_id_refs_;
 
-  /// Objects whose values have been freed by the language frontend.
-  /// The values in plasma will not be pinned. An object ID is
-  /// removed from this set once its Reference has been deleted
-  /// locally.
-  absl::flat_hash_set<ObjectID> freed_objects_ GUARDED_BY(mutex_);
+  /// Objects whose values have been freed by the language frontend, by the shard of
+  /// their reference. The values in plasma will not be pinned. An object ID is
+  /// removed from this set once its Reference has been deleted locally. Each shard
+  /// is guarded by its lock in `shard_mutexes_`.
+  std::array<absl::flat_hash_set<ObjectID>, kNumShards> freed_objects_;
 
   /// The callback to call once an object ID that we own is no longer in scope
   /// and it has no tasks that depend on it that may be retried in the future.
@@ -863,6 +1136,11 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// out of scope.
   std::function<void()> shutdown_hook_ GUARDED_BY(mutex_) = nullptr;
 
+  /// The ref removed messages that have not been published yet, by the ID of
+  /// the owner they are sent to.
+  absl::flat_hash_map<WorkerID, rpc::PubMessage> pending_ref_removed_messages_
+      GUARDED_BY(mutex_);
+
   /// Object status publisher. It is used to publish the ref removed message for the
   /// reference counting protocol. It is not guarded by a lock because the class itself is
   /// thread-safe.
@@ -872,17 +1150,23 @@ class ReferenceCounter : public ReferenceCounterInterface,
   /// other workers.
   pubsub::SubscriberInterface *object_info_subscriber_;
 
+  /// Protects the queue of reconstructable objects, which references in all shards
+  /// are added to and removed from.
+  absl::Mutex reconstructable_owned_objects_mutex_;
+
   /// Objects that we own that are still in scope at the application level and
   /// that may be reconstructed. These objects may have pinned lineage that
   /// should be evicted on memory pressure. The queue is in FIFO order, based
   /// on ObjectRef creation time.
-  std::list<ObjectID> reconstructable_owned_objects_ GUARDED_BY(mutex_);
+  std::list<ObjectID> reconstructable_owned_objects_
+      GUARDED_BY(reconstructable_owned_objects_mutex_);
 
   /// We keep a FIFO queue of objects in scope so that we can choose lineage to
   /// evict under memory pressure. This is an index from ObjectID to the
   /// object's place in the queue.
   absl::flat_hash_map<ObjectID, std::list<ObjectID>::iterator>
-      reconstructable_owned_objects_index_ GUARDED_BY(mutex_);
+      reconstructable_owned_objects_index_
+          GUARDED_BY(reconstructable_owned_objects_mutex_);
 };
 
 }  // namespace core
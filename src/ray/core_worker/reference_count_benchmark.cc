@@ -0,0 +1,291 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how many reference updates per second the reference counter sustains
+// when many threads copy and drop ObjectRefs and submit and finish tasks at once, as
+// drivers with many threads do. Also measures the CPU time that an owner spends on the
+// ref removed messages of a borrower that stops using many borrowed refs at once, with
+// and without coalescing the messages.
+//
+// Usage: reference_count_benchmark --num_iterations=20000 --lineage_pinning=true
+//            --num_borrowed_refs=100000
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "ray/core_worker/reference_count.h"
+#include "ray/pubsub/mock_pubsub.h"
+
+DEFINE_int64(num_iterations, 20000, "The number of tasks that each thread submits.");
+DEFINE_int64(num_shared_objects, 4,
+             "The number of objects that all threads pass to their tasks.");
+DEFINE_bool(lineage_pinning, true,
+            "Whether the returns of the tasks pin the lineage of their arguments.");
+DEFINE_int64(num_borrowed_refs, 100000,
+             "The number of refs that the borrower stops using at once.");
+
+namespace ray {
+namespace core {
+
+/// The number of reference counter calls in each iteration of a thread.
+constexpr int64_t kUpdatesPerIteration = 10;
+
+/// Each iteration of a thread submits a task that depends on a shared object, an
+/// object of the thread and a new owned object, finishes it without retries, and drops
+/// the task's return object. Returns the number of reference counter calls per second
+/// over all threads.
+double RunReferenceCountBenchmark(int num_threads) {
+  testing::NiceMock<mock_pubsub::MockPublisher> publisher;
+  testing::NiceMock<mock_pubsub::MockSubscriber> subscriber;
+  rpc::WorkerAddress address(rpc::Address{});
+  ReferenceCounter reference_counter(address, &publisher, &subscriber,
+                                     FLAGS_lineage_pinning);
+  reference_counter.SetReleaseLineageCallback(
+      [](const ObjectID &, std::vector<ObjectID> *) { return 0; });
+  std::vector<ObjectID> shared_ids;
+  for (int64_t i = 0; i < FLAGS_num_shared_objects; i++) {
+    shared_ids.push_back(ObjectID::FromRandom());
+    reference_counter.AddLocalReference(shared_ids.back(), "");
+  }
+
+  std::atomic<int64_t> num_updates(0);
+  auto run = [&](int thread_index) {
+    const rpc::Address owner_address;
+    const rpc::Address borrower_address;
+    const ReferenceCounter::ReferenceTableProto borrowed_refs;
+    ObjectID thread_id = ObjectID::FromRandom();
+    reference_counter.AddLocalReference(thread_id, "");
+    int64_t thread_updates = 0;
+    std::vector<ObjectID> deleted;
+    for (int64_t i = 0; i < FLAGS_num_iterations; i++) {
+      const auto &shared_id = shared_ids[(thread_index + i) % shared_ids.size()];
+      ObjectID arg_id = ObjectID::FromRandom();
+      ObjectID return_id = ObjectID::FromRandom();
+      reference_counter.AddOwnedObject(arg_id, {}, owner_address, "", 0, true);
+      reference_counter.AddLocalReference(arg_id, "");
+      reference_counter.AddOwnedObject(return_id, {}, owner_address, "", 0, true);
+      reference_counter.AddLocalReference(return_id, "");
+      reference_counter.AddLocalReference(shared_id, "");
+      reference_counter.UpdateSubmittedTaskReferences({return_id},
+                                                      {shared_id, thread_id, arg_id});
+      reference_counter.RemoveLocalReference(arg_id, &deleted);
+      reference_counter.RemoveLocalReference(shared_id, &deleted);
+      reference_counter.UpdateFinishedTaskReferences(
+          {return_id}, {shared_id, thread_id, arg_id}, /*release_lineage=*/true,
+          borrower_address, borrowed_refs, &deleted);
+      reference_counter.RemoveLocalReference(return_id, &deleted);
+      deleted.clear();
+      thread_updates += kUpdatesPerIteration;
+    }
+    reference_counter.RemoveLocalReference(thread_id, nullptr);
+    num_updates += thread_updates;
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  RAY_CHECK(reference_counter.NumObjectIDsInScope() == shared_ids.size());
+  return num_updates / seconds;
+}
+
+/// Passes the WaitForRefRemoved subscriptions of an owner to a borrower in the same
+/// process, and the ref removed messages of the borrower back to the owner.
+class LoopbackSubscriber : public pubsub::SubscriberInterface {
+ public:
+  void SetBorrower(ReferenceCounter *borrower) { borrower_ = borrower; }
+
+  bool Subscribe(std::unique_ptr<rpc::SubMessage> sub_message,
+                 rpc::ChannelType channel_type, const rpc::Address &publisher_address,
+                 const std::string &key_id,
+                 pubsub::SubscribeDoneCallback subscribe_done_callback,
+                 pubsub::SubscriptionItemCallback subscription_callback,
+                 pubsub::SubscriptionFailureCallback subscription_failure_callback)
+      override {
+    RAY_CHECK(channel_type == rpc::ChannelType::WORKER_REF_REMOVED_CHANNEL);
+    const auto &request = sub_message->worker_ref_removed_message();
+    borrower_->SetRefRemovedCallback(
+        ObjectID::FromBinary(request.reference().object_id()),
+        ObjectID::FromBinary(request.contained_in_id()),
+        request.reference().owner_address(),
+        [this](const ObjectID &object_id) { borrower_->HandleRefRemoved(object_id); });
+    return callbacks_.emplace(key_id, std::move(subscription_callback)).second;
+  }
+
+  bool SubscribeChannel(
+      std::unique_ptr<rpc::SubMessage> sub_message, rpc::ChannelType channel_type,
+      const rpc::Address &publisher_address,
+      pubsub::SubscribeDoneCallback subscribe_done_callback,
+      pubsub::SubscriptionItemCallback subscription_callback,
+      pubsub::SubscriptionFailureCallback subscription_failure_callback) override {
+    return false;
+  }
+
+  bool Unsubscribe(const rpc::ChannelType channel_type,
+                   const rpc::Address &publisher_address,
+                   const std::string &key_id) override {
+    return callbacks_.erase(key_id) > 0;
+  }
+
+  bool UnsubscribeChannel(const rpc::ChannelType channel_type,
+                          const rpc::Address &publisher_address) override {
+    return false;
+  }
+
+  bool IsSubscribed(const rpc::ChannelType channel_type,
+                    const rpc::Address &publisher_address,
+                    const std::string &key_id) const override {
+    return callbacks_.contains(key_id);
+  }
+
+  std::string DebugString() const override { return ""; }
+
+  /// Run the owner's callback for a message of the borrower.
+  void Deliver(const rpc::PubMessage &message) {
+    auto it = callbacks_.find(message.key_id());
+    RAY_CHECK(it != callbacks_.end());
+    // The callback unsubscribes, which erases it.
+    const auto callback = it->second;
+    callback(message);
+  }
+
+ private:
+  ReferenceCounter *borrower_ = nullptr;
+  absl::flat_hash_map<std::string, pubsub::SubscriptionItemCallback> callbacks_;
+};
+
+rpc::Address RandomAddress() {
+  rpc::Address address;
+  address.set_ip_address("127.0.0.1");
+  address.set_raylet_id(NodeID::FromRandom().Binary());
+  address.set_worker_id(WorkerID::FromRandom().Binary());
+  return address;
+}
+
+struct RefRemovedBenchmarkResult {
+  int64_t num_messages = 0;
+  double owner_cpu_seconds = 0;
+};
+
+/// An owner passes `num_borrowed_refs` objects nested in one object to a task. The
+/// borrower that runs the task keeps the refs past the task, then stops using all of
+/// them at once. Returns the number of ref removed messages that the borrower sent
+/// and the CPU time that the owner took to process them.
+RefRemovedBenchmarkResult RunRefRemovedBenchmark(bool coalesce_ref_removed_messages) {
+  const rpc::Address owner_address = RandomAddress();
+  const rpc::Address borrower_address = RandomAddress();
+  testing::NiceMock<mock_pubsub::MockPublisher> owner_publisher;
+  LoopbackSubscriber owner_subscriber;
+  ReferenceCounter owner(rpc::WorkerAddress(owner_address), &owner_publisher,
+                         &owner_subscriber);
+  std::vector<rpc::PubMessage> messages;
+  testing::NiceMock<mock_pubsub::MockPublisher> borrower_publisher;
+  ON_CALL(borrower_publisher, Publish(testing::_))
+      .WillByDefault(testing::Invoke(
+          [&messages](const rpc::PubMessage &message) { messages.push_back(message); }));
+  testing::NiceMock<mock_pubsub::MockSubscriber> borrower_subscriber;
+  ReferenceCounter borrower(rpc::WorkerAddress(borrower_address), &borrower_publisher,
+                            &borrower_subscriber, /*lineage_pinning_enabled=*/false,
+                            /*client_factory=*/nullptr, coalesce_ref_removed_messages);
+  owner_subscriber.SetBorrower(&borrower);
+
+  // The owner puts the inner objects, wraps them in an outer object and passes it to
+  // a task. Then its own references go out of scope.
+  std::vector<ObjectID> inner_ids;
+  for (int64_t i = 0; i < FLAGS_num_borrowed_refs; i++) {
+    inner_ids.push_back(ObjectID::FromRandom());
+    owner.AddOwnedObject(inner_ids.back(), {}, owner_address, "", 0, false);
+    owner.AddLocalReference(inner_ids.back(), "");
+  }
+  const auto outer_id = ObjectID::FromRandom();
+  owner.AddOwnedObject(outer_id, inner_ids, owner_address, "", 0, false);
+  owner.AddLocalReference(outer_id, "");
+  const auto return_id = ObjectID::FromRandom();
+  owner.UpdateSubmittedTaskReferences({return_id}, {outer_id});
+  owner.AddOwnedObject(return_id, {}, owner_address, "", 0, false);
+  owner.RemoveLocalReference(outer_id, nullptr);
+  for (const auto &inner_id : inner_ids) {
+    owner.RemoveLocalReference(inner_id, nullptr);
+  }
+
+  // The borrower deserializes the inner refs and keeps them after the task finishes.
+  borrower.AddLocalReference(outer_id, "");
+  for (const auto &inner_id : inner_ids) {
+    borrower.AddLocalReference(inner_id, "");
+    borrower.AddBorrowedObject(inner_id, outer_id, owner_address);
+  }
+  ReferenceCounter::ReferenceTableProto borrowed_refs;
+  borrower.PopAndClearLocalBorrowers({outer_id}, &borrowed_refs, nullptr);
+  owner.UpdateFinishedTaskReferences({return_id}, {outer_id}, /*release_lineage=*/false,
+                                     borrower_address, borrowed_refs, nullptr);
+
+  // The borrower stops using all the inner refs at once.
+  for (const auto &inner_id : inner_ids) {
+    borrower.RemoveLocalReference(inner_id, nullptr);
+  }
+  borrower.FlushRefRemovedMessages();
+
+  RefRemovedBenchmarkResult result;
+  result.num_messages = messages.size();
+  // Only this thread runs, so the CPU time of the process is the owner's.
+  const std::clock_t start = std::clock();
+  for (const auto &message : messages) {
+    owner_subscriber.Deliver(message);
+  }
+  result.owner_cpu_seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+  for (const auto &inner_id : inner_ids) {
+    RAY_CHECK(!owner.HasReference(inner_id));
+  }
+  return result;
+}
+
+}  // namespace core
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::cout << std::setw(10) << "threads" << std::setw(16) << "updates/s"
+            << std::setw(20) << "updates/s/thread" << std::endl;
+  for (int num_threads : {1, 2, 4, 8, 16}) {
+    const double updates_per_second = ray::core::RunReferenceCountBenchmark(num_threads);
+    std::cout << std::setw(10) << num_threads << std::setw(16) << std::fixed
+              << std::setprecision(0) << updates_per_second << std::setw(20)
+              << updates_per_second / num_threads << std::endl;
+  }
+
+  std::cout << std::endl
+            << std::setw(10) << "coalesce" << std::setw(12) << "refs" << std::setw(12)
+            << "messages" << std::setw(16) << "owner CPU ms" << std::endl;
+  for (bool coalesce_ref_removed_messages : {false, true}) {
+    const auto result = ray::core::RunRefRemovedBenchmark(coalesce_ref_removed_messages);
+    std::cout << std::setw(10) << (coalesce_ref_removed_messages ? "true" : "false")
+              << std::setw(12) << FLAGS_num_borrowed_refs << std::setw(12)
+              << result.num_messages << std::setw(16) << std::fixed
+              << std::setprecision(1) << result.owner_cpu_seconds * 1000 << std::endl;
+  }
+  return 0;
+}
@@ -14,6 +14,8 @@
 
 #include "ray/core_worker/reference_count.h"
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "absl/functional/bind_front.h"
@@ -236,6 +238,7 @@ class MockDistributedPublisher : public pubsub::PublisherInterface {
       // TODO(swang): Test object locations pubsub too.
       return;
     }
+    num_published_messages_++;
     const auto subscribers = directory_->GetSubscriberIdsByKeyId(pub_message.key_id());
     const auto oid = ObjectID::FromBinary(pub_message.key_id());
     for (const auto &subscriber_id : subscribers) {
@@ -259,6 +262,7 @@ class MockDistributedPublisher : public pubsub::PublisherInterface {
   SubscriptionCallbackMap *subscription_callback_map_;
   SubscriptionFailureCallbackMap *subscription_failure_callback_map_;
   WorkerID publisher_id_;
+  int64_t num_published_messages_ = 0;
 };
 
 class MockWorkerClient : public MockCoreWorkerClientInterface {
@@ -272,7 +276,8 @@ class MockWorkerClient : public MockCoreWorkerClientInterface {
     return address;
   }
 
-  MockWorkerClient(const std::string &addr, PublisherFactoryFn client_factory = nullptr)
+  MockWorkerClient(const std::string &addr, PublisherFactoryFn client_factory = nullptr,
+                   bool coalesce_ref_removed_messages = false)
       : address_(CreateRandomAddress(addr)),
         publisher_(std::make_shared<MockDistributedPublisher>(
             &directory, &subscription_callback_map, &subscription_failure_callback_map,
@@ -281,7 +286,8 @@ class MockWorkerClient : public MockCoreWorkerClientInterface {
             &directory, &subscription_callback_map, &subscription_failure_callback_map,
             WorkerID::FromBinary(address_.worker_id()), client_factory)),
         rc_(rpc::WorkerAddress(address_), publisher_.get(), subscriber_.get(),
-            /*lineage_pinning_enabled=*/false, client_factory) {}
+            /*lineage_pinning_enabled=*/false, client_factory,
+            coalesce_ref_removed_messages) {}
 
   ~MockWorkerClient() override {
     if (!failed_) {
@@ -525,6 +531,61 @@ TEST_F(ReferenceCountTest, TestBasic) {
   out.clear();
 }
 
+// Submit and finish tasks and copy and drop ObjectRefs from many threads at once, as
+// drivers with many threads do. Most updates only need the locks of their objects'
+// shards, but some objects go in and out of scope concurrently.
+TEST_F(ReferenceCountTest, TestConcurrentReferenceUpdates) {
+  const int num_threads = 8;
+  const int num_iterations = 2000;
+  std::vector<ObjectID> shared_ids;
+  for (int i = 0; i < 4; i++) {
+    shared_ids.push_back(ObjectID::FromRandom());
+    rc->AddLocalReference(shared_ids.back(), "");
+  }
+
+  auto run = [&](int thread_index) {
+    ObjectID thread_id = ObjectID::FromRandom();
+    ObjectID return_id = ObjectID::FromRandom();
+    rc->AddLocalReference(thread_id, "");
+    rc->AddLocalReference(return_id, "");
+    std::vector<ObjectID> deleted;
+    for (int i = 0; i < num_iterations; i++) {
+      const auto &shared_id = shared_ids[(thread_index + i) % shared_ids.size()];
+      rc->AddLocalReference(shared_id, "");
+      rc->UpdateSubmittedTaskReferences({return_id}, {shared_id, thread_id});
+      // An object that goes in and out of scope.
+      ObjectID temp_id = ObjectID::FromRandom();
+      rc->AddLocalReference(temp_id, "");
+      rc->UpdateSubmittedTaskReferences({return_id}, {temp_id});
+      rc->RemoveLocalReference(temp_id, &deleted);
+      rc->UpdateFinishedTaskReferences({return_id}, {temp_id}, false, empty_borrower,
+                                       empty_refs, &deleted);
+      rc->UpdateFinishedTaskReferences({return_id}, {shared_id, thread_id}, false,
+                                       empty_borrower, empty_refs, &deleted);
+      rc->RemoveLocalReference(shared_id, &deleted);
+    }
+    ASSERT_EQ(deleted.size(), static_cast<size_t>(num_iterations));
+    rc->RemoveLocalReference(thread_id, nullptr);
+    rc->RemoveLocalReference(return_id, nullptr);
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(rc->NumObjectIDsInScope(), shared_ids.size());
+  for (const auto &shared_id : shared_ids) {
+    ASSERT_FALSE(rc->IsObjectPendingCreation(shared_id));
+    std::vector<ObjectID> deleted;
+    rc->RemoveLocalReference(shared_id, &deleted);
+    ASSERT_EQ(deleted.size(), 1);
+  }
+}
+
 TEST_F(ReferenceCountTest, TestUnreconstructableObjectOutOfScope) {
   ObjectID id = ObjectID::FromRandom();
   rpc::Address address;
@@ -991,6 +1052,77 @@ TEST(DistributedReferenceCountTest, TestSimpleBorrowerReferenceRemoved) {
   ASSERT_FALSE(owner->rc_.HasReference(inner_id));
 }
 
+// A borrower is given references to many object IDs by the same owner and
+// stops using all of them at once. The ref removed messages for all of them
+// should be coalesced into one message to the owner if the borrower coalesces
+// them, and the owner should clean up all of them in one go.
+//
+// @ray.remote
+// def borrower(inner_ids):
+//     pass
+//
+// inner_ids = [ray.put(i) for i in range(100000)]
+// outer_id = ray.put(inner_ids)
+// res = borrower.remote(outer_id)
+TEST(DistributedReferenceCountTest, TestCoalescedRefRemoved) {
+  const int num_objects = 100000;
+  auto run = [&](bool coalesce_ref_removed_messages) {
+    auto borrower = std::make_shared<MockWorkerClient>("1", nullptr,
+                                                       coalesce_ref_removed_messages);
+    auto owner = std::make_shared<MockWorkerClient>(
+        "2", [&](const rpc::Address &addr) { return borrower; });
+
+    // The owner creates the inner objects and wraps them.
+    std::vector<ObjectID> inner_ids;
+    for (int i = 0; i < num_objects; i++) {
+      inner_ids.push_back(ObjectID::FromRandom());
+      owner->Put(inner_ids.back());
+    }
+    auto outer_id = ObjectID::FromRandom();
+    owner->rc_.AddOwnedObject(outer_id, inner_ids, owner->address_, "", 0, false);
+    owner->rc_.AddLocalReference(outer_id, "");
+
+    // The owner submits a task that depends on the outer object, and its
+    // references go out of scope.
+    auto return_id = owner->SubmitTaskWithArg(outer_id);
+    owner->rc_.RemoveLocalReference(outer_id, nullptr);
+    for (const auto &inner_id : inner_ids) {
+      owner->rc_.RemoveLocalReference(inner_id, nullptr);
+    }
+
+    // The borrower is given references to the inner objects and keeps them past
+    // the task's lifetime.
+    borrower->rc_.AddLocalReference(outer_id, "");
+    for (const auto &inner_id : inner_ids) {
+      borrower->GetSerializedObjectId(outer_id, inner_id, owner->address_);
+    }
+    auto borrower_refs = borrower->FinishExecutingTask(outer_id, ObjectID::Nil());
+    owner->HandleSubmittedTaskFinished(return_id, outer_id, {}, borrower->address_,
+                                       borrower_refs);
+    borrower->FlushBorrowerCallbacks();
+    for (const auto &inner_id : inner_ids) {
+      ASSERT_TRUE(owner->rc_.HasReference(inner_id));
+    }
+
+    // The borrower stops using all the inner objects at once.
+    for (const auto &inner_id : inner_ids) {
+      borrower->rc_.RemoveLocalReference(inner_id, nullptr);
+    }
+    borrower->rc_.FlushRefRemovedMessages();
+    ASSERT_EQ(borrower->publisher_->num_published_messages_,
+              coalesce_ref_removed_messages ? 1 : num_objects);
+    for (const auto &inner_id : inner_ids) {
+      ASSERT_FALSE(borrower->rc_.HasReference(inner_id));
+      ASSERT_FALSE(owner->rc_.HasReference(inner_id));
+    }
+  };
+  run(/*coalesce_ref_removed_messages=*/false);
+  run(/*coalesce_ref_removed_messages=*/true);
+  // Drop the callbacks of the workers that are gone.
+  subscription_callback_map.clear();
+  subscription_failure_callback_map.clear();
+}
+
 // A borrower is given a reference to an object ID, passes the reference to
 // another borrower by submitting a task, and does not wait for it to finish.
 //
@@ -2378,6 +2510,82 @@ TEST_F(ReferenceCountLineageEnabledTest, TestBasicLineage) {
   ASSERT_EQ(lineage_deleted.size(), 1);
 }
 
+// Owned objects go out of scope and release the lineage of their tasks from many
+// threads at once, under the locks of their shards only. The worker shuts down once,
+// after the last reference is gone.
+TEST_F(ReferenceCountLineageEnabledTest, TestConcurrentLineageRelease) {
+  const int num_threads = 8;
+  const int num_iterations = 1000;
+  absl::Mutex mu;
+  absl::flat_hash_map<ObjectID, ObjectID> task_args;
+  std::atomic<int> num_lineage_released(0);
+  rc->SetReleaseLineageCallback(
+      [&](const ObjectID &object_id, std::vector<ObjectID> *ids_to_release) {
+        num_lineage_released++;
+        absl::MutexLock lock(&mu);
+        auto it = task_args.find(object_id);
+        if (it != task_args.end()) {
+          ids_to_release->push_back(it->second);
+          task_args.erase(it);
+        }
+        return 0;
+      });
+  ObjectID pinned_id = ObjectID::FromRandom();
+  rc->AddLocalReference(pinned_id, "");
+  int num_shutdowns = 0;
+  rc->DrainAndShutdown([&]() { num_shutdowns++; });
+
+  rpc::Address borrower_address;
+  borrower_address.set_worker_id(WorkerID::FromRandom().Binary());
+  auto run = [&]() {
+    for (int i = 0; i < num_iterations; i++) {
+      ObjectID arg_id = ObjectID::FromRandom();
+      ObjectID return_id = ObjectID::FromRandom();
+      rc->AddOwnedObject(arg_id, {}, rpc::Address(), "", 0, true);
+      rc->AddLocalReference(arg_id, "");
+      rc->AddOwnedObject(return_id, {}, rpc::Address(), "", 0, true);
+      rc->AddLocalReference(return_id, "");
+      {
+        absl::MutexLock lock(&mu);
+        task_args[return_id] = arg_id;
+      }
+      rc->UpdateSubmittedTaskReferences({return_id}, {arg_id});
+      rc->RemoveLocalReference(arg_id, nullptr);
+
+      // The worker that executed the task stopped borrowing the argument.
+      ReferenceCounter::ReferenceTableProto borrowed_refs;
+      borrowed_refs.Add()->mutable_reference()->set_object_id(arg_id.Binary());
+      std::vector<ObjectID> deleted;
+      rc->UpdateFinishedTaskReferences({return_id}, {arg_id}, /*release_lineage=*/false,
+                                       borrower_address, borrowed_refs, &deleted);
+      // The argument is out of scope, but the task may be retried.
+      ASSERT_EQ(deleted, std::vector<ObjectID>({arg_id}));
+      ASSERT_TRUE(rc->HasReference(arg_id));
+
+      deleted.clear();
+      rc->RemoveLocalReference(return_id, &deleted);
+      ASSERT_EQ(deleted, std::vector<ObjectID>({return_id}));
+      ASSERT_FALSE(rc->HasReference(return_id));
+      ASSERT_FALSE(rc->HasReference(arg_id));
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // The lineage of both the return object and the argument was released.
+  ASSERT_EQ(num_lineage_released, 2 * num_threads * num_iterations);
+  ASSERT_EQ(rc->NumObjectIDsInScope(), 1);
+  ASSERT_EQ(num_shutdowns, 0);
+  rc->RemoveLocalReference(pinned_id, nullptr);
+  ASSERT_EQ(num_shutdowns, 1);
+}
+
 // Test for pinning the lineage of an object, where the lineage is a chain of
 // tasks that each depend on the previous. The previous objects should already
 // have gone out of scope, but their Reference entry is pinned until the final
@@ -2487,6 +2695,56 @@ TEST_F(ReferenceCountLineageEnabledTest, TestEvictLineage) {
   ASSERT_FALSE(lineage_evicted);
 }
 
+// An object that is spilled to distributed external storage can be restored
+// from its spill URL, so its lineage and the lineage of its task's arguments
+// should be released. Objects spilled to a node's local disk keep their lineage.
+TEST_F(ReferenceCountLineageEnabledTest, TestCollapseLineageOnDurableSpill) {
+  std::vector<ObjectID> ids;
+  for (int i = 0; i < 3; i++) {
+    ObjectID id = ObjectID::FromRandom();
+    ids.push_back(id);
+    rc->AddOwnedObject(id, {}, rpc::Address(), "", 0, true);
+  }
+  std::vector<ObjectID> lineage_deleted;
+  rc->SetReleaseLineageCallback(
+      [&](const ObjectID &object_id, std::vector<ObjectID> *ids_to_release) {
+        lineage_deleted.push_back(object_id);
+        if (object_id == ids[1]) {
+          // ID1 depends on ID0.
+          ids_to_release->push_back(ids[0]);
+        }
+        return 10;
+      });
+
+  // ID1 depends on ID0.
+  rc->UpdateSubmittedTaskReferences({ids[1]}, {ids[0]});
+  rc->UpdateFinishedTaskReferences({ids[1]}, {ids[0]}, /*release_lineage=*/false,
+                                   empty_borrower, empty_refs, nullptr);
+  rc->AddLocalReference(ids[1], "");
+  rc->AddLocalReference(ids[2], "");
+
+  // ID2 is spilled to a node's local disk, so it keeps its lineage.
+  ASSERT_TRUE(rc->HandleObjectSpilled(ids[2], "/tmp/spill/obj", NodeID::FromRandom(),
+                                      100, /*release=*/false));
+  ASSERT_TRUE(lineage_deleted.empty());
+
+  // ID1 is spilled to distributed storage, so the lineage of ID1 and ID0 is
+  // released.
+  ASSERT_TRUE(rc->HandleObjectSpilled(ids[1], "s3://bucket/obj", NodeID::Nil(), 100,
+                                      /*release=*/false));
+  ASSERT_EQ(lineage_deleted, std::vector<ObjectID>({ids[1], ids[0]}));
+  ASSERT_FALSE(rc->HasReference(ids[0]));
+  bool lineage_evicted = false;
+  ASSERT_FALSE(rc->IsObjectReconstructable(ids[1], &lineage_evicted));
+  ASSERT_FALSE(lineage_evicted);
+  ASSERT_TRUE(rc->IsObjectReconstructable(ids[2], &lineage_evicted));
+
+  // ID1 is no longer a candidate for lineage eviction.
+  lineage_deleted.clear();
+  ASSERT_EQ(rc->EvictLineage(10), 10);
+  ASSERT_EQ(lineage_deleted, std::vector<ObjectID>({ids[2]}));
+}
+
 TEST_F(ReferenceCountLineageEnabledTest, TestResubmittedTask) {
   std::vector<ObjectID> out;
   std::vector<ObjectID> lineage_deleted;
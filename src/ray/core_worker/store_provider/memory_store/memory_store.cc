@@ -156,13 +156,14 @@ CoreWorkerMemoryStore::CoreWorkerMemoryStore(
 void CoreWorkerMemoryStore::GetAsync(
     const ObjectID &object_id, std::function<void(std::shared_ptr<RayObject>)> callback) {
   std::shared_ptr<RayObject> ptr;
+  auto &shard = GetShard(object_id);
   {
-    absl::MutexLock lock(&mu_);
-    auto iter = objects_.find(object_id);
-    if (iter != objects_.end()) {
+    absl::MutexLock lock(&shard.mu);
+    auto iter = shard.objects.find(object_id);
+    if (iter != shard.objects.end()) {
       ptr = iter->second;
     } else {
-      object_async_get_requests_[object_id].push_back(callback);
+      shard.object_async_get_requests[object_id].push_back(callback);
     }
     if (ptr != nullptr) {
       ptr->SetAccessed();
@@ -176,15 +177,19 @@ void CoreWorkerMemoryStore::GetAsync(
 
 std::shared_ptr<RayObject> CoreWorkerMemoryStore::GetIfExists(const ObjectID &object_id) {
   std::shared_ptr<RayObject> ptr;
+  auto &shard = GetShard(object_id);
+  if (!MayContain(shard, object_id)) {
+    return ptr;
+  }
   {
-    absl::MutexLock lock(&mu_);
-    auto iter = objects_.find(object_id);
-    if (iter != objects_.end()) {
+    absl::ReaderMutexLock lock(&shard.mu);
+    auto iter = shard.objects.find(object_id);
+    if (iter != shard.objects.end()) {
       ptr = iter->second;
     }
-    if (ptr != nullptr) {
-      ptr->SetAccessed();
-    }
+  }
+  if (ptr != nullptr) {
+    ptr->SetAccessed();
   }
   return ptr;
 }
@@ -194,27 +199,28 @@ bool CoreWorkerMemoryStore::Put(const RayObject &object, const ObjectID &object_
   auto object_entry = std::make_shared<RayObject>(object.GetData(), object.GetMetadata(),
                                                   object.GetNestedRefs(), true);
   bool stored_in_direct_memory = true;
+  auto &shard = GetShard(object_id);
 
   // TODO(edoakes): we should instead return a flag to the caller to put the object in
   // plasma.
   {
-    absl::MutexLock lock(&mu_);
+    absl::MutexLock lock(&shard.mu);
 
-    auto iter = objects_.find(object_id);
-    if (iter != objects_.end()) {
+    auto iter = shard.objects.find(object_id);
+    if (iter != shard.objects.end()) {
       return true;  // Object already exists in the store, which is fine.
     }
 
-    auto async_callback_it = object_async_get_requests_.find(object_id);
-    if (async_callback_it != object_async_get_requests_.end()) {
+    auto async_callback_it = shard.object_async_get_requests.find(object_id);
+    if (async_callback_it != shard.object_async_get_requests.end()) {
       auto &callbacks = async_callback_it->second;
       async_callbacks = std::move(callbacks);
-      object_async_get_requests_.erase(async_callback_it);
+      shard.object_async_get_requests.erase(async_callback_it);
     }
 
     bool should_add_entry = true;
-    auto object_request_iter = object_get_requests_.find(object_id);
-    if (object_request_iter != object_get_requests_.end()) {
+    auto object_request_iter = shard.object_get_requests.find(object_id);
+    if (object_request_iter != shard.object_get_requests.end()) {
       auto &get_requests = object_request_iter->second;
       for (auto &get_request : get_requests) {
         get_request->Set(object_id, object_entry);
@@ -231,7 +237,7 @@ bool CoreWorkerMemoryStore::Put(const RayObject &object, const ObjectID &object_
 
     if (should_add_entry) {
       // If there is no existing get request, then add the `RayObject` to map.
-      EmplaceObjectAndUpdateStats(object_id, object_entry);
+      EmplaceObjectAndUpdateStats(shard, object_id, object_entry);
     } else {
       // It is equivalent to the object being added and immediately deleted from the
       // store.
@@ -273,16 +279,21 @@ Status CoreWorkerMemoryStore::GetImpl(const std::vector<ObjectID> &object_ids,
     absl::flat_hash_set<ObjectID> remaining_ids;
     absl::flat_hash_set<ObjectID> ids_to_remove;
 
-    absl::MutexLock lock(&mu_);
     // Check for existing objects and see if this get request can be fullfilled.
     for (size_t i = 0; i < object_ids.size() && count < num_objects; i++) {
       const auto &object_id = object_ids[i];
-      auto iter = objects_.find(object_id);
-      if (iter != objects_.end()) {
+      auto &shard = GetShard(object_id);
+      if (!MayContain(shard, object_id)) {
+        remaining_ids.insert(object_id);
+        continue;
+      }
+      absl::ReaderMutexLock lock(&shard.mu);
+      auto iter = shard.objects.find(object_id);
+      if (iter != shard.objects.end()) {
         iter->second->SetAccessed();
         (*results)[i] = iter->second;
         if (remove_after_get) {
-          // Note that we cannot remove the object_id from `objects_` now,
+          // Note that we cannot remove the object_id from the store now,
           // because `object_ids` might have duplicate ids.
           ids_to_remove.insert(object_id);
         }
@@ -296,7 +307,9 @@ Status CoreWorkerMemoryStore::GetImpl(const std::vector<ObjectID> &object_ids,
     // Clean up the objects if ref counting is off.
     if (ref_counter_ == nullptr) {
       for (const auto &object_id : ids_to_remove) {
-        EraseObjectAndUpdateStats(object_id);
+        auto &shard = GetShard(object_id);
+        absl::MutexLock lock(&shard.mu);
+        EraseObjectAndUpdateStats(shard, object_id);
       }
     }
 
@@ -312,7 +325,19 @@ Status CoreWorkerMemoryStore::GetImpl(const std::vector<ObjectID> &object_ids,
         std::make_shared<GetRequest>(std::move(remaining_ids), required_objects,
                                      remove_after_get, abort_if_any_object_is_exception);
     for (const auto &object_id : get_request->ObjectIds()) {
-      object_get_requests_[object_id].push_back(get_request);
+      auto &shard = GetShard(object_id);
+      absl::MutexLock lock(&shard.mu);
+      // The object may have been put after we checked for it above. Put won't see
+      // this request then, so set the object on the request directly.
+      auto iter = shard.objects.find(object_id);
+      if (iter == shard.objects.end()) {
+        shard.object_get_requests[object_id].push_back(get_request);
+      } else {
+        get_request->Set(object_id, iter->second);
+        if (remove_after_get && ref_counter_ == nullptr) {
+          EraseObjectAndUpdateStats(shard, object_id);
+        }
+      }
     }
   }
 
@@ -356,29 +381,28 @@ Status CoreWorkerMemoryStore::GetImpl(const std::vector<ObjectID> &object_ids,
     RAY_CHECK_OK(raylet_client_->NotifyDirectCallTaskUnblocked());
   }
 
-  {
-    absl::MutexLock lock(&mu_);
-    // Populate results.
-    for (size_t i = 0; i < object_ids.size(); i++) {
-      const auto &object_id = object_ids[i];
-      if ((*results)[i] == nullptr) {
-        (*results)[i] = get_request->Get(object_id);
-      }
+  // Populate results.
+  for (size_t i = 0; i < object_ids.size(); i++) {
+    const auto &object_id = object_ids[i];
+    if ((*results)[i] == nullptr) {
+      (*results)[i] = get_request->Get(object_id);
     }
+  }
 
-    // Remove get request.
-    for (const auto &object_id : get_request->ObjectIds()) {
-      auto object_request_iter = object_get_requests_.find(object_id);
-      if (object_request_iter != object_get_requests_.end()) {
-        auto &get_requests = object_request_iter->second;
-        // Erase get_request from the vector.
-        auto it = std::find(get_requests.begin(), get_requests.end(), get_request);
-        if (it != get_requests.end()) {
-          get_requests.erase(it);
-          // If the vector is empty, remove the object ID from the map.
-          if (get_requests.empty()) {
-            object_get_requests_.erase(object_request_iter);
-          }
+  // Remove get request.
+  for (const auto &object_id : get_request->ObjectIds()) {
+    auto &shard = GetShard(object_id);
+    absl::MutexLock lock(&shard.mu);
+    auto object_request_iter = shard.object_get_requests.find(object_id);
+    if (object_request_iter != shard.object_get_requests.end()) {
+      auto &get_requests = object_request_iter->second;
+      // Erase get_request from the vector.
+      auto it = std::find(get_requests.begin(), get_requests.end(), get_request);
+      if (it != get_requests.end()) {
+        get_requests.erase(it);
+        // If the vector is empty, remove the object ID from the map.
+        if (get_requests.empty()) {
+          shard.object_get_requests.erase(object_request_iter);
         }
       }
     }
@@ -442,35 +466,41 @@ Status CoreWorkerMemoryStore::Wait(const absl::flat_hash_set<ObjectID> &object_i
 
 void CoreWorkerMemoryStore::Delete(const absl::flat_hash_set<ObjectID> &object_ids,
                                    absl::flat_hash_set<ObjectID> *plasma_ids_to_delete) {
-  absl::MutexLock lock(&mu_);
   for (const auto &object_id : object_ids) {
-    auto it = objects_.find(object_id);
-    if (it != objects_.end()) {
+    auto &shard = GetShard(object_id);
+    absl::MutexLock lock(&shard.mu);
+    auto it = shard.objects.find(object_id);
+    if (it != shard.objects.end()) {
       if (it->second->IsInPlasmaError()) {
         plasma_ids_to_delete->insert(object_id);
       } else {
         OnDelete(it->second);
-        EraseObjectAndUpdateStats(object_id);
+        EraseObjectAndUpdateStats(shard, object_id);
       }
     }
   }
 }
 
 void CoreWorkerMemoryStore::Delete(const std::vector<ObjectID> &object_ids) {
-  absl::MutexLock lock(&mu_);
   for (const auto &object_id : object_ids) {
-    auto it = objects_.find(object_id);
-    if (it != objects_.end()) {
+    auto &shard = GetShard(object_id);
+    absl::MutexLock lock(&shard.mu);
+    auto it = shard.objects.find(object_id);
+    if (it != shard.objects.end()) {
       OnDelete(it->second);
-      EraseObjectAndUpdateStats(object_id);
+      EraseObjectAndUpdateStats(shard, object_id);
     }
   }
 }
 
 bool CoreWorkerMemoryStore::Contains(const ObjectID &object_id, bool *in_plasma) {
-  absl::MutexLock lock(&mu_);
-  auto it = objects_.find(object_id);
-  if (it != objects_.end()) {
+  auto &shard = GetShard(object_id);
+  if (!MayContain(shard, object_id)) {
+    return false;
+  }
+  absl::ReaderMutexLock lock(&shard.mu);
+  auto it = shard.objects.find(object_id);
+  if (it != shard.objects.end()) {
     if (it->second->IsInPlasmaError()) {
       *in_plasma = true;
     }
@@ -496,60 +526,67 @@ void CoreWorkerMemoryStore::OnDelete(std::shared_ptr<RayObject> obj) {
 }
 
 void CoreWorkerMemoryStore::NotifyUnhandledErrors() {
-  absl::MutexLock lock(&mu_);
   int64_t threshold = absl::GetCurrentTimeNanos() - kUnhandledErrorGracePeriodNanos;
-  auto it = objects_.begin();
   int count = 0;
-  while (it != objects_.end() && count < kMaxUnhandledErrorScanItems) {
-    const auto &obj = it->second;
-    if (IsUnhandledError(obj) && obj->CreationTimeNanos() < threshold &&
-        unhandled_exception_handler_ != nullptr) {
-      obj->SetAccessed();
-      unhandled_exception_handler_(*obj);
+  for (auto &shard : shards_) {
+    absl::MutexLock lock(&shard.mu);
+    auto it = shard.objects.begin();
+    while (it != shard.objects.end() && count < kMaxUnhandledErrorScanItems) {
+      const auto &obj = it->second;
+      if (IsUnhandledError(obj) && obj->CreationTimeNanos() < threshold &&
+          unhandled_exception_handler_ != nullptr) {
+        obj->SetAccessed();
+        unhandled_exception_handler_(*obj);
+      }
+      it++;
+      count++;
     }
-    it++;
-    count++;
   }
 }
 
-inline void CoreWorkerMemoryStore::EraseObjectAndUpdateStats(const ObjectID &object_id) {
-  auto it = objects_.find(object_id);
-  if (it == objects_.end()) {
+inline void CoreWorkerMemoryStore::EraseObjectAndUpdateStats(Shard &shard,
+                                                             const ObjectID &object_id) {
+  auto it = shard.objects.find(object_id);
+  if (it == shard.objects.end()) {
     return;
   }
 
   if (it->second->IsInPlasmaError()) {
-    num_in_plasma_ -= 1;
+    shard.num_in_plasma -= 1;
   } else {
-    num_local_objects_ -= 1;
-    used_object_store_memory_ -= it->second->GetSize();
+    shard.num_local_objects -= 1;
+    shard.used_object_store_memory -= it->second->GetSize();
   }
-  RAY_CHECK(num_in_plasma_ >= 0 && num_local_objects_ >= 0 &&
-            used_object_store_memory_ >= 0);
-  objects_.erase(it);
+  RAY_CHECK(shard.num_in_plasma >= 0 && shard.num_local_objects >= 0 &&
+            shard.used_object_store_memory >= 0);
+  shard.objects.erase(it);
+  GetBucketCounter(shard, object_id).fetch_sub(1, std::memory_order_relaxed);
 }
 
 inline void CoreWorkerMemoryStore::EmplaceObjectAndUpdateStats(
-    const ObjectID &object_id, std::shared_ptr<RayObject> &object_entry) {
-  auto inserted = objects_.emplace(object_id, object_entry).second;
+    Shard &shard, const ObjectID &object_id, std::shared_ptr<RayObject> &object_entry) {
+  auto inserted = shard.objects.emplace(object_id, object_entry).second;
   if (inserted) {
+    GetBucketCounter(shard, object_id).fetch_add(1, std::memory_order_relaxed);
     if (object_entry->IsInPlasmaError()) {
-      num_in_plasma_ += 1;
+      shard.num_in_plasma += 1;
     } else {
-      num_local_objects_ += 1;
-      used_object_store_memory_ += object_entry->GetSize();
+      shard.num_local_objects += 1;
+      shard.used_object_store_memory += object_entry->GetSize();
     }
   }
-  RAY_CHECK(num_in_plasma_ >= 0 && num_local_objects_ >= 0 &&
-            used_object_store_memory_ >= 0);
+  RAY_CHECK(shard.num_in_plasma >= 0 && shard.num_local_objects >= 0 &&
+            shard.used_object_store_memory >= 0);
 }
 
 MemoryStoreStats CoreWorkerMemoryStore::GetMemoryStoreStatisticalData() {
-  absl::MutexLock lock(&mu_);
   MemoryStoreStats item;
-  item.num_in_plasma = num_in_plasma_;
-  item.num_local_objects = num_local_objects_;
-  item.used_object_store_memory = used_object_store_memory_;
+  for (const auto &shard : shards_) {
+    absl::ReaderMutexLock lock(&shard.mu);
+    item.num_in_plasma += shard.num_in_plasma;
+    item.num_local_objects += shard.num_local_objects;
+    item.used_object_store_memory += shard.used_object_store_memory;
+  }
   return item;
 }
 
@@ -16,6 +16,9 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <array>
+#include <atomic>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
@@ -29,8 +32,12 @@ namespace ray {
 namespace core {
 
 struct MemoryStoreStats {
+  /// Number of objects in the plasma store for this memory store.
   int32_t num_in_plasma = 0;
+  /// Number of objects that don't exist in the plasma store.
   int32_t num_local_objects = 0;
+  /// Number of object store memory used by this memory store. (It doesn't include plasma
+  /// store memory usage).
   int64_t used_object_store_memory = 0;
 };
 
@@ -134,8 +141,26 @@ class CoreWorkerMemoryStore {
   ///
   /// \return Count of objects in the store.
   int Size() {
-    absl::MutexLock lock(&mu_);
-    return objects_.size();
+    int size = 0;
+    for (auto &shard : shards_) {
+      absl::ReaderMutexLock lock(&shard.mu);
+      size += shard.objects.size();
+    }
+    return size;
+  }
+
+  /// Returns the number of GetAsync callbacks waiting for objects.
+  ///
+  /// \return Count of the callbacks across all objects.
+  size_t NumAsyncGetRequests() {
+    size_t num_requests = 0;
+    for (auto &shard : shards_) {
+      absl::MutexLock lock(&shard.mu);
+      for (const auto &entry : shard.object_async_get_requests) {
+        num_requests += entry.second.size();
+      }
+    }
+    return num_requests;
   }
 
   /// Returns stats data of memory usage.
@@ -156,6 +181,63 @@ class CoreWorkerMemoryStore {
 
  private:
   FRIEND_TEST(TestMemoryStore, TestMemoryStoreStats);
+  FRIEND_TEST(TestMemoryStore, TestConcurrentPutAndGet);
+
+  /// The number of shards that the objects are split into.
+  static constexpr size_t kNumShards = 32;
+
+  /// The number of buckets of object ID hashes per shard that objects are counted in,
+  /// see Shard::num_objects_by_bucket.
+  static constexpr size_t kNumBucketsPerShard = 256;
+
+  /// The objects and the requests waiting for them, for the object IDs that hash
+  /// to the same shard. Operations on an object only need the lock of its shard.
+  struct Shard {
+    /// Protects the data structures below.
+    mutable absl::Mutex mu;
+
+    /// Map from object ID to `RayObject`.
+    /// NOTE: This map should be modified by EmplaceObjectAndUpdateStats and
+    /// EraseObjectAndUpdateStats.
+    absl::flat_hash_map<ObjectID, std::shared_ptr<RayObject>> objects GUARDED_BY(mu);
+
+    /// Map from object ID to its get requests.
+    absl::flat_hash_map<ObjectID, std::vector<std::shared_ptr<GetRequest>>>
+        object_get_requests GUARDED_BY(mu);
+
+    /// Map from object ID to its async get requests.
+    absl::flat_hash_map<ObjectID,
+                        std::vector<std::function<void(std::shared_ptr<RayObject>)>>>
+        object_async_get_requests GUARDED_BY(mu);
+
+    /// Stats of the objects in this shard. See the fields of MemoryStoreStats.
+    int32_t num_in_plasma GUARDED_BY(mu) = 0;
+    int32_t num_local_objects GUARDED_BY(mu) = 0;
+    int64_t used_object_store_memory GUARDED_BY(mu) = 0;
+
+    /// The number of objects in `objects` per bucket of object ID hashes. It is only
+    /// updated under `mu`, together with `objects`, but read without it: an object
+    /// whose bucket is empty can't be in the shard, so looking it up doesn't need the
+    /// lock.
+    std::array<std::atomic<uint32_t>, kNumBucketsPerShard> num_objects_by_bucket{};
+  };
+
+  /// Return the shard that the object belongs to.
+  Shard &GetShard(const ObjectID &object_id) {
+    return shards_[object_id.Hash() % kNumShards];
+  }
+
+  /// Return the counter of the object's bucket in Shard::num_objects_by_bucket.
+  static std::atomic<uint32_t> &GetBucketCounter(Shard &shard,
+                                                 const ObjectID &object_id) {
+    return shard.num_objects_by_bucket[(object_id.Hash() / kNumShards) %
+                                       kNumBucketsPerShard];
+  }
+
+  /// Whether the object may be in the shard. This doesn't take the shard's lock.
+  static bool MayContain(Shard &shard, const ObjectID &object_id) {
+    return GetBucketCounter(shard, object_id).load(std::memory_order_relaxed) > 0;
+  }
 
   /// See the public version of `Get` for meaning of the other arguments.
   /// \param[in] abort_if_any_object_is_exception Whether we should abort if any object
@@ -169,13 +251,14 @@ class CoreWorkerMemoryStore {
   void OnDelete(std::shared_ptr<RayObject> obj);
 
   /// Emplace the given object entry to the in-memory-store and update stats properly.
-  void EmplaceObjectAndUpdateStats(const ObjectID &object_id,
+  void EmplaceObjectAndUpdateStats(Shard &shard, const ObjectID &object_id,
                                    std::shared_ptr<RayObject> &object_entry)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+      EXCLUSIVE_LOCKS_REQUIRED(shard.mu);
 
   /// Erase the object of the object id from the in memory store and update stats
   /// properly.
-  void EraseObjectAndUpdateStats(const ObjectID &object_id) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void EraseObjectAndUpdateStats(Shard &shard, const ObjectID &object_id)
+      EXCLUSIVE_LOCKS_REQUIRED(shard.mu);
 
   /// If enabled, holds a reference to local worker ref counter. TODO(ekl) make this
   /// mandatory once Java is supported.
@@ -184,39 +267,14 @@ class CoreWorkerMemoryStore {
   // If set, this will be used to notify worker blocked / unblocked on get calls.
   std::shared_ptr<raylet::RayletClient> raylet_client_ = nullptr;
 
-  /// Protects the data structures below.
-  mutable absl::Mutex mu_;
-
-  /// Map from object ID to `RayObject`.
-  /// NOTE: This map should be modified by EmplaceObjectAndUpdateStats and
-  /// EraseObjectAndUpdateStats.
-  absl::flat_hash_map<ObjectID, std::shared_ptr<RayObject>> objects_ GUARDED_BY(mu_);
-
-  /// Map from object ID to its get requests.
-  absl::flat_hash_map<ObjectID, std::vector<std::shared_ptr<GetRequest>>>
-      object_get_requests_ GUARDED_BY(mu_);
-
-  /// Map from object ID to its async get requests.
-  absl::flat_hash_map<ObjectID,
-                      std::vector<std::function<void(std::shared_ptr<RayObject>)>>>
-      object_async_get_requests_ GUARDED_BY(mu_);
+  /// The objects in this store, sharded by the hash of their object ID.
+  std::array<Shard, kNumShards> shards_;
 
   /// Function passed in to be called to check for signals (e.g., Ctrl-C).
   std::function<Status()> check_signals_;
 
   /// Function called to report unhandled exceptions.
   std::function<void(const RayObject &)> unhandled_exception_handler_;
-
-  ///
-  /// Below information is stats.
-  ///
-  /// Number of objects in the plasma store for this memory store.
-  int32_t num_in_plasma_ GUARDED_BY(mu_) = 0;
-  /// Number of objects that don't exist in the plasma store.
-  int32_t num_local_objects_ GUARDED_BY(mu_) = 0;
-  /// Number of object store memory used by this memory store. (It doesn't include plasma
-  /// store memory usage).
-  int64_t used_object_store_memory_ GUARDED_BY(mu_) = 0;
 };
 
 }  // namespace core
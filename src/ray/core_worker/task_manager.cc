@@ -14,6 +14,9 @@
 
 #include "ray/core_worker/task_manager.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
 #include "ray/common/buffer.h"
 #include "ray/common/common_protocol.h"
 #include "ray/common/constants.h"
@@ -28,6 +31,47 @@ const int64_t kTaskFailureThrottlingThreshold = 50;
 // Throttle task failure logs to once this interval.
 const int64_t kTaskFailureLoggingFrequencyMillis = 5000;
 
+namespace {
+
+/// Whether a field of the task spec is specific to each task, rather than usually the
+/// same for all tasks of a function submitted by the same caller.
+bool IsPerTaskField(int field_number) {
+  switch (field_number) {
+  case rpc::TaskSpec::kTaskIdFieldNumber:
+  case rpc::TaskSpec::kParentCounterFieldNumber:
+  case rpc::TaskSpec::kArgsFieldNumber:
+  case rpc::TaskSpec::kActorCreationTaskSpecFieldNumber:
+  case rpc::TaskSpec::kActorTaskSpecFieldNumber:
+  case rpc::TaskSpec::kSkipExecutionFieldNumber:
+  case rpc::TaskSpec::kAttemptNumberFieldNumber:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Split a serialized task spec into its serialized shared and per-task fields,
+/// without parsing the field values.
+void SplitSerializedTaskSpec(const std::string &serialized, std::string *shared_fields,
+                             std::string *task_fields) {
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t *>(serialized.data()), serialized.size());
+  while (true) {
+    const int start = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      break;
+    }
+    RAY_CHECK(google::protobuf::internal::WireFormatLite::SkipField(&input, tag));
+    const int field_number =
+        google::protobuf::internal::WireFormatLite::GetTagFieldNumber(tag);
+    auto *fields = IsPerTaskField(field_number) ? task_fields : shared_fields;
+    fields->append(serialized, start, input.CurrentPosition() - start);
+  }
+}
+
+}  // namespace
+
 std::vector<rpc::ObjectReference> TaskManager::AddPendingTask(
     const rpc::Address &caller_address, const TaskSpecification &spec,
     const std::string &call_site, int max_retries) {
@@ -115,17 +159,17 @@ bool TaskManager::ResubmitTask(const TaskID &task_id, std::vector<ObjectID> *tas
       num_pending_tasks_++;
 
       // The task is pending again, so it's no longer counted as lineage. If
-      // the task finishes and we still need the spec, we'll add the task back
-      // to the footprint sum.
-      total_lineage_footprint_bytes_ -= it->second.lineage_footprint_bytes;
-      it->second.lineage_footprint_bytes = 0;
+      // the task finishes and we still need the spec, we'll compact it and add
+      // the task back to the footprint sum.
+      it->second.spec = GetSpec(it->second);
+      total_lineage_footprint_bytes_ -= ReleaseCompactedLineage(it->second);
 
       if (it->second.num_retries_left > 0) {
         it->second.num_retries_left--;
       } else {
         RAY_CHECK(it->second.num_retries_left == -1);
       }
-      spec = it->second.spec;
+      spec = *it->second.spec;
 
       for (const auto &return_id : it->second.reconstructable_return_ids) {
         return_ids.push_back(return_id);
@@ -294,7 +338,7 @@ void TaskManager::CompletePendingTask(const TaskID &task_id,
     auto it = submissible_tasks_.find(task_id);
     RAY_CHECK(it != submissible_tasks_.end())
         << "Tried to complete task that was not pending " << task_id;
-    spec = it->second.spec;
+    spec = *it->second.spec;
 
     // Release the lineage for any non-plasma return objects.
     for (const auto &direct_return_id : direct_return_ids) {
@@ -320,8 +364,7 @@ void TaskManager::CompletePendingTask(const TaskID &task_id,
     if (task_retryable) {
       // Pin the task spec if it may be retried again.
       release_lineage = false;
-      it->second.lineage_footprint_bytes = it->second.spec.GetMessage().ByteSizeLong();
-      total_lineage_footprint_bytes_ += it->second.lineage_footprint_bytes;
+      total_lineage_footprint_bytes_ += CompactLineage(it->second);
       if (total_lineage_footprint_bytes_ > max_lineage_bytes_) {
         RAY_LOG(INFO) << "Total lineage size is " << total_lineage_footprint_bytes_ / 1e6
                       << "MB, which exceeds the limit of " << max_lineage_bytes_ / 1e6
@@ -354,7 +397,7 @@ bool TaskManager::RetryTaskIfPossible(const TaskID &task_id) {
         << "Tried to retry task that was not pending " << task_id;
     RAY_CHECK(it->second.pending)
         << "Tried to retry task that was not pending " << task_id;
-    spec = it->second.spec;
+    spec = *it->second.spec;
     num_retries_left = it->second.num_retries_left;
     if (num_retries_left > 0) {
       it->second.num_retries_left--;
@@ -396,7 +439,7 @@ void TaskManager::FailPendingTask(const TaskID &task_id, rpc::ErrorType error_ty
         << "Tried to fail task that was not pending " << task_id;
     RAY_CHECK(it->second.pending)
         << "Tried to fail task that was not pending " << task_id;
-    spec = it->second.spec;
+    spec = *it->second.spec;
     submissible_tasks_.erase(it);
     num_pending_tasks_--;
 
@@ -532,19 +575,27 @@ int64_t TaskManager::RemoveLineageReference(const ObjectID &object_id,
 
   if (it->second.reconstructable_return_ids.empty() && !it->second.pending) {
     // If the task can no longer be retried, decrement the lineage ref count
-    // for each of the task's args.
-    for (size_t i = 0; i < it->second.spec.NumArgs(); i++) {
-      if (it->second.spec.ArgByRef(i)) {
-        released_objects->push_back(it->second.spec.ArgId(i));
+    // for each of the task's args. The args of a compacted spec are among the
+    // fields of the task, so the shared fields don't need to be parsed.
+    rpc::TaskSpec task_fields;
+    const rpc::TaskSpec *message = &task_fields;
+    if (it->second.spec) {
+      message = &it->second.spec->GetMessage();
+    } else {
+      const auto serialized = lineage_arena_.Get(it->second.lineage_task_fields);
+      RAY_CHECK(task_fields.ParseFromArray(serialized.data(), serialized.size()));
+    }
+    for (const auto &arg : message->args()) {
+      if (arg.has_object_ref()) {
+        released_objects->push_back(ObjectID::FromBinary(arg.object_ref().object_id()));
       } else {
-        const auto &inlined_refs = it->second.spec.ArgInlinedRefs(i);
-        for (const auto &inlined_ref : inlined_refs) {
+        for (const auto &inlined_ref : arg.nested_inlined_refs()) {
           released_objects->push_back(ObjectID::FromBinary(inlined_ref.object_id()));
         }
       }
     }
 
-    total_lineage_footprint_bytes_ -= it->second.lineage_footprint_bytes;
+    total_lineage_footprint_bytes_ -= ReleaseCompactedLineage(it->second);
     // The task has finished and none of the return IDs are in scope anymore,
     // so it is safe to remove the task spec.
     submissible_tasks_.erase(it);
@@ -585,7 +636,7 @@ absl::optional<TaskSpecification> TaskManager::GetTaskSpec(const TaskID &task_id
   if (it == submissible_tasks_.end()) {
     return absl::optional<TaskSpecification>();
   }
-  return it->second.spec;
+  return GetSpec(it->second);
 }
 
 std::vector<TaskID> TaskManager::GetPendingChildrenTasks(
@@ -593,12 +644,79 @@ std::vector<TaskID> TaskManager::GetPendingChildrenTasks(
   std::vector<TaskID> ret_vec;
   absl::MutexLock lock(&mu_);
   for (auto it : submissible_tasks_) {
-    if ((it.second.pending) && (it.second.spec.ParentTaskId() == parent_task_id)) {
+    if ((it.second.pending) && (it.second.spec->ParentTaskId() == parent_task_id)) {
       ret_vec.push_back(it.first);
     }
   }
   return ret_vec;
 }
 
+int64_t TaskManager::CompactLineage(TaskEntry &entry) {
+  RAY_CHECK(entry.spec);
+  // The spec was usually serialized when it was pushed, so this reuses its bytes.
+  std::string serialized;
+  entry.spec->AppendSerializedMessage(&serialized);
+  std::string shared_fields;
+  std::string task_fields;
+  SplitSerializedTaskSpec(serialized, &shared_fields, &task_fields);
+
+  int64_t bytes_added = task_fields.size();
+  auto inserted = lineage_shared_fields_.emplace(std::move(shared_fields), 0);
+  if (inserted.second) {
+    bytes_added += inserted.first->first.size();
+  }
+  inserted.first->second++;
+  entry.lineage_shared_fields = &inserted.first->first;
+  entry.lineage_task_fields = lineage_arena_.Add(task_fields);
+  entry.lineage_footprint_bytes = task_fields.size();
+  entry.spec.reset();
+  return bytes_added;
+}
+
+int64_t TaskManager::ReleaseCompactedLineage(TaskEntry &entry) {
+  if (entry.lineage_shared_fields == nullptr) {
+    return 0;
+  }
+  int64_t bytes_removed = entry.lineage_footprint_bytes;
+  lineage_arena_.Remove(entry.lineage_task_fields);
+  auto it = lineage_shared_fields_.find(*entry.lineage_shared_fields);
+  RAY_CHECK(it != lineage_shared_fields_.end());
+  if (--it->second == 0) {
+    bytes_removed += it->first.size();
+    lineage_shared_fields_.erase(it);
+  }
+  entry.lineage_shared_fields = nullptr;
+  entry.lineage_task_fields = LineageArena::Span();
+  entry.lineage_footprint_bytes = 0;
+
+  if (lineage_arena_.NeedsRelocation()) {
+    // Most of the arena is of released specs, which the remaining specs keep
+    // allocated. Move the remaining specs together so that the rest is freed.
+    lineage_arena_.StartNewChunk();
+    for (auto &task : submissible_tasks_) {
+      if (task.second.lineage_shared_fields != nullptr) {
+        task.second.lineage_task_fields =
+            lineage_arena_.Relocate(task.second.lineage_task_fields);
+      }
+    }
+  }
+  return bytes_removed;
+}
+
+TaskSpecification TaskManager::GetSpec(const TaskEntry &entry) const {
+  if (entry.spec) {
+    return *entry.spec;
+  }
+  // The fields of the task don't overlap with the shared fields, so merging them
+  // restores the original spec.
+  rpc::TaskSpec message;
+  RAY_CHECK(message.ParseFromString(*entry.lineage_shared_fields));
+  const auto task_fields = lineage_arena_.Get(entry.lineage_task_fields);
+  google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t *>(task_fields.data()), task_fields.size());
+  RAY_CHECK(message.MergeFromCodedStream(&input));
+  return TaskSpecification(std::move(message));
+}
+
 }  // namespace core
 }  // namespace ray
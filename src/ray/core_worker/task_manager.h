@@ -16,9 +16,12 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "ray/common/id.h"
 #include "ray/common/task/task.h"
+#include "ray/core_worker/lineage_arena.h"
 #include "ray/core_worker/store_provider/memory_store/memory_store.h"
 #include "src/ray/protobuf/core_worker.pb.h"
 #include "src/ray/protobuf/gcs.pb.h"
@@ -229,13 +232,32 @@ class TaskManager : public TaskFinisherInterface, public TaskResubmissionInterfa
     return total_lineage_footprint_bytes_;
   }
 
+  /// Return the number of bytes of the task spec that is pinned as lineage to
+  /// reconstruct the return objects of the given task, or 0 if there is none. This
+  /// doesn't include the fields that the spec shares with other pinned specs.
+  int64_t LineageFootprintBytes(const TaskID &task_id) const {
+    absl::MutexLock lock(&mu_);
+    auto it = submissible_tasks_.find(task_id);
+    return it == submissible_tasks_.end() ? 0 : it->second.lineage_footprint_bytes;
+  }
+
+  /// Return the number of bytes allocated to store the pinned lineage compactly.
+  int64_t LineageAllocatedBytes() const {
+    absl::MutexLock lock(&mu_);
+    int64_t bytes = lineage_arena_.AllocatedBytes();
+    for (const auto &shared_fields : lineage_shared_fields_) {
+      bytes += shared_fields.first.size();
+    }
+    return bytes;
+  }
+
  private:
   struct TaskEntry {
     TaskEntry(const TaskSpecification &spec_arg, int num_retries_left_arg,
               size_t num_returns)
         : spec(spec_arg), num_retries_left(num_retries_left_arg) {
       for (size_t i = 0; i < num_returns; i++) {
-        reconstructable_return_ids.insert(spec.ReturnId(i));
+        reconstructable_return_ids.insert(spec->ReturnId(i));
       }
     }
     /// The task spec. This is pinned as long as the following are true:
@@ -249,7 +271,16 @@ class TaskManager : public TaskFinisherInterface, public TaskResubmissionInterfa
     /// the worker fails. We could avoid this by either not caching the full
     /// TaskSpec for tasks that cannot be retried (e.g., actor tasks), or by
     /// storing a shared_ptr to a PushTaskRequest protobuf for all tasks.
-    const TaskSpecification spec;
+    /// While the task is only pinned as lineage, this is empty and the spec is
+    /// kept compactly in `lineage_shared_fields` and `lineage_task_fields` instead.
+    absl::optional<TaskSpecification> spec;
+    /// The serialized fields of the compacted spec that are usually the same for all
+    /// tasks of a function and caller, such as the function descriptor, caller address,
+    /// resources and runtime env. This points to a key of `lineage_shared_fields_`.
+    const std::string *lineage_shared_fields = nullptr;
+    /// The location of the rest of the serialized fields of the compacted spec, such as
+    /// the task ID and args, in `lineage_arena_`.
+    LineageArena::Span lineage_task_fields;
     // Number of times this task may be resubmitted. If this reaches 0, then
     // the task entry may be erased.
     int num_retries_left;
@@ -271,10 +302,9 @@ class TaskManager : public TaskFinisherInterface, public TaskResubmissionInterfa
     //    pending tasks and tasks that finished execution but that may be
     //    retried in the future.
     absl::flat_hash_set<ObjectID> reconstructable_return_ids;
-    // The size of this (serialized) task spec in bytes, if the task spec is
-    // not pending, i.e. it is being pinned because it's in another object's
-    // lineage. We cache this because the task spec protobuf can mutate
-    // out-of-band.
+    // The size of the fields of this compacted task spec that are not shared with
+    // other tasks, if the task spec is not pending, i.e. it is being pinned because
+    // it's in another object's lineage.
     int64_t lineage_footprint_bytes = 0;
   };
 
@@ -300,6 +330,23 @@ class TaskManager : public TaskFinisherInterface, public TaskResubmissionInterfa
   /// Shutdown if all tasks are finished and shutdown is scheduled.
   void ShutdownIfNeeded() LOCKS_EXCLUDED(mu_);
 
+  /// Compact the spec of a task that finished and is now only pinned as lineage.
+  /// The serialized spec is split into the fields that are shared with other tasks,
+  /// which are stored once for all tasks, and the fields of this task, which are
+  /// stored in the lineage arena.
+  ///
+  /// \return The number of bytes added to the lineage footprint.
+  int64_t CompactLineage(TaskEntry &entry) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  /// Release the compacted spec of a task, e.g., because it is resubmitted or no
+  /// longer needed.
+  ///
+  /// \return The number of bytes removed from the lineage footprint.
+  int64_t ReleaseCompactedLineage(TaskEntry &entry) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  /// Return the full spec of a task, whether it is compacted or not.
+  TaskSpecification GetSpec(const TaskEntry &entry) const EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   /// Used to store task results.
   std::shared_ptr<CoreWorkerMemoryStore> in_memory_store_;
 
@@ -353,8 +400,17 @@ class TaskManager : public TaskFinisherInterface, public TaskResubmissionInterfa
   /// execution.
   size_t num_pending_tasks_ = 0;
 
+  /// The bytes of the fields of the compacted specs that are not shared with other
+  /// tasks, plus the bytes of each set of shared fields once.
   int64_t total_lineage_footprint_bytes_ GUARDED_BY(mu_) = 0;
 
+  /// The fields that compacted specs share, by their serialization, with the number
+  /// of compacted specs that use them.
+  absl::node_hash_map<std::string, int64_t> lineage_shared_fields_ GUARDED_BY(mu_);
+
+  /// Stores the fields of each compacted spec that are not shared.
+  LineageArena lineage_arena_ GUARDED_BY(mu_);
+
   /// Optional shutdown hook to call when pending tasks all finish.
   std::function<void()> shutdown_hook_ GUARDED_BY(mu_) = nullptr;
 
@@ -182,6 +182,10 @@ class CoreWorkerTest : public ::testing::Test {
   // it is guaranteed that all tasks are successfully completed.
   void TestActorRestart(std::unordered_map<std::string, double> &resources);
 
+  // Test that a borrower asking again for the statuses of objects that are not ready
+  // doesn't make the owner wait for them again in its memory store.
+  void TestGetObjectStatusesReAsk();
+
  protected:
   bool WaitForDirectCallActorState(const ActorID &actor_id, bool wait_alive,
                                    int timeout_ms);
@@ -481,6 +485,55 @@ void CoreWorkerTest::TestActorFailure(
   }
 }
 
+void CoreWorkerTest::TestGetObjectStatusesReAsk() {
+  RayConfig::instance().initialize(R"({"object_status_batch_window_ms": 0})");
+  auto &driver = CoreWorkerProcess::GetCoreWorker();
+
+  const int num_objects = 10;
+  std::vector<ObjectID> object_ids;
+  for (int i = 0; i < num_objects; i++) {
+    auto object_id = ObjectID::FromRandom();
+    driver.reference_counter_->AddOwnedObject(object_id, {}, driver.rpc_address_, "", 0,
+                                              false);
+    driver.reference_counter_->AddLocalReference(object_id, "");
+    object_ids.push_back(object_id);
+  }
+  const size_t num_initial_gets = driver.memory_store_->NumAsyncGetRequests();
+
+  uint8_t array[] = {1, 2, 3};
+  auto buffer = std::make_shared<LocalMemoryBuffer>(array, sizeof(array));
+  RayObject object(buffer, nullptr, std::vector<rpc::ObjectReference>());
+  for (int i = 0; i < num_objects; i++) {
+    // Ask for the objects that are not ready yet, like the borrower does after each
+    // reply. Ask twice per round, as a borrower retrying a request would.
+    std::vector<rpc::GetObjectStatusesReply> replies(2);
+    int num_replied = 0;
+    for (auto &reply : replies) {
+      rpc::GetObjectStatusesRequest request;
+      request.set_owner_worker_id(driver.GetWorkerID().Binary());
+      for (int j = i; j < num_objects; j++) {
+        request.add_object_ids(object_ids[j].Binary());
+      }
+      driver.HandleGetObjectStatuses(
+          request, &reply,
+          [&num_replied](Status status, std::function<void()> success,
+                         std::function<void()> failure) { num_replied++; });
+    }
+    ASSERT_EQ(num_replied, 0);
+    ASSERT_EQ(driver.memory_store_->NumAsyncGetRequests(),
+              num_initial_gets + num_objects - i);
+
+    RAY_CHECK(driver.memory_store_->Put(object, object_ids[i]));
+    ASSERT_EQ(num_replied, 2);
+    for (const auto &reply : replies) {
+      ASSERT_EQ(reply.object_ids_size(), 1);
+      ASSERT_EQ(reply.object_ids(0), object_ids[i].Binary());
+      ASSERT_EQ(reply.statuses(0).status(), rpc::GetObjectStatusReply::CREATED);
+    }
+  }
+  ASSERT_EQ(driver.memory_store_->NumAsyncGetRequests(), num_initial_gets);
+}
+
 class ZeroNodeTest : public CoreWorkerTest {
  public:
   ZeroNodeTest() : CoreWorkerTest(0) {}
@@ -901,6 +954,8 @@ TEST_F(TwoNodeTest, TestNormalTaskCrossNodes) {
   TestNormalTask(resources);
 }
 
+TEST_F(SingleNodeTest, TestGetObjectStatusesReAsk) { TestGetObjectStatusesReAsk(); }
+
 TEST_F(SingleNodeTest, TestActorTaskLocal) {
   std::unordered_map<std::string, double> resources;
   TestActorTask(resources);
@@ -658,9 +658,285 @@ TEST_P(DirectActorSubmitterTest, TestPendingTasks) {
   ASSERT_FALSE(submitter_.PendingTasksFull(actor_id));
 }
 
+TEST_P(DirectActorSubmitterTest, TestInFlightWindow) {
+  auto execute_out_of_order = GetParam();
+  CoreWorkerDirectActorTaskSubmitter submitter(
+      *client_pool_, *store_, *task_finisher_, actor_creator_,
+      [](const ActorID &actor_id, int64_t num_queued) {}, io_context,
+      /*max_tasks_in_flight=*/2);
+  rpc::Address addr;
+  auto worker_id = WorkerID::FromRandom();
+  addr.set_worker_id(worker_id.Binary());
+  ActorID actor_id = ActorID::Of(JobID::FromInt(0), TaskID::Nil(), 0);
+  submitter.AddActorQueueIfNotExists(actor_id, -1, execute_out_of_order);
+  submitter.ConnectActor(actor_id, addr, 0);
+
+  for (int i = 0; i < 5; i++) {
+    auto task = CreateActorTaskHelper(actor_id, worker_id, i);
+    ASSERT_TRUE(submitter.SubmitTask(task).ok());
+    ASSERT_EQ(io_context.poll_one(), 1);
+  }
+  // Only the tasks in the window are pushed to the actor.
+  ASSERT_EQ(worker_client_->callbacks.size(), 2);
+
+  // Each reply lets one more task through, in order.
+  EXPECT_CALL(*task_finisher_, CompletePendingTask(_, _, _)).Times(5);
+  ASSERT_TRUE(worker_client_->ReplyPushTask());
+  ASSERT_EQ(worker_client_->callbacks.size(), 2);
+  ASSERT_TRUE(worker_client_->ReplyPushTask());
+  ASSERT_TRUE(worker_client_->ReplyPushTask());
+  ASSERT_EQ(worker_client_->callbacks.size(), 2);
+  ASSERT_THAT(worker_client_->received_seq_nos, ElementsAre(0, 1, 2, 3, 4));
+  while (!worker_client_->callbacks.empty()) {
+    ASSERT_TRUE(worker_client_->ReplyPushTask());
+  }
+}
+
+TEST_P(DirectActorSubmitterTest, TestWaitUntilPendingTasksNotFull) {
+  auto execute_out_of_order = GetParam();
+  int32_t max_pending_calls = 2;
+  rpc::Address addr;
+  auto worker_id = WorkerID::FromRandom();
+  addr.set_worker_id(worker_id.Binary());
+  ActorID actor_id = ActorID::Of(JobID::FromInt(0), TaskID::Nil(), 0);
+  submitter_.AddActorQueueIfNotExists(actor_id, max_pending_calls, execute_out_of_order);
+  submitter_.ConnectActor(actor_id, addr, 0);
+
+  for (int32_t i = 0; i < max_pending_calls; i++) {
+    ASSERT_TRUE(submitter_.WaitUntilPendingTasksNotFull(actor_id, /*timeout_ms=*/0));
+    ASSERT_TRUE(CheckSubmitTask(CreateActorTaskHelper(actor_id, worker_id, i)));
+  }
+  // The queue is full, so the caller either fails right away or after the timeout.
+  ASSERT_FALSE(submitter_.WaitUntilPendingTasksNotFull(actor_id, /*timeout_ms=*/0));
+  ASSERT_FALSE(submitter_.WaitUntilPendingTasksNotFull(actor_id, /*timeout_ms=*/10));
+
+  // A blocked caller is woken up by the reply that frees up room. The queues of other
+  // actors added meanwhile don't affect the caller.
+  EXPECT_CALL(*task_finisher_, CompletePendingTask(_, _, _)).Times(max_pending_calls);
+  std::thread reply_thread([this, max_pending_calls, execute_out_of_order]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int i = 1; i <= 100; i++) {
+      auto other_actor_id = ActorID::Of(JobID::FromInt(0), TaskID::Nil(), i);
+      submitter_.AddActorQueueIfNotExists(other_actor_id, max_pending_calls,
+                                          execute_out_of_order);
+    }
+    ASSERT_TRUE(worker_client_->ReplyPushTask());
+  });
+  ASSERT_TRUE(submitter_.WaitUntilPendingTasksNotFull(actor_id, /*timeout_ms=*/-1));
+  reply_thread.join();
+  ASSERT_TRUE(worker_client_->ReplyPushTask());
+}
+
 INSTANTIATE_TEST_SUITE_P(ExecuteOutOfOrder, DirectActorSubmitterTest,
                          ::testing::Values(true, false));
 
+// A client that records the actor task RPCs instead of sending them.
+class MockBatchingWorkerClient : public rpc::CoreWorkerClient {
+ public:
+  MockBatchingWorkerClient(const rpc::Address &addr,
+                           rpc::ClientCallManager &client_call_manager)
+      : rpc::CoreWorkerClient(addr, client_call_manager) {}
+
+  std::vector<rpc::PushTaskRequest> push_task_requests;
+  std::vector<rpc::ClientCallback<rpc::PushTaskReply>> push_task_callbacks;
+  std::vector<rpc::PushTasksRequest> push_tasks_requests;
+  std::vector<rpc::ClientCallback<rpc::PushTasksReply>> push_tasks_callbacks;
+
+ protected:
+  void InvokePushTask(const rpc::PushTaskRequest &request,
+                      const rpc::ClientCallback<rpc::PushTaskReply> &callback) override {
+    push_task_requests.push_back(request);
+    push_task_callbacks.push_back(callback);
+  }
+
+  void InvokePushTasks(
+      const rpc::PushTasksRequest &request,
+      const rpc::ClientCallback<rpc::PushTasksReply> &callback) override {
+    push_tasks_requests.push_back(request);
+    push_tasks_callbacks.push_back(callback);
+  }
+};
+
+class ActorTaskBatchingTest : public ::testing::Test {
+ public:
+  ActorTaskBatchingTest() : client_call_manager_(io_context_) {
+    RayConfig::instance().initialize(
+        R"({"max_actor_tasks_per_push_task_batch": 3,
+            "actor_task_max_rpcs_in_flight": 2,
+            "push_tasks_batch_repoll_delay_ms": 0})");
+    rpc::Address addr;
+    addr.set_ip_address("127.0.0.1");
+    addr.set_port(1);
+    client_ = std::make_shared<MockBatchingWorkerClient>(addr, client_call_manager_);
+  }
+
+  ~ActorTaskBatchingTest() {
+    RayConfig::instance().initialize(
+        R"({"max_actor_tasks_per_push_task_batch": 1,
+            "actor_task_max_rpcs_in_flight": 16,
+            "push_tasks_batch_repoll_delay_ms": 100})");
+  }
+
+  // Push actor tasks with the given sequence numbers, recording the status each task
+  // is replied to with.
+  void PushTasks(int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      auto request = std::make_unique<rpc::PushTaskRequest>(CreatePushTaskRequestHelper(
+          actor_id_, i, WorkerID::FromRandom(), TaskID::Nil(), 0));
+      client_->PushActorTask(std::move(request), /*skip_queue=*/false,
+                             [this, i](Status status, const rpc::PushTaskReply &reply) {
+                               replied_seq_nos_.push_back(i);
+                               statuses_.push_back(status);
+                             });
+    }
+  }
+
+ protected:
+  instrumented_io_context io_context_;
+  rpc::ClientCallManager client_call_manager_;
+  std::shared_ptr<MockBatchingWorkerClient> client_;
+  ActorID actor_id_ = ActorID::Of(JobID::FromInt(0), TaskID::Nil(), 0);
+  std::vector<int64_t> replied_seq_nos_;
+  std::vector<Status> statuses_;
+};
+
+TEST_F(ActorTaskBatchingTest, TestBatchOrderAndStatuses) {
+  PushTasks(0, 5);
+  // Each task is pushed on its own while the queue is empty, until the cap on RPCs in
+  // flight is reached. The tasks queued behind them are not sent yet.
+  ASSERT_EQ(client_->push_task_requests.size(), 2);
+  ASSERT_TRUE(client_->push_tasks_requests.empty());
+
+  // A reply makes room for one RPC, which carries all of the queued tasks in order.
+  client_->push_task_callbacks[0](Status::OK(), rpc::PushTaskReply());
+  ASSERT_EQ(client_->ClientProcessedUpToSeqno(), 0);
+  ASSERT_EQ(client_->push_tasks_requests.size(), 1);
+  const auto &batch = client_->push_tasks_requests[0];
+  ASSERT_EQ(batch.requests_size(), 3);
+  for (int i = 0; i < batch.requests_size(); i++) {
+    ASSERT_EQ(batch.requests(i).sequence_number(), i + 2);
+    ASSERT_EQ(batch.requests(i).client_processed_up_to(), 0);
+  }
+
+  // Each task gets its own status from the reply to the batch.
+  rpc::PushTasksReply reply;
+  reply.add_replies()->set_index(0);
+  auto *failed_reply = reply.add_replies();
+  failed_reply->set_index(1);
+  failed_reply->set_status_code(static_cast<int32_t>(StatusCode::Invalid));
+  failed_reply->set_status_message("invalid");
+  auto *canceled_reply = reply.add_replies();
+  canceled_reply->set_index(2);
+  canceled_reply->set_task_canceled(true);
+  client_->push_tasks_callbacks[0](Status::OK(), reply);
+  ASSERT_EQ(client_->push_tasks_requests.size(), 1);
+  client_->push_task_callbacks[1](Status::OK(), rpc::PushTaskReply());
+
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 2, 3, 4, 1));
+  ASSERT_TRUE(statuses_[1].ok());
+  ASSERT_TRUE(statuses_[2].IsInvalid());
+  ASSERT_EQ(statuses_[2].message(), "invalid");
+  ASSERT_TRUE(statuses_[3].IsIOError());
+  ASSERT_TRUE(statuses_[4].ok());
+  ASSERT_EQ(client_->ClientProcessedUpToSeqno(), 4);
+}
+
+TEST_F(ActorTaskBatchingTest, TestBatchFailure) {
+  PushTasks(0, 8);
+  client_->push_task_callbacks[0](Status::OK(), rpc::PushTaskReply());
+  client_->push_task_callbacks[1](Status::OK(), rpc::PushTaskReply());
+  ASSERT_EQ(client_->push_tasks_requests.size(), 2);
+  ASSERT_EQ(client_->push_tasks_requests[0].requests_size(), 3);
+  ASSERT_EQ(client_->push_tasks_requests[1].requests_size(), 3);
+
+  // A failed RPC fails all of the tasks in the batch with its status.
+  client_->push_tasks_callbacks[0](Status::IOError("connection lost"),
+                                   rpc::PushTasksReply());
+  // A reply to a task that was replied to already fails the rest of the tasks too.
+  rpc::PushTasksReply reply;
+  reply.add_replies()->set_index(0);
+  reply.add_replies()->set_index(0);
+  client_->push_tasks_callbacks[1](Status::OK(), reply);
+
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2, 3, 4, 5, 6, 7));
+  for (size_t i = 2; i < statuses_.size(); i++) {
+    ASSERT_TRUE(statuses_[i].IsIOError());
+  }
+  ASSERT_EQ(statuses_[2].message(), "connection lost");
+}
+
+TEST_F(ActorTaskBatchingTest, TestBatchRepliesAreStreamed) {
+  PushTasks(0, 5);
+  client_->push_task_callbacks[0](Status::OK(), rpc::PushTaskReply());
+  client_->push_task_callbacks[1](Status::OK(), rpc::PushTaskReply());
+  ASSERT_EQ(client_->push_tasks_requests.size(), 1);
+  ASSERT_EQ(client_->push_tasks_requests[0].requests_size(), 3);
+
+  // The first task of the batch is replied to on its own, and the rest of the replies
+  // are waited for with another request.
+  rpc::PushTasksReply reply;
+  reply.set_batch_id(7);
+  reply.add_replies()->set_index(0);
+  client_->push_tasks_callbacks[0](Status::OK(), reply);
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2));
+  ASSERT_EQ(client_->push_tasks_requests.size(), 2);
+  ASSERT_EQ(client_->push_tasks_requests[1].batch_id(), 7);
+  ASSERT_EQ(client_->push_tasks_requests[1].requests_size(), 0);
+  // The batch is in flight until all of its tasks are replied to.
+  ASSERT_EQ(client_->ClientProcessedUpToSeqno(), 1);
+
+  reply.clear_replies();
+  reply.add_replies()->set_index(2);
+  reply.add_replies()->set_index(1);
+  client_->push_tasks_callbacks[1](Status::OK(), reply);
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2, 4, 3));
+  ASSERT_EQ(client_->push_tasks_requests.size(), 2);
+  ASSERT_EQ(client_->ClientProcessedUpToSeqno(), 4);
+  for (const auto &status : statuses_) {
+    ASSERT_TRUE(status.ok());
+  }
+}
+
+TEST_F(ActorTaskBatchingTest, TestBatchPollIsRetried) {
+  PushTasks(0, 5);
+  client_->push_task_callbacks[0](Status::OK(), rpc::PushTaskReply());
+  client_->push_task_callbacks[1](Status::OK(), rpc::PushTaskReply());
+  rpc::PushTasksReply reply;
+  reply.set_batch_id(7);
+  reply.add_replies()->set_index(0);
+  client_->push_tasks_callbacks[0](Status::OK(), reply);
+  ASSERT_EQ(client_->push_tasks_requests.size(), 2);
+
+  // A failed request for more replies doesn't fail the tasks, which may still run at
+  // the actor. The same batch is asked for again.
+  client_->push_tasks_callbacks[1](Status::IOError("connection lost"),
+                                   rpc::PushTasksReply());
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2));
+  ASSERT_EQ(client_->push_tasks_requests.size(), 2);
+  io_context_.poll();
+  ASSERT_EQ(client_->push_tasks_requests.size(), 3);
+  ASSERT_EQ(client_->push_tasks_requests[2].batch_id(), 7);
+  ASSERT_EQ(client_->push_tasks_requests[2].requests_size(), 0);
+
+  reply.clear_replies();
+  reply.add_replies()->set_index(1);
+  client_->push_tasks_callbacks[2](Status::OK(), reply);
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2, 3));
+  ASSERT_EQ(client_->push_tasks_requests.size(), 4);
+
+  // The tasks fail once the actor reports the batch as unknown.
+  client_->push_tasks_callbacks[3](Status::Invalid("Unknown batch of pushed tasks"),
+                                   rpc::PushTasksReply());
+  io_context_.poll();
+  ASSERT_EQ(client_->push_tasks_requests.size(), 4);
+  ASSERT_THAT(replied_seq_nos_, ElementsAre(0, 1, 2, 3, 4));
+  for (size_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(statuses_[i].ok());
+  }
+  ASSERT_TRUE(statuses_[4].IsInvalid());
+  ASSERT_EQ(client_->ClientProcessedUpToSeqno(), 4);
+}
+
 class MockDependencyWaiter : public DependencyWaiter {
  public:
   MOCK_METHOD2(Wait, void(const std::vector<rpc::ObjectReference> &dependencies,
@@ -14,6 +14,8 @@
 
 #include "ray/core_worker/transport/direct_task_transport.h"
 
+#include <algorithm>
+
 #include "gtest/gtest.h"
 #include "ray/common/task/task_spec.h"
 #include "ray/common/task/task_util.h"
@@ -49,9 +51,23 @@ class MockWorkerClient : public rpc::CoreWorkerClientInterface {
  public:
   void PushNormalTask(std::unique_ptr<rpc::PushTaskRequest> request,
                       const rpc::ClientCallback<rpc::PushTaskReply> &callback) override {
+    // Keep the pushed spec as the worker parses it, and the bytes it was sent as.
+    rpc::PushTaskRequest received;
+    RAY_CHECK(received.ParseFromString(request->SerializeAsString()));
+    pushed_task_specs.push_back(received.task_spec());
+    RAY_CHECK(request->unknown_fields().field_count() == 1);
+    pushed_task_spec_bytes.push_back(request->unknown_fields().field(0).length_delimited());
     callbacks.push_back(callback);
   }
 
+  void PushNormalTasks(
+      std::unique_ptr<rpc::PushTasksRequest> request,
+      const rpc::ClientCallback<rpc::PushTasksReply> &callback) override {
+    batch_sizes.push_back(request->requests_size());
+    batch_num_replied.push_back(0);
+    batch_callbacks.push_back(callback);
+  }
+
   void StealTasks(const rpc::StealTasksRequest &request,
                   const rpc::ClientCallback<rpc::StealTasksReply> &callback) override {
     steal_callbacks.push_back(callback);
@@ -96,12 +112,44 @@ class MockWorkerClient : public rpc::CoreWorkerClientInterface {
     return true;
   }
 
+  // Reply to the next tasks of the oldest batch of pushed tasks, or to all of the rest
+  // if num_replies is -1. The tasks at the canceled indices are replied to as canceled.
+  bool ReplyPushTasks(Status status = Status::OK(),
+                      const std::vector<int> &canceled_indices = {},
+                      int num_replies = -1) {
+    if (batch_callbacks.size() == 0) {
+      return false;
+    }
+    auto callback = batch_callbacks.front();
+    auto reply = rpc::PushTasksReply();
+    int &num_replied = batch_num_replied.front();
+    const int end = num_replies == -1 ? batch_sizes.front() : num_replied + num_replies;
+    for (; status.ok() && num_replied < end; num_replied++) {
+      auto task_reply = reply.add_replies();
+      task_reply->set_index(num_replied);
+      task_reply->set_task_canceled(
+          std::count(canceled_indices.begin(), canceled_indices.end(), num_replied) > 0);
+    }
+    if (!status.ok() || num_replied == batch_sizes.front()) {
+      batch_callbacks.pop_front();
+      batch_sizes.pop_front();
+      batch_num_replied.pop_front();
+    }
+    callback(status, reply);
+    return true;
+  }
+
   void CancelTask(const rpc::CancelTaskRequest &request,
                   const rpc::ClientCallback<rpc::CancelTaskReply> &callback) override {
     kill_requests.push_front(request);
   }
 
   std::list<rpc::ClientCallback<rpc::PushTaskReply>> callbacks;
+  std::vector<rpc::TaskSpec> pushed_task_specs;
+  std::vector<std::string> pushed_task_spec_bytes;
+  std::list<rpc::ClientCallback<rpc::PushTasksReply>> batch_callbacks;
+  std::list<int> batch_sizes;
+  std::list<int> batch_num_replied;
   std::list<rpc::ClientCallback<rpc::StealTasksReply>> steal_callbacks;
   std::list<rpc::CancelTaskRequest> kill_requests;
 };
@@ -172,6 +220,15 @@ class MockRayletClient : public WorkerLeaseInterface {
     return Status::OK();
   }
 
+  Status ReturnWorkers(const std::vector<std::pair<int, WorkerID>> &workers,
+                       bool disconnect_worker) override {
+    num_return_workers_requests++;
+    for (const auto &worker : workers) {
+      RAY_CHECK_OK(ReturnWorker(worker.first, worker.second, disconnect_worker));
+    }
+    return Status::OK();
+  }
+
   void ReportWorkerBacklog(
       const WorkerID &worker_id,
       const std::vector<rpc::WorkerBacklogReport> &backlog_reports) override {
@@ -193,6 +250,7 @@ class MockRayletClient : public WorkerLeaseInterface {
     if (grant_or_reject) {
       num_grant_or_reject_leases_requested += 1;
     }
+    lease_specs.push_back(resource_spec.GetMessage());
     callbacks.push_back(callback);
   }
 
@@ -204,6 +262,20 @@ class MockRayletClient : public WorkerLeaseInterface {
     callbacks.push_back(callback);
   }
 
+  void RequestWorkerLeases(
+      const TaskSpecification &resource_spec, bool grant_or_reject, int64_t max_leases,
+      const rpc::ClientCallback<rpc::RequestWorkerLeaseReply> &callback,
+      const int64_t backlog_size, uint64_t reservation_token) override {
+    num_workers_requested += 1;
+    if (grant_or_reject) {
+      num_grant_or_reject_leases_requested += 1;
+    }
+    max_leases_requested.push_back(max_leases);
+    reservation_tokens.push_back(reservation_token);
+    lease_specs.push_back(resource_spec.GetMessage());
+    callbacks.push_back(callback);
+  }
+
   void ReleaseUnusedWorkers(
       const std::vector<WorkerID> &workers_in_use,
       const rpc::ClientCallback<rpc::ReleaseUnusedWorkersReply> &callback) override {}
@@ -220,7 +292,8 @@ class MockRayletClient : public WorkerLeaseInterface {
       const std::string &address, int port, const NodeID &retry_at_raylet_id,
       bool cancel = false, std::string worker_id = std::string(), bool reject = false,
       const rpc::RequestWorkerLeaseReply::SchedulingFailureType &failure_type =
-          rpc::RequestWorkerLeaseReply::SCHEDULING_CANCELLED_INTENDED) {
+          rpc::RequestWorkerLeaseReply::SCHEDULING_CANCELLED_INTENDED,
+      uint64_t reservation_token = 0) {
     rpc::RequestWorkerLeaseReply reply;
     if (cancel) {
       reply.set_canceled(true);
@@ -231,6 +304,7 @@ class MockRayletClient : public WorkerLeaseInterface {
       reply.mutable_retry_at_raylet_address()->set_ip_address(address);
       reply.mutable_retry_at_raylet_address()->set_port(port);
       reply.mutable_retry_at_raylet_address()->set_raylet_id(retry_at_raylet_id.Binary());
+      reply.set_reservation_token(reservation_token);
     } else {
       reply.mutable_worker_address()->set_ip_address(address);
       reply.mutable_worker_address()->set_port(port);
@@ -251,6 +325,32 @@ class MockRayletClient : public WorkerLeaseInterface {
     }
   }
 
+  // Trigger a reply to RequestWorkerLeases that grants a worker at each of the ports.
+  bool GrantWorkerLeases(const std::string &address, const std::vector<int> &ports,
+                         const NodeID &raylet_id) {
+    rpc::RequestWorkerLeaseReply reply;
+    for (size_t i = 0; i < ports.size(); i++) {
+      rpc::Address *worker_address;
+      if (i == 0) {
+        worker_address = reply.mutable_worker_address();
+      } else {
+        worker_address = reply.add_additional_leases()->mutable_worker_address();
+      }
+      worker_address->set_ip_address(address);
+      worker_address->set_port(ports[i]);
+      worker_address->set_raylet_id(raylet_id.Binary());
+      worker_address->set_worker_id(WorkerID::FromRandom().Binary());
+    }
+    if (callbacks.size() == 0) {
+      return false;
+    } else {
+      auto callback = callbacks.front();
+      callback(Status::OK(), reply);
+      callbacks.pop_front();
+      return true;
+    }
+  }
+
   bool FailWorkerLeaseDueToGrpcUnavailable() {
     rpc::RequestWorkerLeaseReply reply;
     if (callbacks.size() == 0) {
@@ -281,6 +381,10 @@ class MockRayletClient : public WorkerLeaseInterface {
   int num_grant_or_reject_leases_requested = 0;
   int num_workers_requested = 0;
   int num_workers_returned = 0;
+  int num_return_workers_requests = 0;
+  std::vector<int64_t> max_leases_requested;
+  std::vector<uint64_t> reservation_tokens;
+  std::vector<rpc::TaskSpec> lease_specs;
   int num_workers_disconnected = 0;
   int num_leases_canceled = 0;
   int reported_backlog_size = 0;
@@ -908,6 +1012,150 @@ TEST(DirectTaskTransportTest, TestSubmitMultipleTasks) {
   ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
 }
 
+TEST(DirectTaskTransportTest, TestLeaseSpecWithoutInlinedArgs) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(), 1,
+      absl::nullopt, 1);
+
+  // Tasks with a large arg passed by value.
+  const std::string data(1024 * 1024, 'x');
+  std::vector<TaskSpecification> tasks;
+  for (int i = 0; i < 2; i++) {
+    tasks.push_back(BuildEmptyTaskSpec());
+    tasks.back().GetMutableMessage().add_args()->set_data(data);
+    ASSERT_TRUE(submitter.SubmitTask(tasks.back()).ok());
+  }
+  ASSERT_EQ(raylet_client->num_workers_requested, 1);
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+
+  // The lease requests carry the args without their data, and a new task ID each
+  // time.
+  ASSERT_EQ(raylet_client->lease_specs.size(), 2);
+  for (const auto &lease_spec : raylet_client->lease_specs) {
+    ASSERT_EQ(lease_spec.args_size(), 1);
+    ASSERT_TRUE(lease_spec.args(0).data().empty());
+  }
+  ASSERT_NE(raylet_client->lease_specs[0].task_id(),
+            raylet_client->lease_specs[1].task_id());
+  // The specs of the tasks themselves are untouched.
+  for (const auto &task : tasks) {
+    ASSERT_EQ(task.GetMessage().args(0).data(), data);
+  }
+
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1001, NodeID::Nil()));
+  while (!worker_client->callbacks.empty()) {
+    ASSERT_TRUE(worker_client->ReplyPushTask());
+  }
+  ASSERT_EQ(task_finisher->num_tasks_complete, 2);
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
+TEST(DirectTaskTransportTest, TestLeaseSpecFollowsPlacementChanges) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(), 1,
+      absl::nullopt, 1);
+
+  // Two tasks of the same scheduling key, the second one in a placement group.
+  const auto placement_group_id = PlacementGroupID::FromRandom();
+  TaskSpecification task1 = BuildEmptyTaskSpec();
+  TaskSpecification task2 = BuildEmptyTaskSpec();
+  task2.GetMutableMessage()
+      .mutable_scheduling_strategy()
+      ->mutable_placement_group_scheduling_strategy()
+      ->set_placement_group_id(placement_group_id.Binary());
+  ASSERT_TRUE(submitter.SubmitTask(task1).ok());
+  ASSERT_TRUE(submitter.SubmitTask(task2).ok());
+  ASSERT_EQ(raylet_client->num_workers_requested, 1);
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+
+  // The second lease request carries the placement group of the second task.
+  ASSERT_EQ(raylet_client->lease_specs.size(), 2);
+  ASSERT_FALSE(raylet_client->lease_specs[0]
+                   .scheduling_strategy()
+                   .has_placement_group_scheduling_strategy());
+  ASSERT_EQ(raylet_client->lease_specs[1]
+                .scheduling_strategy()
+                .placement_group_scheduling_strategy()
+                .placement_group_id(),
+            placement_group_id.Binary());
+
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1001, NodeID::Nil()));
+  while (!worker_client->callbacks.empty()) {
+    ASSERT_TRUE(worker_client->ReplyPushTask());
+  }
+  ASSERT_EQ(task_finisher->num_tasks_complete, 2);
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
+TEST(DirectTaskTransportTest, TestRetryReusesSerializedTaskSpec) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(), 1,
+      absl::nullopt, 1);
+
+  // The task manager keeps a copy of the spec, which is what it retries.
+  TaskSpecification task = BuildEmptyTaskSpec();
+  task.GetMutableMessage().add_args()->set_data(std::string(1024, 'x'));
+  const TaskSpecification retried_task = task;
+  ASSERT_TRUE(submitter.SubmitTask(task).ok());
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(worker_client->pushed_task_specs.size(), 1);
+  ASSERT_EQ(worker_client->pushed_task_specs[0].task_id(), task.TaskId().Binary());
+  ASSERT_EQ(worker_client->pushed_task_specs[0].args(0).data(), std::string(1024, 'x'));
+  ASSERT_TRUE(worker_client->ReplyPushTask(Status::IOError("worker dead")));
+
+  // The retry is pushed as the bytes cached by the first push, with only the new attempt
+  // number appended to them.
+  TaskSpecification retry = retried_task;
+  retry.SetAttemptNumber(1);
+  ASSERT_TRUE(submitter.SubmitTask(retry).ok());
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1001, NodeID::Nil()));
+  ASSERT_EQ(worker_client->pushed_task_specs.size(), 2);
+  const auto &first_bytes = worker_client->pushed_task_spec_bytes[0];
+  const auto &retry_bytes = worker_client->pushed_task_spec_bytes[1];
+  ASSERT_GT(retry_bytes.size(), first_bytes.size());
+  ASSERT_LT(retry_bytes.size(), first_bytes.size() + 8);
+  ASSERT_EQ(retry_bytes.compare(0, first_bytes.size(), first_bytes), 0);
+  ASSERT_EQ(worker_client->pushed_task_specs[1].attempt_number(), 1);
+  ASSERT_EQ(worker_client->pushed_task_specs[1].task_id(), task.TaskId().Binary());
+  ASSERT_EQ(worker_client->pushed_task_specs[1].args(0).data(), std::string(1024, 'x'));
+
+  ASSERT_TRUE(worker_client->ReplyPushTask());
+  ASSERT_EQ(task_finisher->num_tasks_complete, 1);
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
 TEST(DirectTaskTransportTest, TestReuseWorkerLease) {
   rpc::Address address;
   auto raylet_client = std::make_shared<MockRayletClient>();
@@ -1233,6 +1481,54 @@ TEST(DirectTaskTransportTest, TestSpillback) {
   ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
 }
 
+TEST(DirectTaskTransportTest, TestSpillbackReservationToken) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+
+  std::unordered_map<int, std::shared_ptr<MockRayletClient>> remote_lease_clients;
+  auto lease_client_factory = [&](const std::string &ip, int port) {
+    auto client = std::make_shared<MockRayletClient>();
+    remote_lease_clients[port] = client;
+    return client;
+  };
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, lease_client_factory, lease_policy, store,
+      task_finisher, NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator,
+      JobID::Nil());
+  TaskSpecification task = BuildEmptyTaskSpec();
+  ASSERT_TRUE(submitter.SubmitTask(task).ok());
+
+  // The local raylet spills the request back and reserves the remote node's resources.
+  auto remote_raylet_id = NodeID::FromRandom();
+  ASSERT_TRUE(raylet_client->GrantWorkerLease(
+      "localhost", 7777, remote_raylet_id, false, "", false,
+      rpc::RequestWorkerLeaseReply::SCHEDULING_CANCELLED_INTENDED,
+      /*reservation_token=*/42));
+  // The token is passed on to the remote raylet.
+  ASSERT_EQ(remote_lease_clients[7777]->num_grant_or_reject_leases_requested, 1);
+  ASSERT_EQ(remote_lease_clients[7777]->reservation_tokens,
+            std::vector<uint64_t>({42}));
+  ASSERT_EQ(remote_lease_clients[7777]->max_leases_requested,
+            std::vector<int64_t>({1}));
+
+  // After a rejection, the retry at the local raylet doesn't carry the token.
+  ASSERT_TRUE(remote_lease_clients[7777]->GrantWorkerLease("local", 1234, NodeID::Nil(),
+                                                           false, "", /*reject=*/true));
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+  ASSERT_TRUE(raylet_client->reservation_tokens.empty());
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("local", 1234, NodeID::Nil()));
+  ASSERT_TRUE(worker_client->ReplyPushTask());
+  ASSERT_EQ(task_finisher->num_tasks_complete, 1);
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
 TEST(DirectTaskTransportTest, TestSpillbackRoundTrip) {
   rpc::Address address;
   auto raylet_client = std::make_shared<MockRayletClient>();
@@ -1761,6 +2057,214 @@ TEST(DirectTaskTransportTest, TestPipeliningConcurrentWorkerLeases) {
   ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
 }
 
+TEST(DirectTaskTransportTest, TestMultipleLeasesPerRequest) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(), 1,
+      absl::nullopt, /*max_pending_lease_requests_per_scheduling_category=*/1,
+      /*max_leases_per_lease_request=*/4);
+
+  for (int i = 0; i < 6; i++) {
+    ASSERT_TRUE(submitter.SubmitTask(BuildEmptyTaskSpec()).ok());
+  }
+  ASSERT_EQ(raylet_client->num_workers_requested, 1);
+  ASSERT_TRUE(raylet_client->max_leases_requested.empty());
+
+  // The first task is pushed. One request asks for workers for 4 of the 5 queued tasks.
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(worker_client->callbacks.size(), 1);
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+  ASSERT_EQ(raylet_client->max_leases_requested, std::vector<int64_t>({4}));
+
+  // The raylet grants 3 of the 4 workers in one reply. 3 more tasks are pushed and the
+  // remaining 2 queued tasks are requested in one request.
+  ASSERT_TRUE(raylet_client->GrantWorkerLeases("localhost", {1001, 1002, 1003},
+                                               NodeID::Nil()));
+  ASSERT_EQ(worker_client->callbacks.size(), 4);
+  ASSERT_EQ(raylet_client->num_workers_requested, 3);
+  ASSERT_EQ(raylet_client->max_leases_requested, std::vector<int64_t>({4, 2}));
+
+  // The last 2 tasks reuse the first 2 workers to finish. The other 2 workers are
+  // returned and the pending lease request is canceled.
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(worker_client->ReplyPushTask());
+  }
+  ASSERT_EQ(worker_client->callbacks.size(), 2);
+  ASSERT_EQ(raylet_client->num_workers_returned, 2);
+  ASSERT_EQ(raylet_client->num_leases_canceled, 1);
+
+  // The lease request is granted before the raylet processes the cancellation. Both
+  // workers are unused; the additional one is returned in a single batched request.
+  ASSERT_TRUE(raylet_client->GrantWorkerLeases("localhost", {1004, 1005},
+                                               NodeID::Nil()));
+  ASSERT_EQ(raylet_client->num_workers_returned, 4);
+  ASSERT_EQ(raylet_client->num_return_workers_requests, 1);
+
+  while (!worker_client->callbacks.empty()) {
+    ASSERT_TRUE(worker_client->ReplyPushTask());
+  }
+  ASSERT_EQ(raylet_client->num_workers_returned, 6);
+  ASSERT_EQ(raylet_client->num_workers_requested, 3);
+  ASSERT_EQ(raylet_client->num_workers_disconnected, 0);
+  ASSERT_EQ(task_finisher->num_tasks_complete, 6);
+  ASSERT_EQ(task_finisher->num_tasks_failed, 0);
+
+  // Check that there are no entries left in the scheduling_key_entries_ hashmap. These
+  // would otherwise cause a memory leak.
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
+TEST(DirectTaskTransportTest, TestPushTaskBatches) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(),
+      /*max_tasks_in_flight_per_worker=*/4, absl::nullopt,
+      /*max_pending_lease_requests_per_scheduling_category=*/1,
+      /*max_leases_per_lease_request=*/1, /*max_tasks_per_push_task_batch=*/4);
+
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(submitter.SubmitTask(BuildEmptyTaskSpec()).ok());
+  }
+  ASSERT_EQ(raylet_client->num_workers_requested, 1);
+
+  // The first 4 tasks are pushed in one batch. Another worker is requested for the
+  // last task.
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(worker_client->batch_sizes, std::list<int>({4}));
+  ASSERT_TRUE(worker_client->callbacks.empty());
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+
+  // The second task of the batch is canceled at the worker. The last task is pushed
+  // on its own to the same worker.
+  ASSERT_TRUE(worker_client->ReplyPushTasks(Status::OK(), {1}));
+  ASSERT_EQ(task_finisher->num_tasks_complete, 3);
+  ASSERT_EQ(task_finisher->num_tasks_failed, 1);
+  ASSERT_EQ(worker_client->callbacks.size(), 1);
+  ASSERT_TRUE(worker_client->batch_callbacks.empty());
+
+  ASSERT_TRUE(worker_client->ReplyPushTask());
+  ASSERT_EQ(task_finisher->num_tasks_complete, 4);
+  ASSERT_EQ(raylet_client->num_workers_returned, 1);
+  ASSERT_EQ(raylet_client->num_leases_canceled, 1);
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("nil", 0, NodeID::Nil(), /*cancel=*/true));
+
+  ASSERT_EQ(raylet_client->num_workers_disconnected, 0);
+  ASSERT_EQ(task_finisher->num_tasks_failed, 1);
+
+  // Check that there are no entries left in the scheduling_key_entries_ hashmap. These
+  // would otherwise cause a memory leak.
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
+TEST(DirectTaskTransportTest, TestPushTaskBatchStreamsReplies) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(),
+      /*max_tasks_in_flight_per_worker=*/4, absl::nullopt,
+      /*max_pending_lease_requests_per_scheduling_category=*/1,
+      /*max_leases_per_lease_request=*/1, /*max_tasks_per_push_task_batch=*/4);
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(submitter.SubmitTask(BuildEmptyTaskSpec()).ok());
+  }
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(worker_client->batch_sizes, std::list<int>({4}));
+
+  // The first task of the batch finishes before the others. It is completed right
+  // away, and its room in the pipeline is used by a new task.
+  ASSERT_TRUE(worker_client->ReplyPushTasks(Status::OK(), {}, /*num_replies=*/1));
+  ASSERT_EQ(task_finisher->num_tasks_complete, 1);
+  ASSERT_EQ(worker_client->batch_callbacks.size(), 1);
+  ASSERT_TRUE(submitter.SubmitTask(BuildEmptyTaskSpec()).ok());
+  ASSERT_EQ(worker_client->callbacks.size(), 1);
+
+  // The worker is kept until all of the tasks in flight have finished.
+  ASSERT_TRUE(worker_client->ReplyPushTasks(Status::OK(), {}, /*num_replies=*/2));
+  ASSERT_EQ(task_finisher->num_tasks_complete, 3);
+  ASSERT_TRUE(worker_client->ReplyPushTask());
+  ASSERT_EQ(task_finisher->num_tasks_complete, 4);
+  ASSERT_EQ(raylet_client->num_workers_returned, 0);
+
+  // The RPC fails before the last task of the batch is replied to.
+  ASSERT_TRUE(worker_client->ReplyPushTasks(Status::IOError("worker dead")));
+  ASSERT_TRUE(worker_client->batch_callbacks.empty());
+  ASSERT_EQ(task_finisher->num_tasks_complete, 4);
+  ASSERT_EQ(task_finisher->num_tasks_failed, 1);
+  ASSERT_EQ(raylet_client->num_workers_disconnected, 1);
+  ASSERT_EQ(raylet_client->num_workers_requested, 1);
+
+  // Check that there are no entries left in the scheduling_key_entries_ hashmap. These
+  // would otherwise cause a memory leak.
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
+TEST(DirectTaskTransportTest, TestFailedPushTaskBatch) {
+  rpc::Address address;
+  auto raylet_client = std::make_shared<MockRayletClient>();
+  auto worker_client = std::make_shared<MockWorkerClient>();
+  auto store = std::make_shared<CoreWorkerMemoryStore>();
+  auto client_pool = std::make_shared<rpc::CoreWorkerClientPool>(
+      [&](const rpc::Address &addr) { return worker_client; });
+  auto task_finisher = std::make_shared<MockTaskFinisher>();
+  auto actor_creator = std::make_shared<MockActorCreator>();
+  auto lease_policy = std::make_shared<MockLeasePolicy>();
+  CoreWorkerDirectTaskSubmitter submitter(
+      address, raylet_client, client_pool, nullptr, lease_policy, store, task_finisher,
+      NodeID::Nil(), WorkerType::WORKER, kLongTimeout, actor_creator, JobID::Nil(),
+      /*max_tasks_in_flight_per_worker=*/4, absl::nullopt,
+      /*max_pending_lease_requests_per_scheduling_category=*/1,
+      /*max_leases_per_lease_request=*/1, /*max_tasks_per_push_task_batch=*/4);
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(submitter.SubmitTask(BuildEmptyTaskSpec()).ok());
+  }
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1000, NodeID::Nil()));
+  ASSERT_EQ(worker_client->batch_sizes, std::list<int>({3}));
+
+  // All of the tasks in the batch fail, and the worker is not reused.
+  ASSERT_TRUE(worker_client->ReplyPushTasks(Status::IOError("worker dead")));
+  ASSERT_EQ(task_finisher->num_tasks_complete, 0);
+  ASSERT_EQ(task_finisher->num_tasks_failed, 3);
+  ASSERT_EQ(raylet_client->num_workers_returned, 0);
+  ASSERT_EQ(raylet_client->num_workers_disconnected, 1);
+
+  // The worker requested while the batch was in flight is not needed anymore.
+  ASSERT_EQ(raylet_client->num_workers_requested, 2);
+  ASSERT_TRUE(raylet_client->GrantWorkerLease("localhost", 1001, NodeID::Nil()));
+  ASSERT_EQ(raylet_client->num_workers_returned, 1);
+
+  // Check that there are no entries left in the scheduling_key_entries_ hashmap. These
+  // would otherwise cause a memory leak.
+  ASSERT_TRUE(submitter.CheckNoSchedulingKeyEntriesPublic());
+}
+
 TEST(DirectTaskTransportTest, TestPipeliningReuseWorkerLease) {
   rpc::Address address;
   auto raylet_client = std::make_shared<MockRayletClient>();
@@ -0,0 +1,233 @@
+// Copyright 2017 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/core_worker/future_resolver.h"
+
+#include "gtest/gtest.h"
+#include "ray/common/test_util.h"
+#include "ray/core_worker/store_provider/memory_store/memory_store.h"
+
+namespace ray {
+namespace core {
+
+class MockWorkerClient : public rpc::CoreWorkerClientInterface {
+ public:
+  void GetObjectStatus(
+      const rpc::GetObjectStatusRequest &request,
+      const rpc::ClientCallback<rpc::GetObjectStatusReply> &callback) override {
+    callbacks.push_back(callback);
+  }
+
+  void GetObjectStatuses(
+      const rpc::GetObjectStatusesRequest &request,
+      const rpc::ClientCallback<rpc::GetObjectStatusesReply> &callback) override {
+    batch_requests.push_back(request);
+    batch_callbacks.push_back(callback);
+  }
+
+  // Reply to the oldest batch request. Only the objects for which `ready` returns
+  // true are included in the reply.
+  bool ReplyGetObjectStatuses(std::function<bool(const ObjectID &)> ready,
+                              Status status = Status::OK()) {
+    if (batch_callbacks.empty()) {
+      return false;
+    }
+    auto request = batch_requests.front();
+    auto callback = batch_callbacks.front();
+    batch_requests.pop_front();
+    batch_callbacks.pop_front();
+    rpc::GetObjectStatusesReply reply;
+    for (const auto &object_id_binary : request.object_ids()) {
+      if (ready(ObjectID::FromBinary(object_id_binary))) {
+        reply.add_object_ids(object_id_binary);
+        auto *object_status = reply.add_statuses();
+        object_status->set_status(rpc::GetObjectStatusReply::CREATED);
+        object_status->mutable_object()->set_data("value");
+      }
+    }
+    callback(status, reply);
+    return true;
+  }
+
+  bool ReplyGetObjectStatus() {
+    if (callbacks.empty()) {
+      return false;
+    }
+    auto callback = callbacks.front();
+    callbacks.pop_front();
+    rpc::GetObjectStatusReply reply;
+    reply.set_status(rpc::GetObjectStatusReply::CREATED);
+    reply.mutable_object()->set_data("value");
+    callback(Status::OK(), reply);
+    return true;
+  }
+
+  std::list<rpc::ClientCallback<rpc::GetObjectStatusReply>> callbacks;
+  std::list<rpc::GetObjectStatusesRequest> batch_requests;
+  std::list<rpc::ClientCallback<rpc::GetObjectStatusesReply>> batch_callbacks;
+};
+
+class FutureResolverTest : public ::testing::Test {
+ public:
+  FutureResolverTest()
+      : store_(std::make_shared<CoreWorkerMemoryStore>()),
+        worker_client_(std::make_shared<MockWorkerClient>()),
+        client_pool_(std::make_shared<rpc::CoreWorkerClientPool>(
+            [&](const rpc::Address &addr) { return worker_client_; })) {
+    owner_address_.set_worker_id(WorkerID::FromRandom().Binary());
+    rpc_address_.set_worker_id(WorkerID::FromRandom().Binary());
+  }
+
+  std::unique_ptr<FutureResolver> MakeResolver(uint64_t batch_window_ms,
+                                               size_t max_batch_size) {
+    return std::make_unique<FutureResolver>(
+        store_, nullptr,
+        [](const ObjectID &, const absl::flat_hash_set<NodeID> &, uint64_t) {},
+        client_pool_, rpc_address_, io_service_, batch_window_ms, max_batch_size);
+  }
+
+  // Run the handler of the next timer, which flushes the pending batches.
+  void RunTimer() {
+    io_service_.restart();
+    io_service_.run_one();
+  }
+
+  bool IsResolved(const ObjectID &object_id) {
+    return store_->GetIfExists(object_id) != nullptr;
+  }
+
+  instrumented_io_context io_service_;
+  std::shared_ptr<CoreWorkerMemoryStore> store_;
+  std::shared_ptr<MockWorkerClient> worker_client_;
+  std::shared_ptr<rpc::CoreWorkerClientPool> client_pool_;
+  rpc::Address owner_address_;
+  rpc::Address rpc_address_;
+};
+
+TEST_F(FutureResolverTest, TestBatchedObjectStatus) {
+  auto resolver = MakeResolver(/*batch_window_ms=*/1, /*max_batch_size=*/100);
+  std::vector<ObjectID> object_ids;
+  for (int i = 0; i < 3; i++) {
+    object_ids.push_back(ObjectID::FromRandom());
+    resolver->ResolveFutureAsync(object_ids.back(), owner_address_);
+  }
+  // The requests are sent together once the window has passed.
+  ASSERT_TRUE(worker_client_->batch_requests.empty());
+  RunTimer();
+  ASSERT_EQ(worker_client_->batch_requests.size(), 1);
+  ASSERT_EQ(worker_client_->batch_requests.front().object_ids_size(), 3);
+  ASSERT_EQ(worker_client_->batch_requests.front().owner_worker_id(),
+            owner_address_.worker_id());
+
+  // The owner replies with the objects that are ready so far. The remaining object is
+  // asked for again.
+  ASSERT_TRUE(worker_client_->ReplyGetObjectStatuses(
+      [&](const ObjectID &object_id) { return object_id != object_ids[2]; }));
+  ASSERT_TRUE(IsResolved(object_ids[0]));
+  ASSERT_TRUE(IsResolved(object_ids[1]));
+  ASSERT_FALSE(IsResolved(object_ids[2]));
+  ASSERT_EQ(worker_client_->batch_requests.size(), 1);
+  ASSERT_EQ(worker_client_->batch_requests.front().object_ids_size(), 1);
+
+  ASSERT_TRUE(worker_client_->ReplyGetObjectStatuses(
+      [](const ObjectID &object_id) { return true; }));
+  ASSERT_TRUE(IsResolved(object_ids[2]));
+  ASSERT_TRUE(worker_client_->batch_requests.empty());
+  ASSERT_TRUE(worker_client_->callbacks.empty());
+}
+
+TEST_F(FutureResolverTest, TestBatchedObjectStatusMaxBatchSize) {
+  auto resolver = MakeResolver(/*batch_window_ms=*/1, /*max_batch_size=*/2);
+  for (int i = 0; i < 5; i++) {
+    resolver->ResolveFutureAsync(ObjectID::FromRandom(), owner_address_);
+  }
+  // Full batches are sent right away.
+  ASSERT_EQ(worker_client_->batch_requests.size(), 2);
+  RunTimer();
+  RunTimer();
+  ASSERT_EQ(worker_client_->batch_requests.size(), 3);
+  ASSERT_EQ(worker_client_->batch_requests.back().object_ids_size(), 1);
+}
+
+TEST_F(FutureResolverTest, TestBatchedObjectStatusOwnerDied) {
+  auto resolver = MakeResolver(/*batch_window_ms=*/1, /*max_batch_size=*/100);
+  std::vector<ObjectID> object_ids;
+  for (int i = 0; i < 3; i++) {
+    object_ids.push_back(ObjectID::FromRandom());
+    resolver->ResolveFutureAsync(object_ids.back(), owner_address_);
+  }
+  RunTimer();
+  ASSERT_TRUE(worker_client_->ReplyGetObjectStatuses(
+      [](const ObjectID &object_id) { return false; },
+      Status::IOError("owner died")));
+  // All of the objects are resolved with an error and not asked for again.
+  for (const auto &object_id : object_ids) {
+    auto object = store_->GetIfExists(object_id);
+    ASSERT_TRUE(object != nullptr);
+    rpc::ErrorType error_type;
+    ASSERT_TRUE(object->IsException(&error_type));
+    ASSERT_EQ(error_type, rpc::ErrorType::OWNER_DIED);
+  }
+  ASSERT_TRUE(worker_client_->batch_requests.empty());
+}
+
+TEST_F(FutureResolverTest, TestFanIn) {
+  // A task that receives many refs owned by the same worker, with the objects becoming
+  // ready over time.
+  const int num_objects = 5000;
+  for (bool batched : {false, true}) {
+    auto resolver = MakeResolver(/*batch_window_ms=*/batched ? 1 : 0,
+                                 /*max_batch_size=*/500);
+    std::vector<ObjectID> object_ids;
+    for (int i = 0; i < num_objects; i++) {
+      object_ids.push_back(ObjectID::FromRandom());
+    }
+
+    int num_rpcs = 0;
+    for (const auto &object_id : object_ids) {
+      resolver->ResolveFutureAsync(object_id, owner_address_);
+    }
+    if (batched) {
+      RunTimer();
+      // Each reply carries every other object of its request.
+      int num_replies = 0;
+      while (worker_client_->ReplyGetObjectStatuses([&](const ObjectID &object_id) {
+        return num_replies % 2 == 1 || object_id.Hash() % 2 == 0;
+      })) {
+        num_replies++;
+      }
+      num_rpcs = num_replies;
+    } else {
+      while (worker_client_->ReplyGetObjectStatus()) {
+        num_rpcs++;
+      }
+    }
+    for (const auto &object_id : object_ids) {
+      ASSERT_TRUE(IsResolved(object_id));
+    }
+    if (batched) {
+      ASSERT_LT(num_rpcs, num_objects / 100);
+    } else {
+      ASSERT_EQ(num_rpcs, num_objects);
+    }
+  }
+}
+
+}  // namespace core
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
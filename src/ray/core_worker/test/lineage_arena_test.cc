@@ -0,0 +1,96 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/core_worker/lineage_arena.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ray {
+namespace core {
+
+TEST(LineageArenaTest, TestAddAndRemove) {
+  LineageArena arena(/*chunk_size=*/100);
+  auto a = arena.Add("hello");
+  auto b = arena.Add("world");
+  ASSERT_EQ(arena.Get(a), "hello");
+  ASSERT_EQ(arena.Get(b), "world");
+  ASSERT_EQ(arena.AllocatedBytes(), 100);
+  ASSERT_EQ(arena.LiveBytes(), 10);
+
+  // Entries that do not fit in the current chunk go to a new one.
+  auto c = arena.Add(std::string(95, 'c'));
+  ASSERT_EQ(arena.AllocatedBytes(), 200);
+  // Entries larger than a chunk get a chunk of their own.
+  auto d = arena.Add(std::string(150, 'd'));
+  ASSERT_EQ(arena.AllocatedBytes(), 350);
+  ASSERT_EQ(arena.Get(c), std::string(95, 'c'));
+  ASSERT_EQ(arena.Get(d), std::string(150, 'd'));
+
+  // A chunk is freed with its last entry.
+  arena.Remove(a);
+  ASSERT_EQ(arena.AllocatedBytes(), 350);
+  arena.Remove(b);
+  ASSERT_EQ(arena.AllocatedBytes(), 250);
+  arena.Remove(c);
+  ASSERT_EQ(arena.AllocatedBytes(), 150);
+  // The current chunk is kept for the next entries.
+  arena.Remove(d);
+  ASSERT_EQ(arena.AllocatedBytes(), 150);
+  ASSERT_EQ(arena.LiveBytes(), 0);
+  auto e = arena.Add("again");
+  ASSERT_EQ(arena.Get(e), "again");
+  ASSERT_EQ(arena.AllocatedBytes(), 150);
+}
+
+// Test that relocating the entries bounds the allocated bytes when a few entries
+// outlive the rest of their chunks.
+TEST(LineageArenaTest, TestRelocationBoundsWaste) {
+  const size_t chunk_size = 1000;
+  LineageArena arena(chunk_size);
+  std::vector<LineageArena::Span> spans;
+  for (int i = 0; i < 1000; i++) {
+    spans.push_back(arena.Add(std::string(50, 'a' + i % 26)));
+  }
+  ASSERT_EQ(arena.AllocatedBytes(), 50 * 1000);
+
+  // Keep one entry in each chunk.
+  std::vector<int> kept;
+  for (int i = 0; i < 1000; i++) {
+    if (i % 20 == 0) {
+      kept.push_back(i);
+    } else {
+      arena.Remove(spans[i]);
+    }
+  }
+  ASSERT_EQ(arena.LiveBytes(), 50 * 50);
+  ASSERT_EQ(arena.AllocatedBytes(), 50 * 1000);
+  ASSERT_TRUE(arena.NeedsRelocation());
+
+  arena.StartNewChunk();
+  for (int i : kept) {
+    spans[i] = arena.Relocate(spans[i]);
+  }
+  ASSERT_FALSE(arena.NeedsRelocation());
+  ASSERT_LE(arena.AllocatedBytes(), 2 * arena.LiveBytes() + chunk_size);
+  ASSERT_EQ(arena.LiveBytes(), 50 * 50);
+  for (int i : kept) {
+    ASSERT_EQ(arena.Get(spans[i]), std::string(50, 'a' + i % 26));
+  }
+}
+
+}  // namespace core
+}  // namespace ray
@@ -14,6 +14,8 @@
 
 #include "ray/core_worker/store_provider/memory_store/memory_store.h"
 
+#include <thread>
+
 #include "absl/synchronization/mutex.h"
 #include "gtest/gtest.h"
 #include "ray/common/test_util.h"
@@ -71,9 +73,9 @@ TEST(TestMemoryStore, TestMemoryStoreStats) {
   // Iterate through the memory store and compare the values that are obtained by
   // GetMemoryStoreStatisticalData.
   auto fill_expected_memory_stats = [&](MemoryStoreStats &expected_item) {
-    {
-      absl::MutexLock lock(&provider->mu_);
-      for (const auto &it : provider->objects_) {
+    for (auto &shard : provider->shards_) {
+      absl::MutexLock lock(&shard.mu);
+      for (const auto &it : shard.objects) {
         if (it.second->IsInPlasmaError()) {
           expected_item.num_in_plasma += 1;
         } else {
@@ -124,6 +126,109 @@ TEST(TestMemoryStore, TestMemoryStoreStats) {
   ASSERT_EQ(item.used_object_store_memory, expected_item3.used_object_store_memory);
 }
 
+// Put and get objects from many threads at once, as the results of many tasks
+// are returned and fetched in parallel. Every get should see its object, and
+// the stats should add up once the threads are done.
+TEST(TestMemoryStore, TestLookupsAfterPutAndDelete) {
+  // Lookups of objects that were never put or were deleted skip the shard lock, and
+  // must still see the objects that are in the store.
+  const int num_objects = 10000;
+  std::shared_ptr<CoreWorkerMemoryStore> provider =
+      std::make_shared<CoreWorkerMemoryStore>(nullptr, nullptr, nullptr, nullptr);
+  RayObject obj(rpc::ErrorType::TASK_EXECUTION_EXCEPTION);
+  std::vector<ObjectID> ids;
+  for (int i = 0; i < num_objects; i++) {
+    ids.push_back(ObjectID::FromRandom());
+    bool in_plasma = false;
+    ASSERT_FALSE(provider->Contains(ids.back(), &in_plasma));
+    ASSERT_EQ(provider->GetIfExists(ids.back()), nullptr);
+    ASSERT_TRUE(provider->Put(obj, ids.back()));
+  }
+  // Delete every other object.
+  std::vector<ObjectID> deleted_ids;
+  for (int i = 0; i < num_objects; i += 2) {
+    deleted_ids.push_back(ids[i]);
+  }
+  provider->Delete(deleted_ids);
+  for (int i = 0; i < num_objects; i++) {
+    bool in_plasma = false;
+    ASSERT_EQ(provider->Contains(ids[i], &in_plasma), i % 2 == 1);
+    auto result = provider->GetIfExists(ids[i]);
+    ASSERT_EQ(result != nullptr, i % 2 == 1);
+    if (result != nullptr) {
+      ASSERT_TRUE(result->WasAccessed());
+    }
+  }
+  provider->Delete(ids);
+  for (const auto &id : ids) {
+    bool in_plasma = false;
+    ASSERT_FALSE(provider->Contains(id, &in_plasma));
+  }
+  ASSERT_EQ(provider->Size(), 0);
+}
+
+TEST(TestMemoryStore, TestConcurrentPutAndGet) {
+  const int num_threads = 8;
+  const int num_objects = 2000;
+  std::shared_ptr<CoreWorkerMemoryStore> provider =
+      std::make_shared<CoreWorkerMemoryStore>(nullptr, nullptr, nullptr, nullptr);
+  WorkerContext context(WorkerType::WORKER, WorkerID::FromRandom(), JobID::FromInt(0));
+  RayObject local_obj(rpc::ErrorType::TASK_EXECUTION_EXCEPTION);
+  RayObject plasma_obj(rpc::ErrorType::OBJECT_IN_PLASMA);
+
+  std::vector<std::vector<ObjectID>> ids(num_threads);
+  for (auto &thread_ids : ids) {
+    for (int i = 0; i < num_objects; i++) {
+      thread_ids.push_back(ObjectID::FromRandom());
+    }
+  }
+
+  // Each thread gets the objects that the previous thread puts, so most gets
+  // have to wait for the put.
+  auto run = [&](int thread_index) {
+    std::thread putter([&]() {
+      for (int i = 0; i < num_objects; i++) {
+        RAY_CHECK(provider->Put(i % 2 ? local_obj : plasma_obj, ids[thread_index][i]));
+      }
+    });
+    const auto &ids_to_get = ids[(thread_index + 1) % num_threads];
+    for (int i = 0; i < num_objects; i++) {
+      std::vector<std::shared_ptr<RayObject>> results;
+      RAY_CHECK_OK(provider->Get({ids_to_get[i]}, 1, -1, context,
+                                 /*remove_after_get=*/false, &results));
+      RAY_CHECK(results[0] != nullptr);
+      bool in_plasma = false;
+      RAY_CHECK(provider->Contains(ids_to_get[i], &in_plasma));
+      RAY_CHECK(in_plasma == (i % 2 == 0));
+    }
+    putter.join();
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(run, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(provider->Size(), num_threads * num_objects);
+  MemoryStoreStats item = provider->GetMemoryStoreStatisticalData();
+  ASSERT_EQ(item.num_in_plasma, num_threads * num_objects / 2);
+  ASSERT_EQ(item.num_local_objects, num_threads * num_objects / 2);
+  ASSERT_EQ(item.used_object_store_memory,
+            num_threads * num_objects / 2 * static_cast<int64_t>(local_obj.GetSize()));
+
+  for (const auto &thread_ids : ids) {
+    provider->Delete(thread_ids);
+  }
+  item = provider->GetMemoryStoreStatisticalData();
+  ASSERT_EQ(provider->Size(), 0);
+  ASSERT_EQ(item.num_in_plasma, 0);
+  ASSERT_EQ(item.num_local_objects, 0);
+  ASSERT_EQ(item.used_object_store_memory, 0);
+}
+
 }  // namespace core
 }  // namespace ray
 
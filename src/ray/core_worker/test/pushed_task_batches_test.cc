@@ -0,0 +1,143 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/core_worker/transport/pushed_task_batches.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ray {
+namespace core {
+
+class PushedTaskBatchesTest : public ::testing::Test {
+ public:
+  PushedTaskBatchesTest()
+      : batches_(/*poll_timeout_ms=*/1000, [this]() { return current_time_ms_; }) {}
+
+  // Return a callback that records the status each reply is sent with.
+  rpc::SendReplyCallback RecordStatus() {
+    return [this](Status status, std::function<void()>, std::function<void()>) {
+      statuses_.push_back(status);
+    };
+  }
+
+  // Return the indices of the tasks in a reply.
+  static std::vector<int> Indices(const rpc::PushTasksReply &reply) {
+    std::vector<int> indices;
+    for (const auto &task_reply : reply.replies()) {
+      indices.push_back(task_reply.index());
+    }
+    return indices;
+  }
+
+ protected:
+  int64_t current_time_ms_ = 0;
+  PushedTaskBatches batches_;
+  std::vector<Status> statuses_;
+};
+
+TEST_F(PushedTaskBatchesTest, TestRepliesAreStreamed) {
+  rpc::PushTasksReply reply;
+  auto batch = batches_.AddBatch(3, &reply, RecordStatus());
+  ASSERT_EQ(batches_.NumBatches(), 1);
+
+  // The first task to finish is replied to right away.
+  batch->task_replies[1].mutable_reply()->set_is_application_level_error(true);
+  batches_.ReplyToTask(*batch, 1, Status::OK(), /*canceled=*/false);
+  ASSERT_EQ(statuses_.size(), 1);
+  ASSERT_EQ(reply.batch_id(), batch->id);
+  ASSERT_EQ(Indices(reply), std::vector<int>({1}));
+  ASSERT_TRUE(reply.replies(0).reply().is_application_level_error());
+
+  // A task that finishes while no RPC waits is replied to with the next RPC.
+  batches_.ReplyToTask(*batch, 0, Status::Invalid("invalid"), /*canceled=*/false);
+  ASSERT_EQ(statuses_.size(), 1);
+  rpc::PushTasksReply poll_reply;
+  batches_.WaitForReplies(batch->id, &poll_reply, RecordStatus());
+  ASSERT_EQ(statuses_.size(), 2);
+  ASSERT_EQ(Indices(poll_reply), std::vector<int>({0}));
+  ASSERT_EQ(poll_reply.replies(0).status_code(),
+            static_cast<int32_t>(StatusCode::Invalid));
+
+  // The batch is forgotten once its last reply is sent.
+  rpc::PushTasksReply last_reply;
+  batches_.WaitForReplies(batch->id, &last_reply, RecordStatus());
+  ASSERT_EQ(statuses_.size(), 2);
+  batches_.ReplyToTask(*batch, 2, Status::OK(), /*canceled=*/true);
+  ASSERT_EQ(statuses_.size(), 3);
+  ASSERT_EQ(Indices(last_reply), std::vector<int>({2}));
+  ASSERT_TRUE(last_reply.replies(0).task_canceled());
+  ASSERT_EQ(batches_.NumBatches(), 0);
+  for (const auto &status : statuses_) {
+    ASSERT_TRUE(status.ok());
+  }
+}
+
+TEST_F(PushedTaskBatchesTest, TestCallerDiesMidBatch) {
+  rpc::PushTasksReply reply;
+  auto batch = batches_.AddBatch(3, &reply, RecordStatus());
+  batches_.ReplyToTask(*batch, 0, Status::OK(), /*canceled=*/false);
+  ASSERT_EQ(statuses_.size(), 1);
+
+  // The caller dies before it asks for the rest of the replies. The batch is kept until
+  // the timeout passes.
+  current_time_ms_ += 500;
+  batches_.ReplyToTask(*batch, 1, Status::OK(), /*canceled=*/false);
+  batches_.ForgetUnpolledBatches();
+  ASSERT_EQ(batches_.NumBatches(), 1);
+  current_time_ms_ += 1000;
+  batches_.ForgetUnpolledBatches();
+  ASSERT_EQ(batches_.NumBatches(), 0);
+
+  // The task that is still running finishes after its batch was forgotten.
+  batches_.ReplyToTask(*batch, 2, Status::OK(), /*canceled=*/false);
+  ASSERT_EQ(batches_.NumBatches(), 0);
+  ASSERT_EQ(statuses_.size(), 1);
+
+  // The replies can't be asked for anymore.
+  rpc::PushTasksReply poll_reply;
+  batches_.WaitForReplies(batch->id, &poll_reply, RecordStatus());
+  ASSERT_EQ(statuses_.size(), 2);
+  ASSERT_TRUE(statuses_[1].IsInvalid());
+}
+
+TEST_F(PushedTaskBatchesTest, TestWaitedOnBatchIsKept) {
+  rpc::PushTasksReply reply;
+  auto batch = batches_.AddBatch(2, &reply, RecordStatus());
+  batches_.ReplyToTask(*batch, 0, Status::OK(), /*canceled=*/false);
+  rpc::PushTasksReply poll_reply;
+  batches_.WaitForReplies(batch->id, &poll_reply, RecordStatus());
+
+  // A batch that an RPC waits on is kept however long its tasks run.
+  current_time_ms_ += 10000;
+  batches_.ForgetUnpolledBatches();
+  ASSERT_EQ(batches_.NumBatches(), 1);
+  batches_.ReplyToTask(*batch, 1, Status::OK(), /*canceled=*/false);
+  ASSERT_EQ(statuses_.size(), 2);
+  ASSERT_EQ(Indices(poll_reply), std::vector<int>({1}));
+  ASSERT_EQ(batches_.NumBatches(), 0);
+
+  // Only one RPC may wait on a batch at a time.
+  rpc::PushTasksReply other_reply;
+  auto other_batch = batches_.AddBatch(1, &other_reply, RecordStatus());
+  rpc::PushTasksReply duplicate_reply;
+  batches_.WaitForReplies(other_batch->id, &duplicate_reply, RecordStatus());
+  ASSERT_EQ(statuses_.size(), 3);
+  ASSERT_TRUE(statuses_[2].IsInvalid());
+  ASSERT_NE(other_batch->id, batch->id);
+}
+
+}  // namespace core
+}  // namespace ray
@@ -14,6 +14,8 @@
 
 #include "ray/core_worker/task_manager.h"
 
+#include <google/protobuf/util/message_differencer.h>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "ray/common/task/task_spec.h"
@@ -591,6 +593,143 @@ TEST_F(TaskManagerLineageTest, TestResubmitTask) {
   ASSERT_EQ(reference_counter_->NumObjectIDsInScope(), 0);
 }
 
+// Test that a long chain of tasks of the same function is pinned compactly. The
+// fields that the tasks share, such as their function and runtime env, are stored
+// once, so each task only costs the bytes of its own ID and args. The chain therefore
+// stays below the lineage limit, which its full specs exceed many times over.
+TEST_F(TaskManagerLineageTest, TestLineageCompaction) {
+  rpc::Address caller_address;
+  const int num_tasks = 100;
+  ObjectID dep = ObjectID::FromRandom();
+  reference_counter_->AddLocalReference(dep, "");
+  std::vector<TaskSpecification> specs;
+  for (int i = 0; i < num_tasks; i++) {
+    auto spec = CreateTaskHelper(1, {dep});
+    auto &message = spec.GetMutableMessage();
+    message.mutable_function_descriptor()
+        ->mutable_python_function_descriptor()
+        ->set_function_name("chain_step");
+    message.mutable_runtime_env_info()->set_serialized_runtime_env(
+        R"({"env_vars": {"PAYLOAD": ")" + std::string(2000, 'x') + R"("}})");
+    message.set_parent_counter(i);
+    specs.push_back(spec);
+    manager_.AddPendingTask(caller_address, spec, "", /*max_retries=*/3);
+    auto return_id = spec.ReturnId(0);
+    reference_counter_->AddLocalReference(return_id, "");
+    // Nothing is pinned as lineage while the task is pending.
+    ASSERT_EQ(manager_.LineageFootprintBytes(spec.TaskId()), 0);
+
+    // The task completes and stores its return value in plasma.
+    rpc::PushTaskReply reply;
+    auto return_object = reply.add_return_objects();
+    return_object->set_object_id(return_id.Binary());
+    auto data = GenerateRandomBuffer();
+    return_object->set_data(data->Data(), data->Size());
+    return_object->set_in_plasma(true);
+    manager_.CompletePendingTask(spec.TaskId(), reply, rpc::Address());
+
+    reference_counter_->RemoveLocalReference(dep, nullptr);
+    dep = return_id;
+  }
+
+  // None of the lineage was evicted.
+  const int64_t max_lineage_bytes = 10000;
+  ASSERT_GT(num_tasks * static_cast<int64_t>(specs[0].GetMessage().ByteSizeLong()),
+            10 * max_lineage_bytes);
+  ASSERT_EQ(manager_.NumSubmissibleTasks(), num_tasks);
+  int64_t task_bytes = 0;
+  for (const auto &spec : specs) {
+    const int64_t bytes = manager_.LineageFootprintBytes(spec.TaskId());
+    ASSERT_GT(bytes, 0);
+    ASSERT_LT(bytes, 100);
+    task_bytes += bytes;
+  }
+  // The shared fields are counted once for all tasks.
+  const int64_t shared_bytes = manager_.TotalLineageFootprintBytes() - task_bytes;
+  ASSERT_GT(shared_bytes, 2000);
+  ASSERT_LT(shared_bytes, static_cast<int64_t>(specs[0].GetMessage().ByteSizeLong()));
+  ASSERT_LT(manager_.TotalLineageFootprintBytes(), max_lineage_bytes);
+  ASSERT_LE(manager_.LineageAllocatedBytes(), 64 * 1024 + shared_bytes);
+
+  // The compacted specs are restored in full.
+  for (int i : {0, num_tasks / 2, num_tasks - 1}) {
+    ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+        manager_.GetTaskSpec(specs[i].TaskId())->GetMessage(), specs[i].GetMessage()));
+  }
+
+  // A resubmitted task is pending again, so its spec is no longer compacted.
+  const auto &resubmitted = specs[num_tasks / 2];
+  const int64_t resubmitted_bytes = manager_.LineageFootprintBytes(resubmitted.TaskId());
+  std::vector<ObjectID> resubmitted_task_deps;
+  ASSERT_TRUE(manager_.ResubmitTask(resubmitted.TaskId(), &resubmitted_task_deps));
+  ASSERT_EQ(resubmitted_task_deps, resubmitted.GetDependencyIds());
+  ASSERT_EQ(manager_.LineageFootprintBytes(resubmitted.TaskId()), 0);
+  ASSERT_EQ(manager_.TotalLineageFootprintBytes(),
+            shared_bytes + task_bytes - resubmitted_bytes);
+  ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      manager_.GetTaskSpec(resubmitted.TaskId())->GetMessage(),
+      resubmitted.GetMessage()));
+  rpc::PushTaskReply reply;
+  auto return_object = reply.add_return_objects();
+  return_object->set_object_id(resubmitted.ReturnId(0).Binary());
+  return_object->set_in_plasma(true);
+  manager_.CompletePendingTask(resubmitted.TaskId(), reply, rpc::Address());
+  ASSERT_EQ(manager_.LineageFootprintBytes(resubmitted.TaskId()), resubmitted_bytes);
+  ASSERT_EQ(manager_.TotalLineageFootprintBytes(), shared_bytes + task_bytes);
+
+  // The whole chain is released once the last return object goes out of scope.
+  reference_counter_->RemoveLocalReference(dep, nullptr);
+  ASSERT_EQ(manager_.NumSubmissibleTasks(), 0);
+  ASSERT_EQ(manager_.TotalLineageFootprintBytes(), 0);
+  ASSERT_EQ(reference_counter_->NumObjectIDsInScope(), 0);
+}
+
+// Specs with the same resources built separately share their compacted fields, even
+// though the entries of their resource maps are in a different order.
+TEST_F(TaskManagerLineageTest, TestLineageCompactionSharesResourceMaps) {
+  rpc::Address caller_address;
+  const int num_tasks = 10;
+  std::vector<TaskSpecification> specs;
+  int64_t task_bytes = 0;
+  int64_t shared_bytes = 0;
+  for (int i = 0; i < num_tasks; i++) {
+    auto spec = CreateTaskHelper(1, {});
+    auto &resources = *spec.GetMutableMessage().mutable_required_resources();
+    if (i % 2 == 0) {
+      resources["CPU"] = 1;
+      resources["GPU"] = 1;
+    } else {
+      resources["GPU"] = 1;
+      resources["CPU"] = 1;
+    }
+    specs.push_back(spec);
+    manager_.AddPendingTask(caller_address, spec, "", /*max_retries=*/3);
+    auto return_id = spec.ReturnId(0);
+    reference_counter_->AddLocalReference(return_id, "");
+
+    rpc::PushTaskReply reply;
+    auto return_object = reply.add_return_objects();
+    return_object->set_object_id(return_id.Binary());
+    return_object->set_in_plasma(true);
+    manager_.CompletePendingTask(spec.TaskId(), reply, rpc::Address());
+    task_bytes += manager_.LineageFootprintBytes(spec.TaskId());
+    if (i == 0) {
+      shared_bytes = manager_.TotalLineageFootprintBytes() - task_bytes;
+      ASSERT_GT(shared_bytes, 0);
+    }
+    // The shared fields are counted once for all tasks.
+    ASSERT_EQ(manager_.TotalLineageFootprintBytes(), shared_bytes + task_bytes);
+  }
+
+  for (const auto &spec : specs) {
+    ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+        manager_.GetTaskSpec(spec.TaskId())->GetMessage(), spec.GetMessage()));
+    reference_counter_->RemoveLocalReference(spec.ReturnId(0), nullptr);
+  }
+  ASSERT_EQ(manager_.NumSubmissibleTasks(), 0);
+  ASSERT_EQ(manager_.TotalLineageFootprintBytes(), 0);
+}
+
 // Test resubmission for a task that was successfully executed once and stored
 // its return values in plasma. On re-execution, the task's return values
 // should be stored in plasma again, even if the worker returns its values
@@ -18,6 +18,7 @@
 
 #include "ray/common/task/task.h"
 #include "ray/gcs/pb_util.h"
+#include "ray/stats/metric_defs.h"
 
 using ray::rpc::ActorTableData;
 using namespace ray::gcs;
@@ -338,10 +339,12 @@ void CoreWorkerDirectActorTaskSubmitter::SendPendingTasks(const ActorID &actor_i
     client_queue.pending_force_kill.reset();
   }
 
-  // Submit all pending actor_submit_queue->
+  // Submit all pending actor_submit_queue-> If the in-flight window is full, the rest
+  // are sent as replies come back.
   auto &actor_submit_queue = client_queue.actor_submit_queue;
 
-  while (true) {
+  while (max_tasks_in_flight_ <= 0 ||
+         client_queue.cur_inflight_calls < max_tasks_in_flight_) {
     auto task = actor_submit_queue->PopNextTaskToSend();
     if (!task.has_value()) {
       break;
@@ -453,10 +456,16 @@ void CoreWorkerDirectActorTaskSubmitter::PushActorTask(ClientQueue &queue,
             queue.actor_submit_queue->MarkTaskCompleted(actor_counter, task_spec);
           }
           queue.cur_pending_calls--;
+          queue.cur_inflight_calls--;
+          if (max_tasks_in_flight_ > 0) {
+            // The reply frees up a slot in the in-flight window.
+            SendPendingTasks(actor_id);
+          }
         }
       };
 
   queue.inflight_task_callbacks.emplace(task_id, std::move(reply_callback));
+  queue.cur_inflight_calls++;
   rpc::ClientCallback<rpc::PushTaskReply> wrapped_callback =
       [this, task_id, actor_id](const Status &status, const rpc::PushTaskReply &reply) {
         rpc::ClientCallback<rpc::PushTaskReply> reply_callback;
@@ -491,8 +500,61 @@ bool CoreWorkerDirectActorTaskSubmitter::PendingTasksFull(const ActorID &actor_i
   absl::MutexLock lock(&mu_);
   auto it = client_queues_.find(actor_id);
   RAY_CHECK(it != client_queues_.end());
-  return it->second.max_pending_calls > 0 &&
-         it->second.cur_pending_calls >= it->second.max_pending_calls;
+  return it->second.PendingTasksFull();
+}
+
+bool CoreWorkerDirectActorTaskSubmitter::WaitUntilPendingTasksNotFull(
+    const ActorID &actor_id, int64_t timeout_ms) {
+  absl::MutexLock lock(&mu_);
+  RAY_CHECK(client_queues_.contains(actor_id));
+  // Tasks submitted to a dead actor are failed right away, so there is no need to wait.
+  // The queue is looked up on every check, since adding the queue of another actor
+  // while mu_ is released may rehash client_queues_.
+  auto has_room = [this, &actor_id]() {
+    mu_.AssertReaderHeld();
+    auto it = client_queues_.find(actor_id);
+    return it == client_queues_.end() || !it->second.PendingTasksFull() ||
+           it->second.state == rpc::ActorTableData::DEAD;
+  };
+  if (has_room() || timeout_ms == 0) {
+    return has_room();
+  }
+  const int64_t start_ms = current_time_ms();
+  bool not_full = true;
+  if (timeout_ms < 0) {
+    mu_.Await(absl::Condition(&has_room));
+  } else {
+    not_full = mu_.AwaitWithTimeout(absl::Condition(&has_room),
+                                    absl::Milliseconds(timeout_ms));
+  }
+  stats::STATS_actor_task_submit_backpressure_wait_ms.Record(
+      current_time_ms() - start_ms, actor_id.Hex());
+  return not_full;
+}
+
+void CoreWorkerDirectActorTaskSubmitter::RecordMetrics() {
+  absl::MutexLock lock(&mu_);
+  for (const auto &queue_pair : client_queues_) {
+    const auto &actor_id = queue_pair.first;
+    const auto &queue = queue_pair.second;
+    const bool active =
+        queue.state != rpc::ActorTableData::DEAD && queue.cur_pending_calls > 0;
+    if (!active && !queue_depth_recorded_actors_.contains(actor_id)) {
+      continue;
+    }
+    std::unordered_map<std::string, std::string> tags{{"ActorId", actor_id.Hex()}};
+    tags["State"] = "Queued";
+    stats::STATS_actor_task_submit_queue_depth.Record(
+        active ? queue.cur_pending_calls - queue.cur_inflight_calls : 0, tags);
+    tags["State"] = "InFlight";
+    stats::STATS_actor_task_submit_queue_depth.Record(
+        active ? queue.cur_inflight_calls : 0, tags);
+    if (active) {
+      queue_depth_recorded_actors_.insert(actor_id);
+    } else {
+      queue_depth_recorded_actors_.erase(actor_id);
+    }
+  }
 }
 
 std::string CoreWorkerDirectActorTaskSubmitter::DebugString(
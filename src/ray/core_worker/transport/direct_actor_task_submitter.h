@@ -67,11 +67,13 @@ class CoreWorkerDirectActorTaskSubmitter
       rpc::CoreWorkerClientPool &core_worker_client_pool, CoreWorkerMemoryStore &store,
       TaskFinisherInterface &task_finisher, ActorCreatorInterface &actor_creator,
       std::function<void(const ActorID &, int64_t)> warn_excess_queueing,
-      instrumented_io_context &io_service)
+      instrumented_io_context &io_service,
+      int64_t max_tasks_in_flight = ::RayConfig::instance().actor_task_max_in_flight())
       : core_worker_client_pool_(core_worker_client_pool),
         resolver_(store, task_finisher, actor_creator),
         task_finisher_(task_finisher),
         warn_excess_queueing_(warn_excess_queueing),
+        max_tasks_in_flight_(max_tasks_in_flight),
         io_service_(io_service) {
     next_queueing_warn_threshold_ =
         ::RayConfig::instance().actor_excess_queueing_warn_threshold();
@@ -84,6 +86,7 @@ class CoreWorkerDirectActorTaskSubmitter
   ///
   /// \param[in] actor_id The actor for whom to add a queue.
   /// \param[in] max_pending_calls The max pending calls for the actor to be added.
+  /// \param[in] execute_out_of_order Whether the actor executes tasks out of order.
   void AddActorQueueIfNotExists(const ActorID &actor_id, int32_t max_pending_calls,
                                 bool execute_out_of_order = false);
 
@@ -138,6 +141,22 @@ class CoreWorkerDirectActorTaskSubmitter
   /// \return Whether the corresponding client queue is full or not.
   bool PendingTasksFull(const ActorID &actor_id) const;
 
+  /// Wait until the number of tasks in requests is below max_pending_calls, or the
+  /// actor is dead. Tasks for a dead actor are always accepted, so that they fail with
+  /// the death cause of the actor.
+  ///
+  /// \param[in] actor_id Actor id.
+  /// \param[in] timeout_ms How long to wait. 0 doesn't wait, and a negative value
+  /// waits until there is room.
+  /// \return Whether the corresponding client queue has room for another task.
+  bool WaitUntilPendingTasksNotFull(const ActorID &actor_id, int64_t timeout_ms);
+
+  /// Record the queue depth of each actor queue that has pending tasks. The depth of a
+  /// queue that was recorded before is recorded as 0 once the queue is empty or its
+  /// actor is dead, and is then no longer recorded, so that the number of series
+  /// doesn't grow with the number of actors ever submitted to.
+  void RecordMetrics();
+
   /// Returns debug string for class.
   ///
   /// \param[in] actor_id The actor whose debug string to return.
@@ -201,13 +220,23 @@ class CoreWorkerDirectActorTaskSubmitter
     /// The current task number in this client queue.
     int32_t cur_pending_calls = 0;
 
+    /// The number of tasks pushed to the actor that haven't been replied to. This is
+    /// bounded by max_tasks_in_flight_, and each reply is a credit to push one more.
+    int32_t cur_inflight_calls = 0;
+
+    /// Whether the number of tasks in requests >= max_pending_calls.
+    bool PendingTasksFull() const {
+      return max_pending_calls > 0 && cur_pending_calls >= max_pending_calls;
+    }
+
     /// Returns debug string for class.
     ///
     /// \return string.
     std::string DebugString() const {
       std::ostringstream stream;
       stream << "max_pending_calls=" << max_pending_calls
-             << " cur_pending_calls=" << cur_pending_calls;
+             << " cur_pending_calls=" << cur_pending_calls
+             << " cur_inflight_calls=" << cur_inflight_calls;
       return stream.str();
     }
   };
@@ -259,6 +288,9 @@ class CoreWorkerDirectActorTaskSubmitter
 
   absl::flat_hash_map<ActorID, ClientQueue> client_queues_ GUARDED_BY(mu_);
 
+  /// The actors whose queue depth was recorded by the last call to `RecordMetrics`.
+  absl::flat_hash_set<ActorID> queue_depth_recorded_actors_ GUARDED_BY(mu_);
+
   /// Resolve direct call object dependencies.
   LocalDependencyResolver resolver_;
 
@@ -272,6 +304,10 @@ class CoreWorkerDirectActorTaskSubmitter
   /// exceeds this quantity. This threshold is doubled each time it is hit.
   int64_t next_queueing_warn_threshold_;
 
+  /// The max number of tasks pushed to an actor that haven't been replied to. A value
+  /// <=0 means no limit.
+  const int64_t max_tasks_in_flight_;
+
   /// The event loop where the actor task events are handled.
   instrumented_io_context &io_service_;
 
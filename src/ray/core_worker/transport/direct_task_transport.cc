@@ -14,7 +14,11 @@
 
 #include "ray/core_worker/transport/direct_task_transport.h"
 
+#include <google/protobuf/unknown_field_set.h>
+#include <google/protobuf/util/message_differencer.h>
+
 #include "ray/core_worker/transport/dependency_resolver.h"
+#include "ray/stats/metric_defs.h"
 
 namespace ray {
 namespace core {
@@ -76,7 +80,7 @@ Status CoreWorkerDirectTaskSubmitter::SubmitTask(TaskSpecification task_spec) {
             task_spec.GetRuntimeEnvHash());
         auto &scheduling_key_entry = scheduling_key_entries_[scheduling_key];
         scheduling_key_entry.task_queue.push_back(task_spec);
-        scheduling_key_entry.resource_spec = task_spec;
+        scheduling_key_entry.UpdateLeaseSpec(task_spec);
 
         if (!scheduling_key_entry.AllPipelinesToWorkersFull(
                 max_tasks_in_flight_per_worker_)) {
@@ -339,6 +343,7 @@ void CoreWorkerDirectTaskSubmitter::OnWorkerIdle(
   } else {
     auto &client = *client_cache_->GetOrConnect(addr.ToProto());
 
+    std::vector<TaskSpecification> tasks_to_push;
     while (!current_queue.empty() &&
            !lease_entry.PipelineToWorkerFull(max_tasks_in_flight_per_worker_)) {
       auto task_spec = current_queue.front();
@@ -352,9 +357,10 @@ void CoreWorkerDirectTaskSubmitter::OnWorkerIdle(
       scheduling_key_entry.total_tasks_in_flight++;
 
       executing_tasks_.emplace(task_spec.TaskId(), addr);
-      PushNormalTask(addr, client, scheduling_key, task_spec, assigned_resources);
+      tasks_to_push.push_back(std::move(task_spec));
       current_queue.pop_front();
     }
+    PushNormalTasks(addr, client, scheduling_key, tasks_to_push, assigned_resources);
     // If stealing is not an option, we can cancel the request for new worker leases
     if (max_tasks_in_flight_per_worker_ == 1) {
       CancelWorkerLeaseIfNeeded(scheduling_key);
@@ -424,6 +430,95 @@ CoreWorkerDirectTaskSubmitter::GetOrConnectLeaseClient(
   return lease_client;
 }
 
+namespace {
+
+/// Set the task spec of a push request from the spec's cached wire form. The bytes are
+/// added as an unknown field with the number of the `task_spec` field, which is
+/// serialized exactly like the field itself, so the worker parses them as the task
+/// spec. Unlike copying the spec into the request, this doesn't copy every arg and
+/// serialize the spec again for each push.
+void SetSerializedTaskSpec(const TaskSpecification &task_spec,
+                           rpc::PushTaskRequest *request) {
+  task_spec.AppendSerializedMessage(request->mutable_unknown_fields()->AddLengthDelimited(
+      rpc::PushTaskRequest::kTaskSpecFieldNumber));
+}
+
+/// Whether two resource maps have the same resources and quantities.
+bool SameResources(const google::protobuf::Map<std::string, double> &lhs,
+                   const google::protobuf::Map<std::string, double> &rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (const auto &resource : lhs) {
+    auto it = rhs.find(resource.first);
+    if (it == rhs.end() || it->second != resource.second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void CoreWorkerDirectTaskSubmitter::SchedulingKeyEntry::UpdateLeaseSpec(
+    const TaskSpecification &task_spec) {
+  const rpc::TaskSpec &message = task_spec.GetMessage();
+  // Raylets read the resources, function, depth, runtime env, dependencies and actor
+  // of the lease spec, which are all part of the scheduling key, so only the fields
+  // below can differ between the tasks of a key.
+  if (lease_spec) {
+    const rpc::TaskSpec &lease_message = lease_spec->GetMessage();
+    if (lease_message.type() == message.type() &&
+        lease_message.language() == message.language() &&
+        lease_message.job_id() == message.job_id() &&
+        google::protobuf::util::MessageDifferencer::Equals(
+            lease_message.caller_address(), message.caller_address()) &&
+        SameResources(lease_message.required_placement_resources(),
+                      message.required_placement_resources()) &&
+        google::protobuf::util::MessageDifferencer::Equals(
+            lease_message.scheduling_strategy(), message.scheduling_strategy())) {
+      return;
+    }
+  }
+
+  // Copy every field but the args, whose inline data may be large, and only keep the
+  // references of the args passed by reference.
+  rpc::TaskSpec lease_message;
+  lease_message.set_type(message.type());
+  lease_message.set_name(message.name());
+  lease_message.set_language(message.language());
+  lease_message.mutable_function_descriptor()->CopyFrom(message.function_descriptor());
+  lease_message.set_job_id(message.job_id());
+  lease_message.set_task_id(message.task_id());
+  lease_message.set_parent_task_id(message.parent_task_id());
+  lease_message.set_parent_counter(message.parent_counter());
+  lease_message.set_caller_id(message.caller_id());
+  lease_message.mutable_caller_address()->CopyFrom(message.caller_address());
+  for (const auto &arg : message.args()) {
+    auto *lease_arg = lease_message.add_args();
+    if (arg.has_object_ref()) {
+      lease_arg->mutable_object_ref()->CopyFrom(arg.object_ref());
+    }
+  }
+  lease_message.set_num_returns(message.num_returns());
+  *lease_message.mutable_required_resources() = message.required_resources();
+  *lease_message.mutable_required_placement_resources() =
+      message.required_placement_resources();
+  if (message.has_actor_creation_task_spec()) {
+    lease_message.mutable_actor_creation_task_spec()->CopyFrom(
+        message.actor_creation_task_spec());
+  }
+  lease_message.set_max_retries(message.max_retries());
+  lease_message.set_debugger_breakpoint(message.debugger_breakpoint());
+  lease_message.mutable_runtime_env_info()->CopyFrom(message.runtime_env_info());
+  lease_message.set_concurrency_group_name(message.concurrency_group_name());
+  lease_message.set_retry_exceptions(message.retry_exceptions());
+  lease_message.set_depth(message.depth());
+  lease_message.mutable_scheduling_strategy()->CopyFrom(message.scheduling_strategy());
+  lease_message.set_attempt_number(message.attempt_number());
+  lease_spec = TaskSpecification(std::move(lease_message));
+}
+
 void CoreWorkerDirectTaskSubmitter::ReportWorkerBacklog() {
   absl::MutexLock lock(&mu_);
   ReportWorkerBacklogInternal();
@@ -433,8 +528,13 @@ void CoreWorkerDirectTaskSubmitter::ReportWorkerBacklogInternal() {
   absl::flat_hash_map<SchedulingClass, std::pair<TaskSpecification, int64_t>> backlogs;
   for (auto &scheduling_key_and_entry : scheduling_key_entries_) {
     const SchedulingClass scheduling_class = std::get<0>(scheduling_key_and_entry.first);
+    const auto &lease_spec = scheduling_key_and_entry.second.lease_spec;
+    if (!lease_spec) {
+      // No task was ever queued with this key, so there is no backlog to report.
+      continue;
+    }
     if (backlogs.find(scheduling_class) == backlogs.end()) {
-      backlogs[scheduling_class].first = scheduling_key_and_entry.second.resource_spec;
+      backlogs[scheduling_class].first = *lease_spec;
       backlogs[scheduling_class].second = 0;
     }
     // We report backlog size per scheduling class not per scheduling key
@@ -467,7 +567,8 @@ void CoreWorkerDirectTaskSubmitter::ReportWorkerBacklogIfNeeded(
 }
 
 void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
-    const SchedulingKey &scheduling_key, const rpc::Address *raylet_address) {
+    const SchedulingKey &scheduling_key, const rpc::Address *raylet_address,
+    uint64_t reservation_token, int64_t num_spillbacks) {
   auto &scheduling_key_entry = scheduling_key_entries_[scheduling_key];
 
   if (scheduling_key_entry.pending_lease_requests.size() ==
@@ -508,17 +609,25 @@ void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
       return;
     }
   } else if (scheduling_key_entry.task_queue.size() <=
-             scheduling_key_entry.pending_lease_requests.size()) {
+             scheduling_key_entry.num_pending_leases) {
     // All tasks have corresponding pending leases, no need to request more
     return;
   }
 
+  // Ask for a worker for each queued task that doesn't have a pending lease yet, so
+  // that the raylet can grant them in one reply.
+  const size_t num_leases =
+      task_queue.empty()
+          ? 1
+          : std::min<size_t>(max_leases_per_lease_request_,
+                             task_queue.size() - scheduling_key_entry.num_pending_leases);
   num_leases_requested_++;
-  // Create a TaskSpecification with an overwritten TaskID to make sure we don't reuse the
-  // same TaskID to request a worker
-  auto resource_spec_msg = scheduling_key_entry.resource_spec.GetMutableMessage();
-  resource_spec_msg.set_task_id(TaskID::FromRandom(job_id_).Binary());
-  const TaskSpecification resource_spec = TaskSpecification(resource_spec_msg);
+  // Overwrite the TaskID of the cached lease spec in place to make sure we don't reuse
+  // the same TaskID to request a worker. Lease clients serialize the spec before
+  // returning, so patching it for the next request doesn't affect this one.
+  RAY_CHECK(scheduling_key_entry.lease_spec);
+  TaskSpecification &resource_spec = *scheduling_key_entry.lease_spec;
+  resource_spec.GetMutableMessage().set_task_id(TaskID::FromRandom(job_id_).Binary());
   rpc::Address best_node_address;
   const bool is_spillback = (raylet_address != nullptr);
   if (raylet_address == nullptr) {
@@ -529,22 +638,27 @@ void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
 
   auto lease_client = GetOrConnectLeaseClient(raylet_address);
   const TaskID task_id = resource_spec.TaskId();
-  RAY_LOG(DEBUG) << "Requesting lease from raylet "
+  RAY_LOG(DEBUG) << "Requesting " << num_leases << " leases from raylet "
                  << NodeID::FromBinary(raylet_address->raylet_id()) << " for task "
                  << task_id;
 
-  lease_client->RequestWorkerLease(
-      resource_spec,
-      /*grant_or_reject=*/is_spillback,
-      [this, scheduling_key, task_id, is_spillback, raylet_address = *raylet_address](
-          const Status &status, const rpc::RequestWorkerLeaseReply &reply) {
+  auto lease_callback =
+      [this, scheduling_key, task_id, is_spillback, num_leases, num_spillbacks,
+       raylet_address = *raylet_address](const Status &status,
+                                         const rpc::RequestWorkerLeaseReply &reply) {
         absl::MutexLock lock(&mu_);
 
         auto &scheduling_key_entry = scheduling_key_entries_[scheduling_key];
         auto lease_client = GetOrConnectLeaseClient(&raylet_address);
         scheduling_key_entry.pending_lease_requests.erase(task_id);
+        scheduling_key_entry.num_pending_leases -= num_leases;
 
         if (status.ok()) {
+          // Add the workers granted in addition to the first one before handling the
+          // first one, so that no more workers are requested for the tasks they will
+          // run.
+          const auto additional_leases =
+              AddAdditionalLeases(reply, lease_client, scheduling_key);
           if (reply.canceled()) {
             RAY_LOG(DEBUG) << "Lease canceled for task: " << task_id
                            << ", canceled type: "
@@ -597,13 +711,15 @@ void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
             // Retry the request at the first raylet since the resource view may be
             // refreshed.
             RAY_CHECK(is_spillback);
-            RequestNewWorkerIfNeeded(scheduling_key);
+            RequestNewWorkerIfNeeded(scheduling_key, /*raylet_address=*/nullptr,
+                                     /*reservation_token=*/0, num_spillbacks + 1);
           } else if (!reply.worker_address().raylet_id().empty()) {
             // We got a lease for a worker. Add the lease client state and try to
             // assign work to the worker.
             rpc::WorkerAddress addr(reply.worker_address());
             RAY_LOG(DEBUG) << "Lease granted to task " << task_id << " from raylet "
                            << addr.raylet_id;
+            stats::STATS_scheduler_lease_spillback_count.Record(num_spillbacks);
 
             auto resources_copy = reply.resource_mapping();
 
@@ -621,7 +737,12 @@ void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
                            << NodeID::FromBinary(
                                   reply.retry_at_raylet_address().raylet_id());
 
-            RequestNewWorkerIfNeeded(scheduling_key, &reply.retry_at_raylet_address());
+            RequestNewWorkerIfNeeded(scheduling_key, &reply.retry_at_raylet_address(),
+                                     reply.reservation_token(), num_spillbacks + 1);
+          }
+          for (const auto *lease : additional_leases) {
+            OnWorkerIdle(rpc::WorkerAddress(lease->worker_address()), scheduling_key,
+                         /*error=*/false, lease->resource_mapping());
           }
         } else if (lease_client != local_lease_client_) {
           // A lease request to a remote raylet failed. Retry locally if the lease is
@@ -663,12 +784,62 @@ void CoreWorkerDirectTaskSubmitter::RequestNewWorkerIfNeeded(
             RequestNewWorkerIfNeeded(scheduling_key);
           }
         }
-      },
-      task_queue.size());
+      };
+  // Only requests for multiple leases carry a reservation token, so use one for
+  // spilled back requests with a token too.
+  if (num_leases > 1 || reservation_token != 0) {
+    lease_client->RequestWorkerLeases(resource_spec,
+                                      /*grant_or_reject=*/is_spillback, num_leases,
+                                      lease_callback, task_queue.size(),
+                                      reservation_token);
+  } else {
+    lease_client->RequestWorkerLease(resource_spec,
+                                     /*grant_or_reject=*/is_spillback, lease_callback,
+                                     task_queue.size());
+  }
   scheduling_key_entry.pending_lease_requests.emplace(task_id, *raylet_address);
+  scheduling_key_entry.num_pending_leases += num_leases;
   ReportWorkerBacklogIfNeeded(scheduling_key);
 }
 
+std::vector<const rpc::WorkerLease *>
+CoreWorkerDirectTaskSubmitter::AddAdditionalLeases(
+    const rpc::RequestWorkerLeaseReply &reply,
+    const std::shared_ptr<WorkerLeaseInterface> &lease_client,
+    const SchedulingKey &scheduling_key) {
+  std::vector<const rpc::WorkerLease *> added_leases;
+  if (reply.additional_leases().empty()) {
+    return added_leases;
+  }
+  // Keep as many workers as the queued tasks need, counting the first granted worker.
+  const auto &task_queue = scheduling_key_entries_[scheduling_key].task_queue;
+  int64_t num_workers_needed =
+      (task_queue.size() + max_tasks_in_flight_per_worker_ - 1) /
+      max_tasks_in_flight_per_worker_;
+  if (!reply.canceled() && !reply.worker_address().raylet_id().empty()) {
+    num_workers_needed--;
+  }
+
+  std::vector<std::pair<int, WorkerID>> unused_workers;
+  for (const auto &lease : reply.additional_leases()) {
+    rpc::WorkerAddress addr(lease.worker_address());
+    if (static_cast<int64_t>(added_leases.size()) >= num_workers_needed) {
+      unused_workers.emplace_back(addr.port, addr.worker_id);
+      continue;
+    }
+    RAY_LOG(DEBUG) << "Additional lease granted to worker " << addr.worker_id
+                   << " from raylet " << addr.raylet_id;
+    AddWorkerLeaseClient(addr, lease_client, lease.resource_mapping(), scheduling_key);
+    added_leases.push_back(&lease);
+  }
+  if (!unused_workers.empty()) {
+    RAY_LOG(DEBUG) << "Returning " << unused_workers.size()
+                   << " unused additional leases";
+    RAY_UNUSED(lease_client->ReturnWorkers(unused_workers, /*disconnect_worker=*/false));
+  }
+  return added_leases;
+}
+
 void CoreWorkerDirectTaskSubmitter::PushNormalTask(
     const rpc::WorkerAddress &addr, rpc::CoreWorkerClientInterface &client,
     const SchedulingKey &scheduling_key, const TaskSpecification &task_spec,
@@ -677,18 +848,14 @@ void CoreWorkerDirectTaskSubmitter::PushNormalTask(
                  << addr.worker_id << " of raylet " << addr.raylet_id;
   auto task_id = task_spec.TaskId();
   auto request = std::make_unique<rpc::PushTaskRequest>();
-  bool is_actor = task_spec.IsActorTask();
   bool is_actor_creation = task_spec.IsActorCreationTask();
 
-  // NOTE(swang): CopyFrom is needed because if we use Swap here and the task
-  // fails, then the task data will be gone when the TaskManager attempts to
-  // access the task.
-  request->mutable_task_spec()->CopyFrom(task_spec.GetMessage());
+  SetSerializedTaskSpec(task_spec, request.get());
   request->mutable_resource_mapping()->CopyFrom(assigned_resources);
   request->set_intended_worker_id(addr.worker_id.Binary());
   client.PushNormalTask(
       std::move(request),
-      [this, task_spec, task_id, is_actor, is_actor_creation, scheduling_key, addr,
+      [this, task_spec, task_id, is_actor_creation, scheduling_key, addr,
        assigned_resources](Status status, const rpc::PushTaskReply &reply) {
         {
           RAY_LOG(DEBUG) << "Task " << task_id << " finished from worker "
@@ -732,25 +899,160 @@ void CoreWorkerDirectTaskSubmitter::PushNormalTask(
                          /*error=*/!status.ok(), assigned_resources);
           }
         }
-        if (!status.ok()) {
-          // TODO: It'd be nice to differentiate here between process vs node
-          // failure (e.g., by contacting the raylet). If it was a process
-          // failure, it may have been an application-level error and it may
-          // not make sense to retry the task.
-          RAY_UNUSED(task_finisher_->FailOrRetryPendingTask(
-              task_id,
-              is_actor ? rpc::ErrorType::ACTOR_DIED : rpc::ErrorType::WORKER_DIED,
-              &status));
+        FinishPushedTask(task_spec, status, reply, addr);
+      });
+}
+
+void CoreWorkerDirectTaskSubmitter::PushNormalTasks(
+    const rpc::WorkerAddress &addr, rpc::CoreWorkerClientInterface &client,
+    const SchedulingKey &scheduling_key, const std::vector<TaskSpecification> &task_specs,
+    const google::protobuf::RepeatedPtrField<rpc::ResourceMapEntry> &assigned_resources) {
+  for (size_t i = 0; i < task_specs.size(); i += max_tasks_per_push_task_batch_) {
+    const size_t end = std::min<size_t>(i + max_tasks_per_push_task_batch_,
+                                        task_specs.size());
+    if (end - i == 1) {
+      PushNormalTask(addr, client, scheduling_key, task_specs[i], assigned_resources);
+    } else {
+      PushNormalTaskBatch(addr, client, scheduling_key,
+                          std::vector<TaskSpecification>(task_specs.begin() + i,
+                                                         task_specs.begin() + end),
+                          assigned_resources);
+    }
+  }
+}
+
+void CoreWorkerDirectTaskSubmitter::PushNormalTaskBatch(
+    const rpc::WorkerAddress &addr, rpc::CoreWorkerClientInterface &client,
+    const SchedulingKey &scheduling_key, std::vector<TaskSpecification> task_specs,
+    const google::protobuf::RepeatedPtrField<rpc::ResourceMapEntry> &assigned_resources) {
+  RAY_LOG(DEBUG) << "Pushing " << task_specs.size() << " tasks to worker "
+                 << addr.worker_id << " of raylet " << addr.raylet_id;
+  auto request = std::make_unique<rpc::PushTasksRequest>();
+  request->set_intended_worker_id(addr.worker_id.Binary());
+  for (const auto &task_spec : task_specs) {
+    RAY_CHECK(!task_spec.IsActorTask() && !task_spec.IsActorCreationTask());
+    auto task_request = request->add_requests();
+    SetSerializedTaskSpec(task_spec, task_request);
+    task_request->mutable_resource_mapping()->CopyFrom(assigned_resources);
+    task_request->set_intended_worker_id(addr.worker_id.Binary());
+  }
+  // The worker streams back the replies of the tasks as they finish, so each reply
+  // is handled like the reply to a single pushed task.
+  auto replied = std::make_shared<std::vector<bool>>(task_specs.size(), false);
+  client.PushNormalTasks(
+      std::move(request),
+      [this, task_specs = std::move(task_specs), replied, scheduling_key, addr,
+       assigned_resources](Status status, const rpc::PushTasksReply &reply) {
+        // The tasks that this reply is about. If the RPC failed, these are all of the
+        // tasks that weren't replied to yet.
+        std::vector<std::pair<size_t, const rpc::PushTasksReply::TaskReply *>> replies;
+        if (status.ok()) {
+          for (const auto &task_reply : reply.replies()) {
+            replies.emplace_back(task_reply.index(), &task_reply);
+          }
         } else {
-          if (!task_spec.GetMessage().retry_exceptions() ||
-              !reply.is_application_level_error() ||
-              !task_finisher_->RetryTaskIfPossible(task_id)) {
-            task_finisher_->CompletePendingTask(task_id, reply, addr.ToProto());
+          for (size_t i = 0; i < task_specs.size(); i++) {
+            if (!(*replied)[i]) {
+              replies.emplace_back(i, nullptr);
+            }
+          }
+        }
+        {
+          absl::MutexLock lock(&mu_);
+          // The lease is forgotten once the worker replies that it is exiting, which may
+          // be before the rest of the batch is replied to.
+          auto lease_it = worker_to_lease_entry_.find(addr);
+          auto &scheduling_key_entry = scheduling_key_entries_[scheduling_key];
+          bool worker_exiting = false;
+          bool was_error = !status.ok();
+          bool all_tasks_stolen = status.ok();
+          for (const auto &index_and_reply : replies) {
+            const auto &task_spec = task_specs[index_and_reply.first];
+            const auto task_reply = index_and_reply.second;
+            (*replied)[index_and_reply.first] = true;
+            // A stolen task may already have been pushed to the thief.
+            auto it = executing_tasks_.find(task_spec.TaskId());
+            if (it != executing_tasks_.end() && it->second == addr) {
+              executing_tasks_.erase(it);
+            }
+            if (lease_it != worker_to_lease_entry_.end()) {
+              RAY_CHECK(lease_it->second.tasks_in_flight > 0);
+              lease_it->second.tasks_in_flight--;
+            }
+            RAY_CHECK(scheduling_key_entry.total_tasks_in_flight >= 1);
+            scheduling_key_entry.total_tasks_in_flight--;
+            if (task_reply != nullptr) {
+              worker_exiting = worker_exiting || task_reply->reply().worker_exiting();
+              was_error = was_error || task_reply->status_code() != 0;
+              all_tasks_stolen = all_tasks_stolen && task_reply->reply().task_stolen();
+            }
+          }
+
+          if (lease_it == worker_to_lease_entry_.end()) {
+            // The worker already replied that it is exiting.
+            if (scheduling_key_entry.CanDelete()) {
+              scheduling_key_entries_.erase(scheduling_key);
+            }
+          } else if (worker_exiting) {
+            RAY_LOG(DEBUG) << "Worker " << addr.worker_id
+                           << " replied that it is exiting.";
+            // The worker is draining and will shutdown after it is done. Don't return
+            // it to the Raylet since that will kill it early.
+            worker_to_lease_entry_.erase(lease_it);
+            scheduling_key_entry.active_workers.erase(addr);
+            if (scheduling_key_entry.CanDelete()) {
+              scheduling_key_entries_.erase(scheduling_key);
+            }
+          } else if (!all_tasks_stolen) {
+            // Stolen tasks are pushed to the thief, which is then made busy, in the
+            // StealTasks callback.
+            OnWorkerIdle(addr, scheduling_key, was_error, assigned_resources);
+          }
+        }
+
+        for (const auto &index_and_reply : replies) {
+          const auto &task_spec = task_specs[index_and_reply.first];
+          const auto task_reply = index_and_reply.second;
+          if (task_reply == nullptr) {
+            FinishPushedTask(task_spec, status, rpc::PushTaskReply(), addr);
+          } else if (task_reply->reply().task_stolen()) {
+            continue;
+          } else if (task_reply->task_canceled()) {
+            RAY_UNUSED(task_finisher_->FailOrRetryPendingTask(
+                task_spec.TaskId(), rpc::ErrorType::TASK_CANCELLED, nullptr));
+          } else {
+            const Status task_status(static_cast<StatusCode>(task_reply->status_code()),
+                                     task_reply->status_message());
+            FinishPushedTask(task_spec, task_status, task_reply->reply(), addr);
           }
         }
       });
 }
 
+void CoreWorkerDirectTaskSubmitter::FinishPushedTask(const TaskSpecification &task_spec,
+                                                     const Status &status,
+                                                     const rpc::PushTaskReply &reply,
+                                                     const rpc::WorkerAddress &addr) {
+  const TaskID task_id = task_spec.TaskId();
+  if (!status.ok()) {
+    // TODO: It'd be nice to differentiate here between process vs node
+    // failure (e.g., by contacting the raylet). If it was a process
+    // failure, it may have been an application-level error and it may
+    // not make sense to retry the task.
+    RAY_UNUSED(task_finisher_->FailOrRetryPendingTask(
+        task_id,
+        task_spec.IsActorTask() ? rpc::ErrorType::ACTOR_DIED
+                                : rpc::ErrorType::WORKER_DIED,
+        &status));
+  } else {
+    if (!task_spec.GetMessage().retry_exceptions() ||
+        !reply.is_application_level_error() ||
+        !task_finisher_->RetryTaskIfPossible(task_id)) {
+      task_finisher_->CompletePendingTask(task_id, reply, addr.ToProto());
+    }
+  }
+}
+
 Status CoreWorkerDirectTaskSubmitter::CancelTask(TaskSpecification task_spec,
                                                  bool force_kill, bool recursive) {
   RAY_LOG(INFO) << "Cancelling a task: " << task_spec.TaskId()
@@ -18,6 +18,7 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "ray/common/id.h"
 #include "ray/common/ray_object.h"
 #include "ray/core_worker/actor_manager.h"
@@ -69,7 +70,11 @@ class CoreWorkerDirectTaskSubmitter {
           ::RayConfig::instance().max_tasks_in_flight_per_worker(),
       absl::optional<boost::asio::steady_timer> cancel_timer = absl::nullopt,
       uint64_t max_pending_lease_requests_per_scheduling_category =
-          ::RayConfig::instance().max_pending_lease_requests_per_scheduling_category())
+          ::RayConfig::instance().max_pending_lease_requests_per_scheduling_category(),
+      uint64_t max_leases_per_lease_request =
+          ::RayConfig::instance().max_leases_per_lease_request(),
+      uint32_t max_tasks_per_push_task_batch =
+          ::RayConfig::instance().max_tasks_per_push_task_batch())
       : rpc_address_(rpc_address),
         local_lease_client_(lease_client),
         lease_client_factory_(lease_client_factory),
@@ -85,6 +90,10 @@ class CoreWorkerDirectTaskSubmitter {
         max_tasks_in_flight_per_worker_(max_tasks_in_flight_per_worker),
         max_pending_lease_requests_per_scheduling_category_(
             max_pending_lease_requests_per_scheduling_category),
+        max_leases_per_lease_request_(
+            std::max<uint64_t>(max_leases_per_lease_request, 1)),
+        max_tasks_per_push_task_batch_(
+            std::max<uint32_t>(max_tasks_per_push_task_batch, 1)),
         cancel_retry_timer_(std::move(cancel_timer)) {}
 
   /// Schedule a task for direct submission to a worker.
@@ -151,8 +160,15 @@ class CoreWorkerDirectTaskSubmitter {
   /// flight and there are tasks queued. If a raylet address is provided, then
   /// the worker should be requested from the raylet at that address. Else, the
   /// worker should be requested from the local raylet.
+  ///
+  /// \param reservation_token The token of the reservation that the raylet which
+  /// spilled the request back to `raylet_address` made there, or 0.
+  /// \param num_spillbacks How many times the lease was already spilled back or
+  /// rejected, to record when it is granted.
   void RequestNewWorkerIfNeeded(const SchedulingKey &task_queue_key,
-                                const rpc::Address *raylet_address = nullptr)
+                                const rpc::Address *raylet_address = nullptr,
+                                uint64_t reservation_token = 0,
+                                int64_t num_spillbacks = 0)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
   /// Cancel a pending worker lease and retry until the cancellation succeeds
@@ -162,6 +178,19 @@ class CoreWorkerDirectTaskSubmitter {
   void CancelWorkerLeaseIfNeeded(const SchedulingKey &scheduling_key)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  /// Set up client state for the workers granted in addition to the first one by a
+  /// lease request. Workers that no queued task needs are returned to the raylet in one
+  /// request. The caller should call OnWorkerIdle for each added worker.
+  ///
+  /// \param[in] reply The reply to the lease request.
+  /// \param[in] lease_client The client through which the workers should be returned.
+  /// \param[in] scheduling_key The scheduling key of the lease request.
+  /// \return The leases of the added workers.
+  std::vector<const rpc::WorkerLease *> AddAdditionalLeases(
+      const rpc::RequestWorkerLeaseReply &reply,
+      const std::shared_ptr<WorkerLeaseInterface> &lease_client,
+      const SchedulingKey &scheduling_key) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   /// Set up client state for newly granted worker lease.
   void AddWorkerLeaseClient(
       const rpc::WorkerAddress &addr, std::shared_ptr<WorkerLeaseInterface> lease_client,
@@ -213,6 +242,28 @@ class CoreWorkerDirectTaskSubmitter {
                       const google::protobuf::RepeatedPtrField<rpc::ResourceMapEntry>
                           &assigned_resources);
 
+  /// Push tasks to a specific worker, in batches of up to max_tasks_per_push_task_batch_
+  /// tasks per RPC.
+  void PushNormalTasks(const rpc::WorkerAddress &addr,
+                       rpc::CoreWorkerClientInterface &client,
+                       const SchedulingKey &task_queue_key,
+                       const std::vector<TaskSpecification> &task_specs,
+                       const google::protobuf::RepeatedPtrField<rpc::ResourceMapEntry>
+                           &assigned_resources);
+
+  /// Push a batch of tasks to a specific worker in one RPC.
+  void PushNormalTaskBatch(const rpc::WorkerAddress &addr,
+                           rpc::CoreWorkerClientInterface &client,
+                           const SchedulingKey &task_queue_key,
+                           std::vector<TaskSpecification> task_specs,
+                           const google::protobuf::RepeatedPtrField<rpc::ResourceMapEntry>
+                               &assigned_resources);
+
+  /// Complete, retry or fail a task that was pushed to a worker, given the reply.
+  void FinishPushedTask(const TaskSpecification &task_spec, const Status &status,
+                        const rpc::PushTaskReply &reply,
+                        const rpc::WorkerAddress &addr) LOCKS_EXCLUDED(mu_);
+
   /// Address of our RPC server.
   rpc::Address rpc_address_;
 
@@ -266,6 +317,13 @@ class CoreWorkerDirectTaskSubmitter {
   // Max number of pending lease requests per SchedulingKey.
   const uint64_t max_pending_lease_requests_per_scheduling_category_;
 
+  // Max number of workers to ask for in one lease request.
+  const uint64_t max_leases_per_lease_request_;
+
+  // Max number of tasks to push to a worker in one RPC. Batches are also limited by the
+  // room in the pipeline to the worker.
+  const uint32_t max_tasks_per_push_task_batch_;
+
   /// A LeaseEntry struct is used to condense the metadata about a single executor:
   /// (1) The lease client through which the worker should be returned
   /// (2) The expiration time of a worker's lease.
@@ -326,7 +384,12 @@ class CoreWorkerDirectTaskSubmitter {
   struct SchedulingKeyEntry {
     // Keep track of pending worker lease requests to the raylet.
     absl::flat_hash_map<TaskID, rpc::Address> pending_lease_requests;
-    TaskSpecification resource_spec = TaskSpecification();
+    // The total number of workers asked for by the pending lease requests.
+    size_t num_pending_leases = 0;
+    // The spec sent to raylets in lease requests and backlog reports. It is built from
+    // the first task queued with this key, without the data of args passed by value
+    // since raylets never read it, and each lease request then only patches its task ID.
+    absl::optional<TaskSpecification> lease_spec;
     // Tasks that are queued for execution. We keep an individual queue per
     // scheduling class to ensure fairness.
     std::deque<TaskSpecification> task_queue = std::deque<TaskSpecification>();
@@ -338,6 +401,10 @@ class CoreWorkerDirectTaskSubmitter {
     uint32_t total_tasks_in_flight = 0;
     int64_t last_reported_backlog_size = 0;
 
+    // Build the lease spec from a task queued with this key, unless it already matches
+    // the task in all the fields that raylets read.
+    void UpdateLeaseSpec(const TaskSpecification &task_spec);
+
     // Check whether it's safe to delete this SchedulingKeyEntry from the
     // scheduling_key_entries_ hashmap.
     inline bool CanDelete() const {
@@ -371,14 +438,14 @@ class CoreWorkerDirectTaskSubmitter {
 
     // Get the current backlog size for this scheduling key
     [[nodiscard]] inline int64_t BacklogSize() const {
-      if (task_queue.size() < pending_lease_requests.size()) {
-        // During work stealing we may have more pending lease requests than the number of
+      if (task_queue.size() < num_pending_leases) {
+        // During work stealing we may have more pending leases than the number of
         // queued tasks
         return 0;
       }
 
-      // Subtract tasks with pending lease requests so we don't double count them.
-      return task_queue.size() - pending_lease_requests.size();
+      // Subtract tasks with pending leases so we don't double count them.
+      return task_queue.size() - num_pending_leases;
     }
   };
 
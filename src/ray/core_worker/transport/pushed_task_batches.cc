@@ -0,0 +1,130 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/core_worker/transport/pushed_task_batches.h"
+
+#include "ray/util/logging.h"
+
+namespace ray {
+namespace core {
+
+PushedTaskBatch::PushedTaskBatch(int64_t id_arg, int num_tasks)
+    : id(id_arg), task_replies(num_tasks), num_unsent_replies(num_tasks) {
+  for (int i = 0; i < num_tasks; i++) {
+    task_replies[i].set_index(i);
+  }
+}
+
+PushedTaskBatches::PushedTaskBatches(int64_t poll_timeout_ms,
+                                     std::function<int64_t()> get_time_ms)
+    : poll_timeout_ms_(poll_timeout_ms), get_time_ms_(std::move(get_time_ms)) {}
+
+std::shared_ptr<PushedTaskBatch> PushedTaskBatches::AddBatch(
+    int num_tasks, rpc::PushTasksReply *reply,
+    rpc::SendReplyCallback send_reply_callback) {
+  absl::MutexLock lock(&mu_);
+  // The same task may be pushed again in another batch, e.g., when the push is retried,
+  // so the tasks of each batch are told apart by the batch's ID.
+  auto batch = std::make_shared<PushedTaskBatch>(++last_batch_id_, num_tasks);
+  batch->reply = reply;
+  batch->send_reply_callback = std::move(send_reply_callback);
+  batches_.emplace(batch->id, batch);
+  return batch;
+}
+
+void PushedTaskBatches::ReplyToTask(PushedTaskBatch &batch, int index,
+                                    const Status &status, bool canceled) {
+  rpc::SendReplyCallback send_replies;
+  {
+    absl::MutexLock lock(&mu_);
+    auto &task_reply = batch.task_replies[index];
+    task_reply.set_status_code(static_cast<int32_t>(status.code()));
+    task_reply.set_status_message(status.message());
+    task_reply.set_task_canceled(canceled);
+    batch.finished_tasks.push_back(index);
+    send_replies = TakeReplies(batch);
+  }
+  if (send_replies) {
+    send_replies(Status::OK(), nullptr, nullptr);
+  }
+}
+
+void PushedTaskBatches::WaitForReplies(int64_t batch_id, rpc::PushTasksReply *reply,
+                                       rpc::SendReplyCallback send_reply_callback) {
+  rpc::SendReplyCallback send_replies;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = batches_.find(batch_id);
+    if (it == batches_.end() || it->second->reply != nullptr) {
+      send_replies = [send_reply_callback](Status, std::function<void()>,
+                                           std::function<void()>) {
+        send_reply_callback(Status::Invalid("Unknown batch of pushed tasks"), nullptr,
+                            nullptr);
+      };
+    } else {
+      auto &batch = *it->second;
+      batch.reply = reply;
+      batch.send_reply_callback = std::move(send_reply_callback);
+      send_replies = TakeReplies(batch);
+    }
+  }
+  if (send_replies) {
+    send_replies(Status::OK(), nullptr, nullptr);
+  }
+}
+
+void PushedTaskBatches::ForgetUnpolledBatches() {
+  absl::MutexLock lock(&mu_);
+  const int64_t now_ms = get_time_ms_();
+  for (auto it = batches_.begin(); it != batches_.end();) {
+    const auto &batch = *it->second;
+    if (batch.reply == nullptr && now_ms - batch.unpolled_since_ms > poll_timeout_ms_) {
+      RAY_LOG(INFO) << "Forgetting the " << batch.num_unsent_replies
+                    << " unsent replies to batch " << batch.id
+                    << " of pushed tasks, since the caller hasn't asked for them for "
+                    << now_ms - batch.unpolled_since_ms << "ms.";
+      batches_.erase(it++);
+    } else {
+      it++;
+    }
+  }
+}
+
+size_t PushedTaskBatches::NumBatches() const {
+  absl::MutexLock lock(&mu_);
+  return batches_.size();
+}
+
+rpc::SendReplyCallback PushedTaskBatches::TakeReplies(PushedTaskBatch &batch) {
+  if (batch.reply == nullptr || batch.finished_tasks.empty()) {
+    return nullptr;
+  }
+  batch.reply->set_batch_id(batch.id);
+  for (int index : batch.finished_tasks) {
+    batch.reply->add_replies()->Swap(&batch.task_replies[index]);
+  }
+  batch.num_unsent_replies -= batch.finished_tasks.size();
+  batch.finished_tasks.clear();
+  batch.reply = nullptr;
+  batch.unpolled_since_ms = get_time_ms_();
+  auto send_reply_callback = std::move(batch.send_reply_callback);
+  batch.send_reply_callback = nullptr;
+  if (batch.num_unsent_replies == 0) {
+    batches_.erase(batch.id);
+  }
+  return send_reply_callback;
+}
+
+}  // namespace core
+}  // namespace ray
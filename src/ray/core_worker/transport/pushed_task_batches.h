@@ -0,0 +1,134 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "ray/common/status.h"
+#include "ray/rpc/server_call.h"
+#include "src/ray/protobuf/core_worker.pb.h"
+
+namespace ray {
+namespace core {
+
+/// The replies to a batch of tasks pushed to this worker by one PushTasks RPC. The
+/// fields other than `id` and `task_replies` are protected by the mutex of the
+/// `PushedTaskBatches` that the batch was added to.
+struct PushedTaskBatch {
+  PushedTaskBatch(int64_t id_arg, int num_tasks);
+
+  /// The ID of the batch, which the caller asks for the missing replies with.
+  const int64_t id;
+  /// The replies of the tasks, in the order of the request. Each task fills in its
+  /// own.
+  std::vector<rpc::PushTasksReply::TaskReply> task_replies;
+  /// The indices of the finished tasks whose replies haven't been sent yet.
+  std::vector<int> finished_tasks;
+  /// The number of tasks whose replies haven't been sent yet.
+  int num_unsent_replies;
+  /// The RPC that waits for more replies, if any.
+  rpc::PushTasksReply *reply = nullptr;
+  rpc::SendReplyCallback send_reply_callback;
+  /// When the last reply was sent, if no RPC waits for more replies.
+  int64_t unpolled_since_ms = 0;
+};
+
+/// The batches of tasks pushed to this worker that still have replies to send. The
+/// replies are streamed back to the caller: each PushTasks RPC of a batch is replied to
+/// as soon as some of its tasks have finished, and the caller then asks for the rest
+/// with another RPC.
+///
+/// A caller that dies, or whose request for more replies is lost, never asks for the
+/// rest of the replies. So a batch that no RPC waits on is forgotten once the timeout
+/// passes, and a later request for its replies fails as if the batch were unknown. Its
+/// tasks still run.
+///
+/// This class is thread-safe.
+class PushedTaskBatches {
+ public:
+  /// \param poll_timeout_ms How long to keep the replies to a batch that no RPC waits
+  /// on.
+  /// \param get_time_ms A function that returns the current time in milliseconds.
+  PushedTaskBatches(int64_t poll_timeout_ms, std::function<int64_t()> get_time_ms);
+
+  /// Add a batch of pushed tasks.
+  ///
+  /// \param num_tasks The number of tasks in the batch.
+  /// \param reply The reply to the RPC that pushed the tasks, which waits for the first
+  /// replies.
+  /// \param send_reply_callback The callback to send the reply.
+  /// \return The batch, whose task replies the tasks fill in.
+  std::shared_ptr<PushedTaskBatch> AddBatch(int num_tasks, rpc::PushTasksReply *reply,
+                                            rpc::SendReplyCallback send_reply_callback);
+
+  /// Mark a task of a batch as replied to, and send its reply if an RPC waits for it.
+  /// The batch may have been forgotten already, in which case the reply is dropped.
+  ///
+  /// \param batch The batch of the task.
+  /// \param index The index of the task in the batch.
+  /// \param status The status of the task's reply.
+  /// \param canceled Whether the task was canceled before it was executed.
+  void ReplyToTask(PushedTaskBatch &batch, int index, const Status &status,
+                   bool canceled);
+
+  /// Wait for more replies to a batch. The RPC fails if the batch is unknown, e.g.,
+  /// because it was forgotten.
+  ///
+  /// \param batch_id The ID of the batch.
+  /// \param reply The reply to the RPC that waits for the replies.
+  /// \param send_reply_callback The callback to send the reply.
+  void WaitForReplies(int64_t batch_id, rpc::PushTasksReply *reply,
+                      rpc::SendReplyCallback send_reply_callback);
+
+  /// Forget the batches that no RPC has waited on for longer than the timeout.
+  void ForgetUnpolledBatches();
+
+  /// Return the number of batches that still have replies to send.
+  size_t NumBatches() const;
+
+ private:
+  /// Move the replies of the finished tasks of a batch into the RPC that waits for them,
+  /// if there are any, and forget the batch once all of its replies are sent.
+  ///
+  /// \return The callback to send the reply, to be called without holding the mutex,
+  /// or nullptr if there is nothing to send yet.
+  rpc::SendReplyCallback TakeReplies(PushedTaskBatch &batch)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  /// How long to keep the replies to a batch that no RPC waits on.
+  const int64_t poll_timeout_ms_;
+
+  /// Returns the current time in milliseconds.
+  const std::function<int64_t()> get_time_ms_;
+
+  /// Protects the batches.
+  mutable absl::Mutex mu_;
+
+  /// The ID of the last batch. Batches are numbered from 1.
+  int64_t last_batch_id_ GUARDED_BY(mu_) = 0;
+
+  /// The batches that still have replies to send, keyed by ID. The tasks of a batch
+  /// share ownership of it, so that a forgotten batch stays valid until they finish.
+  absl::flat_hash_map<int64_t, std::shared_ptr<PushedTaskBatch>> batches_
+      GUARDED_BY(mu_);
+};
+
+}  // namespace core
+}  // namespace ray
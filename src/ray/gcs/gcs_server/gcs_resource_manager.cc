@@ -203,13 +203,19 @@ void GcsResourceManager::UpdateFromResourceReport(const rpc::ResourcesData &data
 
   if (resources_data->should_global_gc() || resources_data->resources_total_size() > 0 ||
       resources_data->resources_available_changed() ||
-      resources_data->resource_load_changed()) {
+      resources_data->resource_load_changed() ||
+      resources_data->handled_reservation_tokens_size() > 0) {
     absl::MutexLock guard(&resource_buffer_mutex_);
-    resources_buffer_[node_id] = *resources_data;
+    auto &buffered_data = resources_buffer_[node_id];
+    // Raylets only report a handled reservation token once, so keep the tokens of a
+    // report that is replaced before it was broadcast.
+    resources_data->mutable_handled_reservation_tokens()->MergeFrom(
+        buffered_data.handled_reservation_tokens());
+    buffered_data = *resources_data;
     // Clear the fields that will not be used by raylet.
-    resources_buffer_[node_id].clear_resource_load();
-    resources_buffer_[node_id].clear_resource_load_by_shape();
-    resources_buffer_[node_id].clear_resources_normal_task();
+    buffered_data.clear_resource_load();
+    buffered_data.clear_resource_load_by_shape();
+    buffered_data.clear_resources_normal_task();
   }
 }
 
@@ -71,6 +71,14 @@ struct GcsServerMocker {
       return Status::OK();
     }
 
+    ray::Status ReturnWorkers(const std::vector<std::pair<int, WorkerID>> &workers,
+                              bool disconnect_worker) override {
+      for (const auto &worker : workers) {
+        RAY_CHECK_OK(ReturnWorker(worker.first, worker.second, disconnect_worker));
+      }
+      return Status::OK();
+    }
+
     void ReportWorkerBacklog(
         const WorkerID &worker_id,
         const std::vector<rpc::WorkerBacklogReport> &backlog_reports) override {}
@@ -92,6 +100,15 @@ struct GcsServerMocker {
       callbacks.push_back(callback);
     }
 
+    void RequestWorkerLeases(
+        const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+        int64_t max_leases,
+        const rpc::ClientCallback<rpc::RequestWorkerLeaseReply> &callback,
+        const int64_t backlog_size = -1, uint64_t reservation_token = 0) override {
+      num_workers_requested += 1;
+      callbacks.push_back(callback);
+    }
+
     /// WorkerLeaseInterface
     void ReleaseUnusedWorkers(
         const std::vector<WorkerID> &workers_in_use,
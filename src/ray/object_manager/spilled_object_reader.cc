@@ -14,6 +14,9 @@
 
 #include "ray/object_manager/spilled_object_reader.h"
 
+#include <zlib.h>
+
+#include <algorithm>
 #include <fstream>
 #include <regex>
 
@@ -22,7 +25,10 @@
 namespace ray {
 namespace {
 const size_t UINT64_size = sizeof(uint64_t);
-}
+/// The codec is stored in the top byte of the address_size header field.
+const int kCodecShift = 56;
+const uint64_t kAddressSizeMask = (static_cast<uint64_t>(1) << kCodecShift) - 1;
+}  // namespace
 
 /* static */ absl::optional<SpilledObjectReader>
 SpilledObjectReader::CreateSpilledObjectReader(const std::string &object_url) {
@@ -41,18 +47,23 @@ SpilledObjectReader::CreateSpilledObjectReader(const std::string &object_url) {
   uint64_t metadata_offset = 0;
   uint64_t metadata_size = 0;
   rpc::Address owner_address;
+  SpilledObjectCodec codec = SpilledObjectCodec::kNone;
+  uint64_t block_size = 0;
+  std::vector<uint64_t> block_offsets;
 
   std::ifstream is(file_path, std::ios::binary);
-  if (!is || !SpilledObjectReader::ParseObjectHeader(is, object_offset, data_offset,
-                                                     data_size, metadata_offset,
-                                                     metadata_size, owner_address)) {
+  if (!is || !SpilledObjectReader::ParseObjectHeader(
+                 is, object_offset, object_size, data_offset, data_size,
+                 metadata_offset, metadata_size, owner_address, codec, block_size,
+                 block_offsets)) {
     RAY_LOG(WARNING) << "Failed to parse object header for spilled object " << object_url;
     return absl::optional<SpilledObjectReader>();
   }
 
-  return absl::optional<SpilledObjectReader>(
-      SpilledObjectReader(std::move(file_path), object_size, data_offset, data_size,
-                          metadata_offset, metadata_size, std::move(owner_address)));
+  return absl::optional<SpilledObjectReader>(SpilledObjectReader(
+      std::move(file_path), object_size, data_offset, data_size, metadata_offset,
+      metadata_size, std::move(owner_address), codec, block_size,
+      std::move(block_offsets)));
 }
 
 uint64_t SpilledObjectReader::GetDataSize() const { return data_size_; }
@@ -66,14 +77,19 @@ const rpc::Address &SpilledObjectReader::GetOwnerAddress() const {
 SpilledObjectReader::SpilledObjectReader(std::string file_path, uint64_t object_size,
                                          uint64_t data_offset, uint64_t data_size,
                                          uint64_t metadata_offset, uint64_t metadata_size,
-                                         rpc::Address owner_address)
+                                         rpc::Address owner_address,
+                                         SpilledObjectCodec codec, uint64_t block_size,
+                                         std::vector<uint64_t> block_offsets)
     : file_path_(std::move(file_path)),
       object_size_(object_size),
       data_offset_(data_offset),
       data_size_(data_size),
       metadata_offset_(metadata_offset),
       metadata_size_(metadata_size),
-      owner_address_(std::move(owner_address)) {}
+      owner_address_(std::move(owner_address)),
+      codec_(codec),
+      block_size_(block_size),
+      block_offsets_(std::move(block_offsets)) {}
 
 /* static */ bool SpilledObjectReader::ParseObjectURL(const std::string &object_url,
                                                       std::string &file_path,
@@ -105,11 +121,11 @@ SpilledObjectReader::SpilledObjectReader(std::string file_path, uint64_t object_
 }
 
 /* static */
-bool SpilledObjectReader::ParseObjectHeader(std::istream &is, uint64_t object_offset,
-                                            uint64_t &data_offset, uint64_t &data_size,
-                                            uint64_t &metadata_offset,
-                                            uint64_t &metadata_size,
-                                            rpc::Address &owner_address) {
+bool SpilledObjectReader::ParseObjectHeader(
+    std::istream &is, uint64_t object_offset, uint64_t object_size,
+    uint64_t &data_offset, uint64_t &data_size, uint64_t &metadata_offset,
+    uint64_t &metadata_size, rpc::Address &owner_address, SpilledObjectCodec &codec,
+    uint64_t &block_size, std::vector<uint64_t> &block_offsets) {
   if (!is.seekg(object_offset)) {
     return false;
   }
@@ -119,7 +135,17 @@ bool SpilledObjectReader::ParseObjectHeader(std::istream &is, uint64_t object_of
       !ReadUINT64(is, data_size)) {
     return false;
   }
+  codec = static_cast<SpilledObjectCodec>(address_size >> kCodecShift);
+  address_size &= kAddressSizeMask;
+  if (codec != SpilledObjectCodec::kNone && codec != SpilledObjectCodec::kZlib) {
+    RAY_LOG(ERROR) << "Unknown spilled object codec " << static_cast<int>(codec);
+    return false;
+  }
 
+  if (address_size > object_size || object_size - address_size < UINT64_size * 3) {
+    // The header is corrupt, don't allocate for the address.
+    return false;
+  }
   std::string address_str(address_size, '\0');
   if (!is.read(&address_str[0], address_size) ||
       !owner_address.ParseFromString(address_str)) {
@@ -128,6 +154,45 @@ bool SpilledObjectReader::ParseObjectHeader(std::istream &is, uint64_t object_of
 
   metadata_offset = object_offset + UINT64_size * 3 + address_size;
   data_offset = metadata_offset + metadata_size;
+  block_size = 0;
+  block_offsets.clear();
+  if (codec == SpilledObjectCodec::kNone) {
+    return true;
+  }
+
+  uint64_t num_blocks = 0;
+  if (!is.seekg(data_offset) || !ReadUINT64(is, block_size) ||
+      !ReadUINT64(is, num_blocks)) {
+    return false;
+  }
+  // Every block except the last one holds exactly block_size uncompressed bytes.
+  if (block_size == 0 ? (data_size != 0 || num_blocks != 0)
+                      : num_blocks != (data_size + block_size - 1) / block_size) {
+    return false;
+  }
+  // The block table and the blocks must be within the object. Otherwise a corrupt
+  // header could make us allocate a block table larger than the object.
+  const uint64_t object_end = object_offset + object_size;
+  if (metadata_size > object_end - metadata_offset ||
+      (object_end - data_offset) / UINT64_size < 2 ||
+      num_blocks > (object_end - data_offset) / UINT64_size - 2) {
+    RAY_LOG(ERROR) << "Spilled object header with " << num_blocks
+                   << " blocks doesn't fit in the object of " << object_size
+                   << " bytes";
+    return false;
+  }
+  block_offsets.reserve(num_blocks + 1);
+  uint64_t block_offset = data_offset + UINT64_size * (2 + num_blocks);
+  for (uint64_t i = 0; i < num_blocks; i++) {
+    uint64_t compressed_size = 0;
+    if (!ReadUINT64(is, compressed_size) || compressed_size > object_end - block_offset) {
+      return false;
+    }
+    block_offsets.push_back(block_offset);
+    block_offset += compressed_size;
+  }
+  block_offsets.push_back(block_offset);
+  data_offset = block_offsets.front();
   return true;
 }
 
@@ -154,10 +219,58 @@ uint64_t SpilledObjectReader::ToUINT64(const std::string &s) {
 
 bool SpilledObjectReader::ReadFromDataSection(uint64_t offset, uint64_t size,
                                               char *output) const {
+  if (codec_ != SpilledObjectCodec::kNone) {
+    return ReadFromCompressedDataSection(offset, size, output);
+  }
   std::ifstream is(file_path_, std::ios::binary);
   return is.seekg(data_offset_ + offset) && is.read(output, size);
 }
 
+bool SpilledObjectReader::ReadFromCompressedDataSection(uint64_t offset, uint64_t size,
+                                                        char *output) const {
+  if (offset + size > data_size_) {
+    return false;
+  }
+  if (size == 0) {
+    return true;
+  }
+  std::ifstream is(file_path_, std::ios::binary);
+  std::string compressed;
+  std::string block;
+  const uint64_t end = offset + size;
+  // Chunks are usually aligned to blocks, so each block is inflated at most once.
+  for (uint64_t i = offset / block_size_; i * block_size_ < end; i++) {
+    const uint64_t block_begin = i * block_size_;
+    compressed.resize(block_offsets_[i + 1] - block_offsets_[i]);
+    block.resize(std::min(block_size_, data_size_ - block_begin));
+    if (!is.seekg(block_offsets_[i]) || !is.read(&compressed[0], compressed.size()) ||
+        !DecompressBlock(codec_, compressed, block)) {
+      return false;
+    }
+    const uint64_t copy_begin = std::max(offset, block_begin);
+    const uint64_t copy_end = std::min(end, block_begin + block.size());
+    std::copy(block.begin() + (copy_begin - block_begin),
+              block.begin() + (copy_end - block_begin), output + (copy_begin - offset));
+  }
+  return true;
+}
+
+/* static */
+bool SpilledObjectReader::DecompressBlock(SpilledObjectCodec codec,
+                                          const std::string &input,
+                                          std::string &output) {
+  switch (codec) {
+  case SpilledObjectCodec::kZlib: {
+    uLongf output_size = output.size();
+    int ret = uncompress(reinterpret_cast<Bytef *>(&output[0]), &output_size,
+                         reinterpret_cast<const Bytef *>(input.data()), input.size());
+    return ret == Z_OK && output_size == output.size();
+  }
+  default:
+    return false;
+  }
+}
+
 bool SpilledObjectReader::ReadFromMetadataSection(uint64_t offset, uint64_t size,
                                                   char *output) const {
   std::ifstream is(file_path_, std::ios::binary);
@@ -17,12 +17,23 @@
 #include <gtest/gtest_prod.h>
 
 #include <string>
+#include <vector>
 
 #include "absl/types/optional.h"
 #include "ray/object_manager/object_reader.h"
 #include "src/ray/protobuf/common.pb.h"
 
 namespace ray {
+
+/// Compression codec applied to the data payload of a spilled object. The codec is
+/// recorded in the top byte of the address_size header field, so objects spilled
+/// without compression keep the original format. Must be kept in sync with
+/// python/ray/external_storage.py.
+enum class SpilledObjectCodec : uint8_t {
+  kNone = 0,
+  kZlib = 1,
+};
+
 /// Reader for a local object spilled in the object_url.
 /// This class is thread safe.
 class SpilledObjectReader : public IObjectReader {
@@ -47,7 +58,10 @@ class SpilledObjectReader : public IObjectReader {
  private:
   SpilledObjectReader(std::string file_path, uint64_t total_size, uint64_t data_offset,
                       uint64_t data_size, uint64_t metadata_offset,
-                      uint64_t metadata_size, rpc::Address owner_address);
+                      uint64_t metadata_size, rpc::Address owner_address,
+                      SpilledObjectCodec codec = SpilledObjectCodec::kNone,
+                      uint64_t block_size = 0,
+                      std::vector<uint64_t> block_offsets = {});
 
   /// Parse the object url in the form of {path}?offset={offset}&size={size}.
   /// Return false if parsing failed.
@@ -63,27 +77,52 @@ class SpilledObjectReader : public IObjectReader {
   /// Read the istream, parse the object header according to the following format.
   /// Return false if the input stream is deleted or corrupted.
   ///     --- start of an object (at object_offset) ---
-  ///      address_size        (8 bytes),
+  ///      address_size        (8 bytes, top byte holds the SpilledObjectCodec),
   ///      metadata_size       (8 bytes),
-  ///      data_size           (8 bytes),
+  ///      data_size           (8 bytes, size of the uncompressed data),
   ///      serialized_address  (address_size bytes),
   ///      metadata_payload    (metadata_size bytes),
   ///      data_payload        (data_size bytes)
   ///    --- start of another object ---
   ///      ...
   ///
+  /// If the codec is not kNone, the data payload is split into blocks of block_size
+  /// uncompressed bytes which are compressed independently, so that any range of the
+  /// data can be read without inflating the whole object:
+  ///      block_size          (8 bytes),
+  ///      num_blocks          (8 bytes),
+  ///      block_sizes         (num_blocks * 8 bytes, compressed size of each block),
+  ///      compressed_blocks   (sum of block_sizes bytes)
+  ///
   /// \param[in] is input stream to read from.
   /// \param[in] object_offset offset of the object stored in the file.
+  /// \param[in] object_size size of the object stored in the file, including the
+  /// header. The block table of a compressed data payload must fit in it.
   /// \param[out] data_offset data payload offset in the file.
   /// \param[out] data_size size of the data payload.
   /// \param[out] metadata_offset metadata payload offset in the file.
   /// \param[out] metadata_size size of the metadata payload.
   /// \param[out] owner_address owner address.
+  /// \param[out] codec compression codec of the data payload.
+  /// \param[out] block_size uncompressed size of each compressed block.
+  /// \param[out] block_offsets file offsets of the compressed blocks, followed by the
+  /// end offset of the last block. Empty if the data payload is not compressed.
   /// \return bool.
   static bool ParseObjectHeader(std::istream &is, uint64_t object_offset,
-                                uint64_t &data_offset, uint64_t &data_size,
-                                uint64_t &metadata_offset, uint64_t &metadata_size,
-                                rpc::Address &owner_address);
+                                uint64_t object_size, uint64_t &data_offset,
+                                uint64_t &data_size, uint64_t &metadata_offset,
+                                uint64_t &metadata_size, rpc::Address &owner_address,
+                                SpilledObjectCodec &codec, uint64_t &block_size,
+                                std::vector<uint64_t> &block_offsets);
+
+  /// Read and decompress the blocks of a compressed data payload that cover
+  /// [offset, offset + size) into output.
+  bool ReadFromCompressedDataSection(uint64_t offset, uint64_t size,
+                                     char *output) const;
+
+  /// Decompress a single block. Return false if the block is corrupted.
+  static bool DecompressBlock(SpilledObjectCodec codec, const std::string &input,
+                              std::string &output);
 
   /// Read 8 bytes from inputstream and deserialize it as a little-endian
   /// uint64_t. Return false if reach end of stream early.
@@ -97,6 +136,8 @@ class SpilledObjectReader : public IObjectReader {
   FRIEND_TEST(SpilledObjectReaderTest, ToUINT64);
   FRIEND_TEST(SpilledObjectReaderTest, ReadUINT64);
   FRIEND_TEST(SpilledObjectReaderTest, ParseObjectHeader);
+  FRIEND_TEST(SpilledObjectReaderTest, ParseCompressedObjectHeader);
+  FRIEND_TEST(SpilledObjectReaderTest, ParseCorruptCompressedObjectHeader);
   FRIEND_TEST(SpilledObjectReaderTest, Getters);
   FRIEND_TEST(ChunkObjectReaderTest, GetNumChunks);
 
@@ -107,6 +148,9 @@ class SpilledObjectReader : public IObjectReader {
   const uint64_t metadata_offset_;
   const uint64_t metadata_size_;
   const rpc::Address owner_address_;
+  const SpilledObjectCodec codec_;
+  const uint64_t block_size_;
+  const std::vector<uint64_t> block_offsets_;
 };
 
 }  // namespace ray
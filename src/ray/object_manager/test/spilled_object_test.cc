@@ -16,6 +16,8 @@
 #include "ray/object_manager/memory_object_reader.h"
 #include "ray/object_manager/spilled_object_reader.h"
 
+#include <zlib.h>
+
 #include <boost/endian/conversion.hpp>
 #include <fstream>
 
@@ -121,6 +123,49 @@ std::string ContructObjectString(uint64_t object_offset, std::string data,
   result.append(data);
   return result;
 }
+
+void AppendUINT64(std::string &result, uint64_t value) {
+  uint64_t little_endian = boost::endian::native_to_little(value);
+  result.append((char *)(&little_endian), 8);
+}
+
+/// Same as ContructObjectString, but the data payload is split into zlib compressed
+/// blocks of block_size bytes.
+std::string ContructCompressedObjectString(uint64_t object_offset, std::string data,
+                                           std::string metadata,
+                                           rpc::Address owner_address,
+                                           uint64_t block_size) {
+  std::string result(object_offset, '\0');
+  std::string address_str;
+  owner_address.SerializeToString(&address_str);
+  AppendUINT64(result, address_str.size() |
+                           (static_cast<uint64_t>(SpilledObjectCodec::kZlib) << 56));
+  AppendUINT64(result, metadata.size());
+  AppendUINT64(result, data.size());
+  result.append(address_str);
+  result.append(metadata);
+
+  std::vector<std::string> blocks;
+  for (uint64_t begin = 0; begin < data.size(); begin += block_size) {
+    auto block = data.substr(begin, block_size);
+    std::string compressed(compressBound(block.size()), '\0');
+    uLongf compressed_size = compressed.size();
+    RAY_CHECK(compress(reinterpret_cast<Bytef *>(&compressed[0]), &compressed_size,
+                       reinterpret_cast<const Bytef *>(block.data()),
+                       block.size()) == Z_OK);
+    compressed.resize(compressed_size);
+    blocks.push_back(std::move(compressed));
+  }
+  AppendUINT64(result, block_size);
+  AppendUINT64(result, blocks.size());
+  for (auto &block : blocks) {
+    AppendUINT64(result, block.size());
+  }
+  for (auto &block : blocks) {
+    result.append(block);
+  }
+  return result;
+}
 }  // namespace
 
 TEST(SpilledObjectReaderTest, ParseObjectHeader) {
@@ -134,10 +179,16 @@ TEST(SpilledObjectReaderTest, ParseObjectHeader) {
     uint64_t actual_metadata_offset = 0;
     uint64_t actual_metadata_size = 0;
     rpc::Address actual_owner_address;
+    SpilledObjectCodec actual_codec;
+    uint64_t actual_block_size = 0;
+    std::vector<uint64_t> actual_block_offsets;
     std::istringstream is(str);
     ASSERT_TRUE(SpilledObjectReader::ParseObjectHeader(
-        is, object_offset, actual_data_offset, actual_data_size, actual_metadata_offset,
-        actual_metadata_size, actual_owner_address));
+        is, object_offset, str.size() - object_offset, actual_data_offset,
+        actual_data_size, actual_metadata_offset, actual_metadata_size,
+        actual_owner_address, actual_codec, actual_block_size, actual_block_offsets));
+    ASSERT_EQ(SpilledObjectCodec::kNone, actual_codec);
+    ASSERT_TRUE(actual_block_offsets.empty());
     std::string address_str;
     owner_address.SerializeToString(&address_str);
     ASSERT_EQ(object_offset + 24 + address_str.size(), actual_metadata_offset);
@@ -171,16 +222,21 @@ TEST(SpilledObjectReaderTest, ParseObjectHeader) {
     std::string metadata("metadata");
     rpc::Address owner_address;
     auto str = ContructObjectString(object_offset, data, metadata, owner_address);
+    const uint64_t object_size = str.size() - object_offset;
     str = str.substr(0, truncate_size);
     uint64_t actual_data_offset = 0;
     uint64_t actual_data_size = 0;
     uint64_t actual_metadata_offset = 0;
     uint64_t actual_metadata_size = 0;
     rpc::Address actual_owner_address;
+    SpilledObjectCodec actual_codec;
+    uint64_t actual_block_size = 0;
+    std::vector<uint64_t> actual_block_offsets;
     std::istringstream is(str);
     ASSERT_FALSE(SpilledObjectReader::ParseObjectHeader(
-        is, object_offset, actual_data_offset, actual_data_size, actual_metadata_offset,
-        actual_metadata_size, actual_owner_address));
+        is, object_offset, object_size, actual_data_offset, actual_data_size,
+        actual_metadata_offset, actual_metadata_size, actual_owner_address, actual_codec,
+        actual_block_size, actual_block_offsets));
   };
 
   std::string address_str;
@@ -192,6 +248,108 @@ TEST(SpilledObjectReaderTest, ParseObjectHeader) {
   }
 }
 
+TEST(SpilledObjectReaderTest, ParseCompressedObjectHeader) {
+  std::string data(10000, 'c');
+  std::string metadata("metadata");
+  rpc::Address owner_address;
+  owner_address.set_raylet_id("yes");
+  auto str = ContructCompressedObjectString(100 /* object_offset */, data, metadata,
+                                            owner_address, 4096 /* block_size */);
+  uint64_t actual_data_offset = 0;
+  uint64_t actual_data_size = 0;
+  uint64_t actual_metadata_offset = 0;
+  uint64_t actual_metadata_size = 0;
+  rpc::Address actual_owner_address;
+  SpilledObjectCodec actual_codec;
+  uint64_t actual_block_size = 0;
+  std::vector<uint64_t> actual_block_offsets;
+  const uint64_t object_size = str.size() - 100;
+  std::istringstream is(str);
+  ASSERT_TRUE(SpilledObjectReader::ParseObjectHeader(
+      is, 100, object_size, actual_data_offset, actual_data_size, actual_metadata_offset,
+      actual_metadata_size, actual_owner_address, actual_codec, actual_block_size,
+      actual_block_offsets));
+  ASSERT_EQ(SpilledObjectCodec::kZlib, actual_codec);
+  ASSERT_EQ(data.size(), actual_data_size);
+  ASSERT_EQ(metadata.size(), actual_metadata_size);
+  ASSERT_EQ(metadata, str.substr(actual_metadata_offset, actual_metadata_size));
+  ASSERT_EQ(owner_address.raylet_id(), actual_owner_address.raylet_id());
+  ASSERT_EQ(4096, actual_block_size);
+  // 3 blocks plus the end offset.
+  ASSERT_EQ(4, actual_block_offsets.size());
+  ASSERT_EQ(actual_data_offset, actual_block_offsets.front());
+  ASSERT_EQ(str.size(), actual_block_offsets.back());
+  // Compressed data is much smaller than the raw data.
+  ASSERT_LT(str.size(), 100 + data.size());
+
+  // Truncated block table.
+  std::istringstream truncated(str.substr(0, actual_data_offset - 1));
+  ASSERT_FALSE(SpilledObjectReader::ParseObjectHeader(
+      truncated, 100, object_size, actual_data_offset, actual_data_size,
+      actual_metadata_offset, actual_metadata_size, actual_owner_address, actual_codec,
+      actual_block_size, actual_block_offsets));
+}
+
+TEST(SpilledObjectReaderTest, ParseCorruptCompressedObjectHeader) {
+  rpc::Address owner_address;
+  std::string address_str;
+  owner_address.SerializeToString(&address_str);
+  uint64_t data_offset = 0;
+  uint64_t data_size = 0;
+  uint64_t metadata_offset = 0;
+  uint64_t metadata_size = 0;
+  rpc::Address actual_owner_address;
+  SpilledObjectCodec codec;
+  uint64_t block_size = 0;
+  std::vector<uint64_t> block_offsets;
+  auto parse = [&](const std::string &str) {
+    std::istringstream is(str);
+    return SpilledObjectReader::ParseObjectHeader(
+        is, 0, str.size(), data_offset, data_size, metadata_offset, metadata_size,
+        actual_owner_address, codec, block_size, block_offsets);
+  };
+
+  // A header that claims far more blocks than the object holds, with a data size
+  // that matches them, must fail without allocating the block table.
+  const uint64_t num_blocks = uint64_t(1) << 60;
+  std::string str;
+  AppendUINT64(str, address_str.size() |
+                        (static_cast<uint64_t>(SpilledObjectCodec::kZlib) << 56));
+  AppendUINT64(str, 0);
+  AppendUINT64(str, num_blocks);
+  str.append(address_str);
+  AppendUINT64(str, 1);
+  AppendUINT64(str, num_blocks);
+  AppendUINT64(str, 1);
+  ASSERT_FALSE(parse(str));
+
+  // A block whose compressed size runs past the end of the object.
+  str.clear();
+  AppendUINT64(str, address_str.size() |
+                        (static_cast<uint64_t>(SpilledObjectCodec::kZlib) << 56));
+  AppendUINT64(str, 0);
+  AppendUINT64(str, 1);
+  str.append(address_str);
+  AppendUINT64(str, 1);
+  AppendUINT64(str, 1);
+  AppendUINT64(str, 1000);
+  str.append("x");
+  ASSERT_FALSE(parse(str));
+  // The same header is accepted once the block fits.
+  str.append(std::string(999, 'x'));
+  ASSERT_TRUE(parse(str));
+  ASSERT_EQ(2, block_offsets.size());
+  ASSERT_EQ(str.size(), block_offsets.back());
+
+  // An address size beyond the object.
+  str.clear();
+  AppendUINT64(str, (uint64_t(1) << 50) |
+                        (static_cast<uint64_t>(SpilledObjectCodec::kZlib) << 56));
+  AppendUINT64(str, 0);
+  AppendUINT64(str, 0);
+  ASSERT_FALSE(parse(str));
+}
+
 namespace {
 std::string CreateSpilledObjectReaderOnTmp(uint64_t object_offset, std::string data,
                                            std::string metadata,
@@ -210,6 +368,23 @@ std::string CreateSpilledObjectReaderOnTmp(uint64_t object_offset, std::string d
                          str.size() - object_offset);
 }
 
+std::string CreateCompressedSpilledObjectReaderOnTmp(uint64_t object_offset,
+                                                     std::string data,
+                                                     std::string metadata,
+                                                     rpc::Address owner_address,
+                                                     uint64_t block_size) {
+  auto str = ContructCompressedObjectString(object_offset, data, metadata,
+                                            owner_address, block_size);
+  std::string tmp_file = ray::JoinPaths(
+      ray::GetUserTempDir(), "spilled_object_test" + ObjectID::FromRandom().Hex());
+
+  std::ofstream f(tmp_file, std::ios::binary);
+  RAY_CHECK(f.write(str.c_str(), str.size()));
+  f.close();
+  return absl::StrFormat("%s?offset=%d&size=%d", tmp_file, object_offset,
+                         str.size() - object_offset);
+}
+
 MemoryObjectReader CreateMemoryObjectReader(std::string &data, std::string &metadata,
                                             rpc::Address owner_address) {
   plasma::ObjectBuffer object_buffer;
@@ -384,6 +559,49 @@ TYPED_TEST(ObjectReaderTest, GetChunk) {
   }
 }
 
+TEST(SpilledObjectReaderTest, ReadCompressedData) {
+  std::string data;
+  for (int i = 0; i < 1000; i++) {
+    data.append(std::to_string(i % 17));
+  }
+  std::string metadata("metadata");
+  rpc::Address owner_address;
+  owner_address.set_raylet_id("nonsense");
+
+  for (uint64_t block_size : {1, 7, 64, 10000}) {
+    auto object_url = CreateCompressedSpilledObjectReaderOnTmp(
+        10 /* object_offset */, data, metadata, owner_address, block_size);
+    auto optional_object = SpilledObjectReader::CreateSpilledObjectReader(object_url);
+    ASSERT_TRUE(optional_object.has_value());
+    auto reader = std::make_shared<SpilledObjectReader>(std::move(*optional_object));
+    ASSERT_EQ(data.size(), reader->GetDataSize());
+    ASSERT_EQ(metadata.size(), reader->GetMetadataSize());
+    ASSERT_EQ(owner_address.raylet_id(), reader->GetOwnerAddress().raylet_id());
+
+    for (uint64_t offset : {0, 1, 63, 64, 500}) {
+      for (uint64_t size : {0, 1, 64, 129, 400}) {
+        std::string result(size, '\0');
+        ASSERT_TRUE(reader->ReadFromDataSection(offset, size, &result[0]));
+        ASSERT_EQ(data.substr(offset, size), result);
+      }
+    }
+    std::string result(2, '\0');
+    ASSERT_FALSE(reader->ReadFromDataSection(data.size() - 1, 2, &result[0]));
+
+    // Chunked reads, as done by PushFromFilesystem, reconstruct the whole object.
+    for (uint64_t chunk_size : {1, 64, 333, 5000}) {
+      ChunkObjectReader chunk_reader(reader, chunk_size);
+      std::string actual_output_by_chunks;
+      for (uint64_t i = 0; i < chunk_reader.GetNumChunks(); i++) {
+        auto chunk = chunk_reader.GetChunk(i);
+        ASSERT_TRUE(chunk.has_value());
+        actual_output_by_chunks.append(chunk.value());
+      }
+      ASSERT_EQ(data + metadata, actual_output_by_chunks);
+    }
+  }
+}
+
 TEST(StringAllocationTest, TestNoCopyWhenStringMoved) {
   // Since protobuf always allocate string on heap,
   // move assign a string field doesn't copy the data.
@@ -555,6 +555,7 @@ void NodeManager::HandleJobStarted(const JobID &job_id, const JobTableData &job_
                 << job_data.driver_pid() << " is dead: " << job_data.is_dead()
                 << " driver address: " << job_data.driver_ip_address();
   worker_pool_.HandleJobStarted(job_id, job_data.config());
+  cluster_task_manager_->HandleJobStarted(job_id, job_data.config());
   // Tasks of this job may already arrived but failed to pop a worker because the job
   // config is not local yet. So we trigger dispatching again here to try to
   // reschedule these tasks.
@@ -565,6 +566,7 @@ void NodeManager::HandleJobFinished(const JobID &job_id, const JobTableData &job
   RAY_LOG(DEBUG) << "HandleJobFinished " << job_id;
   RAY_CHECK(job_data.is_dead());
   worker_pool_.HandleJobFinished(job_id);
+  cluster_task_manager_->HandleJobFinished(job_id);
 }
 
 void NodeManager::FillNormalTaskResourceUsage(rpc::ResourcesData &resources_data) {
@@ -1547,10 +1549,32 @@ void NodeManager::HandleReportWorkerBacklog(
     RAY_CHECK(seen.find(scheduling_class) == seen.end());
     cluster_task_manager_->SetWorkerBacklog(scheduling_class, worker_id,
                                             backlog_report.backlog_size());
+    // Warm up workers for a runtime env before its lease requests arrive, since
+    // creating the env can take much longer than starting a worker. Other workers
+    // are prestarted when the lease requests arrive.
+    if (resource_spec.HasRuntimeEnv()) {
+      PrestartWorkers(resource_spec,
+                      cluster_task_manager_->TotalBacklogSize(scheduling_class));
+    }
   }
   send_reply_callback(Status::OK(), nullptr, nullptr);
 }
 
+void NodeManager::PrestartWorkers(const TaskSpecification &task_spec,
+                                  int64_t backlog_size) {
+  if (!RayConfig::instance().enable_worker_prestart()) {
+    return;
+  }
+  // We floor the available CPUs to the nearest integer to avoid starting too
+  // many workers when there is less than 1 CPU left. Otherwise, we could end
+  // up repeatedly starting the worker, then killing it because it idles for
+  // too long. The downside is that we will be slower to schedule tasks that
+  // could use a fraction of a CPU.
+  int64_t available_cpus =
+      static_cast<int64_t>(cluster_resource_scheduler_->GetLocalAvailableCpus());
+  worker_pool_.PrestartWorkers(task_spec, backlog_size, available_cpus);
+}
+
 void NodeManager::HandleRequestWorkerLease(const rpc::RequestWorkerLeaseRequest &request,
                                            rpc::RequestWorkerLeaseReply *reply,
                                            rpc::SendReplyCallback send_reply_callback) {
@@ -1565,19 +1589,17 @@ void NodeManager::HandleRequestWorkerLease(const rpc::RequestWorkerLeaseRequest
     actor_id = task.GetTaskSpecification().ActorCreationId();
   }
 
-  if (RayConfig::instance().enable_worker_prestart()) {
-    auto task_spec = task.GetTaskSpecification();
-    // We floor the available CPUs to the nearest integer to avoid starting too
-    // many workers when there is less than 1 CPU left. Otherwise, we could end
-    // up repeatedly starting the worker, then killing it because it idles for
-    // too long. The downside is that we will be slower to schedule tasks that
-    // could use a fraction of a CPU.
-    int64_t available_cpus =
-        static_cast<int64_t>(cluster_resource_scheduler_->GetLocalAvailableCpus());
-    worker_pool_.PrestartWorkers(task_spec, request.backlog_size(), available_cpus);
-  }
+  // Other workers may have reported a backlog for the same scheduling class, which
+  // implies the same runtime env.
+  const int64_t backlog_size = std::max<int64_t>(
+      request.backlog_size(), cluster_task_manager_->TotalBacklogSize(
+                                  task.GetTaskSpecification().GetSchedulingClass()));
+  PrestartWorkers(task.GetTaskSpecification(), backlog_size);
 
+  const uint64_t reservation_token = request.reservation_token();
+  const int64_t received_time_ms = current_time_ms();
   auto send_reply_callback_wrapper = [this, is_actor_creation_task, actor_id, reply,
+                                      reservation_token, received_time_ms,
                                       send_reply_callback](
                                          Status status, std::function<void()> success,
                                          std::function<void()> failure) {
@@ -1602,11 +1624,28 @@ void NodeManager::HandleRequestWorkerLease(const rpc::RequestWorkerLeaseRequest
       resources_data->set_resources_normal_task_timestamp(absl::GetCurrentTimeNanos());
     }
 
+    // The raylet that spilled the request back to us keeps the resources reserved in
+    // its view of this node until our resource report says we handled the request.
+    if (reservation_token != 0) {
+      cluster_resource_scheduler_->AddHandledReservationToken(reservation_token);
+    }
+    std::string result = "Granted";
+    if (reply->canceled()) {
+      result = "Canceled";
+    } else if (reply->rejected()) {
+      result = "Rejected";
+    } else if (!reply->retry_at_raylet_address().raylet_id().empty()) {
+      result = "SpilledBack";
+    }
+    stats::STATS_scheduler_lease_request_latency_ms.Record(
+        current_time_ms() - received_time_ms, std::move(result));
+
     send_reply_callback(status, success, failure);
   };
 
-  cluster_task_manager_->QueueAndScheduleTask(task, request.grant_or_reject(), reply,
-                                              send_reply_callback_wrapper);
+  cluster_task_manager_->QueueAndScheduleLeases(task, request.grant_or_reject(),
+                                                request.max_leases(), reply,
+                                                send_reply_callback_wrapper);
 }
 
 void NodeManager::HandlePrepareBundleResources(
@@ -1678,6 +1717,23 @@ void NodeManager::HandleCancelResourceReserve(
 void NodeManager::HandleReturnWorker(const rpc::ReturnWorkerRequest &request,
                                      rpc::ReturnWorkerReply *reply,
                                      rpc::SendReplyCallback send_reply_callback) {
+  send_reply_callback(ReturnWorker(request), nullptr, nullptr);
+}
+
+void NodeManager::HandleReturnWorkers(const rpc::ReturnWorkersRequest &request,
+                                      rpc::ReturnWorkersReply *reply,
+                                      rpc::SendReplyCallback send_reply_callback) {
+  Status status;
+  for (const auto &worker_request : request.workers()) {
+    auto worker_status = ReturnWorker(worker_request);
+    if (!worker_status.ok()) {
+      status = worker_status;
+    }
+  }
+  send_reply_callback(status, nullptr, nullptr);
+}
+
+Status NodeManager::ReturnWorker(const rpc::ReturnWorkerRequest &request) {
   // Read the resource spec submitted by the client.
   auto worker_id = WorkerID::FromBinary(request.worker_id());
   std::shared_ptr<WorkerInterface> worker = leased_workers_[worker_id];
@@ -1700,7 +1756,7 @@ void NodeManager::HandleReturnWorker(const rpc::ReturnWorkerRequest &request,
   } else {
     status = Status::Invalid("Returned worker does not exist any more");
   }
-  send_reply_callback(status, nullptr, nullptr);
+  return status;
 }
 
 void NodeManager::HandleShutdownRaylet(const rpc::ShutdownRayletRequest &request,
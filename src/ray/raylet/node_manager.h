@@ -496,11 +496,29 @@ class NodeManager : public rpc::NodeManagerServiceHandler {
                                  rpc::ReportWorkerBacklogReply *reply,
                                  rpc::SendReplyCallback send_reply_callback) override;
 
+  /// Prestart workers for tasks like the given one, if worker prestart is enabled.
+  ///
+  /// \param task_spec The task whose scheduling class and runtime env the workers
+  /// should be able to run.
+  /// \param backlog_size The backlog reported for the task's scheduling class.
+  void PrestartWorkers(const TaskSpecification &task_spec, int64_t backlog_size);
+
   /// Handle a `ReturnWorker` request.
   void HandleReturnWorker(const rpc::ReturnWorkerRequest &request,
                           rpc::ReturnWorkerReply *reply,
                           rpc::SendReplyCallback send_reply_callback) override;
 
+  /// Handle a `ReturnWorkers` request.
+  void HandleReturnWorkers(const rpc::ReturnWorkersRequest &request,
+                           rpc::ReturnWorkersReply *reply,
+                           rpc::SendReplyCallback send_reply_callback) override;
+
+  /// Return a leased worker to the pool, or disconnect it if requested.
+  ///
+  /// \param request The worker to return.
+  /// \return Invalid if the worker is no longer leased.
+  Status ReturnWorker(const rpc::ReturnWorkerRequest &request);
+
   /// Handle a `ReleaseUnusedWorkers` request.
   void HandleReleaseUnusedWorkers(const rpc::ReleaseUnusedWorkersRequest &request,
                                   rpc::ReleaseUnusedWorkersReply *reply,
@@ -18,17 +18,61 @@
 
 #include "ray/common/grpc_util.h"
 #include "ray/common/ray_config.h"
+#include "ray/util/util.h"
 
 namespace ray {
 
+namespace {
+
+/// Subtract a request from a node's available resources, without going below zero.
+void SubtractAvailableResources(const ResourceRequest &resource_request,
+                                NodeResources *resources) {
+  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
+    resources->predefined_resources[i].available =
+        std::max(FixedPoint(0), resources->predefined_resources[i].available -
+                                    resource_request.predefined_resources[i]);
+  }
+
+  for (const auto &task_req_custom_resource : resource_request.custom_resources) {
+    auto it = resources->custom_resources.find(task_req_custom_resource.first);
+    if (it != resources->custom_resources.end()) {
+      it->second.available =
+          std::max(FixedPoint(0), it->second.available - task_req_custom_resource.second);
+    }
+  }
+
+  // TODO(swang): We should also subtract object store memory if the task has
+  // arguments. Right now we do not modify object_pulls_queued in case of
+  // performance regressions in spillback.
+}
+
+/// Undo SubtractAvailableResources.
+void AddAvailableResources(const ResourceRequest &resource_request,
+                           NodeResources *resources) {
+  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
+    auto &capacity = resources->predefined_resources[i];
+    capacity.available = std::min(
+        capacity.total, capacity.available + resource_request.predefined_resources[i]);
+  }
+
+  for (const auto &task_req_custom_resource : resource_request.custom_resources) {
+    auto it = resources->custom_resources.find(task_req_custom_resource.first);
+    if (it != resources->custom_resources.end()) {
+      it->second.available = std::min(
+          it->second.total, it->second.available + task_req_custom_resource.second);
+    }
+  }
+}
+
+}  // namespace
+
 ClusterResourceScheduler::ClusterResourceScheduler(
     int64_t local_node_id, const NodeResources &local_node_resources,
     gcs::GcsClient &gcs_client)
     : local_node_id_(local_node_id),
       gen_(std::chrono::high_resolution_clock::now().time_since_epoch().count()),
       gcs_client_(&gcs_client) {
-  scheduling_policy_ = std::make_unique<raylet_scheduling_policy::SchedulingPolicy>(
-      local_node_id_, nodes_);
+  InitSchedulingPolicy();
   InitResourceUnitInstanceInfo();
   AddOrUpdateNode(local_node_id_, local_node_resources);
   InitLocalResources(local_node_resources);
@@ -42,8 +86,7 @@ ClusterResourceScheduler::ClusterResourceScheduler(
     : get_pull_manager_at_capacity_(get_pull_manager_at_capacity),
       gcs_client_(&gcs_client) {
   local_node_id_ = string_to_int_map_.Insert(local_node_id);
-  scheduling_policy_ = std::make_unique<raylet_scheduling_policy::SchedulingPolicy>(
-      local_node_id_, nodes_);
+  InitSchedulingPolicy();
   NodeResources node_resources = ResourceMapToNodeResources(
       string_to_int_map_, local_node_resources, local_node_resources);
 
@@ -53,6 +96,20 @@ ClusterResourceScheduler::ClusterResourceScheduler(
   get_used_object_store_memory_ = get_used_object_store_memory;
 }
 
+void ClusterResourceScheduler::InitSchedulingPolicy() {
+  const NodeResourceTable *node_table = nullptr;
+  if (RayConfig::instance().scheduler_use_columnar_resource_table()) {
+    node_table = &node_table_;
+    const auto max_shapes = RayConfig::instance().scheduler_candidate_index_max_shapes();
+    if (max_shapes > 0) {
+      candidate_index_ = std::make_unique<SchedulingCandidateIndex>(
+          local_node_id_, node_table_, max_shapes);
+    }
+  }
+  scheduling_policy_ = std::make_unique<raylet_scheduling_policy::SchedulingPolicy>(
+      local_node_id_, nodes_, node_table, candidate_index_.get());
+}
+
 bool ClusterResourceScheduler::NodeAlive(int64_t node_id) const {
   if (node_id == local_node_id_) {
     return true;
@@ -108,6 +165,7 @@ void ClusterResourceScheduler::AddOrUpdateNode(int64_t node_id,
     // This node exists, so update its resources.
     it->second = Node(node_resources);
   }
+  OnNodeResourcesChanged(node_id);
 }
 
 bool ClusterResourceScheduler::UpdateNode(const std::string &node_id_string,
@@ -134,7 +192,16 @@ bool ClusterResourceScheduler::UpdateNode(const std::string &node_id_string,
     }
   }
 
-  if (resource_data.resources_available_changed()) {
+  // The report includes the tasks spilled back to the node whose lease requests it
+  // handled, so their reservations end. If the report leaves the available resources
+  // as they are, return the reserved resources to them.
+  const bool available_changed = resource_data.resources_available_changed();
+  for (uint64_t reservation_token : resource_data.handled_reservation_tokens()) {
+    ReleaseSpillbackReservation(reservation_token,
+                                available_changed ? nullptr : &local_view);
+  }
+
+  if (available_changed) {
     for (size_t i = 0; i < node_resources.predefined_resources.size(); ++i) {
       local_view.predefined_resources[i].available =
           node_resources.predefined_resources[i].available;
@@ -144,6 +211,16 @@ bool ClusterResourceScheduler::UpdateNode(const std::string &node_id_string,
     }
 
     local_view.object_pulls_queued = resource_data.object_pulls_queued();
+
+    // The node hasn't seen the tasks that are still reserved when it sent the report.
+    auto reservations_it = spillback_reservations_by_node_.find(node_id);
+    if (reservations_it != spillback_reservations_by_node_.end()) {
+      for (uint64_t reservation_token : reservations_it->second) {
+        SubtractAvailableResources(
+            spillback_reservations_.at(reservation_token).resource_request,
+            &local_view);
+      }
+    }
   }
 
   AddOrUpdateNode(node_id, local_view);
@@ -157,10 +234,69 @@ bool ClusterResourceScheduler::RemoveNode(int64_t node_id) {
     return false;
   } else {
     nodes_.erase(it);
+    node_table_.RemoveNode(node_id);
+    auto reservations_it = spillback_reservations_by_node_.find(node_id);
+    if (reservations_it != spillback_reservations_by_node_.end()) {
+      for (uint64_t reservation_token : reservations_it->second) {
+        spillback_reservations_.erase(reservation_token);
+      }
+      spillback_reservations_by_node_.erase(reservations_it);
+    }
+    if (candidate_index_) {
+      candidate_index_->OnNodeRemoved(node_id);
+    }
     return true;
   }
 }
 
+void ClusterResourceScheduler::OnNodeResourcesChanged(int64_t node_id) {
+  auto it = nodes_.find(node_id);
+  RAY_CHECK(it != nodes_.end());
+  std::vector<int64_t> grown_totals;
+  std::vector<int64_t> grown_available;
+  if (node_table_.AddOrUpdateNode(node_id, it->second.GetLocalView(), &grown_totals,
+                                  &grown_available)) {
+    availability_epoch_++;
+    if (grown_totals.empty() && grown_available.empty()) {
+      unattributed_gain_epoch_ = availability_epoch_;
+    }
+  }
+  for (int64_t resource_index : grown_totals) {
+    total_grown_epoch_by_resource_[GetResourceNameFromIndex(resource_index)] =
+        availability_epoch_;
+  }
+  for (int64_t resource_index : grown_available) {
+    available_grown_epoch_by_resource_[GetResourceNameFromIndex(resource_index)] =
+        availability_epoch_;
+  }
+  if (candidate_index_) {
+    candidate_index_->OnNodeUpdated(node_id, it->second.GetLocalView());
+  }
+}
+
+std::vector<std::string> ClusterResourceScheduler::GetResourcesWithTotalsGrownSince(
+    uint64_t epoch) const {
+  std::vector<std::string> resources;
+  for (const auto &entry : total_grown_epoch_by_resource_) {
+    if (entry.second > epoch) {
+      resources.push_back(entry.first);
+    }
+  }
+  return resources;
+}
+
+std::vector<std::string> ClusterResourceScheduler::GetResourcesWithAvailabilityGrownSince(
+    uint64_t epoch, bool *all_may_fit) const {
+  *all_may_fit = unattributed_gain_epoch_ > epoch;
+  std::vector<std::string> resources;
+  for (const auto &entry : available_grown_epoch_by_resource_) {
+    if (entry.second > epoch) {
+      resources.push_back(entry.first);
+    }
+  }
+  return resources;
+}
+
 bool ClusterResourceScheduler::RemoveNode(const std::string &node_id_string) {
   auto node_id = string_to_int_map_.Get(node_id_string);
   if (node_id == -1) {
@@ -214,6 +350,7 @@ int64_t ClusterResourceScheduler::GetBestSchedulableNode(
     const ResourceRequest &resource_request,
     const rpc::SchedulingStrategy &scheduling_strategy, bool actor_creation,
     bool force_spillback, int64_t *total_violations, bool *is_infeasible) {
+  ExpireSpillbackReservations();
   // The zero cpu actor is a special case that must be handled the same way by all
   // scheduling policies.
   if (actor_creation && resource_request.IsEmpty()) {
@@ -245,14 +382,17 @@ int64_t ClusterResourceScheduler::GetBestSchedulableNode(
 
   // TODO (Alex): Setting require_available == force_spillback is a hack in order to
   // remain bug compatible with the legacy scheduling algorithms.
-  int64_t best_node_id = scheduling_policy_->HybridPolicy(
-      resource_request,
-      scheduling_strategy.scheduling_strategy_case() ==
-              rpc::SchedulingStrategy::SchedulingStrategyCase::kSpreadSchedulingStrategy
-          ? 0.0
-          : RayConfig::instance().scheduler_spread_threshold(),
-      force_spillback, force_spillback,
-      [this](auto node_id) { return this->NodeAlive(node_id); });
+  auto is_node_available = [this](auto node_id) { return this->NodeAlive(node_id); };
+  const auto num_choices = RayConfig::instance().scheduler_power_of_d_choices();
+  int64_t best_node_id =
+      num_choices > 0
+          ? scheduling_policy_->PowerOfDChoicesPolicy(
+                resource_request, GetSpreadThreshold(scheduling_strategy),
+                force_spillback, force_spillback, is_node_available, num_choices)
+          : scheduling_policy_->HybridPolicy(resource_request,
+                                             GetSpreadThreshold(scheduling_strategy),
+                                             force_spillback, force_spillback,
+                                             is_node_available);
   *is_infeasible = best_node_id == -1 ? true : false;
   if (!*is_infeasible) {
     // TODO (Alex): Support soft constraints if needed later.
@@ -269,6 +409,15 @@ int64_t ClusterResourceScheduler::GetBestSchedulableNode(
   return best_node_id;
 }
 
+float ClusterResourceScheduler::GetSpreadThreshold(
+    const rpc::SchedulingStrategy &scheduling_strategy) const {
+  if (scheduling_strategy.scheduling_strategy_case() ==
+      rpc::SchedulingStrategy::SchedulingStrategyCase::kSpreadSchedulingStrategy) {
+    return 0.0;
+  }
+  return RayConfig::instance().scheduler_spread_threshold();
+}
+
 std::string ClusterResourceScheduler::GetBestSchedulableNode(
     const absl::flat_hash_map<std::string, double> &task_resources,
     const rpc::SchedulingStrategy &scheduling_strategy, bool requires_object_store_memory,
@@ -288,6 +437,46 @@ std::string ClusterResourceScheduler::GetBestSchedulableNode(
   return string_to_int_map_.Get(node_id);
 }
 
+std::vector<SchedulingAssignment> ClusterResourceScheduler::GetBestSchedulableNodes(
+    const absl::flat_hash_map<std::string, double> &task_resources,
+    const rpc::SchedulingStrategy &scheduling_strategy, int64_t num_requests,
+    bool *is_infeasible) {
+  ExpireSpillbackReservations();
+  // Spillback allocates with requires_object_store_memory=false, so the decisions must
+  // use the same request for the allocations below to match them.
+  ResourceRequest resource_request = ResourceMapToResourceRequest(
+      string_to_int_map_, task_resources, /*requires_object_store_memory=*/false);
+  const float spread_threshold = GetSpreadThreshold(scheduling_strategy);
+  std::vector<SchedulingAssignment> assignments;
+  *is_infeasible = false;
+  while (num_requests > 0) {
+    int64_t _unused;
+    int64_t node_id =
+        GetBestSchedulableNode(resource_request, scheduling_strategy,
+                               /*actor_creation=*/false,
+                               /*force_spillback=*/false, &_unused, is_infeasible);
+    if (node_id == -1) {
+      break;
+    }
+    // Requests that stay on the local node are queued without changing its resources,
+    // so the policy would keep picking it for all the remaining requests. The same
+    // goes for a remote node that is feasible but has no available resources.
+    int64_t count = num_requests;
+    bool allocated = false;
+    if (node_id != local_node_id_) {
+      const int64_t num_allocated = SubtractRemoteNodeAvailableResourcesForBatch(
+          node_id, resource_request, spread_threshold, num_requests);
+      if (num_allocated > 0) {
+        count = num_allocated;
+        allocated = true;
+      }
+    }
+    assignments.push_back({string_to_int_map_.Get(node_id), count, allocated});
+    num_requests -= count;
+  }
+  return assignments;
+}
+
 bool ClusterResourceScheduler::SubtractRemoteNodeAvailableResources(
     int64_t node_id, const ResourceRequest &resource_request) {
   RAY_CHECK(node_id != local_node_id_);
@@ -303,27 +492,36 @@ bool ClusterResourceScheduler::SubtractRemoteNodeAvailableResources(
     return false;
   }
 
-  FixedPoint zero(0.);
-
-  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
-    resources->predefined_resources[i].available =
-        std::max(FixedPoint(0), resources->predefined_resources[i].available -
-                                    resource_request.predefined_resources[i]);
-  }
-
-  for (const auto &task_req_custom_resource : resource_request.custom_resources) {
-    auto it = resources->custom_resources.find(task_req_custom_resource.first);
-    if (it != resources->custom_resources.end()) {
-      it->second.available =
-          std::max(FixedPoint(0), it->second.available - task_req_custom_resource.second);
-    }
-  }
+  SubtractAvailableResources(resource_request, resources);
+  OnNodeResourcesChanged(node_id);
+  return true;
+}
 
-  // TODO(swang): We should also subtract object store memory if the task has
-  // arguments. Right now we do not modify object_pulls_queued in case of
-  // performance regressions in spillback.
+int64_t ClusterResourceScheduler::SubtractRemoteNodeAvailableResourcesForBatch(
+    int64_t node_id, const ResourceRequest &resource_request, float spread_threshold,
+    int64_t max_requests) {
+  RAY_CHECK(node_id != local_node_id_);
+  auto it = nodes_.find(node_id);
+  RAY_CHECK(it != nodes_.end());
+  NodeResources *resources = it->second.GetMutableLocalView();
+  auto score = [resources, spread_threshold]() {
+    float utilization = resources->CalculateCriticalResourceUtilization();
+    return utilization < spread_threshold ? 0 : utilization;
+  };
 
-  return true;
+  if (!IsSchedulable(resource_request, node_id, *resources)) {
+    return 0;
+  }
+  const float picked_score = score();
+  int64_t num_requests = 0;
+  do {
+    SubtractAvailableResources(resource_request, resources);
+    num_requests++;
+  } while (num_requests < max_requests &&
+           IsSchedulable(resource_request, node_id, *resources) &&
+           score() <= picked_score);
+  OnNodeResourcesChanged(node_id);
+  return num_requests;
 }
 
 bool ClusterResourceScheduler::GetNodeResources(int64_t node_id,
@@ -469,6 +667,7 @@ void ClusterResourceScheduler::UpdateResourceCapacity(const std::string &node_id
       local_view->custom_resources.emplace(resource_id, resource_capacity);
     }
   }
+  OnNodeResourcesChanged(node_id);
 }
 
 void ClusterResourceScheduler::DeleteLocalResource(const std::string &resource_name) {
@@ -520,6 +719,7 @@ void ClusterResourceScheduler::DeleteResource(const std::string &node_id_string,
       local_resources_.custom_resources.erase(c_itr);
     }
   }
+  OnNodeResourcesChanged(node_id);
 }
 
 bool ClusterResourceScheduler::ResourcesExist(const std::string &resource_name) {
@@ -876,6 +1076,7 @@ void ClusterResourceScheduler::UpdateLocalAvailableResourcesFromResourceInstance
     local_view->custom_resources[resource_name].available = available;
     local_view->custom_resources[resource_name].total = total;
   }
+  OnNodeResourcesChanged(local_node_id_);
 }
 
 void ClusterResourceScheduler::FreeTaskResourceInstances(
@@ -1008,6 +1209,78 @@ bool ClusterResourceScheduler::AllocateRemoteTaskResources(
   return SubtractRemoteNodeAvailableResources(node_id, resource_request);
 }
 
+uint64_t ClusterResourceScheduler::ReserveRemoteTaskResources(
+    const std::string &node_string,
+    const absl::flat_hash_map<std::string, double> &task_resources, bool allocate) {
+  if (allocate && !AllocateRemoteTaskResources(node_string, task_resources)) {
+    return 0;
+  }
+  const auto timeout_ms =
+      RayConfig::instance().scheduler_spillback_reservation_timeout_ms();
+  const int64_t node_id = string_to_int_map_.Insert(node_string);
+  if (timeout_ms == 0 || !nodes_.contains(node_id)) {
+    return 0;
+  }
+
+  uint64_t reservation_token;
+  do {
+    reservation_token = gen_();
+  } while (reservation_token == 0 || spillback_reservations_.contains(reservation_token));
+  spillback_reservations_.emplace(
+      reservation_token,
+      SpillbackReservation{node_id,
+                           ResourceMapToResourceRequest(
+                               string_to_int_map_, task_resources,
+                               /*requires_object_store_memory=*/false),
+                           current_time_ms() + static_cast<int64_t>(timeout_ms)});
+  spillback_reservations_by_node_[node_id].insert(reservation_token);
+  spillback_reservation_expirations_.push_back(reservation_token);
+  return reservation_token;
+}
+
+void ClusterResourceScheduler::AddHandledReservationToken(uint64_t reservation_token) {
+  handled_reservation_tokens_.push_back(reservation_token);
+}
+
+void ClusterResourceScheduler::ReleaseSpillbackReservation(
+    uint64_t reservation_token, NodeResources *node_resources) {
+  auto it = spillback_reservations_.find(reservation_token);
+  if (it == spillback_reservations_.end()) {
+    // Reserved by another raylet, expired, or the node was removed.
+    return;
+  }
+  if (node_resources != nullptr) {
+    AddAvailableResources(it->second.resource_request, node_resources);
+  }
+  auto node_it = spillback_reservations_by_node_.find(it->second.node_id);
+  RAY_CHECK(node_it != spillback_reservations_by_node_.end());
+  node_it->second.erase(reservation_token);
+  if (node_it->second.empty()) {
+    spillback_reservations_by_node_.erase(node_it);
+  }
+  spillback_reservations_.erase(it);
+}
+
+void ClusterResourceScheduler::ExpireSpillbackReservations() {
+  const int64_t now_ms = current_time_ms();
+  while (!spillback_reservation_expirations_.empty()) {
+    const uint64_t reservation_token = spillback_reservation_expirations_.front();
+    auto it = spillback_reservations_.find(reservation_token);
+    if (it != spillback_reservations_.end()) {
+      if (it->second.expiration_time_ms > now_ms) {
+        break;
+      }
+      const int64_t node_id = it->second.node_id;
+      RAY_LOG(DEBUG) << "Spillback reservation " << reservation_token << " on node "
+                     << node_id << " expired";
+      ReleaseSpillbackReservation(reservation_token,
+                                  nodes_.at(node_id).GetMutableLocalView());
+      OnNodeResourcesChanged(node_id);
+    }
+    spillback_reservation_expirations_.pop_front();
+  }
+}
+
 void ClusterResourceScheduler::ReleaseWorkerResources(
     std::shared_ptr<TaskResourceInstances> task_allocation) {
   if (task_allocation == nullptr || task_allocation->IsEmpty()) {
@@ -1092,6 +1365,10 @@ void ClusterResourceScheduler::FillResourceUsage(rpc::ResourcesData &resources_d
   if (!RayConfig::instance().enable_light_weight_resource_report()) {
     resources_data.set_resources_available_changed(true);
   }
+
+  resources_data.mutable_handled_reservation_tokens()->Add(
+      handled_reservation_tokens_.begin(), handled_reservation_tokens_.end());
+  handled_reservation_tokens_.clear();
 }
 
 double ClusterResourceScheduler::GetLocalAvailableCpus() const {
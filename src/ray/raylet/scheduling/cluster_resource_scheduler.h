@@ -16,6 +16,7 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <deque>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -28,6 +29,8 @@
 #include "ray/raylet/scheduling/cluster_resource_data.h"
 #include "ray/raylet/scheduling/cluster_resource_scheduler_interface.h"
 #include "ray/raylet/scheduling/fixed_point.h"
+#include "ray/raylet/scheduling/node_resource_table.h"
+#include "ray/raylet/scheduling/scheduling_candidate_index.h"
 #include "ray/raylet/scheduling/scheduling_ids.h"
 #include "ray/raylet/scheduling/scheduling_policy.h"
 #include "ray/util/logging.h"
@@ -37,6 +40,18 @@ namespace ray {
 
 using rpc::HeartbeatTableData;
 
+/// A group of identical requests that the scheduler sent to the same node, see
+/// ClusterResourceScheduler::GetBestSchedulableNodes().
+struct SchedulingAssignment {
+  /// The node the requests go to.
+  std::string node_id;
+  /// The number of requests in the group.
+  int64_t count;
+  /// Whether the requests' resources were subtracted from the view of the remote node.
+  /// False for the local node, and for a remote node that can't take the requests.
+  bool allocated;
+};
+
 /// Class encapsulating the cluster resources and the logic to assign
 /// tasks to nodes based on the task's constraints and the available
 /// resources at those nodes.
@@ -113,12 +128,51 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
       bool requires_object_store_memory, bool actor_creation, bool force_spillback,
       int64_t *violations, bool *is_infeasible);
 
+  /// Find the nodes to schedule a batch of identical non-actor requests on. The result
+  /// is the same as calling GetBestSchedulableNode (without forcing spillback) once per
+  /// request and calling AllocateRemoteTaskResources for every request that goes to a
+  /// remote node, but the scheduling policy only runs once per returned group.
+  ///
+  /// \param task_resources: The resources required by each request.
+  /// \param scheduling_strategy: The scheduling strategy of the requests.
+  /// \param num_requests: The number of requests in the batch.
+  /// \param is_infeasible[out]: Set to true if the requests are infeasible.
+  ///
+  /// \return The groups of requests per node, in scheduling order. The counts add up
+  /// to `num_requests`, unless no node can schedule the requests.
+  std::vector<SchedulingAssignment> GetBestSchedulableNodes(
+      const absl::flat_hash_map<std::string, double> &task_resources,
+      const rpc::SchedulingStrategy &scheduling_strategy, int64_t num_requests,
+      bool *is_infeasible);
+
   /// Get local node resources.
   const NodeResources &GetLocalNodeResources() const;
 
   /// Get number of nodes in the cluster.
   int64_t NumNodes() const;
 
+  /// Get a counter that is bumped whenever a node is added or any node's resources
+  /// grow. Callers can skip re-evaluating requests that failed to schedule as long as
+  /// the counter is unchanged.
+  uint64_t GetAvailabilityEpoch() const { return availability_epoch_; }
+
+  /// Get the resources whose total grew on some node after the given availability
+  /// epoch. A request that was infeasible and requires none of these resources is
+  /// still infeasible.
+  ///
+  /// \param epoch: An epoch previously returned by GetAvailabilityEpoch().
+  std::vector<std::string> GetResourcesWithTotalsGrownSince(uint64_t epoch) const;
+
+  /// Get the resources whose available amount grew on some node after the given
+  /// availability epoch. A request that didn't fit and requires none of these
+  /// resources still doesn't fit, unless `all_may_fit` is set.
+  ///
+  /// \param epoch: An epoch previously returned by GetAvailabilityEpoch().
+  /// \param[out] all_may_fit: Set if any request may fit now, e.g., because a node
+  /// stopped queueing object pulls.
+  std::vector<std::string> GetResourcesWithAvailabilityGrownSince(
+      uint64_t epoch, bool *all_may_fit) const;
+
   /// Temporarily get the StringIDMap.
   const StringIdMap &GetStringIdMap() const;
 
@@ -248,6 +302,23 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
       const std::string &node_id,
       const absl::flat_hash_map<std::string, double> &task_resources);
 
+  /// Reserve the resources of a task spilled back to a remote node in the local view of
+  /// the node, until the node reports that it handled the lease request or the
+  /// reservation expires. Resource reports sent by the node before that don't include
+  /// the task, so the reserved resources are subtracted from them.
+  ///
+  /// \param node_id Remote node the task is spilled back to.
+  /// \param task_resources Resources required by the task.
+  /// \param allocate Whether to subtract the resources from the node, or whether the
+  /// caller already did.
+  /// \return The token the node reports once it handled the lease request, or 0 if
+  /// nothing was reserved.
+  uint64_t ReserveRemoteTaskResources(
+      const std::string &node_id,
+      const absl::flat_hash_map<std::string, double> &task_resources, bool allocate);
+
+  void AddHandledReservationToken(uint64_t reservation_token) override;
+
   void ReleaseWorkerResources(std::shared_ptr<TaskResourceInstances> task_allocation);
 
   /// Update the available resources of the local node given
@@ -331,6 +402,10 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
   /// Init the information about which resources are unit_instance.
   void InitResourceUnitInstanceInfo();
 
+  /// Create the scheduling policy and the structures it reads from, according to the
+  /// config. `local_node_id_` must be set.
+  void InitSchedulingPolicy();
+
   /// Decrease the available resources of a node when a resource request is
   /// scheduled on the given node.
   ///
@@ -342,6 +417,35 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
   bool SubtractRemoteNodeAvailableResources(int64_t node_id,
                                             const ResourceRequest &resource_request);
 
+  /// Subtract copies of a resource request from a remote node that the scheduling
+  /// policy just picked, for as long as the policy would keep picking the node: while
+  /// the node is still available for the request and its utilization score doesn't
+  /// increase, no other node can become preferable.
+  ///
+  /// \param node_id: The remote node picked by the policy.
+  /// \param resource_request: The request to subtract.
+  /// \param spread_threshold: The spread threshold the policy used.
+  /// \param max_requests: The maximum number of copies to subtract.
+  /// \return The number of requests subtracted from the node, or 0 if the node can't
+  /// take the request right now.
+  int64_t SubtractRemoteNodeAvailableResourcesForBatch(
+      int64_t node_id, const ResourceRequest &resource_request, float spread_threshold,
+      int64_t max_requests);
+
+  /// Release a reservation made by ReserveRemoteTaskResources.
+  ///
+  /// \param reservation_token: Token of the reservation. Unknown tokens are ignored.
+  /// \param node_resources: If set, the view of the reserved node to return the
+  /// reserved resources to.
+  void ReleaseSpillbackReservation(uint64_t reservation_token,
+                                   NodeResources *node_resources);
+
+  /// Release the reservations that have expired.
+  void ExpireSpillbackReservations();
+
+  /// The spread threshold of the hybrid policy for a scheduling strategy.
+  float GetSpreadThreshold(const rpc::SchedulingStrategy &scheduling_strategy) const;
+
   /// Add a new node or overwrite the resources of an existing node.
   ///
   /// \param node_id: Node ID.
@@ -354,6 +458,12 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
   /// \param node_id ID of the node to be removed.
   bool RemoveNode(int64_t node_id);
 
+  /// Propagate a change of a node's local view in `nodes_` to the derived scheduling
+  /// state. Must be called after every modification of a node's resources.
+  ///
+  /// \param node_id: ID of the node whose resources changed.
+  void OnNodeResourcesChanged(int64_t node_id);
+
   /// Check whether a resource request can be scheduled given a node.
   ///
   ///  \param resource_request: Resource request to be scheduled.
@@ -398,6 +508,36 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
   /// List of nodes in the clusters and their resources organized as a map.
   /// The key of the map is the node ID.
   absl::flat_hash_map<int64_t, Node> nodes_;
+  /// Columnar copy of the local views in `nodes_`, used by the scheduling policy.
+  NodeResourceTable node_table_;
+  /// Per resource shape ranking of the nodes in `node_table_`, or nullptr if disabled.
+  std::unique_ptr<SchedulingCandidateIndex> candidate_index_;
+  /// Bumped whenever `node_table_` gains resources, see GetAvailabilityEpoch().
+  uint64_t availability_epoch_ = 0;
+  /// The availability epoch at which each resource's total last grew on some node.
+  absl::flat_hash_map<std::string, uint64_t> total_grown_epoch_by_resource_;
+  /// The availability epoch at which each resource's available amount last grew on
+  /// some node.
+  absl::flat_hash_map<std::string, uint64_t> available_grown_epoch_by_resource_;
+  /// The last availability epoch at which a node gained without any of its resources
+  /// growing, e.g., because it stopped queueing object pulls.
+  uint64_t unattributed_gain_epoch_ = 0;
+  /// A task spilled back to a remote node whose resources are still subtracted from
+  /// the local view of the node, see ReserveRemoteTaskResources().
+  struct SpillbackReservation {
+    int64_t node_id;
+    ResourceRequest resource_request;
+    int64_t expiration_time_ms;
+  };
+  /// The outstanding reservations by token.
+  absl::flat_hash_map<uint64_t, SpillbackReservation> spillback_reservations_;
+  /// The tokens of the outstanding reservations per node.
+  absl::flat_hash_map<int64_t, absl::flat_hash_set<uint64_t>>
+      spillback_reservations_by_node_;
+  /// Reservation tokens in the order they expire. May contain released reservations.
+  std::deque<uint64_t> spillback_reservation_expirations_;
+  /// Reservation tokens of the lease requests this node handled since the last report.
+  std::vector<uint64_t> handled_reservation_tokens_;
   /// Identifier of local node.
   int64_t local_node_id_;
   /// The scheduling policy to use.
@@ -436,6 +576,8 @@ class ClusterResourceScheduler : public ClusterResourceSchedulerInterface {
               UpdateLocalAvailableResourcesFromResourceInstancesTest);
   FRIEND_TEST(ClusterResourceSchedulerTest, ResourceUsageReportTest);
   FRIEND_TEST(ClusterResourceSchedulerTest, ObjectStoreMemoryUsageTest);
+  FRIEND_TEST(ClusterResourceSchedulerTest, SpillbackReservationTest);
+  FRIEND_TEST(ClusterResourceSchedulerTest, SpillbackReservationUnavailableNodeTest);
   FRIEND_TEST(ClusterResourceSchedulerTest, AvailableResourceInstancesOpsTest);
 };
 
@@ -72,6 +72,13 @@ class ClusterResourceSchedulerInterface {
   /// fields used.
   virtual void FillResourceUsage(rpc::ResourcesData &data) = 0;
 
+  /// Record that a lease request spilled back to this node has been granted, rejected
+  /// or canceled. The reservation token is sent with the next resource report, so that
+  /// the raylet that spilled the request back releases its reservation.
+  ///
+  /// \param reservation_token: The token of the request, see RequestWorkerLeaseRequest.
+  virtual void AddHandledReservationToken(uint64_t reservation_token) {}
+
   virtual double GetLocalAvailableCpus() const = 0;
 
   /// Populate a UpdateResourcesRequest. This is inteneded to update the
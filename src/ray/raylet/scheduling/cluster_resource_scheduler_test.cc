@@ -25,6 +25,7 @@
 #include "mock/ray/gcs/gcs_client/gcs_client.h"
 #ifdef UNORDERED_VS_ABSL_MAPS_EVALUATION
 #include <chrono>
+#include <thread>
 
 #include "absl/container/flat_hash_map.h"
 #endif  // UNORDERED_VS_ABSL_MAPS_EVALUATION
@@ -1204,6 +1205,157 @@ TEST_F(ClusterResourceSchedulerTest, DirtyLocalViewTest) {
   }
 }
 
+TEST_F(ClusterResourceSchedulerTest, SpillbackReservationTest) {
+  RayConfig::instance().initialize(
+      R"(
+{
+  "scheduler_spillback_reservation_timeout_ms": 2000
+}
+  )");
+  ClusterResourceScheduler resource_scheduler("local", {{"CPU", 1}}, *gcs_client_);
+  auto remote = NodeID::FromRandom().Binary();
+  resource_scheduler.AddOrUpdateNode(remote, {{"CPU", 2.}}, {{"CPU", 2.}});
+  const absl::flat_hash_map<std::string, double> task_spec = {{"CPU", 1.}};
+  auto remote_available_cpus = [&]() {
+    NodeResources resources;
+    RAY_CHECK(resource_scheduler.GetNodeResources(
+        resource_scheduler.string_to_int_map_.Get(remote), &resources));
+    return resources.predefined_resources[CPU].available.Double();
+  };
+  auto report = [&](absl::optional<double> available_cpus,
+                    const std::vector<uint64_t> &handled_tokens) {
+    rpc::ResourcesData data;
+    (*data.mutable_resources_total())["CPU"] = 2;
+    if (available_cpus) {
+      data.set_resources_available_changed(true);
+      (*data.mutable_resources_available())["CPU"] = *available_cpus;
+    }
+    data.mutable_handled_reservation_tokens()->Add(handled_tokens.begin(),
+                                                   handled_tokens.end());
+    ASSERT_TRUE(resource_scheduler.UpdateNode(remote, data));
+  };
+
+  const uint64_t token1 =
+      resource_scheduler.ReserveRemoteTaskResources(remote, task_spec, true);
+  ASSERT_NE(token1, 0u);
+  ASSERT_EQ(remote_available_cpus(), 1);
+  // A report sent before the remote node received the task doesn't undo the
+  // reservation.
+  report(2, {});
+  ASSERT_EQ(remote_available_cpus(), 1);
+
+  const uint64_t token2 =
+      resource_scheduler.ReserveRemoteTaskResources(remote, task_spec, true);
+  ASSERT_NE(token2, 0u);
+  ASSERT_NE(token2, token1);
+  ASSERT_EQ(remote_available_cpus(), 0);
+  // Nothing left to reserve.
+  ASSERT_EQ(resource_scheduler.ReserveRemoteTaskResources(remote, task_spec, true), 0u);
+
+  // The remote node granted the first task, the second one is still reserved.
+  report(1, {token1});
+  ASSERT_EQ(remote_available_cpus(), 0);
+  // The remote node rejected the second task without a change of its resources.
+  report(absl::nullopt, {token2});
+  ASSERT_EQ(remote_available_cpus(), 1);
+  // Tokens of other raylets are ignored.
+  report(1, {token1, token2, 12345});
+  ASSERT_EQ(remote_available_cpus(), 1);
+
+  // Reservations expire if the remote node never reports the token.
+  RayConfig::instance().initialize(
+      R"(
+{
+  "scheduler_spillback_reservation_timeout_ms": 1
+}
+  )");
+  ASSERT_NE(resource_scheduler.ReserveRemoteTaskResources(remote, task_spec, true), 0u);
+  report(1, {});
+  ASSERT_EQ(remote_available_cpus(), 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  int64_t violations;
+  bool is_infeasible;
+  rpc::SchedulingStrategy scheduling_strategy;
+  scheduling_strategy.mutable_default_scheduling_strategy();
+  resource_scheduler.GetBestSchedulableNode(task_spec, scheduling_strategy, false,
+                                            false, false, &violations, &is_infeasible);
+  ASSERT_EQ(remote_available_cpus(), 1);
+  ASSERT_TRUE(resource_scheduler.spillback_reservations_.empty());
+  ASSERT_TRUE(resource_scheduler.spillback_reservations_by_node_.empty());
+
+  // The node reports the tokens of the requests spilled back to it once.
+  resource_scheduler.AddHandledReservationToken(token1);
+  rpc::ResourcesData data;
+  resource_scheduler.FillResourceUsage(data);
+  ASSERT_EQ(data.handled_reservation_tokens_size(), 1);
+  ASSERT_EQ(data.handled_reservation_tokens(0), token1);
+  data.Clear();
+  resource_scheduler.FillResourceUsage(data);
+  ASSERT_EQ(data.handled_reservation_tokens_size(), 0);
+
+  RayConfig::instance().initialize(
+      R"(
+{
+  "scheduler_spillback_reservation_timeout_ms": 0
+}
+  )");
+}
+
+TEST_F(ClusterResourceSchedulerTest, SpillbackReservationUnavailableNodeTest) {
+  RayConfig::instance().initialize(
+      R"(
+{
+  "scheduler_spillback_reservation_timeout_ms": 1
+}
+  )");
+  // The local node can't run the requests, and the remote node can but has no CPUs
+  // available, so the policy still picks the remote node.
+  ClusterResourceScheduler resource_scheduler("local", {{"GPU", 1}}, *gcs_client_);
+  auto remote = NodeID::FromRandom().Binary();
+  resource_scheduler.AddOrUpdateNode(remote, {{"CPU", 2.}}, {{"CPU", 0.}});
+  const absl::flat_hash_map<std::string, double> task_spec = {{"CPU", 1.}};
+  auto remote_available_cpus = [&]() {
+    NodeResources resources;
+    RAY_CHECK(resource_scheduler.GetNodeResources(
+        resource_scheduler.string_to_int_map_.Get(remote), &resources));
+    return resources.predefined_resources[CPU].available.Double();
+  };
+  rpc::SchedulingStrategy scheduling_strategy;
+  scheduling_strategy.mutable_default_scheduling_strategy();
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool is_infeasible;
+    auto assignments = resource_scheduler.GetBestSchedulableNodes(
+        task_spec, scheduling_strategy, 3, &is_infeasible);
+    ASSERT_FALSE(is_infeasible);
+    ASSERT_EQ(assignments.size(), 1);
+    ASSERT_EQ(assignments[0].node_id, remote);
+    ASSERT_EQ(assignments[0].count, 3);
+    ASSERT_FALSE(assignments[0].allocated);
+    // Nothing was subtracted from the node, so spilling the requests back to it
+    // reserves nothing either.
+    for (int i = 0; i < assignments[0].count; i++) {
+      ASSERT_EQ(resource_scheduler.ReserveRemoteTaskResources(
+                    remote, task_spec, /*allocate=*/!assignments[0].allocated),
+                0u);
+    }
+    ASSERT_TRUE(resource_scheduler.spillback_reservations_.empty());
+    // Once reservations would have expired, the node still has no CPUs available.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int64_t violations;
+    resource_scheduler.GetBestSchedulableNode(task_spec, scheduling_strategy, false,
+                                              false, false, &violations, &is_infeasible);
+    ASSERT_EQ(remote_available_cpus(), 0);
+  }
+
+  RayConfig::instance().initialize(
+      R"(
+{
+  "scheduler_spillback_reservation_timeout_ms": 0
+}
+  )");
+}
+
 TEST_F(ClusterResourceSchedulerTest, DynamicResourceTest) {
   ClusterResourceScheduler resource_scheduler("local", {{"CPU", 2}}, *gcs_client_);
 
@@ -1240,6 +1392,44 @@ TEST_F(ClusterResourceSchedulerTest, DynamicResourceTest) {
   ASSERT_TRUE(result.empty());
 }
 
+TEST_F(ClusterResourceSchedulerTest, ResourcesWithGrownTotalsTest) {
+  ClusterResourceScheduler resource_scheduler("local", {{"CPU", 2}}, *gcs_client_);
+  uint64_t epoch = resource_scheduler.GetAvailabilityEpoch();
+  ASSERT_TRUE(resource_scheduler.GetResourcesWithTotalsGrownSince(epoch).empty());
+
+  // A new node grows the totals of all of its resources.
+  auto remote = NodeID::FromRandom().Binary();
+  resource_scheduler.AddOrUpdateNode(remote, {{"CPU", 4}, {"GPU", 1}},
+                                     {{"CPU", 4}, {"GPU", 1}});
+  ASSERT_GT(resource_scheduler.GetAvailabilityEpoch(), epoch);
+  auto grown = resource_scheduler.GetResourcesWithTotalsGrownSince(epoch);
+  std::sort(grown.begin(), grown.end());
+  ASSERT_EQ(grown, std::vector<std::string>({"CPU", "GPU"}));
+
+  // Using up resources doesn't change the epoch.
+  epoch = resource_scheduler.GetAvailabilityEpoch();
+  resource_scheduler.AddOrUpdateNode(remote, {{"CPU", 4}, {"GPU", 1}},
+                                     {{"CPU", 2}, {"GPU", 1}});
+  ASSERT_EQ(resource_scheduler.GetAvailabilityEpoch(), epoch);
+
+  // Freeing resources changes the epoch, but no total grew. Only the freed resource's
+  // availability grew.
+  resource_scheduler.AddOrUpdateNode(remote, {{"CPU", 4}, {"GPU", 1}},
+                                     {{"CPU", 4}, {"GPU", 1}});
+  ASSERT_GT(resource_scheduler.GetAvailabilityEpoch(), epoch);
+  ASSERT_TRUE(resource_scheduler.GetResourcesWithTotalsGrownSince(epoch).empty());
+  bool all_may_fit = true;
+  auto grown_available =
+      resource_scheduler.GetResourcesWithAvailabilityGrownSince(epoch, &all_may_fit);
+  ASSERT_EQ(grown_available, std::vector<std::string>({"CPU"}));
+  ASSERT_FALSE(all_may_fit);
+
+  epoch = resource_scheduler.GetAvailabilityEpoch();
+  resource_scheduler.AddLocalResourceInstances("custom123", {1.0});
+  ASSERT_EQ(resource_scheduler.GetResourcesWithTotalsGrownSince(epoch),
+            std::vector<std::string>({"custom123"}));
+}
+
 TEST_F(ClusterResourceSchedulerTest, AvailableResourceEmptyTest) {
   ClusterResourceScheduler resource_scheduler("local", {{"custom123", 5}}, *gcs_client_);
   std::shared_ptr<TaskResourceInstances> resource_instances =
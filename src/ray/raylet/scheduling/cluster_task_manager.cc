@@ -16,6 +16,8 @@
 
 #include <google/protobuf/map.h>
 
+#include <queue>
+
 #include <boost/range/join.hpp>
 
 #include "ray/stats/metric_defs.h"
@@ -56,17 +58,39 @@ ClusterTaskManager::ClusterTaskManager(
       get_time_ms_(get_time_ms),
       sched_cls_cap_enabled_(RayConfig::instance().worker_cap_enabled()),
       sched_cls_cap_interval_ms_(sched_cls_cap_interval_ms),
-      sched_cls_cap_max_ms_(RayConfig::instance().worker_cap_max_backoff_delay_ms()) {}
+      sched_cls_cap_max_ms_(RayConfig::instance().worker_cap_max_backoff_delay_ms()),
+      batch_scheduling_enabled_(RayConfig::instance().scheduler_batch_pending_tasks()),
+      job_fair_sharing_enabled_(RayConfig::instance().scheduler_job_fair_sharing()) {}
 
 bool ClusterTaskManager::SchedulePendingTasks() {
   // Always try to schedule infeasible tasks in case they are now feasible.
   TryLocalInfeasibleTaskScheduling();
   bool did_schedule = false;
-  for (auto shapes_it = tasks_to_schedule_.begin();
-       shapes_it != tasks_to_schedule_.end();) {
+  const auto sched_classes = GetSchedulingClassesToEvaluate(tasks_to_schedule_);
+  internal_stats_.num_sched_classes_evaluated += sched_classes.size();
+  for (const auto &scheduling_class : sched_classes) {
+    auto shapes_it = tasks_to_schedule_.find(scheduling_class);
+    if (shapes_it == tasks_to_schedule_.end()) {
+      continue;
+    }
     auto &work_queue = shapes_it->second;
     bool is_infeasible = false;
     for (auto work_it = work_queue.begin(); work_it != work_queue.end();) {
+      // Schedule runs of identical tasks, e.g., a large backlog of one remote
+      // function, with one decision instead of one per task.
+      const size_t batch_size =
+          batch_scheduling_enabled_ ? GetSchedulingBatchSize(work_queue, work_it) : 1;
+      if (batch_size > 1) {
+        const size_t num_scheduled =
+            ScheduleWorkBatch(work_it, batch_size, &did_schedule, &is_infeasible);
+        work_it = work_queue.erase(work_it, work_it + num_scheduled);
+        if (num_scheduled < batch_size) {
+          // There is no node to run the rest of the batch. Move on to the next shape.
+          break;
+        }
+        continue;
+      }
+
       // Check every task in task_to_schedule queue to see
       // whether it can be scheduled. This avoids head-of-line
       // blocking where a task which cannot be scheduled because
@@ -113,16 +137,80 @@ bool ClusterTaskManager::SchedulePendingTasks() {
 
       // TODO(sang): Use a shared pointer deque to reduce copy overhead.
       infeasible_tasks_[shapes_it->first] = shapes_it->second;
-      tasks_to_schedule_.erase(shapes_it++);
+      IndexInfeasibleSchedulingClass(shapes_it->first, *work);
+      tasks_to_schedule_.erase(shapes_it);
     } else if (work_queue.empty()) {
-      tasks_to_schedule_.erase(shapes_it++);
-    } else {
-      shapes_it++;
+      tasks_to_schedule_.erase(shapes_it);
     }
   }
   return did_schedule;
 }
 
+size_t ClusterTaskManager::GetSchedulingBatchSize(
+    const std::deque<std::shared_ptr<internal::Work>> &work_queue,
+    std::deque<std::shared_ptr<internal::Work>>::const_iterator begin) const {
+  auto can_batch = [](const internal::Work &work) {
+    const auto &spec = work.task.GetTaskSpecification();
+    return !work.grant_or_reject && !spec.IsActorCreationTask() &&
+           spec.GetRequiredPlacementResources() == spec.GetRequiredResources();
+  };
+  if (!can_batch(**begin)) {
+    return 1;
+  }
+  const auto &first_spec = (*begin)->task.GetTaskSpecification();
+  size_t batch_size = 1;
+  for (auto it = std::next(begin); it != work_queue.end(); it++) {
+    const auto &spec = (*it)->task.GetTaskSpecification();
+    // Works in a queue share the scheduling class, and therefore the required
+    // resources, but may still differ in scheduling strategy.
+    if (!can_batch(**it) ||
+        spec.GetMessage().scheduling_strategy().scheduling_strategy_case() !=
+            first_spec.GetMessage().scheduling_strategy().scheduling_strategy_case()) {
+      break;
+    }
+    batch_size++;
+  }
+  return batch_size;
+}
+
+size_t ClusterTaskManager::ScheduleWorkBatch(
+    std::deque<std::shared_ptr<internal::Work>>::iterator begin, size_t batch_size,
+    bool *did_schedule, bool *is_infeasible) {
+  const auto &spec = (*begin)->task.GetTaskSpecification();
+  const auto assignments = cluster_resource_scheduler_->GetBestSchedulableNodes(
+      spec.GetRequiredResources().GetResourceMap(),
+      spec.GetMessage().scheduling_strategy(), batch_size, is_infeasible);
+  RAY_LOG(DEBUG) << "Scheduled a batch of " << batch_size << " tasks of "
+                 << spec.GetSchedulingClass() << " on " << assignments.size()
+                 << " node groups, is infeasible? " << *is_infeasible;
+
+  auto work_it = begin;
+  size_t num_scheduled = 0;
+  for (const auto &assignment : assignments) {
+    const auto &node_id_string = assignment.node_id;
+    const int64_t count = assignment.count;
+    if (node_id_string == self_node_id_.Binary()) {
+      for (int64_t i = 0; i < count; i++) {
+        // Warning: WaitForTaskArgsRequests must execute (do not let it short
+        // circuit if did_schedule is true).
+        bool task_scheduled = WaitForTaskArgsRequests(*work_it++);
+        *did_schedule = task_scheduled || *did_schedule;
+      }
+    } else {
+      // If the scheduler already allocated the group's resources on the remote node,
+      // they are only reserved. Otherwise allocating them fails and nothing is
+      // reserved, so no resources are returned to the node that weren't taken.
+      NodeID node_id = NodeID::FromBinary(node_id_string);
+      for (int64_t i = 0; i < count; i++) {
+        Spillback(node_id, *work_it++,
+                  /*allocate_remote_resources=*/!assignment.allocated);
+      }
+    }
+    num_scheduled += count;
+  }
+  return num_scheduled;
+}
+
 bool ClusterTaskManager::WaitForTaskArgsRequests(std::shared_ptr<internal::Work> work) {
   const auto &task = work->task;
   const auto &task_id = task.GetTaskSpecification().TaskId();
@@ -261,6 +349,7 @@ bool ClusterTaskManager::PoppedWorkerHandler(
                          << status;
         }
         work->SetStateWaiting(cause);
+        MarkSchedulingClassDirty(scheduling_class);
         // Return here because we shouldn't remove task dependencies.
         return dispatched;
       }
@@ -277,6 +366,8 @@ bool ClusterTaskManager::PoppedWorkerHandler(
     RAY_LOG(DEBUG) << "Dispatching task " << task_id << " to worker "
                    << worker->WorkerId();
 
+    stats::STATS_scheduler_job_queueing_delay_ms.Record(
+        get_time_ms_() - work->queued_time_ms, spec.JobId().Hex());
     Dispatch(worker, leased_workers_, work->allocated_instances, task, reply, callback);
     erase_from_dispatch_queue_fn(work, scheduling_class);
     dispatched = true;
@@ -298,184 +389,391 @@ void ClusterTaskManager::DispatchScheduledTasksToWorkers(
   // blocking where a task which cannot be dispatched because
   // there are not enough available resources blocks other
   // tasks from being dispatched.
-  for (auto shapes_it = tasks_to_dispatch_.begin();
-       shapes_it != tasks_to_dispatch_.end();) {
-    auto &scheduling_class = shapes_it->first;
-    auto &dispatch_queue = shapes_it->second;
-
-    if (info_by_sched_cls_.find(scheduling_class) == info_by_sched_cls_.end()) {
-      // Initialize the class info.
-      info_by_sched_cls_.emplace(
-          scheduling_class,
-          SchedulingClassInfo(MaxRunningTasksPerSchedulingClass(scheduling_class)));
+  //
+  // Only the classes marked dirty are evaluated, including those that need a resource
+  // that was freed. Classes marked dirty from here on are evaluated by the next pass.
+  const auto sched_classes = GetSchedulingClassesToEvaluate(tasks_to_dispatch_);
+  internal_stats_.num_sched_classes_evaluated += sched_classes.size();
+  dirty_sched_classes_.clear();
+  all_sched_classes_dirty_ = false;
+  if (job_fair_sharing_enabled_) {
+    // Only interleave the classes if their queues are headed by different jobs.
+    // Otherwise, the order doesn't matter.
+    auto head_job_id = [this](SchedulingClass scheduling_class) {
+      return tasks_to_dispatch_.at(scheduling_class)
+          .front()
+          ->task.GetTaskSpecification()
+          .JobId();
+    };
+    for (const auto &scheduling_class : sched_classes) {
+      if (head_job_id(scheduling_class) != head_job_id(sched_classes.front())) {
+        DispatchSchedulingClassesFairly(sched_classes);
+        return;
+      }
+    }
+  }
+  for (const auto &scheduling_class : sched_classes) {
+    DispatchCursor cursor;
+    if (tasks_to_dispatch_.contains(scheduling_class)) {
+      DispatchSchedulingClass(scheduling_class, std::numeric_limits<size_t>::max(),
+                              &cursor);
+      FinishDispatchingSchedulingClass(scheduling_class, cursor);
     }
-    auto &sched_cls_info = info_by_sched_cls_.at(scheduling_class);
+  }
+}
 
-    /// We cap the maximum running tasks of a scheduling class to avoid
-    /// scheduling too many tasks of a single type/depth, when there are
-    /// deeper/other functions that should be run. We need to apply back
-    /// pressure to limit the number of worker processes started in scenarios
-    /// with nested tasks.
-    bool is_infeasible = false;
-    for (auto work_it = dispatch_queue.begin(); work_it != dispatch_queue.end();) {
-      auto &work = *work_it;
-      const auto &task = work->task;
-      const auto spec = task.GetTaskSpecification();
-      TaskID task_id = spec.TaskId();
-      if (work->GetState() == internal::WorkStatus::WAITING_FOR_WORKER) {
-        work_it++;
-        continue;
-      }
+void ClusterTaskManager::DispatchSchedulingClassesFairly(
+    const std::vector<SchedulingClass> &sched_classes) {
+  // A min-heap of the classes that may dispatch more works in this pass, by the
+  // priority of the job of their next work.
+  using QueueEntry = std::pair<std::pair<bool, double>, SchedulingClass>;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>
+      queue;
+  absl::flat_hash_map<SchedulingClass, DispatchCursor> cursors;
+  auto next_job_id = [this, &cursors](SchedulingClass scheduling_class) {
+    return tasks_to_dispatch_.at(scheduling_class)[cursors.at(scheduling_class)
+                                                       .next_index]
+        ->task.GetTaskSpecification()
+        .JobId();
+  };
+  for (const auto &scheduling_class : sched_classes) {
+    cursors.emplace(scheduling_class, DispatchCursor());
+    queue.emplace(GetJobDispatchPriority(next_job_id(scheduling_class)),
+                  scheduling_class);
+  }
+  while (!queue.empty()) {
+    const auto entry = queue.top();
+    queue.pop();
+    const SchedulingClass scheduling_class = entry.second;
+    // Dispatching works of other classes may have lowered the job's priority since the
+    // class was queued.
+    const auto priority = GetJobDispatchPriority(next_job_id(scheduling_class));
+    if (entry.first < priority) {
+      queue.emplace(priority, scheduling_class);
+      continue;
+    }
+    auto &cursor = cursors.at(scheduling_class);
+    if (DispatchSchedulingClass(scheduling_class, /*max_to_dispatch=*/1, &cursor)) {
+      queue.emplace(GetJobDispatchPriority(next_job_id(scheduling_class)),
+                    scheduling_class);
+    } else {
+      FinishDispatchingSchedulingClass(scheduling_class, cursor);
+    }
+  }
+}
 
-      // Check if the scheduling class is at capacity now.
-      if (sched_cls_cap_enabled_ &&
-          sched_cls_info.running_tasks.size() >= sched_cls_info.capacity &&
-          work->GetState() == internal::WorkStatus::WAITING) {
-        RAY_LOG(DEBUG) << "Hit cap! time=" << get_time_ms_()
-                       << " next update time=" << sched_cls_info.next_update_time;
-        if (get_time_ms_() < sched_cls_info.next_update_time) {
-          // We're over capacity and it's not time to admit a new task yet.
-          // Calculate the next time we should admit a new task.
-          int64_t current_capacity = sched_cls_info.running_tasks.size();
-          int64_t allowed_capacity = sched_cls_info.capacity;
-          int64_t exp = current_capacity - allowed_capacity;
-          int64_t wait_time = sched_cls_cap_interval_ms_ * (1L << exp);
-          if (wait_time > sched_cls_cap_max_ms_) {
-            wait_time = sched_cls_cap_max_ms_;
-            RAY_LOG(WARNING) << "Starting too many worker processes for a single type of "
-                                "task. Worker process startup is being throttled.";
-          }
-
-          int64_t target_time = get_time_ms_() + wait_time;
-          sched_cls_info.next_update_time =
-              std::min(target_time, sched_cls_info.next_update_time);
-          break;
-        }
-      }
+bool ClusterTaskManager::DispatchSchedulingClass(SchedulingClass scheduling_class,
+                                                 size_t max_to_dispatch,
+                                                 DispatchCursor *cursor) {
+  auto &dispatch_queue = tasks_to_dispatch_.at(scheduling_class);
+  if (info_by_sched_cls_.find(scheduling_class) == info_by_sched_cls_.end()) {
+    // Initialize the class info.
+    info_by_sched_cls_.emplace(
+        scheduling_class,
+        SchedulingClassInfo(MaxRunningTasksPerSchedulingClass(scheduling_class)));
+  }
+  auto &sched_cls_info = info_by_sched_cls_.at(scheduling_class);
+
+  /// We cap the maximum running tasks of a scheduling class to avoid
+  /// scheduling too many tasks of a single type/depth, when there are
+  /// deeper/other functions that should be run. We need to apply back
+  /// pressure to limit the number of worker processes started in scenarios
+  /// with nested tasks.
+  size_t num_dispatched = 0;
+  auto work_it = dispatch_queue.begin() + cursor->next_index;
+  while (work_it != dispatch_queue.end()) {
+    if (num_dispatched == max_to_dispatch) {
+      cursor->next_index = work_it - dispatch_queue.begin();
+      return true;
+    }
+    auto &work = *work_it;
+    const auto &task = work->task;
+    const auto spec = task.GetTaskSpecification();
+    TaskID task_id = spec.TaskId();
+    if (work->GetState() == internal::WorkStatus::WAITING_FOR_WORKER) {
+      work_it++;
+      continue;
+    }
 
-      bool args_missing = false;
-      bool success = PinTaskArgsIfMemoryAvailable(spec, &args_missing);
-      // An argument was evicted since this task was added to the dispatch
-      // queue. Move it back to the waiting queue. The caller is responsible
-      // for notifying us when the task is unblocked again.
-      if (!success) {
-        if (args_missing) {
-          // Insert the task at the head of the waiting queue because we
-          // prioritize spilling from the end of the queue.
-          auto it = waiting_task_queue_.insert(waiting_task_queue_.begin(),
-                                               std::move(*work_it));
-          RAY_CHECK(waiting_tasks_index_.emplace(task_id, it).second);
-          work_it = dispatch_queue.erase(work_it);
-        } else {
-          // The task's args cannot be pinned due to lack of memory. We should
-          // retry dispatching the task once another task finishes and releases
-          // its arguments.
-          RAY_LOG(DEBUG) << "Dispatching task " << task_id
-                         << " would put this node over the max memory allowed for "
-                            "arguments of executing tasks ("
-                         << max_pinned_task_arguments_bytes_
-                         << "). Waiting to dispatch task until other tasks complete";
-          RAY_CHECK(!executing_task_args_.empty() && !pinned_task_arguments_.empty())
-              << "Cannot dispatch task " << task_id
-              << " until another task finishes and releases its arguments, but no other "
-                 "task is running";
-          work->SetStateWaiting(
-              internal::UnscheduledWorkCause::WAITING_FOR_AVAILABLE_PLASMA_MEMORY);
-          work_it++;
+    // Check if the scheduling class is at capacity now.
+    if (sched_cls_cap_enabled_ &&
+        sched_cls_info.running_tasks.size() >= sched_cls_info.capacity &&
+        work->GetState() == internal::WorkStatus::WAITING) {
+      RAY_LOG(DEBUG) << "Hit cap! time=" << get_time_ms_()
+                     << " next update time=" << sched_cls_info.next_update_time;
+      if (get_time_ms_() < sched_cls_info.next_update_time) {
+        // We're over capacity and it's not time to admit a new task yet.
+        // Calculate the next time we should admit a new task.
+        int64_t current_capacity = sched_cls_info.running_tasks.size();
+        int64_t allowed_capacity = sched_cls_info.capacity;
+        int64_t exp = current_capacity - allowed_capacity;
+        int64_t wait_time = sched_cls_cap_interval_ms_ * (1L << exp);
+        if (wait_time > sched_cls_cap_max_ms_) {
+          wait_time = sched_cls_cap_max_ms_;
+          RAY_LOG(WARNING) << "Starting too many worker processes for a single type of "
+                              "task. Worker process startup is being throttled.";
         }
-        continue;
-      }
-
-      const auto owner_worker_id = WorkerID::FromBinary(spec.CallerAddress().worker_id());
-      const auto owner_node_id = NodeID::FromBinary(spec.CallerAddress().raylet_id());
 
-      // If the owner has died since this task was queued, cancel the task by
-      // killing the worker (unless this task is for a detached actor).
-      if (!spec.IsDetachedActor() && !is_owner_alive_(owner_worker_id, owner_node_id)) {
-        RAY_LOG(WARNING) << "RayTask: " << task.GetTaskSpecification().TaskId()
-                         << "'s caller is no longer running. Cancelling task.";
-        if (!spec.GetDependencies().empty()) {
-          task_dependency_manager_.RemoveTaskDependencies(task_id);
-        }
-        ReleaseTaskArgs(task_id);
-        work_it = dispatch_queue.erase(work_it);
-        continue;
+        int64_t target_time = get_time_ms_() + wait_time;
+        sched_cls_info.next_update_time =
+            std::min(target_time, sched_cls_info.next_update_time);
+        capped_sched_classes_.insert(scheduling_class);
+        return false;
       }
+    }
 
-      // Check if the node is still schedulable. It may not be if dependency resolution
-      // took a long time.
-      auto allocated_instances = std::make_shared<TaskResourceInstances>();
-      bool schedulable = cluster_resource_scheduler_->AllocateLocalTaskResources(
-          spec.GetRequiredResources().GetResourceMap(), allocated_instances);
-
-      if (!schedulable) {
-        ReleaseTaskArgs(task_id);
-        // The local node currently does not have the resources to run the task, so we
-        // should try spilling to another node.
-        bool did_spill = TrySpillback(work, is_infeasible);
-        if (!did_spill) {
-          // There must not be any other available nodes in the cluster, so the task
-          // should stay on this node. We can skip the rest of the shape because the
-          // scheduler will make the same decision.
-          work->SetStateWaiting(
-              internal::UnscheduledWorkCause::WAITING_FOR_RESOURCES_AVAILABLE);
-          break;
-        }
-        if (!spec.GetDependencies().empty()) {
-          task_dependency_manager_.RemoveTaskDependencies(
-              task.GetTaskSpecification().TaskId());
-        }
+    bool args_missing = false;
+    bool success = PinTaskArgsIfMemoryAvailable(spec, &args_missing);
+    // An argument was evicted since this task was added to the dispatch
+    // queue. Move it back to the waiting queue. The caller is responsible
+    // for notifying us when the task is unblocked again.
+    if (!success) {
+      if (args_missing) {
+        // Insert the task at the head of the waiting queue because we
+        // prioritize spilling from the end of the queue.
+        auto it = waiting_task_queue_.insert(waiting_task_queue_.begin(),
+                                             std::move(*work_it));
+        RAY_CHECK(waiting_tasks_index_.emplace(task_id, it).second);
         work_it = dispatch_queue.erase(work_it);
       } else {
-        // Force us to recalculate the next update time the next time a task
-        // comes through this queue. We should only do this when we're
-        // confident we're ready to dispatch the task after all checks have
-        // passed.
-        sched_cls_info.next_update_time = std::numeric_limits<int64_t>::max();
-        sched_cls_info.running_tasks.insert(spec.TaskId());
-        // The local node has the available resources to run the task, so we should run
-        // it.
-        std::string allocated_instances_serialized_json = "{}";
-        if (RayConfig::instance().worker_resource_limits_enabled()) {
-          allocated_instances_serialized_json =
-              cluster_resource_scheduler_->SerializedTaskResourceInstances(
-                  allocated_instances);
-        }
-        work->allocated_instances = allocated_instances;
-        work->SetStateWaitingForWorker();
-        bool is_detached_actor = spec.IsDetachedActor();
-        auto &owner_address = spec.CallerAddress();
-        worker_pool_.PopWorker(
-            spec,
-            [this, task_id, scheduling_class, work, is_detached_actor, owner_address](
-                const std::shared_ptr<WorkerInterface> worker,
-                PopWorkerStatus status) -> bool {
-              return PoppedWorkerHandler(worker, status, task_id, scheduling_class, work,
-                                         is_detached_actor, owner_address);
-            },
-            allocated_instances_serialized_json);
+        // The task's args cannot be pinned due to lack of memory. We should
+        // retry dispatching the task once another task finishes and releases
+        // its arguments.
+        RAY_LOG(DEBUG) << "Dispatching task " << task_id
+                       << " would put this node over the max memory allowed for "
+                          "arguments of executing tasks ("
+                       << max_pinned_task_arguments_bytes_
+                       << "). Waiting to dispatch task until other tasks complete";
+        RAY_CHECK(!executing_task_args_.empty() && !pinned_task_arguments_.empty())
+            << "Cannot dispatch task " << task_id
+            << " until another task finishes and releases its arguments, but no other "
+               "task is running";
+        work->SetStateWaiting(
+            internal::UnscheduledWorkCause::WAITING_FOR_AVAILABLE_PLASMA_MEMORY);
+        sched_classes_waiting_for_memory_.insert(scheduling_class);
         work_it++;
       }
+      continue;
     }
-    // In the beginning of the loop, we add scheduling_class
-    // to the `info_by_sched_cls_` map.
-    // In cases like dead owners, we may not add any tasks
-    // to `running_tasks` so we can remove the map entry
-    // for that scheduling_class to prevent memory leaks.
-    if (sched_cls_info.running_tasks.size() == 0) {
-      info_by_sched_cls_.erase(scheduling_class);
+
+    const auto owner_worker_id = WorkerID::FromBinary(spec.CallerAddress().worker_id());
+    const auto owner_node_id = NodeID::FromBinary(spec.CallerAddress().raylet_id());
+
+    // If the owner has died since this task was queued, cancel the task by
+    // killing the worker (unless this task is for a detached actor).
+    if (!spec.IsDetachedActor() && !is_owner_alive_(owner_worker_id, owner_node_id)) {
+      RAY_LOG(WARNING) << "RayTask: " << task.GetTaskSpecification().TaskId()
+                       << "'s caller is no longer running. Cancelling task.";
+      if (!spec.GetDependencies().empty()) {
+        task_dependency_manager_.RemoveTaskDependencies(task_id);
+      }
+      ReleaseTaskArgs(task_id);
+      work_it = dispatch_queue.erase(work_it);
+      continue;
     }
-    if (is_infeasible) {
-      infeasible_tasks_[shapes_it->first] = std::move(shapes_it->second);
-      tasks_to_dispatch_.erase(shapes_it++);
-    } else if (dispatch_queue.empty()) {
-      tasks_to_dispatch_.erase(shapes_it++);
+
+    // Check if the node is still schedulable. It may not be if dependency resolution
+    // took a long time.
+    auto allocated_instances = std::make_shared<TaskResourceInstances>();
+    bool schedulable = cluster_resource_scheduler_->AllocateLocalTaskResources(
+        spec.GetRequiredResources().GetResourceMap(), allocated_instances);
+
+    if (!schedulable) {
+      ReleaseTaskArgs(task_id);
+      // The local node currently does not have the resources to run the task, so we
+      // should try spilling to another node.
+      bool did_spill = TrySpillback(work, cursor->is_infeasible);
+      if (!did_spill) {
+        // There must not be any other available nodes in the cluster, so the task
+        // should stay on this node. We can skip the rest of the shape because the
+        // scheduler will make the same decision.
+        work->SetStateWaiting(
+            internal::UnscheduledWorkCause::WAITING_FOR_RESOURCES_AVAILABLE);
+        return false;
+      }
+      if (!spec.GetDependencies().empty()) {
+        task_dependency_manager_.RemoveTaskDependencies(
+            task.GetTaskSpecification().TaskId());
+      }
+      work_it = dispatch_queue.erase(work_it);
     } else {
-      shapes_it++;
+      // Force us to recalculate the next update time the next time a task
+      // comes through this queue. We should only do this when we're
+      // confident we're ready to dispatch the task after all checks have
+      // passed.
+      sched_cls_info.next_update_time = std::numeric_limits<int64_t>::max();
+      sched_cls_info.running_tasks.insert(spec.TaskId());
+      num_running_tasks_by_job_[spec.JobId()]++;
+      // The local node has the available resources to run the task, so we should run
+      // it.
+      std::string allocated_instances_serialized_json = "{}";
+      if (RayConfig::instance().worker_resource_limits_enabled()) {
+        allocated_instances_serialized_json =
+            cluster_resource_scheduler_->SerializedTaskResourceInstances(
+                allocated_instances);
+      }
+      work->allocated_instances = allocated_instances;
+      work->SetStateWaitingForWorker();
+      bool is_detached_actor = spec.IsDetachedActor();
+      auto &owner_address = spec.CallerAddress();
+      // The lease request waits for the pops of its additional works that are issued
+      // before its own work is done, e.g., in the same dispatch pass.
+      const auto &lease_batch = work->lease_batch;
+      const bool lease_batch_waits = lease_batch != nullptr && !lease_batch->done &&
+                                     work->reply != lease_batch->reply;
+      if (lease_batch_waits) {
+        lease_batch->num_pending_pops++;
+      }
+      worker_pool_.PopWorker(
+          spec,
+          [this, task_id, scheduling_class, work, is_detached_actor, owner_address,
+           lease_batch_waits](const std::shared_ptr<WorkerInterface> worker,
+                              PopWorkerStatus status) -> bool {
+            const auto lease_batch = work->lease_batch;
+            if (lease_batch != nullptr && lease_batch->replied) {
+              // The lease request was replied to before this additional work was
+              // granted, so nobody would use the worker.
+              CancelTask(task_id);
+            }
+            bool dispatched =
+                PoppedWorkerHandler(worker, status, task_id, scheduling_class, work,
+                                    is_detached_actor, owner_address);
+            if (lease_batch_waits) {
+              lease_batch->num_pending_pops--;
+              MaybeReplyLeaseBatch(lease_batch);
+            }
+            return dispatched;
+          },
+          allocated_instances_serialized_json);
+      work_it++;
+      num_dispatched++;
+    }
+  }
+  return false;
+}
+
+void ClusterTaskManager::FinishDispatchingSchedulingClass(
+    SchedulingClass scheduling_class, const DispatchCursor &cursor) {
+  // DispatchSchedulingClass adds scheduling_class
+  // to the `info_by_sched_cls_` map.
+  // In cases like dead owners, we may not add any tasks
+  // to `running_tasks` so we can remove the map entry
+  // for that scheduling_class to prevent memory leaks.
+  auto info_it = info_by_sched_cls_.find(scheduling_class);
+  if (info_it != info_by_sched_cls_.end() && info_it->second.running_tasks.empty()) {
+    info_by_sched_cls_.erase(info_it);
+  }
+  auto shapes_it = tasks_to_dispatch_.find(scheduling_class);
+  auto &dispatch_queue = shapes_it->second;
+  if (cursor.is_infeasible) {
+    IndexInfeasibleSchedulingClass(shapes_it->first, *dispatch_queue.front());
+    infeasible_tasks_[shapes_it->first] = std::move(shapes_it->second);
+    tasks_to_dispatch_.erase(shapes_it);
+  } else if (dispatch_queue.empty()) {
+    tasks_to_dispatch_.erase(shapes_it);
+  }
+}
+
+std::pair<bool, double> ClusterTaskManager::GetJobDispatchPriority(
+    const JobID &job_id) const {
+  int64_t num_running_tasks = 0;
+  auto running_it = num_running_tasks_by_job_.find(job_id);
+  if (running_it != num_running_tasks_by_job_.end()) {
+    num_running_tasks = running_it->second;
+  }
+  JobSchedulingInfo info;
+  auto info_it = info_by_job_.find(job_id);
+  if (info_it != info_by_job_.end()) {
+    info = info_it->second;
+  }
+  // Jobs below their minimum share go first. Otherwise, the job that would have the
+  // fewest running tasks per weight after this dispatch goes first.
+  return {num_running_tasks >= info.min_share, (num_running_tasks + 1) / info.weight};
+}
+
+void ClusterTaskManager::HandleJobStarted(const JobID &job_id,
+                                          const rpc::JobConfig &job_config) {
+  JobSchedulingInfo info;
+  if (job_config.scheduling_weight() > 0) {
+    info.weight = job_config.scheduling_weight();
+  }
+  info.min_share = static_cast<int64_t>(job_config.min_scheduling_share());
+  info_by_job_[job_id] = info;
+}
+
+void ClusterTaskManager::HandleJobFinished(const JobID &job_id) {
+  info_by_job_.erase(job_id);
+}
+
+std::vector<SchedulingClass> ClusterTaskManager::GetSchedulingClassesToEvaluate(
+    const absl::flat_hash_map<SchedulingClass,
+                              std::deque<std::shared_ptr<internal::Work>>> &queues)
+    const {
+  // Copy the classes, since evaluating them may add or erase queues.
+  std::vector<SchedulingClass> sched_classes;
+  if (all_sched_classes_dirty_) {
+    sched_classes.reserve(queues.size());
+    for (const auto &entry : queues) {
+      sched_classes.push_back(entry.first);
+    }
+  } else {
+    for (const auto &scheduling_class : dirty_sched_classes_) {
+      if (queues.contains(scheduling_class)) {
+        sched_classes.push_back(scheduling_class);
+      }
+    }
+  }
+  return sched_classes;
+}
+
+void ClusterTaskManager::MarkSchedulingClassesWithGrownResourcesDirty() {
+  const uint64_t availability_epoch = cluster_resource_scheduler_->GetAvailabilityEpoch();
+  if (availability_epoch == last_availability_epoch_) {
+    return;
+  }
+  bool all_may_fit = false;
+  const auto grown_resources =
+      cluster_resource_scheduler_->GetResourcesWithAvailabilityGrownSince(
+          last_availability_epoch_, &all_may_fit);
+  last_availability_epoch_ = availability_epoch;
+  if (all_may_fit) {
+    all_sched_classes_dirty_ = true;
+    return;
+  }
+  if (all_sched_classes_dirty_ || grown_resources.empty()) {
+    return;
+  }
+  const absl::flat_hash_set<std::string> grown(grown_resources.begin(),
+                                               grown_resources.end());
+  auto needs_grown_resource = [&grown](const ResourceSet &resources) {
+    for (const auto &entry : resources.GetResourceMap()) {
+      if (grown.contains(entry.first)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  for (const auto *queues : {&tasks_to_schedule_, &tasks_to_dispatch_}) {
+    for (const auto &entry : *queues) {
+      if (entry.second.empty() || dirty_sched_classes_.contains(entry.first)) {
+        continue;
+      }
+      // The works of a class share the resources they require.
+      const auto &spec = entry.second.front()->task.GetTaskSpecification();
+      if (needs_grown_resource(spec.GetRequiredResources()) ||
+          needs_grown_resource(spec.GetRequiredPlacementResources())) {
+        dirty_sched_classes_.insert(entry.first);
+      }
     }
   }
 }
 
+void ClusterTaskManager::MarkSchedulingClassDirty(SchedulingClass scheduling_class) {
+  if (!all_sched_classes_dirty_) {
+    dirty_sched_classes_.insert(scheduling_class);
+  }
+}
+
 bool ClusterTaskManager::TrySpillback(const std::shared_ptr<internal::Work> &work,
                                       bool &is_infeasible) {
   std::string node_id_string =
@@ -501,6 +799,7 @@ void ClusterTaskManager::QueueAndScheduleTask(
   auto work = std::make_shared<internal::Work>(
       task, grant_or_reject, reply,
       [send_reply_callback] { send_reply_callback(Status::OK(), nullptr, nullptr); });
+  work->queued_time_ms = get_time_ms_();
   const auto &scheduling_class = task.GetTaskSpecification().GetSchedulingClass();
   // If the scheduling class is infeasible, just add the work to the infeasible queue
   // directly.
@@ -508,10 +807,100 @@ void ClusterTaskManager::QueueAndScheduleTask(
     infeasible_tasks_[scheduling_class].push_back(work);
   } else {
     tasks_to_schedule_[scheduling_class].push_back(work);
+    MarkSchedulingClassDirty(scheduling_class);
+  }
+  ScheduleAndDispatchTasks();
+}
+
+void ClusterTaskManager::QueueAndScheduleLeases(
+    const RayTask &task, bool grant_or_reject, int64_t max_leases,
+    rpc::RequestWorkerLeaseReply *reply, rpc::SendReplyCallback send_reply_callback) {
+  const auto &spec = task.GetTaskSpecification();
+  if (max_leases > 1 && !spec.IsActorCreationTask()) {
+    // Additional works that would have to wait for a worker to start would be canceled
+    // when the request is replied to, so only queue those that idle workers can serve.
+    // One idle worker is left for the work of the request itself.
+    const int64_t num_idle =
+        static_cast<int64_t>(worker_pool_.NumIdleWorkersForTask(spec));
+    max_leases = std::min(max_leases, num_idle);
+  }
+  if (max_leases <= 1 || spec.IsActorCreationTask()) {
+    QueueAndScheduleTask(task, grant_or_reject, reply, send_reply_callback);
+    return;
+  }
+  RAY_LOG(DEBUG) << "Queuing and scheduling " << max_leases << " leases for task "
+                 << spec.TaskId();
+  auto batch = std::make_shared<internal::LeaseBatch>(reply, [send_reply_callback] {
+    send_reply_callback(Status::OK(), nullptr, nullptr);
+  });
+  std::vector<std::shared_ptr<internal::Work>> works;
+  works.reserve(max_leases);
+  works.push_back(std::make_shared<internal::Work>(
+      task, grant_or_reject, reply, [this, batch] {
+        batch->done = true;
+        MaybeReplyLeaseBatch(batch);
+      }));
+  for (int64_t i = 1; i < max_leases; i++) {
+    // Each additional work needs its own task ID, so that it can be tracked and
+    // canceled separately.
+    rpc::Task task_message;
+    task_message.mutable_task_spec()->CopyFrom(spec.GetMessage());
+    task_message.mutable_task_spec()->set_task_id(
+        TaskID::FromRandom(spec.JobId()).Binary());
+    RayTask additional_task(task_message);
+    auto additional_reply = std::make_unique<rpc::RequestWorkerLeaseReply>();
+    works.push_back(std::make_shared<internal::Work>(
+        additional_task, /*grant_or_reject=*/true, additional_reply.get(), [] {}));
+    batch->additional_leases.emplace_back(
+        additional_task.GetTaskSpecification().TaskId(), std::move(additional_reply));
+  }
+
+  const auto &scheduling_class = spec.GetSchedulingClass();
+  auto &work_queue = infeasible_tasks_.count(scheduling_class) > 0
+                         ? infeasible_tasks_[scheduling_class]
+                         : tasks_to_schedule_[scheduling_class];
+  const int64_t now_ms = get_time_ms_();
+  for (auto &work : works) {
+    work->lease_batch = batch;
+    work->queued_time_ms = now_ms;
+    work_queue.push_back(std::move(work));
   }
+  MarkSchedulingClassDirty(scheduling_class);
   ScheduleAndDispatchTasks();
 }
 
+void ClusterTaskManager::MaybeReplyLeaseBatch(
+    const std::shared_ptr<internal::LeaseBatch> &batch) {
+  if (batch->replied || !batch->done || batch->num_pending_pops > 0) {
+    return;
+  }
+  batch->replied = true;
+  for (const auto &additional_lease : batch->additional_leases) {
+    const auto &additional_reply = *additional_lease.second;
+    if (additional_reply.worker_address().raylet_id().empty()) {
+      // This is a no-op if the work was already rejected.
+      abandoned_leases_.push_back(additional_lease.first);
+      continue;
+    }
+    auto lease = batch->reply->add_additional_leases();
+    lease->mutable_worker_address()->CopyFrom(additional_reply.worker_address());
+    lease->mutable_resource_mapping()->CopyFrom(additional_reply.resource_mapping());
+    lease->set_worker_pid(additional_reply.worker_pid());
+  }
+  RAY_LOG(DEBUG) << "Replying to a lease request with "
+                 << batch->reply->additional_leases_size() << " additional leases";
+  batch->send_reply();
+}
+
+void ClusterTaskManager::CancelAbandonedLeases() {
+  // Canceling a work mutates the queues, so this can't be done while the batch is
+  // replied to, which may happen while iterating over them.
+  for (const auto &task_id : abandoned_leases_) {
+    CancelTask(task_id);
+  }
+  abandoned_leases_.clear();
+}
+
 void ClusterTaskManager::TasksUnblocked(const std::vector<TaskID> &ready_ids) {
   if (ready_ids.empty()) {
     return;
@@ -526,6 +915,7 @@ void ClusterTaskManager::TasksUnblocked(const std::vector<TaskID> &ready_ids) {
       RAY_LOG(DEBUG) << "Args ready, task can be dispatched "
                      << task.GetTaskSpecification().TaskId();
       tasks_to_dispatch_[scheduling_key].push_back(work);
+      MarkSchedulingClassDirty(scheduling_key);
       waiting_task_queue_.erase(it->second);
       waiting_tasks_index_.erase(it);
     }
@@ -537,7 +927,14 @@ void ClusterTaskManager::RemoveFromRunningTasksIfExists(const RayTask &task) {
   auto sched_cls = task.GetTaskSpecification().GetSchedulingClass();
   auto it = info_by_sched_cls_.find(sched_cls);
   if (it != info_by_sched_cls_.end()) {
-    it->second.running_tasks.erase(task.GetTaskSpecification().TaskId());
+    if (it->second.running_tasks.erase(task.GetTaskSpecification().TaskId())) {
+      // The class may have been held back by its cap.
+      MarkSchedulingClassDirty(sched_cls);
+      auto job_it = num_running_tasks_by_job_.find(task.GetTaskSpecification().JobId());
+      if (--job_it->second == 0) {
+        num_running_tasks_by_job_.erase(job_it);
+      }
+    }
     if (it->second.running_tasks.size() == 0) {
       info_by_sched_cls_.erase(it);
     }
@@ -652,6 +1049,10 @@ void ClusterTaskManager::ReleaseTaskArgs(const TaskID &task_id) {
         // This is the last task that needed this argument.
         pinned_task_arguments_bytes_ -= arg_it->second.first->GetSize();
         pinned_task_arguments_.erase(arg_it);
+        for (const auto &scheduling_class : sched_classes_waiting_for_memory_) {
+          MarkSchedulingClassDirty(scheduling_class);
+        }
+        sched_classes_waiting_for_memory_.clear();
       }
     }
     executing_task_args_.erase(it);
@@ -728,6 +1129,7 @@ bool ClusterTaskManager::CancelTask(
         ReplyCancelled(*work_it, failure_type);
         work_queue.erase(work_it);
         if (work_queue.empty()) {
+          UnindexInfeasibleSchedulingClass(shapes_it->first);
           infeasible_tasks_.erase(shapes_it);
         }
         return true;
@@ -864,23 +1266,22 @@ void ClusterTaskManager::FillResourceUsage(
     by_shape_entry->set_backlog_size(TotalBacklogSize(scheduling_class));
   }
 
-  for (const auto &pair : infeasible_tasks_) {
-    const auto &scheduling_class = pair.first;
+  for (const auto &pair : infeasible_sched_classes_by_shape_) {
     if (num_reported++ >= max_resource_shapes_per_load_report_ &&
         max_resource_shapes_per_load_report_ >= 0) {
-      // TODO (Alex): It's possible that we skip a different scheduling key which contains
-      // the same resources.
       skipped_requests++;
       break;
     }
-    const auto &resources =
-        TaskSpecification::GetSchedulingClassDescriptor(scheduling_class)
-            .resource_set.GetResourceMap();
-    const auto &queue = pair.second;
-    const auto &count = queue.size();
+    const auto &shape = pair.first;
+    size_t count = 0;
+    int64_t backlog_size = 0;
+    for (const auto &scheduling_class : pair.second) {
+      count += infeasible_tasks_.at(scheduling_class).size();
+      backlog_size += TotalBacklogSize(scheduling_class);
+    }
 
     auto by_shape_entry = resource_load_by_shape->Add();
-    for (const auto &resource : resources) {
+    for (const auto &resource : shape) {
       // Add to `resource_loads`.
       const auto &label = resource.first;
       const auto &quantity = resource.second;
@@ -895,7 +1296,7 @@ void ClusterTaskManager::FillResourceUsage(
     // ClusterResourceScheduler::GetBestSchedulableNode for more details.
     int num_infeasible = by_shape_entry->num_infeasible_requests_queued();
     by_shape_entry->set_num_infeasible_requests_queued(num_infeasible + count);
-    by_shape_entry->set_backlog_size(TotalBacklogSize(scheduling_class));
+    by_shape_entry->set_backlog_size(backlog_size);
   }
 
   if (skipped_requests > 0) {
@@ -1117,6 +1518,8 @@ std::string ClusterTaskManager::DebugStr() const {
          << internal_stats_.num_tasks_waiting_for_workers << "\n";
   buffer << "num_cancelled_tasks: " << internal_stats_.num_cancelled_tasks << "\n";
   buffer << "Waiting tasks size: " << waiting_tasks_index_.size() << "\n";
+  buffer << "Scheduling classes evaluated by the last pass: "
+         << internal_stats_.num_sched_classes_evaluated << "\n";
   buffer << "Number of executing tasks: " << executing_task_args_.size() << "\n";
   buffer << "Number of pinned task arguments: " << pinned_task_arguments_.size() << "\n";
   buffer << "cluster_resource_scheduler state: "
@@ -1172,8 +1575,28 @@ std::string ClusterTaskManager::DebugStr() const {
 }
 
 void ClusterTaskManager::TryLocalInfeasibleTaskScheduling() {
-  for (auto shapes_it = infeasible_tasks_.begin();
-       shapes_it != infeasible_tasks_.end();) {
+  // An infeasible class can only become feasible once some node's total of a resource
+  // that the class needs grows, so only the classes indexed under such a resource have
+  // to be checked.
+  const uint64_t epoch = cluster_resource_scheduler_->GetAvailabilityEpoch();
+  if (epoch == last_feasibility_check_epoch_) {
+    return;
+  }
+  const auto grown_resources =
+      cluster_resource_scheduler_->GetResourcesWithTotalsGrownSince(
+          last_feasibility_check_epoch_);
+  absl::flat_hash_set<SchedulingClass> sched_classes;
+  for (const auto &resource : grown_resources) {
+    auto it = infeasible_sched_classes_by_resource_.find(resource);
+    if (it != infeasible_sched_classes_by_resource_.end()) {
+      sched_classes.insert(it->second.begin(), it->second.end());
+    }
+  }
+  last_feasibility_check_epoch_ = epoch;
+
+  for (const auto &scheduling_class : sched_classes) {
+    auto shapes_it = infeasible_tasks_.find(scheduling_class);
+    RAY_CHECK(shapes_it != infeasible_tasks_.end());
     auto &work_queue = shapes_it->second;
     RAY_CHECK(!work_queue.empty())
         << "Empty work queue shouldn't have been added as a infeasible shape.";
@@ -1194,15 +1617,57 @@ void ClusterTaskManager::TryLocalInfeasibleTaskScheduling() {
     if (is_infeasible) {
       RAY_LOG(DEBUG) << "No feasible node found for task "
                      << task.GetTaskSpecification().TaskId();
-      shapes_it++;
     } else {
       RAY_LOG(DEBUG) << "Infeasible task of task id "
                      << task.GetTaskSpecification().TaskId()
                      << " is now feasible. Move the entry back to tasks_to_schedule_";
       tasks_to_schedule_[shapes_it->first] = shapes_it->second;
-      infeasible_tasks_.erase(shapes_it++);
+      MarkSchedulingClassDirty(shapes_it->first);
+      UnindexInfeasibleSchedulingClass(shapes_it->first);
+      infeasible_tasks_.erase(shapes_it);
+    }
+  }
+}
+
+void ClusterTaskManager::IndexInfeasibleSchedulingClass(SchedulingClass scheduling_class,
+                                                        const internal::Work &work) {
+  if (infeasible_sched_class_info_.contains(scheduling_class)) {
+    return;
+  }
+  auto &info = infeasible_sched_class_info_[scheduling_class];
+  for (const auto &entry :
+       TaskSpecification::GetSchedulingClassDescriptor(scheduling_class)
+           .resource_set.GetResourceMap()) {
+    info.shape.emplace(entry.first, entry.second);
+  }
+  infeasible_sched_classes_by_shape_[info.shape].insert(scheduling_class);
+  for (const auto &entry : work.task.GetTaskSpecification()
+                               .GetRequiredPlacementResources()
+                               .GetResourceMap()) {
+    info.placement_resources.push_back(entry.first);
+    infeasible_sched_classes_by_resource_[entry.first].insert(scheduling_class);
+  }
+}
+
+void ClusterTaskManager::UnindexInfeasibleSchedulingClass(
+    SchedulingClass scheduling_class) {
+  auto it = infeasible_sched_class_info_.find(scheduling_class);
+  if (it == infeasible_sched_class_info_.end()) {
+    return;
+  }
+  auto shape_it = infeasible_sched_classes_by_shape_.find(it->second.shape);
+  shape_it->second.erase(scheduling_class);
+  if (shape_it->second.empty()) {
+    infeasible_sched_classes_by_shape_.erase(shape_it);
+  }
+  for (const auto &resource : it->second.placement_resources) {
+    auto resource_it = infeasible_sched_classes_by_resource_.find(resource);
+    resource_it->second.erase(scheduling_class);
+    if (resource_it->second.empty()) {
+      infeasible_sched_classes_by_resource_.erase(resource_it);
     }
   }
+  infeasible_sched_class_info_.erase(it);
 }
 
 void ClusterTaskManager::Dispatch(
@@ -1284,7 +1749,8 @@ void ClusterTaskManager::Dispatch(
 }
 
 void ClusterTaskManager::Spillback(const NodeID &spillback_to,
-                                   const std::shared_ptr<internal::Work> &work) {
+                                   const std::shared_ptr<internal::Work> &work,
+                                   bool allocate_remote_resources) {
   auto send_reply_callback = work->callback;
 
   if (work->grant_or_reject) {
@@ -1298,10 +1764,16 @@ void ClusterTaskManager::Spillback(const NodeID &spillback_to,
   const auto &task_spec = task.GetTaskSpecification();
   RAY_LOG(DEBUG) << "Spilling task " << task_spec.TaskId() << " to node " << spillback_to;
 
-  if (!cluster_resource_scheduler_->AllocateRemoteTaskResources(
-          spillback_to.Binary(), task_spec.GetRequiredResources().GetResourceMap())) {
-    RAY_LOG(DEBUG) << "Tried to allocate resources for request " << task_spec.TaskId()
-                   << " on a remote node that are no longer available";
+  // Keep the resources reserved until the remote node reports that it handled the
+  // request, so that reports it sends before the request arrives don't make us spill
+  // back more tasks than it can take.
+  const uint64_t reservation_token =
+      cluster_resource_scheduler_->ReserveRemoteTaskResources(
+          spillback_to.Binary(), task_spec.GetRequiredResources().GetResourceMap(),
+          allocate_remote_resources);
+  if (reservation_token == 0) {
+    RAY_LOG(DEBUG) << "Could not reserve resources for request " << task_spec.TaskId()
+                   << " on the remote node";
   }
 
   auto node_info_ptr = get_node_info_(spillback_to);
@@ -1313,6 +1785,7 @@ void ClusterTaskManager::Spillback(const NodeID &spillback_to,
       node_info_ptr->node_manager_address());
   reply->mutable_retry_at_raylet_address()->set_port(node_info_ptr->node_manager_port());
   reply->mutable_retry_at_raylet_address()->set_raylet_id(spillback_to.Binary());
+  reply->set_reservation_token(reservation_token);
 
   send_reply_callback();
 }
@@ -1341,7 +1814,7 @@ void ClusterTaskManager::SetWorkerBacklog(SchedulingClass scheduling_class,
   }
 }
 
-int64_t ClusterTaskManager::TotalBacklogSize(SchedulingClass scheduling_class) {
+int64_t ClusterTaskManager::TotalBacklogSize(SchedulingClass scheduling_class) const {
   auto backlog_it = backlog_tracker_.find(scheduling_class);
   if (backlog_it == backlog_tracker_.end()) {
     return 0;
@@ -1425,6 +1898,22 @@ bool ClusterTaskManager::ReturnCpuResourcesToBlockedWorker(
 }
 
 void ClusterTaskManager::ScheduleAndDispatchTasks() {
+  CancelAbandonedLeases();
+  // Only the classes that changed since the last pass, or that need a resource that
+  // was freed since, can make progress.
+  MarkSchedulingClassesWithGrownResourcesDirty();
+  const int64_t now_ms = get_time_ms_();
+  for (auto it = capped_sched_classes_.begin(); it != capped_sched_classes_.end();) {
+    auto info_it = info_by_sched_cls_.find(*it);
+    if (info_it == info_by_sched_cls_.end() ||
+        info_it->second.next_update_time <= now_ms) {
+      MarkSchedulingClassDirty(*it);
+      capped_sched_classes_.erase(it++);
+    } else {
+      it++;
+    }
+  }
+  internal_stats_.num_sched_classes_evaluated = 0;
   SchedulePendingTasks();
   DispatchScheduledTasksToWorkers(worker_pool_, leased_workers_);
   // TODO(swang): Spill from waiting queue first? Otherwise, we may end up
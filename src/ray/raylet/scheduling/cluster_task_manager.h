@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <map>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "ray/common/ray_object.h"
@@ -60,6 +62,8 @@ enum class UnscheduledWorkCause {
   WORKER_NOT_FOUND_RATE_LIMITED,
 };
 
+struct LeaseBatch;
+
 /// Work represents all the information needed to make a scheduling decision.
 /// This includes the task, the information we need to communicate to
 /// dispatch/spillback and the callback to trigger it.
@@ -70,6 +74,10 @@ class Work {
   rpc::RequestWorkerLeaseReply *reply;
   std::function<void(void)> callback;
   std::shared_ptr<TaskResourceInstances> allocated_instances;
+  /// The lease request for multiple workers that this work is part of, if any.
+  std::shared_ptr<LeaseBatch> lease_batch;
+  /// The time when the work was queued, in milliseconds.
+  int64_t queued_time_ms = 0;
   Work(RayTask task, bool grant_or_reject, rpc::RequestWorkerLeaseReply *reply,
        std::function<void(void)> callback, WorkStatus status = WorkStatus::WAITING)
       : task(task),
@@ -104,6 +112,35 @@ class Work {
       UnscheduledWorkCause::WAITING_FOR_RESOURCE_ACQUISITION;
 };
 
+/// A lease request for multiple workers of one scheduling class. Besides the work of
+/// the request itself, one work is queued for each additional worker that an idle
+/// worker could serve when the request arrives. These are only granted from the local
+/// node. The request is replied to once its own work is granted, spilled back,
+/// rejected or canceled, and the workers popped for additional works before then were
+/// handed out. Since idle workers are popped in order, these pops resolve right after
+/// the request's own. The reply carries the additional workers granted by then. The
+/// additional works that are still queued at that point are canceled, so that the
+/// request never waits for a worker to start or for resources to free up.
+struct LeaseBatch {
+  LeaseBatch(rpc::RequestWorkerLeaseReply *reply, std::function<void(void)> send_reply)
+      : reply(reply), send_reply(std::move(send_reply)) {}
+
+  /// The reply of the request.
+  rpc::RequestWorkerLeaseReply *reply;
+  /// Sends the reply of the request.
+  std::function<void(void)> send_reply;
+  /// Whether the work of the request itself is done.
+  bool done = false;
+  /// Whether the request was replied to.
+  bool replied = false;
+  /// The number of additional works that were popped a worker before the work of the
+  /// request itself was done, and whose pops haven't resolved yet.
+  int64_t num_pending_pops = 0;
+  /// The task ID and reply of the work for each additional worker.
+  std::vector<std::pair<TaskID, std::unique_ptr<rpc::RequestWorkerLeaseReply>>>
+      additional_leases;
+};
+
 typedef std::function<const rpc::GcsNodeInfo *(const NodeID &node_id)> NodeInfoGetter;
 
 }  // namespace internal
@@ -166,6 +203,12 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
 
   void ClearWorkerBacklog(const WorkerID &worker_id) override;
 
+  int64_t TotalBacklogSize(SchedulingClass scheduling_class) const override;
+
+  void HandleJobStarted(const JobID &job_id, const rpc::JobConfig &job_config) override;
+
+  void HandleJobFinished(const JobID &job_id) override;
+
   /// (Step 1) Queue tasks and schedule.
   /// Queue task and schedule. This hanppens when processing the worker lease request.
   ///
@@ -178,6 +221,19 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
                             rpc::RequestWorkerLeaseReply *reply,
                             rpc::SendReplyCallback send_reply_callback) override;
 
+  /// Queue a request for up to `max_leases` workers to run tasks like the given one,
+  /// and schedule. See internal::LeaseBatch for when the request is replied to.
+  ///
+  /// \param task: The incoming task to be queued and scheduled.
+  /// \param grant_or_reject: True if we we should either grant or reject the request
+  ///                         but no spillback.
+  /// \param max_leases: The maximum number of workers to grant.
+  /// \param reply: The reply of the lease request.
+  /// \param send_reply_callback: The function used during dispatching.
+  void QueueAndScheduleLeases(const RayTask &task, bool grant_or_reject,
+                              int64_t max_leases, rpc::RequestWorkerLeaseReply *reply,
+                              rpc::SendReplyCallback send_reply_callback) override;
+
   /// Move tasks from waiting to ready for dispatch. Called when a task's
   /// dependencies are resolved.
   ///
@@ -283,6 +339,26 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
   /// \return True if any tasks are ready for dispatch.
   bool SchedulePendingTasks();
 
+  /// Count the works at the front of a queue, starting at `begin`, that can be
+  /// scheduled as one batch: they must all be identical normal task requests that
+  /// don't need an immediate grant or reject.
+  ///
+  /// \return The size of the batch, or 1 if the first work can't be batched.
+  size_t GetSchedulingBatchSize(
+      const std::deque<std::shared_ptr<internal::Work>> &work_queue,
+      std::deque<std::shared_ptr<internal::Work>>::const_iterator begin) const;
+
+  /// Schedule a batch of works with a single multi-node scheduling decision, then
+  /// queue or spill back each group of works.
+  ///
+  /// \param begin: The first work of the batch.
+  /// \param batch_size: The size of the batch, see GetSchedulingBatchSize.
+  /// \param did_schedule[out]: Set to true if any work is ready for dispatch.
+  /// \param is_infeasible[out]: Set to true if the works are infeasible.
+  /// \return The number of works scheduled, from the front of the batch.
+  size_t ScheduleWorkBatch(std::deque<std::shared_ptr<internal::Work>>::iterator begin,
+                           size_t batch_size, bool *did_schedule, bool *is_infeasible);
+
   void RemoveFromRunningTasksIfExists(const RayTask &task);
 
   /// Handle the popped worker from worker pool.
@@ -303,6 +379,37 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
       WorkerPoolInterface &worker_pool,
       absl::flat_hash_map<WorkerID, std::shared_ptr<WorkerInterface>> &leased_workers);
 
+  /// The progress of a scheduling class in a dispatch pass.
+  struct DispatchCursor {
+    /// The index of the next work to evaluate in the class' dispatch queue.
+    size_t next_index = 0;
+    /// Whether the class turned out to be infeasible.
+    bool is_infeasible = false;
+  };
+
+  /// Evaluate the works in the dispatch queue of a scheduling class from the cursor
+  /// on, until `max_to_dispatch` of them are waiting for workers, or no more can be
+  /// dispatched.
+  ///
+  /// \return True if the class stopped at `max_to_dispatch` and may dispatch more.
+  bool DispatchSchedulingClass(SchedulingClass scheduling_class, size_t max_to_dispatch,
+                               DispatchCursor *cursor);
+
+  /// Clean up a scheduling class after a dispatch pass evaluated it, moving the class
+  /// to the infeasible queue if the cursor says so.
+  void FinishDispatchingSchedulingClass(SchedulingClass scheduling_class,
+                                        const DispatchCursor &cursor);
+
+  /// Dispatch the works of the given classes one by one, each from the class whose
+  /// next work belongs to the job with the highest priority, so that jobs get their
+  /// weighted fair share of the workers no matter how many tasks they queued.
+  void DispatchSchedulingClassesFairly(const std::vector<SchedulingClass> &sched_classes);
+
+  /// The priority of the next task of a job to be dispatched, lower first. Jobs
+  /// below their minimum share come first, then jobs by their number of running tasks
+  /// per weight.
+  std::pair<bool, double> GetJobDispatchPriority(const JobID &job_id) const;
+
   /// Helper method when the current node does not have the available resources to run a
   /// task.
   ///
@@ -311,10 +418,37 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
   /// the requested resources available).
   bool TrySpillback(const std::shared_ptr<internal::Work> &work, bool &is_infeasible);
 
-  /// Reiterate all local infeasible tasks and register them to task_to_schedule_ if it
-  /// becomes feasible to schedule.
+  /// Reiterate the local infeasible tasks that may have become feasible, and register
+  /// them to task_to_schedule_ if they are feasible now.
   void TryLocalInfeasibleTaskScheduling();
 
+  /// Add a scheduling class that was just moved to `infeasible_tasks_` to the
+  /// infeasible class indexes.
+  ///
+  /// \param scheduling_class: The infeasible class.
+  /// \param work: A work of the class, whose resource demands are indexed.
+  void IndexInfeasibleSchedulingClass(SchedulingClass scheduling_class,
+                                      const internal::Work &work);
+
+  /// Remove a scheduling class that is leaving `infeasible_tasks_` from the infeasible
+  /// class indexes.
+  void UnindexInfeasibleSchedulingClass(SchedulingClass scheduling_class);
+
+  /// Get the scheduling classes of `queues` that the current pass should evaluate:
+  /// all of them if `all_sched_classes_dirty_` is set, else the dirty ones.
+  std::vector<SchedulingClass> GetSchedulingClassesToEvaluate(
+      const absl::flat_hash_map<SchedulingClass,
+                                std::deque<std::shared_ptr<internal::Work>>> &queues)
+      const;
+
+  /// Mark the queued scheduling classes that need a resource whose availability grew
+  /// on some node since the last pass dirty, since they may fit now.
+  void MarkSchedulingClassesWithGrownResourcesDirty();
+
+  /// Mark a scheduling class to be evaluated by the next scheduling pass, because
+  /// its works may be schedulable or dispatchable now.
+  void MarkSchedulingClassDirty(SchedulingClass scheduling_class);
+
   // Try to spill waiting tasks to a remote node, starting from the end of the
   // queue.
   void SpillWaitingTasks();
@@ -332,6 +466,15 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
                                      bool requires_object_store_memory,
                                      bool force_spillback, bool *is_infeasible);
 
+  /// Reply to a lease request for multiple workers if its own work is done and no pop
+  /// it waits for is pending. The additional works that were not granted are canceled
+  /// on the next call to ScheduleAndDispatchTasks.
+  void MaybeReplyLeaseBatch(const std::shared_ptr<internal::LeaseBatch> &batch);
+
+  /// Cancel the additional works of lease batches that were replied to before the
+  /// works were granted.
+  void CancelAbandonedLeases();
+
   /// Recompute the debug stats.
   /// It is needed because updating the debug state is expensive for cluster_task_manager.
   /// TODO(sang): Update the internal states value dynamically instead of iterating the
@@ -417,6 +560,52 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
   absl::flat_hash_map<SchedulingClass, std::deque<std::shared_ptr<internal::Work>>>
       infeasible_tasks_;
 
+  /// The resource demands of a scheduling class in `infeasible_tasks_`.
+  struct InfeasibleSchedulingClassInfo {
+    /// The resource shape of the class, as reported to the autoscaler.
+    std::map<std::string, double> shape;
+    /// The resources needed to place a work of the class.
+    std::vector<std::string> placement_resources;
+  };
+  absl::flat_hash_map<SchedulingClass, InfeasibleSchedulingClassInfo>
+      infeasible_sched_class_info_;
+
+  /// Index of `infeasible_tasks_` by resource. Every class is listed under each
+  /// resource it needs to be placed, since it can only become feasible once some
+  /// node's total of one of these resources grows.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<SchedulingClass>>
+      infeasible_sched_classes_by_resource_;
+
+  /// Index of `infeasible_tasks_` by resource shape, so that the demand of classes
+  /// with the same shape is reported to the autoscaler as one entry.
+  std::map<std::map<std::string, double>, absl::flat_hash_set<SchedulingClass>>
+      infeasible_sched_classes_by_shape_;
+
+  /// The availability epoch of the resource scheduler when the infeasible classes were
+  /// last checked.
+  uint64_t last_feasibility_check_epoch_ = 0;
+
+  /// Additional works of replied lease batches that should be canceled.
+  std::vector<TaskID> abandoned_leases_;
+
+  /// Scheduling classes whose works may have become schedulable or dispatchable
+  /// since the last pass, e.g., because works were queued or their args became
+  /// local. A pass only evaluates these, instead of rescanning all queues.
+  absl::flat_hash_set<SchedulingClass> dirty_sched_classes_;
+
+  /// Whether the next pass should evaluate all scheduling classes, e.g., because a
+  /// node gained in a way that may unblock any class.
+  bool all_sched_classes_dirty_ = true;
+
+  /// The availability epoch of the resource scheduler seen by the last pass.
+  uint64_t last_availability_epoch_ = 0;
+
+  /// Scheduling classes held back by the worker cap until their next update time.
+  absl::flat_hash_set<SchedulingClass> capped_sched_classes_;
+
+  /// Scheduling classes with works waiting for pinned task args to be released.
+  absl::flat_hash_set<SchedulingClass> sched_classes_waiting_for_memory_;
+
   /// Track the backlog of all workers belonging to this raylet.
   absl::flat_hash_map<SchedulingClass, absl::flat_hash_map<WorkerID, int64_t>>
       backlog_tracker_;
@@ -462,6 +651,27 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
 
   const int64_t sched_cls_cap_max_ms_;
 
+  /// Whether to schedule runs of identical pending tasks as one batch.
+  bool batch_scheduling_enabled_;
+
+  /// Whether to dispatch the tasks of different jobs by weighted fair sharing.
+  bool job_fair_sharing_enabled_;
+
+  /// The share of a job in the workers of this node.
+  struct JobSchedulingInfo {
+    /// The weight of the job's share.
+    double weight = 1;
+    /// The number of running tasks the job gets before sharing by weight.
+    int64_t min_share = 0;
+  };
+
+  /// The shares of the jobs that have started, as set in their job configs. Other
+  /// jobs get the default share.
+  absl::flat_hash_map<JobID, JobSchedulingInfo> info_by_job_;
+
+  /// The number of running tasks of each job with running tasks on this node.
+  absl::flat_hash_map<JobID, int64_t> num_running_tasks_by_job_;
+
   struct InternalStats {
     /// Number of tasks that are spilled to other
     /// nodes because it cannot be scheduled locally.
@@ -492,6 +702,8 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
     int64_t num_tasks_to_schedule = 0;
     /// Number of tasks to dispatch.
     int64_t num_tasks_to_dispatch = 0;
+    /// Number of scheduling class queues evaluated by the last scheduling pass.
+    int64_t num_sched_classes_evaluated = 0;
   };
 
   mutable InternalStats internal_stats_;
@@ -509,10 +721,14 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
       const RayTask &task, rpc::RequestWorkerLeaseReply *reply,
       std::function<void(void)> send_reply_callback);
 
-  void Spillback(const NodeID &spillback_to, const std::shared_ptr<internal::Work> &work);
-
-  /// Sum up the backlog size across all workers for a given scheduling class.
-  int64_t TotalBacklogSize(SchedulingClass scheduling_class);
+  /// Reply to a lease request with a node to retry at.
+  ///
+  /// \param spillback_to: The node to retry at.
+  /// \param work: The lease request.
+  /// \param allocate_remote_resources: Whether to subtract the task's resources from the
+  /// node's available resources. False if the caller has already done so.
+  void Spillback(const NodeID &spillback_to, const std::shared_ptr<internal::Work> &work,
+                 bool allocate_remote_resources = true);
 
   // Helper function to pin a task's args immediately before dispatch. This
   // returns false if there are missing args (due to eviction) or if there is
@@ -527,6 +743,7 @@ class ClusterTaskManager : public ClusterTaskManagerInterface {
 
   friend class ClusterTaskManagerTest;
   FRIEND_TEST(ClusterTaskManagerTest, FeasibleToNonFeasible);
+  FRIEND_TEST(ClusterTaskManagerTest, InfeasibleSchedulingClassIndexTest);
 };
 }  // namespace raylet
 }  // namespace ray
@@ -0,0 +1,290 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how many workers the cluster task manager leases per second, and how many
+// lease requests that takes, depending on how many workers one request may ask for.
+// Also measures how many tasks per second it schedules from a backlog of identical
+// tasks onto remote nodes, once task by task and once in batches.
+//
+// Usage: cluster_task_manager_benchmark --num_tasks=100000 --num_workers=16
+//            --num_nodes=100
+
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <list>
+
+// clang-format off
+#include "gflags/gflags.h"
+#include "ray/common/task/task_util.h"
+#include "ray/raylet/scheduling/cluster_resource_scheduler.h"
+#include "ray/raylet/scheduling/cluster_task_manager.h"
+#include "ray/raylet/test/util.h"
+#include "mock/ray/gcs/gcs_client/gcs_client.h"
+// clang-format on
+
+DEFINE_int64(num_tasks, 100000, "The number of tasks that each need a leased worker.");
+DEFINE_int64(num_workers, 16, "The number of CPUs and idle workers of the node.");
+DEFINE_int64(max_pending_requests, 10,
+             "The maximum number of lease requests in flight at once.");
+DEFINE_int64(num_nodes, 100, "The number of remote nodes to schedule the backlog on.");
+
+namespace ray {
+namespace raylet {
+
+/// A worker pool that hands out workers in the order they were popped, after the
+/// pop returns, as WorkerPool does. Workers that would have to be started are
+/// created right away, but counted.
+class FifoWorkerPool : public WorkerPoolInterface {
+ public:
+  void PopWorker(const TaskSpecification &task_spec, const PopWorkerCallback &callback,
+                 const std::string &allocated_instances_serialized_json) override {
+    std::shared_ptr<WorkerInterface> worker;
+    if (idle_workers_.empty()) {
+      worker = std::make_shared<MockWorker>(WorkerID::FromRandom(), 0);
+      num_started_workers_++;
+    } else {
+      worker = idle_workers_.back();
+      idle_workers_.pop_back();
+    }
+    popped_workers_.emplace_back(callback, worker);
+  }
+
+  size_t NumIdleWorkersForTask(const TaskSpecification &task_spec) override {
+    return idle_workers_.size();
+  }
+
+  void PushWorker(const std::shared_ptr<WorkerInterface> &worker) override {
+    idle_workers_.push_back(worker);
+  }
+
+  const std::vector<std::shared_ptr<WorkerInterface>> GetAllRegisteredWorkers(
+      bool filter_dead_workers) const override {
+    return {};
+  }
+
+  /// Run the callbacks of the pops, in the order the workers were popped.
+  void RunPopCallbacks() {
+    while (!popped_workers_.empty()) {
+      auto popped = std::move(popped_workers_.front());
+      popped_workers_.pop_front();
+      if (!popped.first(popped.second, PopWorkerStatus::OK)) {
+        idle_workers_.push_back(popped.second);
+      }
+    }
+  }
+
+  int64_t NumStartedWorkers() const { return num_started_workers_; }
+
+ private:
+  std::vector<std::shared_ptr<WorkerInterface>> idle_workers_;
+  std::deque<std::pair<PopWorkerCallback, std::shared_ptr<WorkerInterface>>>
+      popped_workers_;
+  int64_t num_started_workers_ = 0;
+};
+
+class NoDependencies : public TaskDependencyManagerInterface {
+ public:
+  bool RequestTaskDependencies(
+      const TaskID &task_id,
+      const std::vector<rpc::ObjectReference> &required_objects) override {
+    return true;
+  }
+  void RemoveTaskDependencies(const TaskID &task_id) override {}
+  bool TaskDependenciesBlocked(const TaskID &task_id) const override { return false; }
+  bool CheckObjectLocal(const ObjectID &object_id) const override { return true; }
+};
+
+struct LeaseBenchmarkResult {
+  int64_t num_requests = 0;
+  int64_t num_leases = 0;
+  int64_t num_started_workers = 0;
+  double seconds = 0;
+};
+
+RayTask CreateTask(const JobID &job_id) {
+  TaskSpecBuilder spec_builder;
+  rpc::Address address;
+  spec_builder.SetCommonTaskSpec(
+      TaskID::FromRandom(job_id), "benchmark_task", Language::PYTHON,
+      FunctionDescriptorBuilder::BuildPython("", "", "", ""), job_id, TaskID::Nil(), 0,
+      TaskID::Nil(), address, 0, {{kCPU_ResourceLabel, 1}}, {}, "", 0, "{}", {});
+  return RayTask(spec_builder.Build(), TaskExecutionSpecification());
+}
+
+/// Lease a worker for each task, asking for up to `max_leases` workers per request.
+/// Each leased worker runs one task and is returned. The last requests may lease a few
+/// more workers than there are tasks left.
+LeaseBenchmarkResult RunLeaseBenchmark(int64_t max_leases) {
+  gcs::MockGcsClient gcs_client;
+  const auto node_id = NodeID::FromRandom();
+  auto scheduler = std::make_shared<ClusterResourceScheduler>(
+      node_id.Binary(),
+      absl::flat_hash_map<std::string, double>{
+          {kCPU_ResourceLabel, static_cast<double>(FLAGS_num_workers)}},
+      gcs_client);
+  NoDependencies dependency_manager;
+  FifoWorkerPool pool;
+  absl::flat_hash_map<WorkerID, std::shared_ptr<WorkerInterface>> leased_workers;
+  ClusterTaskManager task_manager(
+      node_id, scheduler, dependency_manager,
+      /*is_owner_alive=*/[](const WorkerID &, const NodeID &) { return true; },
+      /*get_node_info=*/
+      [](const NodeID &) -> const rpc::GcsNodeInfo * { return nullptr; },
+      /*announce_infeasible_task=*/[](const RayTask &) {}, pool, leased_workers,
+      /*get_task_arguments=*/
+      [](const std::vector<ObjectID> &, std::vector<std::unique_ptr<RayObject>> *) {
+        return true;
+      },
+      /*max_pinned_task_arguments_bytes=*/1000);
+  for (int64_t i = 0; i < FLAGS_num_workers; i++) {
+    pool.PushWorker(std::make_shared<MockWorker>(WorkerID::FromRandom(), 0));
+  }
+
+  const auto job_id = JobID::FromInt(1);
+  const auto task = CreateTask(job_id);
+  LeaseBenchmarkResult result;
+  std::list<rpc::RequestWorkerLeaseReply> replies;
+  std::vector<std::list<rpc::RequestWorkerLeaseReply>::iterator> replied;
+  int64_t num_tasks_left = FLAGS_num_tasks;
+  const auto start = std::chrono::steady_clock::now();
+  while (num_tasks_left > 0) {
+    while (static_cast<int64_t>(replies.size()) < FLAGS_max_pending_requests &&
+           static_cast<int64_t>(replies.size()) < num_tasks_left) {
+      auto reply = replies.emplace(replies.end());
+      result.num_requests++;
+      task_manager.QueueAndScheduleLeases(
+          task, /*grant_or_reject=*/false, max_leases, &*reply,
+          [&replied, reply](Status, std::function<void()>, std::function<void()>) {
+            replied.push_back(reply);
+          });
+    }
+    pool.RunPopCallbacks();
+
+    for (const auto &reply : replied) {
+      std::vector<WorkerID> worker_ids = {
+          WorkerID::FromBinary(reply->worker_address().worker_id())};
+      for (const auto &lease : reply->additional_leases()) {
+        worker_ids.push_back(WorkerID::FromBinary(lease.worker_address().worker_id()));
+      }
+      for (const auto &worker_id : worker_ids) {
+        auto worker = leased_workers.at(worker_id);
+        leased_workers.erase(worker_id);
+        RayTask finished_task;
+        task_manager.TaskFinished(worker, &finished_task);
+        pool.PushWorker(worker);
+        result.num_leases++;
+        num_tasks_left--;
+      }
+      replies.erase(reply);
+    }
+    replied.clear();
+    task_manager.ScheduleAndDispatchTasks();
+  }
+  result.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.num_started_workers = pool.NumStartedWorkers();
+  return result;
+}
+
+/// Schedule a backlog of `FLAGS_num_tasks` identical tasks onto remote nodes with
+/// `FLAGS_num_workers` CPUs each, as the raylet of a head node without CPUs does. All
+/// tasks are spilled back.
+///
+/// \param batch Whether to schedule runs of identical tasks with one decision.
+/// \return The number of tasks scheduled per second.
+double RunBatchSchedulingBenchmark(bool batch) {
+  RayConfig::instance().initialize(std::string(R"({"scheduler_batch_pending_tasks": )") +
+                                   (batch ? "true" : "false") + "}");
+  gcs::MockGcsClient gcs_client;
+  const auto node_id = NodeID::FromRandom();
+  auto scheduler = std::make_shared<ClusterResourceScheduler>(
+      node_id.Binary(), absl::flat_hash_map<std::string, double>{{kCPU_ResourceLabel, 0}},
+      gcs_client);
+  NoDependencies dependency_manager;
+  FifoWorkerPool pool;
+  absl::flat_hash_map<WorkerID, std::shared_ptr<WorkerInterface>> leased_workers;
+  absl::flat_hash_map<NodeID, rpc::GcsNodeInfo> node_info;
+  ClusterTaskManager task_manager(
+      node_id, scheduler, dependency_manager,
+      /*is_owner_alive=*/[](const WorkerID &, const NodeID &) { return true; },
+      /*get_node_info=*/
+      [&node_info](const NodeID &id) -> const rpc::GcsNodeInfo * {
+        auto it = node_info.find(id);
+        return it == node_info.end() ? nullptr : &it->second;
+      },
+      /*announce_infeasible_task=*/[](const RayTask &) {}, pool, leased_workers,
+      /*get_task_arguments=*/
+      [](const std::vector<ObjectID> &, std::vector<std::unique_ptr<RayObject>> *) {
+        return true;
+      },
+      /*max_pinned_task_arguments_bytes=*/1000);
+
+  // Without any node with CPUs, the tasks queue up as infeasible.
+  const auto job_id = JobID::FromInt(1);
+  std::vector<rpc::RequestWorkerLeaseReply> replies(FLAGS_num_tasks);
+  int64_t num_replies = 0;
+  for (auto &reply : replies) {
+    task_manager.QueueAndScheduleTask(
+        CreateTask(job_id), /*grant_or_reject=*/false, &reply,
+        [&num_replies](Status, std::function<void()>, std::function<void()>) {
+          num_replies++;
+        });
+  }
+  RAY_CHECK(num_replies == 0);
+  for (int64_t i = 0; i < FLAGS_num_nodes; i++) {
+    const auto remote_node_id = NodeID::FromRandom();
+    const absl::flat_hash_map<std::string, double> resources = {
+        {kCPU_ResourceLabel, static_cast<double>(FLAGS_num_workers)}};
+    scheduler->AddOrUpdateNode(remote_node_id.Binary(), resources, resources);
+    node_info[remote_node_id] = rpc::GcsNodeInfo();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  task_manager.ScheduleAndDispatchTasks();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  RAY_CHECK(num_replies == FLAGS_num_tasks);
+  return FLAGS_num_tasks / seconds;
+}
+
+}  // namespace raylet
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::cout << std::setw(12) << "max_leases" << std::setw(12) << "requests"
+            << std::setw(12) << "leases" << std::setw(16) << "leases/s"
+            << std::setw(18) << "leases/request" << std::setw(18) << "started_workers"
+            << std::endl;
+  for (int64_t max_leases : {1, 2, 4, 8, 16}) {
+    const auto result = ray::raylet::RunLeaseBenchmark(max_leases);
+    std::cout << std::setw(12) << max_leases << std::setw(12) << result.num_requests
+              << std::setw(12) << result.num_leases << std::setw(16) << std::fixed
+              << std::setprecision(0) << result.num_leases / result.seconds
+              << std::setw(18) << std::setprecision(2)
+              << static_cast<double>(result.num_leases) / result.num_requests
+              << std::setw(18) << result.num_started_workers << std::endl;
+  }
+
+  std::cout << std::endl
+            << std::setw(12) << "scheduling" << std::setw(16) << "tasks/s" << std::endl;
+  for (bool batch : {false, true}) {
+    const double tasks_per_second = ray::raylet::RunBatchSchedulingBenchmark(batch);
+    std::cout << std::setw(12) << (batch ? "batched" : "per-task") << std::setw(16)
+              << std::fixed << std::setprecision(0) << tasks_per_second << std::endl;
+  }
+  return 0;
+}
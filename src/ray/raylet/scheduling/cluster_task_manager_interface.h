@@ -16,6 +16,7 @@
 
 #include "ray/raylet/worker.h"
 #include "ray/rpc/server_call.h"
+#include "src/ray/protobuf/gcs.pb.h"
 #include "src/ray/protobuf/node_manager.pb.h"
 
 namespace ray {
@@ -104,6 +105,24 @@ class ClusterTaskManagerInterface {
   /// that we want to remove.
   virtual void ClearWorkerBacklog(const WorkerID &worker_id) = 0;
 
+  /// Sum up the backlog size across all workers for a given scheduling class.
+  ///
+  /// \param scheduling_class: The scheduling class to get the backlog of.
+  /// \return The total backlog size reported by workers.
+  virtual int64_t TotalBacklogSize(SchedulingClass scheduling_class) const = 0;
+
+  /// Handle the start of a job, e.g., to set the job's share in the dispatch of tasks.
+  ///
+  /// \param job_id: The ID of the job.
+  /// \param job_config: The config of the job.
+  virtual void HandleJobStarted(const JobID &job_id,
+                                const rpc::JobConfig &job_config) = 0;
+
+  /// Handle the end of a job.
+  ///
+  /// \param job_id: The ID of the job.
+  virtual void HandleJobFinished(const JobID &job_id) = 0;
+
   /// Queue task and schedule. This hanppens when processing the worker lease request.
   ///
   /// \param task: The incoming task to be queued and scheduled.
@@ -115,6 +134,21 @@ class ClusterTaskManagerInterface {
                                     rpc::RequestWorkerLeaseReply *reply,
                                     rpc::SendReplyCallback send_reply_callback) = 0;
 
+  /// Queue a request for up to `max_leases` workers to run tasks like the given one,
+  /// and schedule. The raylet may grant fewer workers. The first worker is granted to
+  /// the reply as by QueueAndScheduleTask, and the others to its additional leases.
+  ///
+  /// \param task: The incoming task to be queued and scheduled.
+  /// \param grant_or_reject: True if we we should either grant or reject the request
+  ///                         but no spillback.
+  /// \param max_leases: The maximum number of workers to grant.
+  /// \param reply: The reply of the lease request.
+  /// \param send_reply_callback: The function used during dispatching.
+  virtual void QueueAndScheduleLeases(const RayTask &task, bool grant_or_reject,
+                                      int64_t max_leases,
+                                      rpc::RequestWorkerLeaseReply *reply,
+                                      rpc::SendReplyCallback send_reply_callback) = 0;
+
   /// Return if any tasks are pending resource acquisition.
   ///
   /// \param[in] exemplar An example task that is deadlocking.
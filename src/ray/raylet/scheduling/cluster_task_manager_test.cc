@@ -16,6 +16,7 @@
 // clang-format off
 #include "ray/raylet/scheduling/cluster_task_manager.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -56,6 +57,14 @@ class MockWorkerPool : public WorkerPoolInterface {
     callbacks[runtime_env_hash].push_back(callback);
   }
 
+  size_t NumIdleWorkersForTask(const TaskSpecification &task_spec) {
+    const WorkerCacheKey env = {task_spec.SerializedRuntimeEnv(), {}};
+    const int runtime_env_hash = env.IntHash();
+    return std::count_if(workers.begin(), workers.end(), [&](const auto &worker) {
+      return worker->GetRuntimeEnvHash() == runtime_env_hash;
+    });
+  }
+
   void PushWorker(const std::shared_ptr<WorkerInterface> &worker) {
     workers.push_front(worker);
   }
@@ -281,15 +290,53 @@ class ClusterTaskManagerTest : public ::testing::Test {
     node_info_[id] = info;
   }
 
+  /// Queue a lease request without scheduling it, to build up a backlog.
+  void QueueWithoutScheduling(const RayTask &task, rpc::RequestWorkerLeaseReply *reply,
+                              std::function<void(void)> callback) {
+    const auto &scheduling_class = task.GetTaskSpecification().GetSchedulingClass();
+    task_manager_.tasks_to_schedule_[scheduling_class].push_back(
+        std::make_shared<internal::Work>(task, false, reply, callback));
+    task_manager_.MarkSchedulingClassDirty(scheduling_class);
+  }
+
+  /// Force the next scheduling pass to evaluate every scheduling class.
+  void MarkAllSchedulingClassesDirty() { task_manager_.all_sched_classes_dirty_ = true; }
+
+  int64_t NumSchedulingClassesEvaluated() {
+    return task_manager_.internal_stats_.num_sched_classes_evaluated;
+  }
+
+  size_t NumQueuedToSchedule(SchedulingClass scheduling_class) {
+    auto it = task_manager_.tasks_to_schedule_.find(scheduling_class);
+    return it == task_manager_.tasks_to_schedule_.end() ? 0 : it->second.size();
+  }
+
+  void SetBatchScheduling(bool enabled) {
+    task_manager_.batch_scheduling_enabled_ = enabled;
+  }
+
+  void SetJobFairSharing(bool enabled) {
+    task_manager_.job_fair_sharing_enabled_ = enabled;
+  }
+
+  int64_t NumRunningTasks(const JobID &job_id) {
+    auto it = task_manager_.num_running_tasks_by_job_.find(job_id);
+    return it == task_manager_.num_running_tasks_by_job_.end() ? 0 : it->second;
+  }
+
   void AssertNoLeaks() {
     ASSERT_TRUE(task_manager_.tasks_to_schedule_.empty());
     ASSERT_TRUE(task_manager_.tasks_to_dispatch_.empty());
     ASSERT_TRUE(task_manager_.waiting_tasks_index_.empty());
     ASSERT_TRUE(task_manager_.waiting_task_queue_.empty());
     ASSERT_TRUE(task_manager_.infeasible_tasks_.empty());
+    ASSERT_TRUE(task_manager_.infeasible_sched_class_info_.empty());
+    ASSERT_TRUE(task_manager_.infeasible_sched_classes_by_resource_.empty());
+    ASSERT_TRUE(task_manager_.infeasible_sched_classes_by_shape_.empty());
     ASSERT_TRUE(task_manager_.executing_task_args_.empty());
     ASSERT_TRUE(task_manager_.pinned_task_arguments_.empty());
     ASSERT_TRUE(task_manager_.info_by_sched_cls_.empty());
+    ASSERT_TRUE(task_manager_.num_running_tasks_by_job_.empty());
     ASSERT_EQ(task_manager_.pinned_task_arguments_bytes_, 0);
     ASSERT_TRUE(dependency_manager_.subscribed_tasks.empty());
   }
@@ -760,6 +807,111 @@ TEST_F(ClusterTaskManagerTest, TestGrantOrReject) {
   AssertNoLeaks();
 }
 
+TEST_F(ClusterTaskManagerTest, TestMultipleLeases) {
+  /*
+    Test that one lease request can be granted several workers:
+    1. Request 4 leases while 3 workers are idle, for a task that fits on the node
+       only twice.
+    2. Only the 2 works that fit pop a worker, and the third additional work is not
+       even queued.
+    3. The request waits for the pop of its additional work, which was issued in the
+       same pass, and then carries its worker as an additional lease.
+    4. The lease that could not be granted is canceled.
+   */
+  RayTask task = CreateTask({{ray::kCPU_ResourceLabel, 4}});
+  rpc::RequestWorkerLeaseReply reply;
+  int num_callbacks = 0;
+  auto callback = [&num_callbacks](Status, std::function<void()>,
+                                   std::function<void()>) { num_callbacks++; };
+
+  std::vector<std::shared_ptr<WorkerInterface>> workers;
+  for (int i = 0; i < 3; i++) {
+    workers.push_back(std::make_shared<MockWorker>(WorkerID::FromRandom(), 1234 + i));
+    pool_.PushWorker(workers.back());
+  }
+  task_manager_.QueueAndScheduleLeases(task, /*grant_or_reject=*/false,
+                                       /*max_leases=*/4, &reply, callback);
+  ASSERT_EQ(pool_.num_pops, 2);
+  ASSERT_EQ(num_callbacks, 0);
+
+  // Hand out the idle workers in the order they were popped.
+  pool_.workers.clear();
+  ASSERT_EQ(pool_.callbacks.size(), 1);
+  auto pop_callbacks = std::move(pool_.callbacks.begin()->second);
+  pool_.callbacks.clear();
+  ASSERT_EQ(pop_callbacks.size(), 2);
+  ASSERT_TRUE(pop_callbacks.front()(workers[0], PopWorkerStatus::OK));
+  ASSERT_EQ(num_callbacks, 0);
+  ASSERT_TRUE(pop_callbacks.back()(workers[1], PopWorkerStatus::OK));
+  ASSERT_EQ(num_callbacks, 1);
+  ASSERT_EQ(leased_workers_.size(), 2);
+  ASSERT_FALSE(reply.worker_address().raylet_id().empty());
+  ASSERT_EQ(reply.additional_leases_size(), 1);
+  ASSERT_NE(reply.additional_leases(0).worker_address().worker_id(),
+            reply.worker_address().worker_id());
+
+  // The lease that wasn't granted is canceled on the next scheduling pass.
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(num_callbacks, 1);
+  ASSERT_EQ(pool_.num_pops, 2);
+
+  while (!leased_workers_.empty()) {
+    RayTask finished_task;
+    task_manager_.TaskFinished(leased_workers_.begin()->second, &finished_task);
+    leased_workers_.erase(leased_workers_.begin());
+  }
+  AssertNoLeaks();
+}
+
+TEST_F(ClusterTaskManagerTest, TestMultipleLeasesFromIdleWorkers) {
+  /*
+    Test that a lease request for several workers is granted all the idle workers it
+    can use, but never waits for a worker to start:
+    1. Request 4 leases while 2 workers are idle.
+    2. The request gets both idle workers.
+    3. Request 4 leases while 1 worker is idle. It is only granted that worker.
+   */
+  RayTask task = CreateTask({{ray::kCPU_ResourceLabel, 1}});
+  rpc::RequestWorkerLeaseReply reply;
+  int num_callbacks = 0;
+  auto callback = [&num_callbacks](Status, std::function<void()>,
+                                   std::function<void()>) { num_callbacks++; };
+
+  for (int i = 0; i < 2; i++) {
+    std::shared_ptr<MockWorker> worker =
+        std::make_shared<MockWorker>(WorkerID::FromRandom(), 1234 + i);
+    pool_.PushWorker(std::static_pointer_cast<WorkerInterface>(worker));
+  }
+  task_manager_.QueueAndScheduleLeases(task, /*grant_or_reject=*/false,
+                                       /*max_leases=*/4, &reply, callback);
+  ASSERT_EQ(pool_.num_pops, 2);
+  pool_.TriggerCallbacks();
+  ASSERT_EQ(num_callbacks, 1);
+  ASSERT_EQ(leased_workers_.size(), 2);
+  ASSERT_EQ(reply.additional_leases_size(), 1);
+  ASSERT_TRUE(pool_.workers.empty());
+
+  RayTask task2 = CreateTask({{ray::kCPU_ResourceLabel, 1}});
+  rpc::RequestWorkerLeaseReply reply2;
+  pool_.PushWorker(std::make_shared<MockWorker>(WorkerID::FromRandom(), 1236));
+  task_manager_.QueueAndScheduleLeases(task2, /*grant_or_reject=*/false,
+                                       /*max_leases=*/4, &reply2, callback);
+  ASSERT_EQ(pool_.num_pops, 3);
+  pool_.TriggerCallbacks();
+  ASSERT_EQ(num_callbacks, 2);
+  ASSERT_EQ(leased_workers_.size(), 3);
+  ASSERT_EQ(reply2.additional_leases_size(), 0);
+
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(pool_.num_pops, 3);
+  while (!leased_workers_.empty()) {
+    RayTask finished_task;
+    task_manager_.TaskFinished(leased_workers_.begin()->second, &finished_task);
+    leased_workers_.erase(leased_workers_.begin());
+  }
+  AssertNoLeaks();
+}
+
 TEST_F(ClusterTaskManagerTest, TestSpillAfterAssigned) {
   /*
     Test the race condition in which a task is assigned to the local node, but
@@ -1432,6 +1584,58 @@ TEST_F(ClusterTaskManagerTest, FeasibleToNonFeasible) {
             task1.GetTaskSpecification().TaskId());
 }
 
+TEST_F(ClusterTaskManagerTest, InfeasibleSchedulingClassIndexTest) {
+  /*
+    Infeasible classes are indexed by resource, so that a class is only checked again
+    once some node has more of a resource that it needs, and by shape, so that classes
+    with the same shape are reported to the autoscaler as one demand.
+   */
+  rpc::RequestWorkerLeaseReply reply;
+  int num_callbacks = 0;
+  auto callback = [&num_callbacks](Status, std::function<void()>, std::function<void()>) {
+    num_callbacks++;
+  };
+  // The GPU tasks only differ in their runtime env, so they have the same shape.
+  RayTask gpu_task_a = CreateTask({{ray::kGPU_ResourceLabel, 1}}, /*num_args=*/0,
+                                  /*args=*/{}, "mock_env_A");
+  RayTask gpu_task_b = CreateTask({{ray::kGPU_ResourceLabel, 1}}, /*num_args=*/0,
+                                  /*args=*/{}, "mock_env_B");
+  RayTask cpu_task = CreateTask({{ray::kCPU_ResourceLabel, 16}});
+  ASSERT_NE(gpu_task_a.GetTaskSpecification().GetSchedulingClass(),
+            gpu_task_b.GetTaskSpecification().GetSchedulingClass());
+  for (const auto &task : {gpu_task_a, gpu_task_b, cpu_task}) {
+    task_manager_.QueueAndScheduleTask(task, false, &reply, callback);
+  }
+  ASSERT_EQ(num_callbacks, 0);
+  ASSERT_EQ(task_manager_.infeasible_tasks_.size(), 3);
+  ASSERT_EQ(task_manager_.infeasible_sched_classes_by_resource_.at("GPU").size(), 2);
+  ASSERT_EQ(task_manager_.infeasible_sched_classes_by_resource_.at("CPU").size(), 1);
+
+  rpc::ResourcesData data;
+  task_manager_.FillResourceUsage(data);
+  const auto &demands = data.resource_load_by_shape().resource_demands();
+  ASSERT_EQ(demands.size(), 2);
+  for (const auto &demand : demands) {
+    if (demand.shape().count("GPU") > 0) {
+      ASSERT_EQ(demand.num_infeasible_requests_queued(), 2);
+    } else {
+      ASSERT_EQ(demand.num_infeasible_requests_queued(), 1);
+    }
+  }
+
+  // A node with more CPUs only makes the CPU class feasible.
+  AddNode(NodeID::FromRandom(), 16);
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(num_callbacks, 1);
+  ASSERT_EQ(task_manager_.infeasible_tasks_.size(), 2);
+  ASSERT_FALSE(task_manager_.infeasible_sched_classes_by_resource_.contains("CPU"));
+
+  AddNode(NodeID::FromRandom(), 0, /*num_gpus=*/2);
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(num_callbacks, 3);
+  AssertNoLeaks();
+}
+
 TEST_F(ClusterTaskManagerTestWithGPUsAtHead, RleaseAndReturnWorkerCpuResources) {
   const NodeResources &node_resources = scheduler_->GetLocalNodeResources();
   ASSERT_EQ(node_resources.predefined_resources[PredefinedResources::CPU].available, 8);
@@ -2199,6 +2403,232 @@ TEST_F(ClusterTaskManagerTestWithoutCPUsAtHead, OneCpuInfeasibleTask) {
   }
 }
 
+TEST_F(ClusterTaskManagerTestWithoutCPUsAtHead, BatchSchedulingTest) {
+  /*
+    Schedule a backlog of identical tasks onto remote nodes, once task by task and once
+    in batches. Both must spill every task to the same node.
+   */
+  const int num_nodes = 100;
+  const int num_cpus_per_node = 16;
+  const int num_tasks = 10000;
+  std::vector<NodeID> nodes;
+  for (int i = 0; i < num_nodes; i++) {
+    nodes.push_back(NodeID::FromRandom());
+  }
+  std::vector<RayTask> tasks;
+  for (int i = 0; i < num_tasks; i++) {
+    tasks.push_back(CreateTask({{ray::kCPU_ResourceLabel, 1}}));
+  }
+
+  std::vector<std::string> spilled_to[2];
+  for (int batch = 0; batch < 2; batch++) {
+    SetBatchScheduling(batch);
+    // Reset the available resources of the remote nodes.
+    for (const auto &node_id : nodes) {
+      AddNode(node_id, num_cpus_per_node);
+    }
+    std::vector<rpc::RequestWorkerLeaseReply> replies(num_tasks);
+    int num_callbacks = 0;
+    for (int i = 0; i < num_tasks; i++) {
+      QueueWithoutScheduling(tasks[i], &replies[i],
+                             [&num_callbacks] { num_callbacks++; });
+    }
+
+    task_manager_.ScheduleAndDispatchTasks();
+    ASSERT_EQ(num_callbacks, num_tasks);
+    for (const auto &reply : replies) {
+      ASSERT_FALSE(reply.retry_at_raylet_address().raylet_id().empty());
+      spilled_to[batch].push_back(reply.retry_at_raylet_address().raylet_id());
+    }
+    AssertNoLeaks();
+  }
+  ASSERT_EQ(spilled_to[0], spilled_to[1]);
+}
+
+TEST_F(ClusterTaskManagerTest, DirtySchedulingClassesTest) {
+  /*
+    Queue a backlog of many scheduling classes that can't run because the local node is
+    busy. A pass after an event that affects a single class should only evaluate that
+    class, while freeing resources should evaluate all of them.
+   */
+  const int num_classes = 10000;
+  auto noop_callback = [](Status, std::function<void()>, std::function<void()>) {};
+  std::shared_ptr<MockWorker> worker =
+      std::make_shared<MockWorker>(WorkerID::FromRandom(), 1234);
+  pool_.PushWorker(std::static_pointer_cast<WorkerInterface>(worker));
+  RayTask long_task = CreateTask({{ray::kCPU_ResourceLabel, 8}});
+  rpc::RequestWorkerLeaseReply long_reply;
+  task_manager_.QueueAndScheduleTask(long_task, false, &long_reply, noop_callback);
+  pool_.TriggerCallbacks();
+  ASSERT_EQ(leased_workers_.size(), 1);
+
+  // Every task has a different memory demand, and therefore its own scheduling class.
+  std::vector<RayTask> tasks;
+  std::vector<rpc::RequestWorkerLeaseReply> replies(num_classes);
+  int num_callbacks = 0;
+  for (int i = 0; i < num_classes; i++) {
+    tasks.push_back(CreateTask(
+        {{ray::kCPU_ResourceLabel, 1}, {ray::kMemory_ResourceLabel, 0.001 * (i + 1)}}));
+    QueueWithoutScheduling(tasks[i], &replies[i], [&num_callbacks] { num_callbacks++; });
+  }
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(num_callbacks, 0);
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), num_classes);
+
+  // Nothing changed since the last pass.
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), 0);
+
+  // A new task only needs its own class to be evaluated.
+  const auto scheduling_class = tasks[0].GetTaskSpecification().GetSchedulingClass();
+  RayTask task = CreateTask(
+      {{ray::kCPU_ResourceLabel, 1}, {ray::kMemory_ResourceLabel, 0.001}});
+  ASSERT_EQ(task.GetTaskSpecification().GetSchedulingClass(), scheduling_class);
+  rpc::RequestWorkerLeaseReply reply;
+  task_manager_.QueueAndScheduleTask(task, false, &reply, noop_callback);
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), 1);
+  ASSERT_EQ(NumQueuedToSchedule(scheduling_class), 2);
+
+  // A full rescan evaluates every class again.
+  MarkAllSchedulingClassesDirty();
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), num_classes);
+  ASSERT_EQ(num_callbacks, 0);
+
+  // Freeing the CPUs may unblock any class, so all of them are evaluated.
+  RayTask finished_task;
+  task_manager_.TaskFinished(leased_workers_.begin()->second, &finished_task);
+  leased_workers_.clear();
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_GE(NumSchedulingClassesEvaluated(), num_classes);
+  ASSERT_EQ(pool_.num_pops, 1 + 8);
+}
+
+TEST_F(ClusterTaskManagerTest, DirtySchedulingClassesOnResourcesFreedTest) {
+  /*
+    Freeing a resource should only evaluate the waiting classes that need it:
+    1. Hold all CPUs and all memory with long running tasks.
+    2. Queue classes that need CPUs, and classes that need more memory than one of the
+       memory tasks holds.
+    3. Finishing that memory task only evaluates the classes that need memory, which
+       still don't fit.
+   */
+  const int num_classes = 100;
+  auto noop_callback = [](Status, std::function<void()>, std::function<void()>) {};
+  std::vector<RayTask> long_tasks = {CreateTask({{ray::kCPU_ResourceLabel, 8}}),
+                                     CreateTask({{ray::kMemory_ResourceLabel, 100}}),
+                                     CreateTask({{ray::kMemory_ResourceLabel, 28}})};
+  std::vector<rpc::RequestWorkerLeaseReply> long_replies(long_tasks.size());
+  for (size_t i = 0; i < long_tasks.size(); i++) {
+    pool_.PushWorker(std::make_shared<MockWorker>(WorkerID::FromRandom(), 1234 + i));
+    task_manager_.QueueAndScheduleTask(long_tasks[i], false, &long_replies[i],
+                                       noop_callback);
+    pool_.TriggerCallbacks();
+  }
+  ASSERT_EQ(leased_workers_.size(), long_tasks.size());
+
+  std::vector<RayTask> tasks;
+  std::vector<rpc::RequestWorkerLeaseReply> replies(2 * num_classes);
+  int num_callbacks = 0;
+  for (int i = 0; i < num_classes; i++) {
+    tasks.push_back(CreateTask({{ray::kCPU_ResourceLabel, 1 + 0.001 * (i + 1)}}));
+    tasks.push_back(CreateTask({{ray::kMemory_ResourceLabel, 50 + 0.001 * (i + 1)}}));
+  }
+  for (size_t i = 0; i < tasks.size(); i++) {
+    QueueWithoutScheduling(tasks[i], &replies[i], [&num_callbacks] { num_callbacks++; });
+  }
+  task_manager_.ScheduleAndDispatchTasks();
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), 0);
+
+  const auto memory_task_id = long_tasks[2].GetTaskSpecification().TaskId();
+  for (auto it = leased_workers_.begin(); it != leased_workers_.end(); it++) {
+    if (it->second->GetAssignedTask().GetTaskSpecification().TaskId() == memory_task_id) {
+      RayTask finished_task;
+      task_manager_.TaskFinished(it->second, &finished_task);
+      leased_workers_.erase(it);
+      break;
+    }
+  }
+  ASSERT_EQ(leased_workers_.size(), long_tasks.size() - 1);
+  task_manager_.ScheduleAndDispatchTasks();
+  ASSERT_EQ(NumSchedulingClassesEvaluated(), num_classes);
+  ASSERT_EQ(num_callbacks, 0);
+}
+
+TEST_F(ClusterTaskManagerTest, JobFairSharingTest) {
+  /*
+    Two jobs queue more tasks of their own scheduling class than the node can run. The
+    node's CPUs should be shared by the jobs' weights and minimum shares, regardless of
+    the order of the classes.
+   */
+  SetJobFairSharing(true);
+  const JobID job_a = JobID::FromInt(1);
+  const JobID job_b = JobID::FromInt(2);
+  auto create_job_task = [](const JobID &job_id, double memory) {
+    RayTask task = CreateTask(
+        {{ray::kCPU_ResourceLabel, 1}, {ray::kMemory_ResourceLabel, memory}});
+    rpc::Task task_message;
+    task_message.mutable_task_spec()->CopyFrom(task.GetTaskSpecification().GetMessage());
+    task_message.mutable_task_spec()->set_job_id(job_id.Binary());
+    return RayTask(task_message);
+  };
+  auto start_job = [this](const JobID &job_id, double weight, uint64_t min_share) {
+    rpc::JobConfig job_config;
+    job_config.set_scheduling_weight(weight);
+    job_config.set_min_scheduling_share(min_share);
+    task_manager_.HandleJobStarted(job_id, job_config);
+  };
+  // Queue 8 tasks of each job, dispatch and return the number of tasks granted to
+  // each job.
+  auto dispatch = [&]() {
+    std::vector<RayTask> tasks;
+    std::vector<rpc::RequestWorkerLeaseReply> replies(16);
+    for (int i = 0; i < 8; i++) {
+      tasks.push_back(create_job_task(job_a, 0.001));
+      tasks.push_back(create_job_task(job_b, 0.002));
+    }
+    for (size_t i = 0; i < tasks.size(); i++) {
+      QueueWithoutScheduling(tasks[i], &replies[i], [] {});
+    }
+    task_manager_.ScheduleAndDispatchTasks();
+    auto num_running_tasks =
+        std::make_pair(NumRunningTasks(job_a), NumRunningTasks(job_b));
+
+    for (int i = 0; i < 8; i++) {
+      pool_.PushWorker(std::static_pointer_cast<WorkerInterface>(
+          std::make_shared<MockWorker>(WorkerID::FromRandom(), 1234)));
+    }
+    pool_.TriggerCallbacks();
+    EXPECT_EQ(leased_workers_.size(), 8);
+    for (const auto &entry : leased_workers_) {
+      RayTask finished_task;
+      task_manager_.TaskFinished(entry.second, &finished_task);
+    }
+    leased_workers_.clear();
+    for (const auto &task : tasks) {
+      task_manager_.CancelTask(task.GetTaskSpecification().TaskId());
+    }
+    EXPECT_EQ(NumRunningTasks(job_a) + NumRunningTasks(job_b), 0);
+    return num_running_tasks;
+  };
+
+  // Jobs without a config share equally.
+  ASSERT_EQ(dispatch(), (std::make_pair<int64_t, int64_t>(4, 4)));
+
+  start_job(job_b, 3, 0);
+  ASSERT_EQ(dispatch(), (std::make_pair<int64_t, int64_t>(2, 6)));
+
+  start_job(job_a, 1, 6);
+  start_job(job_b, 1, 0);
+  ASSERT_EQ(dispatch(), (std::make_pair<int64_t, int64_t>(6, 2)));
+
+  task_manager_.HandleJobFinished(job_a);
+  ASSERT_EQ(dispatch(), (std::make_pair<int64_t, int64_t>(4, 4)));
+
+  AssertNoLeaks();
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
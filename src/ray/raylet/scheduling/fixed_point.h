@@ -101,6 +101,9 @@ class FixedPoint {
 
   [[nodiscard]] double Double() const { return round(i_) / RESOURCE_UNIT_SCALING; };
 
+  /// The underlying integer, i.e., the value scaled by RESOURCE_UNIT_SCALING.
+  [[nodiscard]] int64_t Raw() const { return i_; };
+
   friend std::ostream &operator<<(std::ostream &out, FixedPoint const &ru1);
 };
 
@@ -0,0 +1,247 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/scheduling/node_resource_table.h"
+
+namespace ray {
+
+namespace {
+
+/// Compute `result[row] &= column[row] >= demand` for all rows. The loop has no
+/// branches and no aliasing, so it is auto-vectorized.
+void AndAtLeast(const std::vector<int64_t> &column, int64_t demand,
+                std::vector<uint8_t> *result) {
+  const int64_t *__restrict values = column.data();
+  uint8_t *__restrict out = result->data();
+  const size_t num_rows = column.size();
+  for (size_t row = 0; row < num_rows; row++) {
+    out[row] &= static_cast<uint8_t>(values[row] >= demand);
+  }
+}
+
+int64_t PredefinedDemand(const ResourceRequest &resource_request, size_t i) {
+  if (i >= resource_request.predefined_resources.size()) {
+    return 0;
+  }
+  return resource_request.predefined_resources[i].Raw();
+}
+
+}  // namespace
+
+bool NodeResourceTable::AddOrUpdateNode(int64_t node_id, const NodeResources &resources,
+                                        std::vector<int64_t> *grown_totals,
+                                        std::vector<int64_t> *grown_available) {
+  size_t row;
+  bool gained = false;
+  auto it = node_id_to_row_.find(node_id);
+  if (it == node_id_to_row_.end()) {
+    gained = true;
+    row = node_ids_.size();
+    node_id_to_row_.emplace(node_id, row);
+    node_ids_.push_back(node_id);
+    object_pulls_queued_.push_back(0);
+    row_custom_resources_.emplace_back();
+    for (auto &column : predefined_resources_) {
+      column.total.push_back(0);
+      column.available.push_back(0);
+    }
+    for (auto &entry : custom_resources_) {
+      entry.second.total.push_back(kMissing);
+      entry.second.available.push_back(kMissing);
+    }
+  } else {
+    row = it->second;
+  }
+
+  gained |= object_pulls_queued_[row] && !resources.object_pulls_queued;
+  object_pulls_queued_[row] = resources.object_pulls_queued;
+  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
+    auto &column = predefined_resources_[i];
+    int64_t total = 0;
+    int64_t available = 0;
+    if (i < resources.predefined_resources.size()) {
+      total = resources.predefined_resources[i].total.Raw();
+      available = resources.predefined_resources[i].available.Raw();
+    }
+    if (total > column.total[row] && grown_totals != nullptr) {
+      grown_totals->push_back(i);
+    }
+    if (available > column.available[row] && grown_available != nullptr) {
+      grown_available->push_back(i);
+    }
+    gained |= total > column.total[row] || available > column.available[row];
+    column.total[row] = total;
+    column.available[row] = available;
+  }
+
+  auto &present = row_custom_resources_[row];
+  for (int64_t resource_id : present) {
+    if (!resources.custom_resources.contains(resource_id)) {
+      ClearCustomResource(resource_id, row);
+    }
+  }
+  present.clear();
+  for (const auto &entry : resources.custom_resources) {
+    auto &column = GetOrCreateCustomColumn(entry.first);
+    if (column.total[row] == kMissing) {
+      column.num_present++;
+    }
+    const int64_t total = entry.second.total.Raw();
+    const int64_t available = entry.second.available.Raw();
+    // kMissing is smaller than any value, so a new resource counts as a gain.
+    if (total > column.total[row] && grown_totals != nullptr) {
+      grown_totals->push_back(entry.first);
+    }
+    if (available > column.available[row] && grown_available != nullptr) {
+      grown_available->push_back(entry.first);
+    }
+    gained |= total > column.total[row] || available > column.available[row];
+    column.total[row] = total;
+    column.available[row] = available;
+    present.push_back(entry.first);
+  }
+  return gained;
+}
+
+bool NodeResourceTable::RemoveNode(int64_t node_id) {
+  auto it = node_id_to_row_.find(node_id);
+  if (it == node_id_to_row_.end()) {
+    return false;
+  }
+  const size_t row = it->second;
+  const size_t last = node_ids_.size() - 1;
+  node_id_to_row_.erase(it);
+  for (int64_t resource_id : row_custom_resources_[row]) {
+    ClearCustomResource(resource_id, row);
+  }
+
+  // Move the last row into the freed slot to keep the columns dense.
+  if (row != last) {
+    node_ids_[row] = node_ids_[last];
+    node_id_to_row_[node_ids_[row]] = row;
+    object_pulls_queued_[row] = object_pulls_queued_[last];
+    row_custom_resources_[row] = std::move(row_custom_resources_[last]);
+    for (auto &column : predefined_resources_) {
+      column.total[row] = column.total[last];
+      column.available[row] = column.available[last];
+    }
+    for (auto &entry : custom_resources_) {
+      entry.second.total[row] = entry.second.total[last];
+      entry.second.available[row] = entry.second.available[last];
+    }
+  }
+
+  node_ids_.pop_back();
+  object_pulls_queued_.pop_back();
+  row_custom_resources_.pop_back();
+  for (auto &column : predefined_resources_) {
+    column.total.pop_back();
+    column.available.pop_back();
+  }
+  for (auto &entry : custom_resources_) {
+    entry.second.total.pop_back();
+    entry.second.available.pop_back();
+  }
+  return true;
+}
+
+int64_t NodeResourceTable::GetRow(int64_t node_id) const {
+  auto it = node_id_to_row_.find(node_id);
+  if (it == node_id_to_row_.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+void NodeResourceTable::ComputeFeasible(const ResourceRequest &resource_request,
+                                        std::vector<uint8_t> *feasible) const {
+  feasible->assign(NumNodes(), 1);
+  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
+    AndAtLeast(predefined_resources_[i].total, PredefinedDemand(resource_request, i),
+               feasible);
+  }
+  for (const auto &entry : resource_request.custom_resources) {
+    auto it = custom_resources_.find(entry.first);
+    if (it == custom_resources_.end()) {
+      // No node has this resource.
+      feasible->assign(NumNodes(), 0);
+      return;
+    }
+    AndAtLeast(it->second.total, entry.second.Raw(), feasible);
+  }
+}
+
+void NodeResourceTable::ComputeAvailable(const ResourceRequest &resource_request,
+                                         std::vector<uint8_t> *available) const {
+  available->assign(NumNodes(), 1);
+  for (size_t i = 0; i < PredefinedResources_MAX; i++) {
+    AndAtLeast(predefined_resources_[i].available, PredefinedDemand(resource_request, i),
+               available);
+  }
+  for (const auto &entry : resource_request.custom_resources) {
+    auto it = custom_resources_.find(entry.first);
+    if (it == custom_resources_.end()) {
+      available->assign(NumNodes(), 0);
+      return;
+    }
+    AndAtLeast(it->second.available, entry.second.Raw(), available);
+  }
+}
+
+void NodeResourceTable::ComputeCriticalResourceUtilization(
+    std::vector<float> *utilization) const {
+  const size_t num_rows = NumNodes();
+  utilization->assign(num_rows, 0);
+  float *__restrict out = utilization->data();
+  for (const auto &i : {CPU, MEM, OBJECT_STORE_MEM}) {
+    const int64_t *__restrict total = predefined_resources_[i].total.data();
+    const int64_t *__restrict available = predefined_resources_[i].available.data();
+    for (size_t row = 0; row < num_rows; row++) {
+      // Same arithmetic as NodeResources::CalculateCriticalResourceUtilization, so that
+      // both produce bit-identical scores.
+      const double total_double = static_cast<double>(total[row]) / RESOURCE_UNIT_SCALING;
+      const double available_double =
+          static_cast<double>(available[row]) / RESOURCE_UNIT_SCALING;
+      const float value =
+          total[row] == 0 ? 0 : static_cast<float>(1 - (available_double / total_double));
+      out[row] = value > out[row] ? value : out[row];
+    }
+  }
+}
+
+NodeResourceTable::Column &NodeResourceTable::GetOrCreateCustomColumn(
+    int64_t resource_id) {
+  auto result = custom_resources_.try_emplace(resource_id);
+  auto &column = result.first->second;
+  if (result.second) {
+    column.total.assign(NumNodes(), kMissing);
+    column.available.assign(NumNodes(), kMissing);
+  }
+  return column;
+}
+
+void NodeResourceTable::ClearCustomResource(int64_t resource_id, size_t row) {
+  auto it = custom_resources_.find(resource_id);
+  if (it == custom_resources_.end() || it->second.total[row] == kMissing) {
+    return;
+  }
+  auto &column = it->second;
+  column.total[row] = kMissing;
+  column.available[row] = kMissing;
+  if (--column.num_present == 0) {
+    custom_resources_.erase(it);
+  }
+}
+
+}  // namespace ray
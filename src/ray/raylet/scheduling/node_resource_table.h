@@ -0,0 +1,133 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <limits>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "ray/raylet/scheduling/cluster_resource_data.h"
+
+namespace ray {
+
+/// Struct-of-arrays copy of the local resource views of all nodes in the cluster.
+///
+/// The scheduling policy evaluates every resource request against every node. Doing
+/// that on `NodeResources` means chasing a hash map node and a vector per node and
+/// branching per resource. This table instead keeps, for each resource, the totals and
+/// the available amounts of all nodes in two contiguous arrays of raw fixed point
+/// values, so that checking one resource for the whole cluster is a branch-free loop
+/// over a column that the compiler can vectorize.
+///
+/// Rows are dense and have no stable order: removing a node moves the last row into
+/// the freed slot. Custom resources are stored as columns that are created when the
+/// first node reports the resource and dropped when the last one stops reporting it.
+class NodeResourceTable {
+ public:
+  /// Value of a custom resource column for nodes that don't have the resource. It is
+  /// smaller than any demand, so such nodes never pass the checks.
+  static constexpr int64_t kMissing = std::numeric_limits<int64_t>::min();
+
+  /// Insert a node, or overwrite the resources of an existing node.
+  ///
+  /// \param node_id: The node to add or update.
+  /// \param resources: The node's local resource view.
+  /// \param grown_totals[out]: If not null, the resources whose total grew are appended:
+  /// predefined resources by their PredefinedResources index, custom ones by their ID.
+  /// \param grown_available[out]: If not null, the resources whose available amount
+  /// grew are appended, in the same way.
+  /// \return True if the node is new or any of its resources grew, i.e., a request
+  /// that did not fit before may fit now.
+  bool AddOrUpdateNode(int64_t node_id, const NodeResources &resources,
+                       std::vector<int64_t> *grown_totals = nullptr,
+                       std::vector<int64_t> *grown_available = nullptr);
+
+  /// Remove a node from the table.
+  ///
+  /// \param node_id: The node to remove.
+  /// \return True if the node was in the table.
+  bool RemoveNode(int64_t node_id);
+
+  /// Number of nodes (rows) in the table.
+  size_t NumNodes() const { return node_ids_.size(); }
+
+  /// \return The row of the node, or -1 if the node isn't in the table.
+  int64_t GetRow(int64_t node_id) const;
+
+  /// \return The id of the node stored in the given row.
+  int64_t GetNodeId(size_t row) const { return node_ids_[row]; }
+
+  /// \return Whether the node in the given row has object pulls queued.
+  bool ObjectPullsQueued(size_t row) const { return object_pulls_queued_[row] != 0; }
+
+  /// \return Whether the node in the given row has any GPUs.
+  bool HasGPUs(size_t row) const { return predefined_resources_[GPU].total[row] > 0; }
+
+  /// Compute for every row whether the node's total resources can satisfy the request.
+  /// Equivalent to `NodeResources::IsFeasible`.
+  ///
+  /// \param resource_request: The request to check.
+  /// \param[out] feasible: Resized to `NumNodes()`; 1 if the row is feasible.
+  void ComputeFeasible(const ResourceRequest &resource_request,
+                       std::vector<uint8_t> *feasible) const;
+
+  /// Compute for every row whether the node's available resources can satisfy the
+  /// request. Equivalent to `NodeResources::IsAvailable` with the pull manager check
+  /// ignored; callers combine it with `ObjectPullsQueued` as needed.
+  ///
+  /// \param resource_request: The request to check.
+  /// \param[out] available: Resized to `NumNodes()`; 1 if the row is available.
+  void ComputeAvailable(const ResourceRequest &resource_request,
+                        std::vector<uint8_t> *available) const;
+
+  /// Compute the critical resource utilization of every row. Equivalent to
+  /// `NodeResources::CalculateCriticalResourceUtilization`.
+  ///
+  /// \param[out] utilization: Resized to `NumNodes()`.
+  void ComputeCriticalResourceUtilization(std::vector<float> *utilization) const;
+
+ private:
+  /// Total and available amounts of one resource, indexed by row.
+  struct Column {
+    std::vector<int64_t> total;
+    std::vector<int64_t> available;
+    /// Number of rows that have the resource. Only used for custom resources.
+    size_t num_present = 0;
+  };
+
+  /// Get the column of a custom resource, creating it if needed.
+  Column &GetOrCreateCustomColumn(int64_t resource_id);
+
+  /// Mark a custom resource as missing in a row, and drop the column if no row has it
+  /// anymore.
+  void ClearCustomResource(int64_t resource_id, size_t row);
+
+  /// Node id stored in each row.
+  std::vector<int64_t> node_ids_;
+  /// Reverse index of `node_ids_`.
+  absl::flat_hash_map<int64_t, size_t> node_id_to_row_;
+  /// Predefined resources. Nodes that don't report a predefined resource store 0.
+  std::array<Column, PredefinedResources_MAX> predefined_resources_;
+  /// Custom resources, keyed by resource id.
+  absl::flat_hash_map<int64_t, Column> custom_resources_;
+  /// The custom resources present in each row, so that an update only needs to touch
+  /// the columns the node had or has.
+  std::vector<std::vector<int64_t>> row_custom_resources_;
+  /// Whether each node has object pulls queued.
+  std::vector<uint8_t> object_pulls_queued_;
+};
+
+}  // namespace ray
@@ -0,0 +1,192 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/scheduling/node_resource_table.h"
+
+#include "gtest/gtest.h"
+
+namespace ray {
+
+class NodeResourceTableTest : public ::testing::Test {
+ protected:
+  NodeResources CreateNodeResources(double available_cpu, double total_cpu) {
+    NodeResources resources;
+    resources.predefined_resources = {{available_cpu, total_cpu}};
+    return resources;
+  }
+
+  /// Check that the table's kernels agree with NodeResources for every node.
+  void CheckConsistent(const absl::flat_hash_map<int64_t, NodeResources> &nodes,
+                       const ResourceRequest &request) {
+    ASSERT_EQ(table_.NumNodes(), nodes.size());
+    std::vector<uint8_t> feasible;
+    std::vector<uint8_t> available;
+    std::vector<float> utilization;
+    table_.ComputeFeasible(request, &feasible);
+    table_.ComputeAvailable(request, &available);
+    table_.ComputeCriticalResourceUtilization(&utilization);
+    for (const auto &entry : nodes) {
+      const int64_t row = table_.GetRow(entry.first);
+      ASSERT_NE(row, -1);
+      ASSERT_EQ(table_.GetNodeId(row), entry.first);
+      ASSERT_EQ(feasible[row] != 0, entry.second.IsFeasible(request));
+      ASSERT_EQ(available[row] != 0, entry.second.IsAvailable(request, true));
+      ASSERT_EQ(utilization[row], entry.second.CalculateCriticalResourceUtilization());
+      ASSERT_EQ(table_.ObjectPullsQueued(row), entry.second.object_pulls_queued);
+    }
+  }
+
+  StringIdMap map_;
+  NodeResourceTable table_;
+};
+
+TEST_F(NodeResourceTableTest, PredefinedResourcesTest) {
+  absl::flat_hash_map<int64_t, NodeResources> nodes;
+  nodes[1] = CreateNodeResources(1, 4);
+  nodes[2] = CreateNodeResources(4, 4);
+  // A node with all predefined resources, including a negative available amount.
+  nodes[3] = CreateNodeResources(-1, 8);
+  nodes[3].predefined_resources.resize(PredefinedResources_MAX);
+  nodes[3].predefined_resources[GPU] = ResourceCapacity(1, 2);
+  nodes[3].predefined_resources[OBJECT_STORE_MEM] = ResourceCapacity(5, 10);
+  nodes[3].object_pulls_queued = true;
+  for (const auto &entry : nodes) {
+    table_.AddOrUpdateNode(entry.first, entry.second);
+  }
+  ASSERT_TRUE(table_.HasGPUs(table_.GetRow(3)));
+  ASSERT_FALSE(table_.HasGPUs(table_.GetRow(1)));
+
+  CheckConsistent(nodes, ResourceMapToResourceRequest(map_, {{"CPU", 2}}, false));
+  CheckConsistent(nodes, ResourceMapToResourceRequest(map_, {{"CPU", 0}}, false));
+  CheckConsistent(nodes,
+                  ResourceMapToResourceRequest(map_, {{"CPU", 1}, {"GPU", 1}}, false));
+  CheckConsistent(nodes, ResourceMapToResourceRequest(
+                             map_, {{"CPU", 1}, {"object_store_memory", 6}}, true));
+
+  // Updates overwrite the row in place.
+  nodes[2] = CreateNodeResources(0, 4);
+  table_.AddOrUpdateNode(2, nodes[2]);
+  CheckConsistent(nodes, ResourceMapToResourceRequest(map_, {{"CPU", 1}}, false));
+}
+
+TEST_F(NodeResourceTableTest, CustomResourcesTest) {
+  const int64_t custom_1 = map_.Insert("custom_1");
+  const int64_t custom_2 = map_.Insert("custom_2");
+  absl::flat_hash_map<int64_t, NodeResources> nodes;
+  nodes[1] = CreateNodeResources(4, 4);
+  nodes[1].custom_resources[custom_1] = ResourceCapacity(1, 2);
+  nodes[2] = CreateNodeResources(4, 4);
+  nodes[2].custom_resources[custom_2] = ResourceCapacity(0, 1);
+  nodes[3] = CreateNodeResources(4, 4);
+  for (const auto &entry : nodes) {
+    table_.AddOrUpdateNode(entry.first, entry.second);
+  }
+
+  auto req_1 = ResourceMapToResourceRequest(map_, {{"custom_1", 1}}, false);
+  auto req_2 = ResourceMapToResourceRequest(map_, {{"custom_2", 1}}, false);
+  // A zero demand still requires the node to have the resource.
+  auto req_zero = ResourceMapToResourceRequest(map_, {{"custom_2", 0}}, false);
+  auto req_unknown = ResourceMapToResourceRequest(map_, {{"unknown", 1}}, false);
+  for (const auto &req : {req_1, req_2, req_zero, req_unknown}) {
+    CheckConsistent(nodes, req);
+  }
+
+  // Move custom_2 from node 2 to node 3.
+  nodes[2].custom_resources.clear();
+  nodes[3].custom_resources[custom_2] = ResourceCapacity(1, 1);
+  table_.AddOrUpdateNode(2, nodes[2]);
+  table_.AddOrUpdateNode(3, nodes[3]);
+  for (const auto &req : {req_1, req_2, req_zero, req_unknown}) {
+    CheckConsistent(nodes, req);
+  }
+
+  // Removing the only node with custom_2 drops the resource entirely.
+  nodes.erase(3);
+  ASSERT_TRUE(table_.RemoveNode(3));
+  ASSERT_FALSE(table_.RemoveNode(3));
+  for (const auto &req : {req_1, req_2, req_zero, req_unknown}) {
+    CheckConsistent(nodes, req);
+  }
+}
+
+TEST_F(NodeResourceTableTest, RemoveNodeTest) {
+  const int64_t custom = map_.Insert("custom");
+  absl::flat_hash_map<int64_t, NodeResources> nodes;
+  for (int64_t node_id = 0; node_id < 10; node_id++) {
+    nodes[node_id] = CreateNodeResources(node_id % 4, 4);
+    if (node_id % 2 == 0) {
+      nodes[node_id].custom_resources[custom] = ResourceCapacity(node_id, 10);
+    }
+    nodes[node_id].object_pulls_queued = node_id % 3 == 0;
+    table_.AddOrUpdateNode(node_id, nodes[node_id]);
+  }
+
+  // Remove from the front, the middle and the back, so that rows get moved around.
+  auto req = ResourceMapToResourceRequest(map_, {{"CPU", 2}, {"custom", 4}}, false);
+  for (int64_t node_id : {0, 5, 9, 2}) {
+    nodes.erase(node_id);
+    ASSERT_TRUE(table_.RemoveNode(node_id));
+    CheckConsistent(nodes, req);
+  }
+  ASSERT_EQ(table_.GetRow(5), -1);
+
+  // A removed node can be added back.
+  nodes[5] = CreateNodeResources(3, 4);
+  table_.AddOrUpdateNode(5, nodes[5]);
+  CheckConsistent(nodes, req);
+}
+
+TEST_F(NodeResourceTableTest, ResourcesGainedTest) {
+  const int64_t custom = map_.Insert("custom");
+  NodeResources node = CreateNodeResources(2, 4);
+  node.object_pulls_queued = true;
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node));
+  ASSERT_FALSE(table_.AddOrUpdateNode(1, node));
+
+  // Using up resources is not a gain, releasing them is.
+  node = CreateNodeResources(1, 4);
+  node.object_pulls_queued = true;
+  ASSERT_FALSE(table_.AddOrUpdateNode(1, node));
+  node = CreateNodeResources(3, 4);
+  node.object_pulls_queued = true;
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node));
+
+  // So is clearing the queued pulls, or adding a custom resource.
+  node.object_pulls_queued = false;
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node));
+  node.custom_resources[custom] = ResourceCapacity(0, 1);
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node));
+  node.custom_resources.clear();
+  ASSERT_FALSE(table_.AddOrUpdateNode(1, node));
+
+  // Only resources whose total grew are reported as grown.
+  std::vector<int64_t> grown_totals;
+  node = CreateNodeResources(4, 4);
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node, &grown_totals));
+  ASSERT_TRUE(grown_totals.empty());
+  node = CreateNodeResources(4, 8);
+  node.custom_resources[custom] = ResourceCapacity(1, 1);
+  ASSERT_TRUE(table_.AddOrUpdateNode(1, node, &grown_totals));
+  ASSERT_EQ(grown_totals, std::vector<int64_t>({CPU, custom}));
+  grown_totals.clear();
+  ASSERT_TRUE(table_.AddOrUpdateNode(2, CreateNodeResources(0, 1), &grown_totals));
+  ASSERT_EQ(grown_totals, std::vector<int64_t>({CPU}));
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
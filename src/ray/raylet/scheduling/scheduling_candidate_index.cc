@@ -0,0 +1,139 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/scheduling/scheduling_candidate_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ray {
+
+SchedulingCandidateIndex::SchedulingCandidateIndex(int64_t local_node_id,
+                                                   const NodeResourceTable &node_table,
+                                                   size_t max_shapes)
+    : local_node_id_(local_node_id), node_table_(node_table), max_shapes_(max_shapes) {
+  RAY_CHECK(max_shapes_ > 0);
+}
+
+void SchedulingCandidateIndex::OnNodeUpdated(int64_t node_id,
+                                             const NodeResources &resources) {
+  const bool is_local = node_id == local_node_id_;
+  const float utilization = resources.CalculateCriticalResourceUtilization();
+  const bool has_gpu = resources.predefined_resources.size() > GPU &&
+                       resources.predefined_resources[GPU].total > 0;
+  for (auto &shape_and_entry : entries_) {
+    auto &entry = shape_and_entry.second;
+    auto it = entry.node_candidates.find(node_id);
+    if (it != entry.node_candidates.end()) {
+      entry.candidates.erase(it->second);
+    }
+    if (!resources.IsFeasible(entry.resource_request)) {
+      if (it != entry.node_candidates.end()) {
+        entry.node_candidates.erase(it);
+      }
+      continue;
+    }
+    // The local node ignores the pull manager capacity, see the hybrid policy.
+    SchedulingCandidate candidate{
+        node_id, resources.IsAvailable(entry.resource_request, is_local),
+        utilization < entry.spread_threshold ? 0 : utilization, is_local, has_gpu};
+    entry.candidates.insert(candidate);
+    entry.node_candidates[node_id] = candidate;
+  }
+}
+
+void SchedulingCandidateIndex::OnNodeRemoved(int64_t node_id) {
+  for (auto &shape_and_entry : entries_) {
+    auto &entry = shape_and_entry.second;
+    auto it = entry.node_candidates.find(node_id);
+    if (it != entry.node_candidates.end()) {
+      entry.candidates.erase(it->second);
+      entry.node_candidates.erase(it);
+    }
+  }
+}
+
+const SchedulingCandidateIndex::CandidateSet &SchedulingCandidateIndex::GetCandidates(
+    const ResourceRequest &resource_request, float spread_threshold) {
+  auto shape = MakeShapeKey(resource_request, spread_threshold);
+  auto it = entries_.find(shape);
+  if (it != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+    return it->second.candidates;
+  }
+
+  if (entries_.size() >= max_shapes_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(shape);
+  auto &entry = entries_[shape];
+  entry.resource_request = resource_request;
+  entry.spread_threshold = spread_threshold;
+  entry.lru_it = lru_.begin();
+  BuildEntry(&entry);
+  return entry.candidates;
+}
+
+SchedulingCandidateIndex::ShapeKey SchedulingCandidateIndex::MakeShapeKey(
+    const ResourceRequest &resource_request, float spread_threshold) {
+  ShapeKey shape;
+  shape.reserve(3 + resource_request.predefined_resources.size() +
+                2 * resource_request.custom_resources.size());
+  shape.push_back(resource_request.requires_object_store_memory);
+  uint32_t threshold_bits;
+  static_assert(sizeof(threshold_bits) == sizeof(spread_threshold));
+  std::memcpy(&threshold_bits, &spread_threshold, sizeof(threshold_bits));
+  shape.push_back(threshold_bits);
+  shape.push_back(resource_request.predefined_resources.size());
+  for (const auto &demand : resource_request.predefined_resources) {
+    shape.push_back(demand.Raw());
+  }
+  std::vector<std::pair<int64_t, int64_t>> custom_resources;
+  custom_resources.reserve(resource_request.custom_resources.size());
+  for (const auto &entry : resource_request.custom_resources) {
+    custom_resources.emplace_back(entry.first, entry.second.Raw());
+  }
+  std::sort(custom_resources.begin(), custom_resources.end());
+  for (const auto &entry : custom_resources) {
+    shape.push_back(entry.first);
+    shape.push_back(entry.second);
+  }
+  return shape;
+}
+
+void SchedulingCandidateIndex::BuildEntry(Entry *entry) const {
+  const auto &resource_request = entry->resource_request;
+  node_table_.ComputeFeasible(resource_request, &feasible_);
+  node_table_.ComputeAvailable(resource_request, &available_);
+  node_table_.ComputeCriticalResourceUtilization(&utilization_);
+  for (size_t row = 0; row < node_table_.NumNodes(); row++) {
+    if (!feasible_[row]) {
+      continue;
+    }
+    const int64_t node_id = node_table_.GetNodeId(row);
+    const bool is_local = node_id == local_node_id_;
+    const bool is_available =
+        available_[row] && (is_local || !resource_request.requires_object_store_memory ||
+                            !node_table_.ObjectPullsQueued(row));
+    const float utilization = utilization_[row];
+    SchedulingCandidate candidate{
+        node_id, is_available, utilization < entry->spread_threshold ? 0 : utilization,
+        is_local, node_table_.HasGPUs(row)};
+    entry->candidates.insert(candidate);
+    entry->node_candidates.emplace(node_id, candidate);
+  }
+}
+
+}  // namespace ray
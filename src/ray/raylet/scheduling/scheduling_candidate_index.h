@@ -0,0 +1,123 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <list>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "ray/raylet/scheduling/cluster_resource_data.h"
+#include "ray/raylet/scheduling/node_resource_table.h"
+
+namespace ray {
+
+/// A node that can run requests of some resource shape, with the properties the hybrid
+/// scheduling policy ranks nodes by.
+struct SchedulingCandidate {
+  int64_t node_id;
+  /// Whether the node's available resources can satisfy the request.
+  bool is_available;
+  /// Critical resource utilization, truncated to 0 below the spread threshold.
+  float score;
+  bool is_local;
+  bool has_gpu;
+
+  /// Orders candidates by the hybrid policy's preference: available nodes first, then
+  /// by score, then by traversal order (the local node first, others by id).
+  bool operator<(const SchedulingCandidate &other) const {
+    return std::make_tuple(!is_available, score, !is_local, node_id) <
+           std::make_tuple(!other.is_available, other.score, !other.is_local,
+                           other.node_id);
+  }
+};
+
+/// Incrementally maintained index from resource shape to the feasible nodes for that
+/// shape, sorted by the hybrid policy's preference.
+///
+/// The first request of a shape builds its entry from the NodeResourceTable in one
+/// vectorized pass. After that, the owner reports every node resource change and each
+/// cached entry re-ranks just that node, so picking a node for a cached shape only
+/// needs to walk the front of a sorted set instead of scoring every node.
+///
+/// The number of cached shapes is bounded; the least recently used shape is evicted
+/// when the bound is exceeded, which also bounds the cost of a node update.
+class SchedulingCandidateIndex {
+ public:
+  using CandidateSet = std::set<SchedulingCandidate>;
+
+  /// \param local_node_id: Identifier of the local node.
+  /// \param node_table: Columnar resources of all nodes, used to build new entries.
+  /// \param max_shapes: The maximum number of resource shapes to cache.
+  SchedulingCandidateIndex(int64_t local_node_id, const NodeResourceTable &node_table,
+                           size_t max_shapes);
+
+  /// Re-rank a node in every cached entry. Must be called after the node is updated in
+  /// the NodeResourceTable.
+  ///
+  /// \param node_id: The node that was added or changed.
+  /// \param resources: The node's new local view.
+  void OnNodeUpdated(int64_t node_id, const NodeResources &resources);
+
+  /// Drop a node from every cached entry.
+  ///
+  /// \param node_id: The node that was removed.
+  void OnNodeRemoved(int64_t node_id);
+
+  /// Get the feasible nodes for a request, best first. Builds the entry on first use.
+  /// The returned set is valid until the next call to a non-const method.
+  ///
+  /// \param resource_request: The request to find nodes for.
+  /// \param spread_threshold: Utilization below which nodes are considered equal.
+  const CandidateSet &GetCandidates(const ResourceRequest &resource_request,
+                                    float spread_threshold);
+
+  /// Number of cached resource shapes.
+  size_t NumShapes() const { return entries_.size(); }
+
+ private:
+  /// Canonical encoding of a request and a spread threshold.
+  using ShapeKey = std::vector<int64_t>;
+
+  struct Entry {
+    ResourceRequest resource_request;
+    float spread_threshold;
+    CandidateSet candidates;
+    /// The current candidate of every feasible node, to find it in `candidates`.
+    absl::flat_hash_map<int64_t, SchedulingCandidate> node_candidates;
+    /// Position in `lru_`.
+    std::list<ShapeKey>::iterator lru_it;
+  };
+
+  static ShapeKey MakeShapeKey(const ResourceRequest &resource_request,
+                               float spread_threshold);
+
+  /// Build an entry for the request from the node table.
+  void BuildEntry(Entry *entry) const;
+
+  const int64_t local_node_id_;
+  const NodeResourceTable &node_table_;
+  const size_t max_shapes_;
+  absl::flat_hash_map<ShapeKey, Entry> entries_;
+  /// Shapes, most recently used first.
+  std::list<ShapeKey> lru_;
+  /// Scratch buffers for building entries.
+  mutable std::vector<uint8_t> feasible_;
+  mutable std::vector<uint8_t> available_;
+  mutable std::vector<float> utilization_;
+};
+
+}  // namespace ray
@@ -0,0 +1,100 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/scheduling/scheduling_candidate_index.h"
+
+#include "gtest/gtest.h"
+
+namespace ray {
+
+class SchedulingCandidateIndexTest : public ::testing::Test {
+ protected:
+  SchedulingCandidateIndexTest() : index_(/*local_node_id=*/0, table_, 2) {}
+
+  void AddOrUpdateNode(int64_t node_id, double available_cpu, double total_cpu) {
+    NodeResources resources;
+    resources.predefined_resources = {{available_cpu, total_cpu}};
+    table_.AddOrUpdateNode(node_id, resources);
+    index_.OnNodeUpdated(node_id, resources);
+  }
+
+  void RemoveNode(int64_t node_id) {
+    table_.RemoveNode(node_id);
+    index_.OnNodeRemoved(node_id);
+  }
+
+  /// The node ids of the candidates, best first.
+  std::vector<int64_t> Candidates(double cpu, float spread_threshold = 0.5) {
+    std::vector<int64_t> node_ids;
+    for (const auto &candidate : index_.GetCandidates(
+             ResourceMapToResourceRequest(map_, {{"CPU", cpu}}, false),
+             spread_threshold)) {
+      node_ids.push_back(candidate.node_id);
+    }
+    return node_ids;
+  }
+
+  StringIdMap map_;
+  NodeResourceTable table_;
+  SchedulingCandidateIndex index_;
+};
+
+TEST_F(SchedulingCandidateIndexTest, RankingTest) {
+  AddOrUpdateNode(0, 0, 4);
+  AddOrUpdateNode(1, 4, 4);
+  AddOrUpdateNode(2, 1, 4);
+  AddOrUpdateNode(3, 5, 8);
+  AddOrUpdateNode(4, 1, 1);
+
+  // Without truncation, nodes are ranked by utilization, unavailable ones last.
+  ASSERT_EQ(Candidates(1, 0), (std::vector<int64_t>{1, 4, 3, 2, 0}));
+  // With truncation, nodes 1, 3 and 4 tie and are ranked by id. The local node 0 is
+  // full, so it comes last.
+  ASSERT_EQ(Candidates(1), (std::vector<int64_t>{1, 3, 4, 2, 0}));
+  // Node 4 is infeasible for 2 CPUs, and node 2 is no longer available.
+  ASSERT_EQ(Candidates(2), (std::vector<int64_t>{1, 3, 2, 0}));
+
+  // Incremental updates re-rank the node in the cached entries.
+  AddOrUpdateNode(0, 4, 4);
+  AddOrUpdateNode(1, 0, 4);
+  ASSERT_EQ(Candidates(1), (std::vector<int64_t>{0, 3, 4, 2, 1}));
+  RemoveNode(3);
+  ASSERT_EQ(Candidates(1), (std::vector<int64_t>{0, 4, 2, 1}));
+  AddOrUpdateNode(5, 8, 8);
+  ASSERT_EQ(Candidates(1), (std::vector<int64_t>{0, 4, 5, 2, 1}));
+}
+
+TEST_F(SchedulingCandidateIndexTest, EvictionTest) {
+  AddOrUpdateNode(0, 4, 4);
+  Candidates(1);
+  Candidates(2);
+  ASSERT_EQ(index_.NumShapes(), 2);
+  // Using the shape for 1 CPU makes the shape for 2 CPUs the least recently used.
+  Candidates(1);
+  Candidates(3);
+  ASSERT_EQ(index_.NumShapes(), 2);
+
+  // An evicted shape is rebuilt from the table on its next use.
+  AddOrUpdateNode(1, 4, 4);
+  ASSERT_EQ(Candidates(2), (std::vector<int64_t>{0, 1}));
+  ASSERT_EQ(Candidates(1), (std::vector<int64_t>{0, 1}));
+  ASSERT_EQ(index_.NumShapes(), 2);
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -40,6 +40,17 @@ int64_t SchedulingPolicy::HybridPolicyWithFilter(
     const ResourceRequest &resource_request, float spread_threshold, bool force_spillback,
     bool require_available, std::function<bool(int64_t)> is_node_available,
     NodeFilter node_filter) {
+  if (candidate_index_ != nullptr) {
+    return HybridPolicyWithFilterIndexed(resource_request, spread_threshold,
+                                         force_spillback, require_available,
+                                         is_node_available, node_filter);
+  }
+  if (node_table_ != nullptr) {
+    return HybridPolicyWithFilterColumnar(resource_request, spread_threshold,
+                                          force_spillback, require_available,
+                                          is_node_available, node_filter);
+  }
+
   // Step 1: Generate the traversal order. We guarantee that the first node is local, to
   // encourage local scheduling. The rest of the traversal order should be globally
   // consistent, to encourage using "warm" workers.
@@ -147,6 +158,219 @@ int64_t SchedulingPolicy::HybridPolicyWithFilter(
   return best_node_id;
 }
 
+int64_t SchedulingPolicy::HybridPolicyWithFilterColumnar(
+    const ResourceRequest &resource_request, float spread_threshold, bool force_spillback,
+    bool require_available, const std::function<bool(int64_t)> &is_node_available,
+    NodeFilter node_filter) {
+  const auto &table = *node_table_;
+  const int64_t local_row = table.GetRow(local_node_id_);
+  RAY_CHECK(local_row != -1);
+  table.ComputeFeasible(resource_request, &feasible_);
+  table.ComputeAvailable(resource_request, &available_);
+  table.ComputeCriticalResourceUtilization(&utilization_);
+
+  // Instead of sorting a traversal, pick the minimum of (not available, truncated
+  // utilization, traversal position) in one pass over the rows. The traversal position
+  // puts the local node first and orders all other nodes by id, so this selects the
+  // same node as the traversal in HybridPolicyWithFilter.
+  int64_t best_node_id = -1;
+  float best_utilization_score = INFINITY;
+  bool best_is_available = false;
+  auto precedes_in_traversal = [this](int64_t node_id, int64_t other_node_id) {
+    if (node_id == local_node_id_ || other_node_id == local_node_id_) {
+      return node_id == local_node_id_;
+    }
+    return node_id < other_node_id;
+  };
+
+  const size_t num_rows = table.NumNodes();
+  for (size_t row = 0; row < num_rows; row++) {
+    if (!feasible_[row]) {
+      continue;
+    }
+    const bool is_local = static_cast<int64_t>(row) == local_row;
+    if (is_local && force_spillback) {
+      continue;
+    }
+    // The local node ignores the pull manager capacity, see HybridPolicyWithFilter.
+    const bool is_available =
+        available_[row] && (is_local || !resource_request.requires_object_store_memory ||
+                            !table.ObjectPullsQueued(row));
+    if (!is_available && (require_available || best_is_available)) {
+      continue;
+    }
+    float critical_resource_utilization = utilization_[row];
+    if (critical_resource_utilization < spread_threshold) {
+      critical_resource_utilization = 0;
+    }
+    const int64_t node_id = table.GetNodeId(row);
+    if (best_node_id != -1 && is_available == best_is_available) {
+      if (critical_resource_utilization > best_utilization_score ||
+          (critical_resource_utilization == best_utilization_score &&
+           !precedes_in_traversal(node_id, best_node_id))) {
+        continue;
+      }
+    }
+
+    // Only evaluate the filters for nodes that would become the best node.
+    if (node_filter != NodeFilter::kAny &&
+        table.HasGPUs(row) != (node_filter == NodeFilter::kGPU)) {
+      continue;
+    }
+    if (!is_node_available(node_id)) {
+      continue;
+    }
+    best_node_id = node_id;
+    best_utilization_score = critical_resource_utilization;
+    best_is_available = is_available;
+  }
+
+  return best_node_id;
+}
+
+int64_t SchedulingPolicy::HybridPolicyWithFilterIndexed(
+    const ResourceRequest &resource_request, float spread_threshold, bool force_spillback,
+    bool require_available, const std::function<bool(int64_t)> &is_node_available,
+    NodeFilter node_filter) {
+  // The candidates are sorted by preference, so the first one that passes the filters
+  // is the node HybridPolicyWithFilter would pick.
+  const auto &candidates =
+      candidate_index_->GetCandidates(resource_request, spread_threshold);
+  for (const auto &candidate : candidates) {
+    if (!candidate.is_available && require_available) {
+      // All remaining candidates are unavailable too.
+      break;
+    }
+    if (candidate.is_local && force_spillback) {
+      continue;
+    }
+    if (node_filter != NodeFilter::kAny &&
+        candidate.has_gpu != (node_filter == NodeFilter::kGPU)) {
+      continue;
+    }
+    if (!is_node_available(candidate.node_id)) {
+      continue;
+    }
+    return candidate.node_id;
+  }
+  return -1;
+}
+
+int64_t SchedulingPolicy::PowerOfDChoicesPolicyWithFilter(
+    const ResourceRequest &resource_request, float spread_threshold, bool force_spillback,
+    bool require_available, const std::function<bool(int64_t)> &is_node_available,
+    size_t num_choices, NodeFilter node_filter) {
+  int64_t best_node_id = -1;
+  float best_utilization_score = INFINITY;
+  bool best_is_available = false;
+
+  // Score a node with the priorities of HybridPolicyWithFilter. Returns false if the
+  // node can't run the request at all, so that it doesn't count as a choice.
+  auto consider = [&](int64_t node_id) {
+    const auto it = nodes_.find(node_id);
+    RAY_CHECK(it != nodes_.end());
+    const auto &node_view = it->second.GetLocalView();
+    if (node_filter != NodeFilter::kAny &&
+        DoesNodeHaveGPUs(node_view) != (node_filter == NodeFilter::kGPU)) {
+      return false;
+    }
+    if (!is_node_available(node_id) || !node_view.IsFeasible(resource_request)) {
+      return false;
+    }
+    // The local node ignores the pull manager capacity, see HybridPolicyWithFilter.
+    const bool is_available =
+        node_view.IsAvailable(resource_request, node_id == local_node_id_);
+    if (!is_available && (require_available || best_is_available)) {
+      return true;
+    }
+    float critical_resource_utilization =
+        node_view.CalculateCriticalResourceUtilization();
+    if (critical_resource_utilization < spread_threshold) {
+      critical_resource_utilization = 0;
+    }
+    // Ties keep the node considered first, i.e., the local node.
+    if (best_node_id == -1 || (is_available && !best_is_available) ||
+        critical_resource_utilization < best_utilization_score) {
+      best_node_id = node_id;
+      best_utilization_score = critical_resource_utilization;
+      best_is_available = is_available;
+    }
+    return true;
+  };
+
+  if (!force_spillback) {
+    consider(local_node_id_);
+    if (best_is_available && best_utilization_score == 0) {
+      // No remote node can beat the local node.
+      return best_node_id;
+    }
+  }
+
+  const auto &table = *node_table_;
+  const size_t num_rows = table.NumNodes();
+  if (num_rows <= num_choices + 1) {
+    // Small cluster, score all nodes.
+    for (size_t row = 0; row < num_rows; row++) {
+      const int64_t node_id = table.GetNodeId(row);
+      if (node_id != local_node_id_) {
+        consider(node_id);
+      }
+    }
+    return best_node_id;
+  }
+
+  // Sample with replacement, and bound the number of draws so that a cluster with few
+  // matching nodes doesn't make the decision as expensive as a full traversal.
+  std::uniform_int_distribution<size_t> distribution(0, num_rows - 1);
+  size_t num_chosen = 0;
+  for (size_t draw = 0; draw < 4 * num_choices && num_chosen < num_choices; draw++) {
+    const int64_t node_id = table.GetNodeId(distribution(gen_));
+    if (node_id != local_node_id_ && consider(node_id)) {
+      num_chosen++;
+    }
+  }
+  return best_node_id;
+}
+
+int64_t SchedulingPolicy::PowerOfDChoicesPolicy(
+    const ResourceRequest &resource_request, float spread_threshold, bool force_spillback,
+    bool require_available, std::function<bool(int64_t)> is_node_available,
+    size_t num_choices, bool scheduler_avoid_gpu_nodes) {
+  if (node_table_ == nullptr || num_choices == 0) {
+    return HybridPolicy(resource_request, spread_threshold, force_spillback,
+                        require_available, std::move(is_node_available),
+                        scheduler_avoid_gpu_nodes);
+  }
+
+  int64_t best_node_id = -1;
+  if (scheduler_avoid_gpu_nodes && !IsGPURequest(resource_request)) {
+    // Try schedule on non-GPU nodes.
+    best_node_id = PowerOfDChoicesPolicyWithFilter(
+        resource_request, spread_threshold, force_spillback,
+        /*require_available*/ true, is_node_available, num_choices, NodeFilter::kNonGpu);
+    if (best_node_id == -1) {
+      // The sample may have missed the non-GPU nodes, check all of them before using a
+      // GPU node.
+      best_node_id = HybridPolicyWithFilter(
+          resource_request, spread_threshold, force_spillback,
+          /*require_available*/ true, is_node_available, NodeFilter::kNonGpu);
+    }
+  }
+  if (best_node_id == -1) {
+    best_node_id = PowerOfDChoicesPolicyWithFilter(
+        resource_request, spread_threshold, force_spillback, require_available,
+        is_node_available, num_choices, NodeFilter::kAny);
+  }
+  if (best_node_id == -1) {
+    // The sample missed all nodes that can run the request. Only the full traversal can
+    // tell whether the request is unfeasible.
+    best_node_id = HybridPolicy(resource_request, spread_threshold, force_spillback,
+                                require_available, std::move(is_node_available),
+                                scheduler_avoid_gpu_nodes);
+  }
+  return best_node_id;
+}
+
 int64_t SchedulingPolicy::HybridPolicy(const ResourceRequest &resource_request,
                                        float spread_threshold, bool force_spillback,
                                        bool require_available,
@@ -12,19 +12,36 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+#include <random>
 #include <vector>
 
 #include "ray/common/ray_config.h"
 #include "ray/gcs/gcs_client/gcs_client.h"
 #include "ray/raylet/scheduling/cluster_resource_data.h"
+#include "ray/raylet/scheduling/node_resource_table.h"
+#include "ray/raylet/scheduling/scheduling_candidate_index.h"
 
 namespace ray {
 namespace raylet_scheduling_policy {
 
 class SchedulingPolicy {
  public:
-  SchedulingPolicy(int64_t local_node_id, const absl::flat_hash_map<int64_t, Node> &nodes)
-      : local_node_id_(local_node_id), nodes_(nodes) {}
+  /// \param local_node_id: Identifier of the local node.
+  /// \param nodes: The nodes in the cluster.
+  /// \param node_table: If set, a columnar copy of the local views in `nodes`, which
+  /// must be kept in sync by the owner. The policy then evaluates requests against the
+  /// table instead of the map. `nodes` is still used as the reference implementation.
+  /// \param candidate_index: If set, an index over `node_table`, which must be kept in
+  /// sync by the owner. The policy then picks nodes from the index.
+  SchedulingPolicy(int64_t local_node_id, const absl::flat_hash_map<int64_t, Node> &nodes,
+                   const NodeResourceTable *node_table = nullptr,
+                   SchedulingCandidateIndex *candidate_index = nullptr)
+      : local_node_id_(local_node_id),
+        nodes_(nodes),
+        node_table_(node_table),
+        candidate_index_(candidate_index),
+        gen_(std::chrono::high_resolution_clock::now().time_since_epoch().count()) {}
 
   /// This scheduling policy was designed with the following assumptions in mind:
   ///   1. Scheduling a task on a new node incurs a cold start penalty (warming the worker
@@ -64,12 +81,47 @@ class SchedulingPolicy {
       std::function<bool(int64_t)> is_node_available,
       bool scheduler_avoid_gpu_nodes = RayConfig::instance().scheduler_avoid_gpu_nodes());
 
+  /// A sampling alternative to HybridPolicy for very large clusters. Instead of
+  /// traversing all nodes, it scores the local node and `num_choices` randomly sampled
+  /// remote nodes, and picks the best of them with the same priorities as HybridPolicy
+  /// (available over feasible nodes, then truncated critical resource utilization). The
+  /// local node is kept if it is available and below the spread threshold, and CPU-only
+  /// requests avoid GPU nodes as in HybridPolicy.
+  ///
+  /// Unless it falls back, the cost of a decision doesn't depend on the cluster size,
+  /// and since there is no fixed traversal order, load isn't concentrated on the nodes
+  /// early in the order. If none of the sampled nodes can run the request, this falls
+  /// back to HybridPolicy, so a request is only reported unfeasible if no node in the
+  /// cluster can run it. Likewise, CPU-only requests only go to GPU nodes after all
+  /// non-GPU nodes were checked. Sampling requires `node_table`; without it, this is
+  /// the same as HybridPolicy.
+  ///
+  /// \param num_choices: The number of remote nodes to sample per decision.
+  ///
+  /// \return -1 if the task is unfeasible, otherwise the node id (key in `nodes`) to
+  /// schedule on.
+  int64_t PowerOfDChoicesPolicy(
+      const ResourceRequest &resource_request, float spread_threshold,
+      bool force_spillback, bool require_available,
+      std::function<bool(int64_t)> is_node_available, size_t num_choices,
+      bool scheduler_avoid_gpu_nodes = RayConfig::instance().scheduler_avoid_gpu_nodes());
+
  private:
   /// Identifier of local node.
   const int64_t local_node_id_;
   /// List of nodes in the clusters and their resources organized as a map.
   /// The key of the map is the node ID.
   const absl::flat_hash_map<int64_t, Node> &nodes_;
+  /// Columnar copy of `nodes_`, or nullptr to use `nodes_` directly.
+  const NodeResourceTable *node_table_;
+  /// Index of the best nodes per resource shape, or nullptr to score all nodes.
+  SchedulingCandidateIndex *candidate_index_;
+  /// Scratch buffers for the columnar path, kept to avoid allocating per request.
+  std::vector<uint8_t> feasible_;
+  std::vector<uint8_t> available_;
+  std::vector<float> utilization_;
+  /// Random generator used to sample nodes in PowerOfDChoicesPolicy.
+  std::mt19937_64 gen_;
 
   enum class NodeFilter {
     /// Default scheduling.
@@ -94,6 +146,28 @@ class SchedulingPolicy {
                                  bool require_available,
                                  std::function<bool(int64_t)> is_node_available,
                                  NodeFilter node_filter = NodeFilter::kAny);
+
+  /// Same as HybridPolicyWithFilter, but computed on `node_table_` in a single pass
+  /// without building and sorting a traversal.
+  int64_t HybridPolicyWithFilterColumnar(
+      const ResourceRequest &resource_request, float spread_threshold,
+      bool force_spillback, bool require_available,
+      const std::function<bool(int64_t)> &is_node_available, NodeFilter node_filter);
+
+  /// Same as HybridPolicyWithFilter, but takes the first matching node from the
+  /// precomputed candidates of `candidate_index_`.
+  int64_t HybridPolicyWithFilterIndexed(
+      const ResourceRequest &resource_request, float spread_threshold,
+      bool force_spillback, bool require_available,
+      const std::function<bool(int64_t)> &is_node_available, NodeFilter node_filter);
+
+  /// Same as HybridPolicyWithFilter, but only considers the local node and
+  /// `num_choices` sampled rows of `node_table_`.
+  int64_t PowerOfDChoicesPolicyWithFilter(
+      const ResourceRequest &resource_request, float spread_threshold,
+      bool force_spillback, bool require_available,
+      const std::function<bool(int64_t)> &is_node_available, size_t num_choices,
+      NodeFilter node_filter);
 };
 }  // namespace raylet_scheduling_policy
 }  // namespace ray
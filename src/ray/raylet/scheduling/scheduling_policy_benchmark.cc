@@ -0,0 +1,124 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the cost per decision of the hybrid and the power-of-d-choices scheduling
+// policies when filling a large cluster of identical nodes with single CPU tasks, and
+// how each spreads the load.
+//
+// Usage: scheduling_policy_benchmark --num_nodes=5000 --cluster_fraction=0.25
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "ray/raylet/scheduling/scheduling_policy.h"
+
+DEFINE_int64(num_nodes, 5000, "The number of nodes in the cluster.");
+DEFINE_double(cluster_fraction, 0.25,
+              "The fraction of the CPUs of the cluster that the tasks fill.");
+
+namespace ray {
+namespace raylet {
+
+/// Places single CPU tasks on a cluster of identical nodes with one policy, as the
+/// raylet of the local node does, and times each decision.
+class PlacementSimulator {
+ public:
+  static constexpr int64_t kLocalNode = 0;
+  static constexpr int kCpusPerNode = 16;
+
+  explicit PlacementSimulator(int64_t num_nodes) : used_cpus_(num_nodes, 0) {
+    for (int64_t node_id = 0; node_id < num_nodes; node_id++) {
+      UpdateNode(node_id);
+    }
+  }
+
+  /// \param num_choices: 0 to use the hybrid policy.
+  void Run(int64_t num_tasks, size_t num_choices) {
+    raylet_scheduling_policy::SchedulingPolicy policy(kLocalNode, nodes_, &table_);
+    const auto req = ResourceMapToResourceRequest(map_, {{"CPU", 1}}, false);
+    auto is_node_available = [](auto) { return true; };
+    for (int64_t i = 0; i < num_tasks; i++) {
+      const auto start = std::chrono::steady_clock::now();
+      const int64_t node_id =
+          num_choices > 0
+              ? policy.PowerOfDChoicesPolicy(req, 0.5, false, false, is_node_available,
+                                             num_choices)
+              : policy.HybridPolicy(req, 0.5, false, false, is_node_available);
+      decision_time_ += std::chrono::steady_clock::now() - start;
+      RAY_CHECK(node_id != -1);
+      used_cpus_[node_id]++;
+      UpdateNode(node_id);
+    }
+    num_decisions_ += num_tasks;
+  }
+
+  double MicrosPerDecision() const {
+    return std::chrono::duration<double, std::micro>(decision_time_).count() /
+           num_decisions_;
+  }
+
+  int MaxUsedCpus() const {
+    return *std::max_element(used_cpus_.begin(), used_cpus_.end());
+  }
+
+  int64_t NumUsedNodes() const {
+    return std::count_if(used_cpus_.begin(), used_cpus_.end(),
+                         [](int used) { return used > 0; });
+  }
+
+ private:
+  void UpdateNode(int64_t node_id) {
+    NodeResources resources;
+    resources.predefined_resources = {
+        {kCpusPerNode - used_cpus_[node_id], kCpusPerNode}, {0, 0}, {0, 0}};
+    nodes_.erase(node_id);
+    nodes_.emplace(node_id, resources);
+    table_.AddOrUpdateNode(node_id, resources);
+  }
+
+  StringIdMap map_;
+  std::vector<int> used_cpus_;
+  absl::flat_hash_map<int64_t, Node> nodes_;
+  NodeResourceTable table_;
+  std::chrono::steady_clock::duration decision_time_{0};
+  int64_t num_decisions_ = 0;
+};
+
+}  // namespace raylet
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  using ray::raylet::PlacementSimulator;
+  const int64_t num_tasks = static_cast<int64_t>(
+      FLAGS_num_nodes * PlacementSimulator::kCpusPerNode * FLAGS_cluster_fraction);
+  std::cout << std::setw(10) << "policy" << std::setw(16) << "us/decision"
+            << std::setw(14) << "used_nodes" << std::setw(18) << "max_cpus_per_node"
+            << std::endl;
+  for (size_t num_choices : {0, 2, 4}) {
+    PlacementSimulator simulator(FLAGS_num_nodes);
+    simulator.Run(num_tasks, num_choices);
+    std::cout << std::setw(10)
+              << (num_choices == 0 ? "hybrid" : "d=" + std::to_string(num_choices))
+              << std::setw(16) << std::fixed << std::setprecision(3)
+              << simulator.MicrosPerDecision() << std::setw(14)
+              << simulator.NumUsedNodes() << std::setw(18) << simulator.MaxUsedCpus()
+              << std::endl;
+  }
+  return 0;
+}
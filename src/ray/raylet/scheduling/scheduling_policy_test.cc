@@ -14,6 +14,9 @@
 
 #include "ray/raylet/scheduling/scheduling_policy.h"
 
+#include <algorithm>
+#include <random>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -392,6 +395,308 @@ TEST_F(SchedulingPolicyTest, NonGpuNodePreferredSchedulingTest) {
   ASSERT_EQ(to_schedule, remote_node_1);
 }
 
+/// A random cluster, mirrored in a NodeResourceTable and a SchedulingCandidateIndex, to
+/// compare the optimized policies against the map-based reference.
+class RandomCluster {
+ public:
+  static constexpr int64_t kLocalNode = 0;
+
+  explicit RandomCluster(uint32_t seed)
+      : gen_(seed), index_(kLocalNode, table_, /*max_shapes=*/8) {
+    custom_id_ = map_.Insert("custom");
+  }
+
+  int RandomInt(int max) { return std::uniform_int_distribution<int>(0, max)(gen_); }
+
+  void AddOrUpdateNode(int64_t node_id) {
+    const int total_cpu = RandomInt(4);
+    const int total_gpu = RandomInt(1) * 2;
+    NodeResources resources =
+        CreateNodeResources(RandomInt(total_cpu), total_cpu, RandomInt(8), 8,
+                            RandomInt(total_gpu), total_gpu);
+    if (RandomInt(1)) {
+      resources.predefined_resources.resize(PredefinedResources_MAX);
+      resources.predefined_resources[OBJECT_STORE_MEM] =
+          ResourceCapacity(RandomInt(10), 10);
+    }
+    if (RandomInt(1)) {
+      resources.custom_resources[custom_id_] = ResourceCapacity(RandomInt(2), 2);
+    }
+    resources.object_pulls_queued = RandomInt(1);
+    nodes_.erase(node_id);
+    nodes_.emplace(node_id, resources);
+    table_.AddOrUpdateNode(node_id, resources);
+    index_.OnNodeUpdated(node_id, resources);
+  }
+
+  void RemoveNode(int64_t node_id) {
+    ASSERT_NE(node_id, kLocalNode);
+    nodes_.erase(node_id);
+    table_.RemoveNode(node_id);
+    index_.OnNodeRemoved(node_id);
+  }
+
+  ResourceRequest RandomRequest() {
+    absl::flat_hash_map<std::string, double> request_map = {
+        {"CPU", static_cast<double>(RandomInt(3))}, {"memory", RandomInt(8) / 2.0}};
+    if (RandomInt(3) == 0) {
+      request_map["GPU"] = 1;
+    }
+    if (RandomInt(3) == 0) {
+      request_map["custom"] = RandomInt(2);
+    }
+    if (RandomInt(3) == 0) {
+      request_map["object_store_memory"] = RandomInt(10);
+    }
+    return ResourceMapToResourceRequest(map_, request_map, RandomInt(1));
+  }
+
+  /// Schedule random requests with all policy implementations and check that they
+  /// agree.
+  void CheckPoliciesAgree(int num_requests) {
+    ASSERT_EQ(table_.NumNodes(), nodes_.size());
+    absl::flat_hash_set<int64_t> dead_nodes = {RandomInt(nodes_.size())};
+    auto is_node_available = [&dead_nodes](int64_t node_id) {
+      return !dead_nodes.contains(node_id);
+    };
+    for (int i = 0; i < num_requests; i++) {
+      auto req = RandomRequest();
+      const float spread_threshold = RandomInt(2) / 2.0;
+      const bool force_spillback = RandomInt(3) == 0;
+      const bool require_available = RandomInt(1);
+      const bool avoid_gpu_nodes = RandomInt(1);
+
+      auto expected = raylet_scheduling_policy::SchedulingPolicy(kLocalNode, nodes_)
+                          .HybridPolicy(req, spread_threshold, force_spillback,
+                                        require_available, is_node_available,
+                                        avoid_gpu_nodes);
+      auto columnar = raylet_scheduling_policy::SchedulingPolicy(kLocalNode, nodes_,
+                                                                 &table_)
+                          .HybridPolicy(req, spread_threshold, force_spillback,
+                                        require_available, is_node_available,
+                                        avoid_gpu_nodes);
+      auto indexed = raylet_scheduling_policy::SchedulingPolicy(kLocalNode, nodes_,
+                                                                &table_, &index_)
+                         .HybridPolicy(req, spread_threshold, force_spillback,
+                                       require_available, is_node_available,
+                                       avoid_gpu_nodes);
+      ASSERT_EQ(columnar, expected) << req.DebugString();
+      ASSERT_EQ(indexed, expected) << req.DebugString();
+    }
+  }
+
+ private:
+  std::mt19937 gen_;
+  StringIdMap map_;
+  int64_t custom_id_;
+  absl::flat_hash_map<int64_t, Node> nodes_;
+  NodeResourceTable table_;
+  SchedulingCandidateIndex index_;
+};
+
+TEST_F(SchedulingPolicyTest, OptimizedPoliciesMatchReferenceTest) {
+  // The columnar and the indexed policies must pick exactly the node the map-based
+  // reference picks, including the tie breaking between nodes with the same
+  // utilization.
+  for (uint32_t trial = 0; trial < 50; trial++) {
+    RandomCluster cluster(trial);
+    const int num_nodes = 1 + cluster.RandomInt(20);
+    for (int64_t node_id = 0; node_id < num_nodes; node_id++) {
+      cluster.AddOrUpdateNode(node_id);
+    }
+    for (int round = 0; round < 10; round++) {
+      cluster.CheckPoliciesAgree(/*num_requests=*/10);
+      // Update, remove and re-add nodes, so that the index has to follow the changes
+      // and the table's rows are no longer in id order.
+      for (int i = 0; i < 1 + num_nodes / 3; i++) {
+        cluster.AddOrUpdateNode(cluster.RandomInt(num_nodes - 1));
+        cluster.RemoveNode(1 + cluster.RandomInt(num_nodes));
+      }
+    }
+  }
+}
+
+TEST_F(SchedulingPolicyTest, PowerOfDChoicesLocalPreferenceTest) {
+  StringIdMap map;
+  ResourceRequest req = ResourceMapToResourceRequest(map, {{"CPU", 1}}, false);
+  int64_t local_node = 0;
+  int64_t remote_node = 1;
+
+  absl::flat_hash_map<int64_t, Node> nodes;
+  NodeResourceTable table;
+  auto add_node = [&](int64_t node_id, const NodeResources &resources) {
+    nodes.erase(node_id);
+    nodes.emplace(node_id, resources);
+    table.AddOrUpdateNode(node_id, resources);
+  };
+  add_node(local_node, CreateNodeResources(6, 10, 0, 0, 0, 0));
+  add_node(remote_node, CreateNodeResources(10, 10, 0, 0, 0, 0));
+  raylet_scheduling_policy::SchedulingPolicy policy(local_node, nodes, &table);
+  auto schedule = [&policy, &req](bool force_spillback) {
+    return policy.PowerOfDChoicesPolicy(req, 0.5, force_spillback, false,
+                                        [](auto) { return true; },
+                                        /*num_choices=*/2);
+  };
+
+  // The local node is below the spread threshold.
+  ASSERT_EQ(schedule(false), local_node);
+  ASSERT_EQ(schedule(true), remote_node);
+
+  // The local node is above the spread threshold, so the less utilized remote node wins.
+  add_node(local_node, CreateNodeResources(3, 10, 0, 0, 0, 0));
+  ASSERT_EQ(schedule(false), remote_node);
+
+  // Ties are broken in favor of the local node.
+  add_node(remote_node, CreateNodeResources(3, 10, 0, 0, 0, 0));
+  ASSERT_EQ(schedule(false), local_node);
+
+  // Without a node table, this is the same as the hybrid policy.
+  ASSERT_EQ(raylet_scheduling_policy::SchedulingPolicy(local_node, nodes)
+                .PowerOfDChoicesPolicy(req, 0.5, true, false, [](auto) { return true; },
+                                       /*num_choices=*/2),
+            remote_node);
+}
+
+TEST_F(SchedulingPolicyTest, PowerOfDChoicesAvoidGpuNodesTest) {
+  StringIdMap map;
+  int64_t local_node = 0;
+  absl::flat_hash_map<int64_t, Node> nodes;
+  NodeResourceTable table;
+  // A GPU local node, many GPU remote nodes and a single CPU-only remote node, which is
+  // busier than all the others.
+  const int64_t num_nodes = 100;
+  const int64_t cpu_node = 42;
+  for (int64_t node_id = 0; node_id < num_nodes; node_id++) {
+    auto resources = node_id == cpu_node ? CreateNodeResources(1, 10, 0, 0, 0, 0)
+                                         : CreateNodeResources(10, 10, 0, 0, 1, 1);
+    nodes.emplace(node_id, resources);
+    table.AddOrUpdateNode(node_id, resources);
+  }
+  raylet_scheduling_policy::SchedulingPolicy policy(local_node, nodes, &table);
+
+  for (int i = 0; i < 10; i++) {
+    // The sample will usually miss the CPU-only node, but a CPU request must still land
+    // on it, like with the hybrid policy.
+    auto req = ResourceMapToResourceRequest(map, {{"CPU", 1}}, false);
+    ASSERT_EQ(policy.PowerOfDChoicesPolicy(req, 0.5, false, false,
+                                           [](auto) { return true; },
+                                           /*num_choices=*/2, true),
+              cpu_node);
+    // GPU requests stay local.
+    req = ResourceMapToResourceRequest(map, {{"CPU", 1}, {"GPU", 1}}, false);
+    ASSERT_EQ(policy.PowerOfDChoicesPolicy(req, 0.5, false, false,
+                                           [](auto) { return true; },
+                                           /*num_choices=*/2, true),
+              local_node);
+  }
+}
+
+TEST_F(SchedulingPolicyTest, PowerOfDChoicesInfeasibleTest) {
+  // Only one node out of many can run the request. A sample that misses it must not
+  // make the request infeasible.
+  StringIdMap map;
+  int64_t local_node = 0;
+  absl::flat_hash_map<int64_t, Node> nodes;
+  NodeResourceTable table;
+  const int64_t num_nodes = 100;
+  const int64_t big_node = 77;
+  for (int64_t node_id = 0; node_id < num_nodes; node_id++) {
+    auto resources = node_id == big_node ? CreateNodeResources(32, 32, 0, 0, 0, 0)
+                                         : CreateNodeResources(4, 4, 0, 0, 0, 0);
+    nodes.emplace(node_id, resources);
+    table.AddOrUpdateNode(node_id, resources);
+  }
+  raylet_scheduling_policy::SchedulingPolicy policy(local_node, nodes, &table);
+
+  for (int i = 0; i < 10; i++) {
+    auto req = ResourceMapToResourceRequest(map, {{"CPU", 16}}, false);
+    ASSERT_EQ(policy.PowerOfDChoicesPolicy(req, 0.5, false, false,
+                                           [](auto) { return true; },
+                                           /*num_choices=*/2),
+              big_node);
+    // Skip dead nodes.
+    ASSERT_EQ(policy.PowerOfDChoicesPolicy(
+                  req, 0.5, false, false,
+                  [big_node](auto node_id) { return node_id != big_node; },
+                  /*num_choices=*/2),
+              -1);
+    req = ResourceMapToResourceRequest(map, {{"CPU", 64}}, false);
+    ASSERT_EQ(policy.PowerOfDChoicesPolicy(req, 0.5, false, false,
+                                           [](auto) { return true; },
+                                           /*num_choices=*/2),
+              -1);
+  }
+}
+
+/// Places single CPU tasks on a large cluster of identical nodes with one policy, and
+/// reports how the load is spread.
+class PlacementSimulator {
+ public:
+  static constexpr int64_t kLocalNode = 0;
+  static constexpr int kCpusPerNode = 16;
+
+  explicit PlacementSimulator(int num_nodes) : used_cpus_(num_nodes, 0) {
+    for (int64_t node_id = 0; node_id < num_nodes; node_id++) {
+      UpdateNode(node_id);
+    }
+  }
+
+  /// \param num_choices: 0 to use the hybrid policy.
+  void Run(int num_tasks, size_t num_choices) {
+    raylet_scheduling_policy::SchedulingPolicy policy(kLocalNode, nodes_, &table_);
+    const auto req = ResourceMapToResourceRequest(map_, {{"CPU", 1}}, false);
+    auto is_node_available = [](auto) { return true; };
+    for (int i = 0; i < num_tasks; i++) {
+      const int64_t node_id =
+          num_choices > 0
+              ? policy.PowerOfDChoicesPolicy(req, 0.5, false, false, is_node_available,
+                                             num_choices)
+              : policy.HybridPolicy(req, 0.5, false, false, is_node_available);
+      ASSERT_NE(node_id, -1);
+      used_cpus_[node_id]++;
+      UpdateNode(node_id);
+    }
+  }
+
+  int MaxUsedCpus() const {
+    return *std::max_element(used_cpus_.begin(), used_cpus_.end());
+  }
+
+  int NumUsedNodes() const {
+    return std::count_if(used_cpus_.begin(), used_cpus_.end(),
+                         [](int used) { return used > 0; });
+  }
+
+ private:
+  void UpdateNode(int64_t node_id) {
+    const auto resources = CreateNodeResources(kCpusPerNode - used_cpus_[node_id],
+                                               kCpusPerNode, 0, 0, 0, 0);
+    nodes_.erase(node_id);
+    nodes_.emplace(node_id, resources);
+    table_.AddOrUpdateNode(node_id, resources);
+  }
+
+  StringIdMap map_;
+  std::vector<int> used_cpus_;
+  absl::flat_hash_map<int64_t, Node> nodes_;
+  NodeResourceTable table_;
+};
+
+TEST_F(SchedulingPolicyTest, PowerOfDChoicesSimulationTest) {
+  // Fill a quarter of a 1000 node cluster. The hybrid policy packs the nodes at the
+  // start of its traversal up to the spread threshold, the sampling policy spreads the
+  // tasks over the cluster.
+  const int num_nodes = 1000;
+  const int num_tasks = num_nodes * PlacementSimulator::kCpusPerNode / 4;
+  PlacementSimulator hybrid(num_nodes);
+  hybrid.Run(num_tasks, /*num_choices=*/0);
+  PlacementSimulator sampling(num_nodes);
+  sampling.Run(num_tasks, /*num_choices=*/2);
+
+  ASSERT_EQ(hybrid.MaxUsedCpus(), PlacementSimulator::kCpusPerNode / 2);
+  ASSERT_GT(sampling.NumUsedNodes(), hybrid.NumUsedNodes());
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
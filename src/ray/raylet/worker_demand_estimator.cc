@@ -0,0 +1,131 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/worker_demand_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ray/util/logging.h"
+
+namespace ray {
+
+namespace raylet {
+
+WorkerDemandEstimator::WorkerDemandEstimator(int64_t interval_ms, double alpha,
+                                             int64_t now_ms)
+    : interval_ms_(interval_ms), alpha_(alpha), interval_start_ms_(now_ms) {
+  RAY_CHECK(interval_ms_ > 0);
+  RAY_CHECK(alpha_ > 0 && alpha_ <= 1);
+}
+
+void WorkerDemandEstimator::RecordLeaseStarted(const Language &language,
+                                               const JobID &job_id) {
+  auto &state = demand_by_lang_[language][job_id];
+  state.num_leased++;
+  state.peak_leased = std::max(state.peak_leased, state.num_leased);
+}
+
+void WorkerDemandEstimator::RecordLeaseFinished(const Language &language,
+                                                const JobID &job_id) {
+  auto lang_it = demand_by_lang_.find(language);
+  if (lang_it == demand_by_lang_.end()) {
+    return;
+  }
+  auto it = lang_it->second.find(job_id);
+  if (it != lang_it->second.end() && it->second.num_leased > 0) {
+    it->second.num_leased--;
+  }
+}
+
+void WorkerDemandEstimator::Update(int64_t now_ms) {
+  if (now_ms < interval_start_ms_ + interval_ms_) {
+    return;
+  }
+  const int64_t num_intervals = (now_ms - interval_start_ms_) / interval_ms_;
+  interval_start_ms_ += num_intervals * interval_ms_;
+  // The peak counts for the first of the elapsed intervals, and the rest of them
+  // peaked at the number of workers leased now, which the average decays towards.
+  const double decay = std::pow(1 - alpha_, num_intervals - 1);
+  for (auto &lang_entry : demand_by_lang_) {
+    for (auto &job_entry : lang_entry.second) {
+      auto &state = job_entry.second;
+      state.average = alpha_ * state.peak_leased + (1 - alpha_) * state.average;
+      state.average = state.num_leased + (state.average - state.num_leased) * decay;
+      state.peak_leased = state.num_leased;
+    }
+  }
+}
+
+bool WorkerDemandEstimator::IsTracked(const Language &language,
+                                      const JobID &job_id) const {
+  return GetDemandState(language, job_id) != nullptr;
+}
+
+double WorkerDemandEstimator::PredictedDemand(const Language &language,
+                                              const JobID &job_id) const {
+  const auto *state = GetDemandState(language, job_id);
+  return state == nullptr ? 0 : state->average;
+}
+
+int64_t WorkerDemandEstimator::TargetWarmWorkers(const Language &language,
+                                                 const JobID &job_id) const {
+  const auto *state = GetDemandState(language, job_id);
+  return state == nullptr ? 0 : TargetWarmWorkers(*state);
+}
+
+int64_t WorkerDemandEstimator::IdleWorkerKillingThresholdMs(
+    const Language &language, const JobID &job_id, int64_t base_threshold_ms) const {
+  const double scale =
+      std::min(1 + PredictedDemand(language, job_id), kMaxIdleKillingThresholdScale);
+  return std::llround(base_threshold_ms * scale);
+}
+
+void WorkerDemandEstimator::ForEachTarget(
+    const std::function<void(const Language &, const JobID &, int64_t)> &fn) const {
+  for (const auto &lang_entry : demand_by_lang_) {
+    for (const auto &job_entry : lang_entry.second) {
+      fn(lang_entry.first, job_entry.first, TargetWarmWorkers(job_entry.second));
+    }
+  }
+}
+
+void WorkerDemandEstimator::RemoveJob(const JobID &job_id) {
+  for (auto it = demand_by_lang_.begin(); it != demand_by_lang_.end();) {
+    it->second.erase(job_id);
+    if (it->second.empty()) {
+      demand_by_lang_.erase(it++);
+    } else {
+      it++;
+    }
+  }
+}
+
+int64_t WorkerDemandEstimator::TargetWarmWorkers(const DemandState &state) {
+  return std::max<int64_t>(std::llround(state.average) - state.num_leased, 0);
+}
+
+const WorkerDemandEstimator::DemandState *WorkerDemandEstimator::GetDemandState(
+    const Language &language, const JobID &job_id) const {
+  auto lang_it = demand_by_lang_.find(language);
+  if (lang_it == demand_by_lang_.end()) {
+    return nullptr;
+  }
+  auto it = lang_it->second.find(job_id);
+  return it == lang_it->second.end() ? nullptr : &it->second;
+}
+
+}  // namespace raylet
+
+}  // namespace ray
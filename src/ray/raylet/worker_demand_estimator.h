@@ -0,0 +1,118 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+
+#include "absl/container/flat_hash_map.h"
+#include "ray/common/id.h"
+#include "ray/common/task/task_common.h"
+
+namespace ray {
+
+namespace raylet {
+
+/// \class WorkerDemandEstimator
+///
+/// Estimates how many workers each job uses at once per language, so that the worker
+/// pool can keep a warm pool of idle workers sized to the demand, and shrink it once
+/// the demand goes away.
+///
+/// Time is split into fixed intervals. The peak number of workers leased at once in
+/// each interval is folded into an exponentially weighted moving average, which is the
+/// predicted number of workers that the job will use at once in the next interval.
+class WorkerDemandEstimator {
+ public:
+  /// \param interval_ms The length of an interval over which the peak is taken.
+  /// \param alpha The weight of the latest interval in the moving average, in (0, 1].
+  /// \param now_ms The current time.
+  WorkerDemandEstimator(int64_t interval_ms, double alpha, int64_t now_ms);
+
+  /// Record that a worker was leased to a task.
+  ///
+  /// \param language The language of the leased worker.
+  /// \param job_id The job of the task.
+  void RecordLeaseStarted(const Language &language, const JobID &job_id);
+
+  /// Record that a leased worker was returned or died. This is a no-op for jobs that
+  /// are not tracked anymore.
+  ///
+  /// \param language The language of the leased worker.
+  /// \param job_id The job of the task.
+  void RecordLeaseFinished(const Language &language, const JobID &job_id);
+
+  /// Fold the peaks of all the intervals that ended before the given time into the
+  /// predictions. Intervals without any lease event peak at the number of workers
+  /// that were leased throughout them.
+  ///
+  /// \param now_ms The current time.
+  void Update(int64_t now_ms);
+
+  /// Whether a lease was recorded for the job and language since the job started.
+  bool IsTracked(const Language &language, const JobID &job_id) const;
+
+  /// The predicted number of workers leased at once in the next interval.
+  double PredictedDemand(const Language &language, const JobID &job_id) const;
+
+  /// The number of idle workers to keep warm for the job and language, which is the
+  /// predicted demand rounded to the nearest integer, minus the workers that are
+  /// already leased.
+  int64_t TargetWarmWorkers(const Language &language, const JobID &job_id) const;
+
+  /// How long an idle worker of the job and language that is not kept warm must have
+  /// been idle before it is killed. The more workers the job is predicted to use,
+  /// the more likely such a worker is reused soon, so the threshold grows with the
+  /// predicted demand, up to kMaxIdleKillingThresholdScale times the base threshold.
+  ///
+  /// \param base_threshold_ms The threshold without any predicted demand.
+  int64_t IdleWorkerKillingThresholdMs(const Language &language, const JobID &job_id,
+                                       int64_t base_threshold_ms) const;
+
+  /// Call the given function for each tracked job and language with its target number
+  /// of warm workers.
+  void ForEachTarget(
+      const std::function<void(const Language &, const JobID &, int64_t)> &fn) const;
+
+  /// Forget the demand of a job, e.g., because it finished.
+  void RemoveJob(const JobID &job_id);
+
+ private:
+  static constexpr double kMaxIdleKillingThresholdScale = 10;
+
+  struct DemandState {
+    /// The number of workers leased right now.
+    int64_t num_leased = 0;
+    /// The peak number of workers leased at once in the current interval.
+    int64_t peak_leased = 0;
+    /// The moving average of the peak number of workers leased per interval.
+    double average = 0;
+  };
+
+  static int64_t TargetWarmWorkers(const DemandState &state);
+
+  const DemandState *GetDemandState(const Language &language, const JobID &job_id) const;
+
+  const int64_t interval_ms_;
+  const double alpha_;
+  /// The start time of the current interval.
+  int64_t interval_start_ms_;
+  /// The demand of each job, by language.
+  absl::flat_hash_map<Language, absl::flat_hash_map<JobID, DemandState>, std::hash<int>>
+      demand_by_lang_;
+};
+
+}  // namespace raylet
+
+}  // namespace ray
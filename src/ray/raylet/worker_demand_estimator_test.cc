@@ -0,0 +1,159 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/worker_demand_estimator.h"
+
+#include "gtest/gtest.h"
+
+namespace ray {
+
+namespace raylet {
+
+const JobID JOB_ID = JobID::FromInt(1);
+const JobID JOB_ID_2 = JobID::FromInt(2);
+
+TEST(WorkerDemandEstimatorTest, TestPeakLeases) {
+  WorkerDemandEstimator estimator(/*interval_ms=*/1000, /*alpha=*/0.5, /*now_ms=*/0);
+  ASSERT_FALSE(estimator.IsTracked(Language::PYTHON, JOB_ID));
+  ASSERT_EQ(estimator.TargetWarmWorkers(Language::PYTHON, JOB_ID), 0);
+
+  for (int i = 0; i < 3; i++) {
+    estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  }
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  ASSERT_TRUE(estimator.IsTracked(Language::PYTHON, JOB_ID));
+  // The peak only counts once its interval ends.
+  estimator.Update(999);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 0);
+  estimator.Update(1000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 1.5);
+  // Two workers are still leased, so none needs to be kept idle.
+  ASSERT_EQ(estimator.TargetWarmWorkers(Language::PYTHON, JOB_ID), 0);
+
+  // The workers leased when the interval starts count towards its peak.
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  estimator.Update(2000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 1.75);
+  ASSERT_EQ(estimator.TargetWarmWorkers(Language::PYTHON, JOB_ID), 1);
+
+  // Other languages and jobs are tracked separately.
+  ASSERT_FALSE(estimator.IsTracked(Language::JAVA, JOB_ID));
+  ASSERT_FALSE(estimator.IsTracked(Language::PYTHON, JOB_ID_2));
+}
+
+TEST(WorkerDemandEstimatorTest, TestDemandDecays) {
+  WorkerDemandEstimator estimator(/*interval_ms=*/1000, /*alpha=*/0.5, /*now_ms=*/0);
+  for (int i = 0; i < 8; i++) {
+    estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  }
+  for (int i = 0; i < 8; i++) {
+    estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  }
+  estimator.Update(1000);
+  ASSERT_EQ(estimator.TargetWarmWorkers(Language::PYTHON, JOB_ID), 4);
+
+  // Intervals without leases decay the demand, also if several of them elapsed
+  // between two updates.
+  estimator.Update(2000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 2);
+  estimator.Update(4000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 0.5);
+  estimator.Update(5000);
+  ASSERT_EQ(estimator.TargetWarmWorkers(Language::PYTHON, JOB_ID), 0);
+  // The job is still tracked, so that its idle workers are not kept warm anymore.
+  ASSERT_TRUE(estimator.IsTracked(Language::PYTHON, JOB_ID));
+
+  // Workers leased throughout several intervals count in all of them.
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  estimator.Update(6000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 1.125);
+  estimator.Update(9000);
+  ASSERT_EQ(estimator.PredictedDemand(Language::PYTHON, JOB_ID), 1.890625);
+}
+
+TEST(WorkerDemandEstimatorTest, TestIdleWorkerKillingThreshold) {
+  WorkerDemandEstimator estimator(/*interval_ms=*/1000, /*alpha=*/1, /*now_ms=*/0);
+  ASSERT_EQ(estimator.IdleWorkerKillingThresholdMs(Language::PYTHON, JOB_ID, 100), 100);
+
+  // The threshold grows with the predicted demand.
+  for (int i = 0; i < 3; i++) {
+    estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  }
+  for (int i = 0; i < 3; i++) {
+    estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  }
+  estimator.Update(1000);
+  ASSERT_EQ(estimator.IdleWorkerKillingThresholdMs(Language::PYTHON, JOB_ID, 100), 400);
+  ASSERT_EQ(estimator.IdleWorkerKillingThresholdMs(Language::PYTHON, JOB_ID_2, 100),
+            100);
+
+  // It is capped for jobs with a high demand.
+  for (int i = 0; i < 100; i++) {
+    estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  }
+  for (int i = 0; i < 100; i++) {
+    estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  }
+  estimator.Update(2000);
+  ASSERT_EQ(estimator.IdleWorkerKillingThresholdMs(Language::PYTHON, JOB_ID, 100), 1000);
+
+  // It drops back once the demand is gone.
+  estimator.Update(3000);
+  ASSERT_EQ(estimator.IdleWorkerKillingThresholdMs(Language::PYTHON, JOB_ID, 100), 100);
+}
+
+TEST(WorkerDemandEstimatorTest, TestRemoveJob) {
+  WorkerDemandEstimator estimator(/*interval_ms=*/1000, /*alpha=*/1, /*now_ms=*/0);
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID);
+  estimator.RecordLeaseStarted(Language::JAVA, JOB_ID);
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID_2);
+  estimator.RecordLeaseStarted(Language::PYTHON, JOB_ID_2);
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID);
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID_2);
+  estimator.RecordLeaseFinished(Language::PYTHON, JOB_ID_2);
+  estimator.Update(1000);
+
+  absl::flat_hash_map<JobID, int64_t> python_targets;
+  int num_targets = 0;
+  estimator.ForEachTarget(
+      [&](const Language &language, const JobID &job_id, int64_t num_workers) {
+        num_targets++;
+        if (language == Language::PYTHON) {
+          python_targets[job_id] = num_workers;
+        }
+      });
+  ASSERT_EQ(num_targets, 3);
+  ASSERT_EQ(python_targets[JOB_ID], 1);
+  ASSERT_EQ(python_targets[JOB_ID_2], 2);
+
+  estimator.RemoveJob(JOB_ID);
+  ASSERT_FALSE(estimator.IsTracked(Language::PYTHON, JOB_ID));
+  ASSERT_FALSE(estimator.IsTracked(Language::JAVA, JOB_ID));
+  ASSERT_TRUE(estimator.IsTracked(Language::PYTHON, JOB_ID_2));
+  // The leases that finish after the job was removed don't track it again.
+  estimator.RecordLeaseFinished(Language::JAVA, JOB_ID);
+  ASSERT_FALSE(estimator.IsTracked(Language::JAVA, JOB_ID));
+}
+
+}  // namespace raylet
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,6 +18,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/filesystem.hpp>
 
+#include "absl/strings/match.h"
 #include "ray/common/constants.h"
 #include "ray/common/network_util.h"
 #include "ray/common/ray_config.h"
@@ -31,6 +32,15 @@
 
 DEFINE_stats(worker_register_time_ms, "end to end latency of register a worker process.",
              (), ({1, 10, 100, 1000, 10000}, ), ray::stats::HISTOGRAM);
+DEFINE_stats(worker_startup_latency_ms,
+             "Latency from starting a worker process until it registers, by whether the "
+             "process was forked from a zygote or started from scratch.",
+             ("StartupMode"), ({10, 50, 100, 250, 500, 1000, 2500, 5000, 10000}, ),
+             ray::stats::HISTOGRAM);
+DEFINE_stats(worker_pool_idle_worker_requests,
+             "Number of worker requests for tasks, by whether an idle worker was "
+             "available (Hit) or a new worker had to be started (Miss).",
+             ("Result"), (), ray::stats::COUNT);
 
 namespace {
 
@@ -138,6 +148,15 @@ WorkerPool::WorkerPool(instrumented_io_context &io_service, const NodeID node_id
         RayConfig::instance().kill_idle_workers_interval_ms(),
         "RayletWorkerPool.deadline_timer.kill_idle_workers");
   }
+  if (RayConfig::instance().worker_demand_prediction_enabled()) {
+    const int64_t interval_ms =
+        RayConfig::instance().worker_demand_estimation_interval_ms();
+    demand_estimator_ = std::make_unique<WorkerDemandEstimator>(
+        interval_ms, RayConfig::instance().worker_demand_ewma_alpha(), get_time_());
+    periodical_runner_.RunFnPeriodically(
+        [this] { MaintainWarmWorkerPools(); }, interval_ms,
+        "RayletWorkerPool.deadline_timer.maintain_warm_worker_pools");
+  }
 }
 
 WorkerPool::~WorkerPool() {
@@ -186,6 +205,8 @@ void WorkerPool::PopWorkerCallbackInternal(const PopWorkerCallback &callback,
   if (worker && !used) {
     // The invalid worker not used, restore it to worker pool.
     PushWorker(worker);
+  } else if (worker) {
+    RecordLeaseStarted(worker);
   }
 }
 
@@ -196,11 +217,13 @@ void WorkerPool::update_worker_startup_token_counter() {
 void WorkerPool::AddStartingWorkerProcess(
     State &state, const int workers_to_start, const rpc::WorkerType worker_type,
     const Process &proc, const std::chrono::high_resolution_clock::time_point &start,
-    const rpc::RuntimeEnvInfo &runtime_env_info) {
+    const rpc::RuntimeEnvInfo &runtime_env_info, const JobID &job_id,
+    int runtime_env_hash, bool forked_from_zygote) {
   state.starting_worker_processes.emplace(
       worker_startup_token_counter_,
       StartingWorkerProcessInfo{workers_to_start, workers_to_start, worker_type, proc,
-                                start, runtime_env_info});
+                                start, runtime_env_info, job_id, runtime_env_hash,
+                                forked_from_zygote});
   runtime_env_manager_.AddURIReference(
       kWorkerSetupTokenPrefix + std::to_string(worker_startup_token_counter_),
       runtime_env_info);
@@ -439,20 +462,37 @@ std::tuple<Process, StartupToken> WorkerPool::StartWorkerProcess(
                                   std::to_string(worker_startup_token_counter_));
   }
 
+  // Only plain Python workers can be forked from a zygote, because the zygote is
+  // started with the same command line as them.
+  const bool use_zygote =
+      RayConfig::instance().worker_zygote_enabled() && WorkerZygote::IsSupported() &&
+      language == Language::PYTHON && worker_type == rpc::WorkerType::WORKER &&
+      dynamic_options.empty() &&
+      (serialized_runtime_env_context.empty() || serialized_runtime_env_context == "{}");
+
   // Start a process and measure the startup time.
   auto start = std::chrono::high_resolution_clock::now();
-  Process proc = StartProcess(worker_command_args, env);
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-  stats::ProcessStartupTimeMs.Record(duration.count());
+  const bool forked_from_zygote =
+      use_zygote && ForkWorkerFromZygote(job_id, worker_command_args, env);
+  Process proc;
+  if (forked_from_zygote) {
+    // The forked worker's pid is only known once the zygote replies, see
+    // OnWorkerForked. Until then, the process is a placeholder.
+    proc = Process::CreateNewDummy();
+  } else {
+    proc = StartProcess(worker_command_args, env);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    stats::ProcessStartupTimeMs.Record(duration.count());
+    RAY_LOG(INFO) << "Started worker process of " << workers_to_start
+                  << " worker(s) with pid " << proc.GetId() << ", the token "
+                  << worker_startup_token_counter_;
+  }
   stats::NumWorkersStarted.Record(1);
-  RAY_LOG(INFO) << "Started worker process of " << workers_to_start
-                << " worker(s) with pid " << proc.GetId() << ", the token "
-                << worker_startup_token_counter_;
-  MonitorStartingWorkerProcess(proc, worker_startup_token_counter_, language,
-                               worker_type);
+  MonitorStartingWorkerProcess(worker_startup_token_counter_, language, worker_type);
   AddStartingWorkerProcess(state, workers_to_start, worker_type, proc, start,
-                           runtime_env_info);
+                           runtime_env_info, job_id, runtime_env_hash,
+                           forked_from_zygote);
   StartupToken worker_startup_token = worker_startup_token_counter_;
   update_worker_startup_token_counter();
   if (IsIOWorkerType(worker_type)) {
@@ -462,15 +502,14 @@ std::tuple<Process, StartupToken> WorkerPool::StartWorkerProcess(
   return {proc, worker_startup_token};
 }
 
-void WorkerPool::MonitorStartingWorkerProcess(const Process &proc,
-                                              StartupToken proc_startup_token,
+void WorkerPool::MonitorStartingWorkerProcess(StartupToken proc_startup_token,
                                               const Language &language,
                                               const rpc::WorkerType worker_type) {
   auto timer = std::make_shared<boost::asio::deadline_timer>(
       *io_service_, boost::posix_time::seconds(
                         RayConfig::instance().worker_register_timeout_seconds()));
   // Capture timer in lambda to copy it once, so that it can avoid destructing timer.
-  timer->async_wait([timer, language, proc = proc, proc_startup_token, worker_type,
+  timer->async_wait([timer, language, proc_startup_token, worker_type,
                      this](const boost::system::error_code e) mutable {
     // check the error code.
     auto &state = this->GetStateForLanguage(language);
@@ -478,6 +517,7 @@ void WorkerPool::MonitorStartingWorkerProcess(const Process &proc,
     // to avoid the zombie worker.
     auto it = state.starting_worker_processes.find(proc_startup_token);
     if (it != state.starting_worker_processes.end()) {
+      auto proc = it->second.proc;
       RAY_LOG(ERROR)
           << "Some workers of the worker process(" << proc.GetId()
           << ") have not registered within the timeout. "
@@ -515,6 +555,76 @@ void WorkerPool::MonitorStartingWorkerProcess(const Process &proc,
   });
 }
 
+bool WorkerPool::ForkWorkerFromZygote(const JobID &job_id,
+                                      const std::vector<std::string> &worker_command_args,
+                                      const ProcessEnvironment &env) {
+  auto it = zygotes_.find(job_id);
+  if (it == zygotes_.end()) {
+    // The zygote imports everything a worker does before it starts listening. Until
+    // then, workers are started from scratch.
+    std::string socket_name = "ray_worker_zygote_" + node_id_.Hex() + "_" + job_id.Hex();
+    // The zygote runs the job's worker command, without the arguments that belong to
+    // the worker that it is started for. Each forked worker gets its own startup token.
+    std::vector<std::string> zygote_command_args;
+    for (const auto &arg : worker_command_args) {
+      if (!absl::StartsWith(arg, "--startup-token=")) {
+        zygote_command_args.push_back(arg);
+      }
+    }
+    zygote_command_args.push_back("--zygote-socket=" + socket_name);
+    const auto &preload_modules = RayConfig::instance().worker_zygote_preload_modules();
+    if (!preload_modules.empty()) {
+      zygote_command_args.push_back("--zygote-preload-modules=" + preload_modules);
+    }
+    Process zygote_proc = StartProcess(zygote_command_args, env);
+    RAY_LOG(INFO) << "Started worker zygote for job " << job_id << " with pid "
+                  << zygote_proc.GetId();
+    zygotes_.emplace(job_id, std::make_shared<WorkerZygote>(
+                                 *io_service_, zygote_proc, socket_name,
+                                 RayConfig::instance().worker_zygote_fork_timeout_ms()));
+    return false;
+  }
+  auto &zygote = it->second;
+  if (!zygote->IsReady()) {
+    return false;
+  }
+  const StartupToken startup_token = worker_startup_token_counter_;
+  const auto start = std::chrono::high_resolution_clock::now();
+  zygote->ForkWorker(startup_token, [this, startup_token, start, worker_command_args,
+                                     env](Process proc) {
+    OnWorkerForked(startup_token, start, std::move(proc), worker_command_args, env);
+  });
+  return true;
+}
+
+void WorkerPool::OnWorkerForked(
+    StartupToken startup_token,
+    const std::chrono::high_resolution_clock::time_point &start, Process proc,
+    const std::vector<std::string> &worker_command_args, const ProcessEnvironment &env) {
+  auto &state = GetStateForLanguage(Language::PYTHON);
+  auto it = state.starting_worker_processes.find(startup_token);
+  if (it == state.starting_worker_processes.end()) {
+    // The forked worker registered before the reply of the zygote was handled.
+    return;
+  }
+  auto &starting_process_info = it->second;
+  if (proc.IsNull()) {
+    // The zygote failed, so start the worker from scratch.
+    proc = StartProcess(worker_command_args, env);
+    starting_process_info.forked_from_zygote = false;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  stats::ProcessStartupTimeMs.Record(duration.count());
+  RAY_LOG(INFO) << "Started worker process of "
+                << starting_process_info.num_starting_workers << " worker(s) with pid "
+                << proc.GetId() << ", the token " << startup_token
+                << (starting_process_info.forked_from_zygote
+                        ? ", forked from the job's zygote"
+                        : "");
+  starting_process_info.proc = proc;
+}
+
 Process WorkerPool::StartProcess(const std::vector<std::string> &worker_command_args,
                                  const ProcessEnvironment &env) {
   if (RAY_LOG_ENABLED(DEBUG)) {
@@ -638,6 +748,11 @@ void WorkerPool::HandleJobFinished(const JobID &job_id) {
   if (NeedToEagerInstallRuntimeEnv(*job_config)) {
     runtime_env_manager_.RemoveURIReference(job_id.Hex());
   }
+  // Kill the job's zygote. The workers it forked are handled like any other worker.
+  zygotes_.erase(job_id);
+  if (demand_estimator_ != nullptr) {
+    demand_estimator_->RemoveJob(job_id);
+  }
   finished_jobs_.insert(job_id);
 }
 
@@ -681,6 +796,8 @@ Status WorkerPool::RegisterWorker(const std::shared_ptr<WorkerInterface> &worker
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       end - starting_process_info.start_time);
   STATS_worker_register_time_ms.Record(duration.count());
+  STATS_worker_startup_latency_ms.Record(
+      duration.count(), starting_process_info.forked_from_zygote ? "Zygote" : "Exec");
   RAY_LOG(DEBUG) << "Registering worker " << worker->WorkerId() << " with pid " << pid
                  << ", port: " << port << ", register cost: " << duration.count()
                  << ", worker_type: " << rpc::WorkerType_Name(worker->GetWorkerType());
@@ -891,6 +1008,27 @@ void WorkerPool::InvokePopWorkerCallbackForProcess(
     RAY_CHECK(callback);
     *worker_used = callback(worker, status);
     starting_workers_to_tasks.erase(it);
+    if (worker && *worker_used) {
+      RecordLeaseStarted(worker);
+    }
+  }
+}
+
+void WorkerPool::RecordLeaseStarted(const std::shared_ptr<WorkerInterface> &worker) {
+  if (demand_estimator_ == nullptr || worker->GetRuntimeEnvHash() != 0 ||
+      worker->GetWorkerType() != rpc::WorkerType::WORKER) {
+    return;
+  }
+  if (demand_leased_workers_.insert(worker->WorkerId()).second) {
+    demand_estimator_->RecordLeaseStarted(worker->GetLanguage(),
+                                          worker->GetAssignedJobId());
+  }
+}
+
+void WorkerPool::RecordLeaseFinished(const std::shared_ptr<WorkerInterface> &worker) {
+  if (demand_leased_workers_.erase(worker->WorkerId())) {
+    demand_estimator_->RecordLeaseFinished(worker->GetLanguage(),
+                                           worker->GetAssignedJobId());
   }
 }
 
@@ -898,6 +1036,7 @@ void WorkerPool::PushWorker(const std::shared_ptr<WorkerInterface> &worker) {
   // Since the worker is now idle, unset its assigned task ID.
   RAY_CHECK(worker->GetAssignedTaskId().IsNil())
       << "Idle workers cannot have an assigned task ID";
+  RecordLeaseFinished(worker);
   auto &state = GetStateForLanguage(worker->GetLanguage());
   bool found;
   bool used;
@@ -942,15 +1081,86 @@ void WorkerPool::TryKillingIdleWorkers() {
   // idle workers that it needs to.
   RAY_CHECK(running_size >= pending_exit_idle_workers_.size());
   running_size -= pending_exit_idle_workers_.size();
-  // Kill idle workers in FIFO order.
+
+  // Count the idle workers of each job and runtime env beyond the allowed number.
+  // These are killed even if the soft limit is not reached, so that warm pools of
+  // runtime envs that are no longer used don't hold on to memory.
+  absl::flat_hash_map<JobID, absl::flat_hash_map<int, int64_t>> num_excess_idle_workers;
+  int64_t total_num_excess_idle_workers = 0;
+  const int64_t max_idle_workers_per_runtime_env =
+      RayConfig::instance().max_idle_workers_per_runtime_env();
+  if (max_idle_workers_per_runtime_env > 0) {
+    for (const auto &idle_pair : idle_of_all_languages_) {
+      const auto &worker = idle_pair.first;
+      if (worker->GetRuntimeEnvHash() != 0 && !worker->IsDead() &&
+          !pending_exit_idle_workers_.count(worker->WorkerId())) {
+        num_excess_idle_workers[worker->GetAssignedJobId()]
+                               [worker->GetRuntimeEnvHash()]++;
+      }
+    }
+    for (auto &job_entry : num_excess_idle_workers) {
+      for (auto &env_entry : job_entry.second) {
+        env_entry.second -= max_idle_workers_per_runtime_env;
+        total_num_excess_idle_workers += std::max<int64_t>(env_entry.second, 0);
+      }
+    }
+  }
+  // Likewise, count the idle workers without a runtime env of each job beyond its
+  // predicted demand. The most recently used workers within the predicted demand are
+  // kept warm, even if the soft limit is exceeded.
+  absl::flat_hash_map<Language, absl::flat_hash_map<JobID, int64_t>, std::hash<int>>
+      num_unpredicted_idle_workers;
+  if (demand_estimator_ != nullptr) {
+    for (const auto &idle_pair : idle_of_all_languages_) {
+      const auto &worker = idle_pair.first;
+      if (worker->GetRuntimeEnvHash() == 0 && !worker->IsDead() &&
+          !pending_exit_idle_workers_.count(worker->WorkerId()) &&
+          demand_estimator_->IsTracked(worker->GetLanguage(),
+                                       worker->GetAssignedJobId())) {
+        num_unpredicted_idle_workers[worker->GetLanguage()]
+                                    [worker->GetAssignedJobId()]++;
+      }
+    }
+    for (auto &lang_entry : num_unpredicted_idle_workers) {
+      for (auto &job_entry : lang_entry.second) {
+        job_entry.second -=
+            demand_estimator_->TargetWarmWorkers(lang_entry.first, job_entry.first);
+        total_num_excess_idle_workers += std::max<int64_t>(job_entry.second, 0);
+      }
+    }
+  }
+
+  // Kill idle workers in FIFO order, which is least recently used first.
   for (const auto &idle_pair : idle_of_all_languages_) {
     const auto &idle_worker = idle_pair.first;
     const auto &job_id = idle_worker->GetAssignedJobId();
+    int64_t *num_excess = nullptr;
+    auto excess_it = num_excess_idle_workers.find(job_id);
+    if (excess_it != num_excess_idle_workers.end()) {
+      auto env_it = excess_it->second.find(idle_worker->GetRuntimeEnvHash());
+      if (env_it != excess_it->second.end() && env_it->second > 0) {
+        num_excess = &env_it->second;
+      }
+    }
+    auto lang_it = num_unpredicted_idle_workers.find(idle_worker->GetLanguage());
+    if (lang_it != num_unpredicted_idle_workers.end()) {
+      auto it = lang_it->second.find(job_id);
+      if (it != lang_it->second.end() && idle_worker->GetRuntimeEnvHash() == 0) {
+        if (it->second <= 0) {
+          // Keep the worker warm for the predicted demand of its job.
+          continue;
+        }
+        num_excess = &it->second;
+      }
+    }
     if (running_size <= static_cast<size_t>(num_workers_soft_limit_)) {
-      if (!finished_jobs_.count(job_id)) {
+      if (!finished_jobs_.count(job_id) && num_excess == nullptr) {
         // Ignore the soft limit for jobs that have already finished, as we
         // should always clean up these workers.
-        break;
+        if (total_num_excess_idle_workers == 0) {
+          break;
+        }
+        continue;
       }
     }
 
@@ -958,6 +1168,11 @@ void WorkerPool::TryKillingIdleWorkers() {
         RayConfig::instance().idle_worker_killing_time_threshold_ms()) {
       break;
     }
+    if (now - idle_pair.second < IdleWorkerKillingThresholdMs(*idle_worker)) {
+      // The job of the worker is predicted to use more workers, so keep it a
+      // while longer.
+      continue;
+    }
 
     if (idle_worker->IsDead()) {
       // This worker has already been killed.
@@ -982,7 +1197,7 @@ void WorkerPool::TryKillingIdleWorkers() {
     for (const auto &worker : workers_in_the_same_process) {
       if (worker_state.idle.count(worker) == 0 ||
           now - idle_of_all_languages_map_[worker] <
-              RayConfig::instance().idle_worker_killing_time_threshold_ms()) {
+              IdleWorkerKillingThresholdMs(*worker)) {
         // Another worker in this process isn't idle, or hasn't been idle for a while, so
         // this process can't be killed.
         can_be_killed = false;
@@ -1005,12 +1220,19 @@ void WorkerPool::TryKillingIdleWorkers() {
         static_cast<size_t>(num_workers_soft_limit_)) {
       // A Java worker process may contain multiple workers. Killing more workers than we
       // expect may slow the job.
-      if (!finished_jobs_.count(job_id)) {
+      if (!finished_jobs_.count(job_id) && num_excess == nullptr) {
         // Ignore the soft limit for jobs that have already finished, as we
         // should always clean up these workers.
-        return;
+        if (total_num_excess_idle_workers == 0) {
+          return;
+        }
+        continue;
       }
     }
+    if (num_excess != nullptr) {
+      (*num_excess)--;
+      total_num_excess_idle_workers--;
+    }
 
     for (const auto &worker : workers_in_the_same_process) {
       RAY_LOG(DEBUG) << "The worker pool has " << running_size
@@ -1080,6 +1302,59 @@ void WorkerPool::TryKillingIdleWorkers() {
   RAY_CHECK(idle_of_all_languages_.size() == idle_of_all_languages_map_.size());
 }
 
+int64_t WorkerPool::IdleWorkerKillingThresholdMs(const WorkerInterface &worker) const {
+  const int64_t threshold_ms =
+      RayConfig::instance().idle_worker_killing_time_threshold_ms();
+  if (demand_estimator_ == nullptr || worker.GetRuntimeEnvHash() != 0) {
+    return threshold_ms;
+  }
+  return demand_estimator_->IdleWorkerKillingThresholdMs(
+      worker.GetLanguage(), worker.GetAssignedJobId(), threshold_ms);
+}
+
+void WorkerPool::MaintainWarmWorkerPools() {
+  if (demand_estimator_ == nullptr) {
+    return;
+  }
+  demand_estimator_->Update(get_time_());
+  demand_estimator_->ForEachTarget([this](const Language &language, const JobID &job_id,
+                                          int64_t num_desired_workers) {
+    if (finished_jobs_.contains(job_id) || !states_by_lang_.contains(language)) {
+      return;
+    }
+    num_desired_workers =
+        std::min<int64_t>(num_desired_workers, num_workers_soft_limit_);
+    auto &state = GetStateForLanguage(language);
+    int64_t num_warm_workers = 0;
+    for (const auto &worker : state.idle) {
+      if (worker->GetAssignedJobId() == job_id && worker->GetRuntimeEnvHash() == 0 &&
+          !worker->IsDead() && !pending_exit_idle_workers_.count(worker->WorkerId())) {
+        num_warm_workers++;
+      }
+    }
+    for (const auto &entry : state.starting_worker_processes) {
+      if (entry.second.job_id == job_id && entry.second.runtime_env_hash == 0 &&
+          entry.second.worker_type == rpc::WorkerType::WORKER) {
+        num_warm_workers += entry.second.num_starting_workers;
+      }
+    }
+    if (num_warm_workers >= num_desired_workers) {
+      return;
+    }
+    int64_t num_needed = num_desired_workers - num_warm_workers;
+    RAY_LOG(DEBUG) << "Prestarting " << num_needed << " " << Language_Name(language)
+                   << " workers for job " << job_id << " given its predicted demand of "
+                   << demand_estimator_->PredictedDemand(language, job_id);
+    for (int64_t i = 0; i < num_needed; i++) {
+      PopWorkerStatus status;
+      StartWorkerProcess(language, rpc::WorkerType::WORKER, job_id, &status);
+      if (status != PopWorkerStatus::OK) {
+        break;
+      }
+    }
+  });
+}
+
 void WorkerPool::PopWorker(const TaskSpecification &task_spec,
                            const PopWorkerCallback &callback,
                            const std::string &allocated_instances_serialized_json) {
@@ -1101,7 +1376,8 @@ void WorkerPool::PopWorker(const TaskSpecification &task_spec,
         dynamic_options, task_spec.GetRuntimeEnvHash(), serialized_runtime_env_context,
         allocated_instances_serialized_json, task_spec.RuntimeEnvInfo());
     if (status == PopWorkerStatus::OK) {
-      RAY_CHECK(proc.IsValid());
+      // A worker forked from a zygote has no pid until the zygote replies.
+      RAY_CHECK(!proc.IsNull());
       WarnAboutSize();
       auto task_info = TaskWaitingForWorkerInfo{task_spec.TaskId(), callback};
       if (dedicated) {
@@ -1166,21 +1442,9 @@ void WorkerPool::PopWorker(const TaskSpecification &task_spec,
     // Find an available worker which is already assigned to this job and which has
     // the specified runtime env.
     // Try to pop the most recently pushed worker.
-    const int runtime_env_hash = task_spec.GetRuntimeEnvHash();
     for (auto it = idle_of_all_languages_.rbegin(); it != idle_of_all_languages_.rend();
          it++) {
-      if (task_spec.GetLanguage() != it->first->GetLanguage() ||
-          it->first->GetAssignedJobId() != task_spec.JobId() ||
-          state.pending_disconnection_workers.count(it->first) > 0 ||
-          it->first->IsDead()) {
-        continue;
-      }
-      // These workers are exiting. So skip them.
-      if (pending_exit_idle_workers_.count(it->first->WorkerId())) {
-        continue;
-      }
-      // Skip if the runtime env doesn't match.
-      if (runtime_env_hash != it->first->GetRuntimeEnvHash()) {
+      if (!CanPopIdleWorker(it->first, task_spec, state)) {
         continue;
       }
 
@@ -1194,6 +1458,13 @@ void WorkerPool::PopWorker(const TaskSpecification &task_spec,
       break;
     }
 
+    if (worker != nullptr) {
+      num_idle_worker_hits_++;
+      STATS_worker_pool_idle_worker_requests.Record(1, "Hit");
+    } else {
+      num_idle_worker_misses_++;
+      STATS_worker_pool_idle_worker_requests.Record(1, "Miss");
+    }
     if (worker == nullptr) {
       // There are no more non-actor workers available to execute this task.
       // Start a new worker process.
@@ -1228,14 +1499,49 @@ void WorkerPool::PopWorker(const TaskSpecification &task_spec,
   }
 }
 
+size_t WorkerPool::NumIdleWorkersForTask(const TaskSpecification &task_spec) {
+  const auto &state = GetStateForLanguage(task_spec.GetLanguage());
+  if (task_spec.IsActorCreationTask() && !task_spec.DynamicWorkerOptions().empty()) {
+    return state.idle_dedicated_workers.count(task_spec.TaskId());
+  }
+  size_t num_idle = 0;
+  for (const auto &idle_pair : idle_of_all_languages_) {
+    if (CanPopIdleWorker(idle_pair.first, task_spec, state)) {
+      num_idle++;
+    }
+  }
+  return num_idle;
+}
+
+bool WorkerPool::CanPopIdleWorker(const std::shared_ptr<WorkerInterface> &worker,
+                                  const TaskSpecification &task_spec,
+                                  const State &state) const {
+  if (task_spec.GetLanguage() != worker->GetLanguage() ||
+      worker->GetAssignedJobId() != task_spec.JobId() ||
+      state.pending_disconnection_workers.count(worker) > 0 || worker->IsDead()) {
+    return false;
+  }
+  // These workers are exiting. So skip them.
+  if (pending_exit_idle_workers_.count(worker->WorkerId())) {
+    return false;
+  }
+  // Skip if the runtime env doesn't match.
+  return task_spec.GetRuntimeEnvHash() == worker->GetRuntimeEnvHash();
+}
+
 void WorkerPool::PrestartWorkers(const TaskSpecification &task_spec, int64_t backlog_size,
                                  int64_t num_available_cpus) {
   // Code path of task that needs a dedicated worker.
-  if ((task_spec.IsActorCreationTask() && !task_spec.DynamicWorkerOptions().empty()) ||
-      task_spec.HasRuntimeEnv()) {
+  if (task_spec.IsActorCreationTask() && !task_spec.DynamicWorkerOptions().empty()) {
     return;  // Not handled.
-    // TODO(architkulkarni): We'd eventually like to prestart workers with the same
-    // runtime env to improve initial startup performance.
+  }
+
+  // Some existing workers may be holding less than 1 CPU each, so we should
+  // start as many workers as needed to fill up the remaining CPUs.
+  auto desired_usable_workers = std::min<int64_t>(num_available_cpus, backlog_size);
+  if (task_spec.HasRuntimeEnv()) {
+    PrestartRuntimeEnvWorkers(task_spec, desired_usable_workers);
+    return;
   }
 
   auto &state = GetStateForLanguage(task_spec.GetLanguage());
@@ -1244,9 +1550,6 @@ void WorkerPool::PrestartWorkers(const TaskSpecification &task_spec, int64_t bac
   for (auto &entry : state.starting_worker_processes) {
     num_usable_workers += entry.second.num_starting_workers;
   }
-  // Some existing workers may be holding less than 1 CPU each, so we should
-  // start as many workers as needed to fill up the remaining CPUs.
-  auto desired_usable_workers = std::min<int64_t>(num_available_cpus, backlog_size);
   if (num_usable_workers < desired_usable_workers) {
     // Account for workers that are idle or already starting.
     int64_t num_needed = desired_usable_workers - num_usable_workers;
@@ -1260,9 +1563,81 @@ void WorkerPool::PrestartWorkers(const TaskSpecification &task_spec, int64_t bac
   }
 }
 
+void WorkerPool::PrestartRuntimeEnvWorkers(const TaskSpecification &task_spec,
+                                           int64_t num_desired_workers) {
+  const int64_t max_idle_workers =
+      RayConfig::instance().max_idle_workers_per_runtime_env();
+  if (max_idle_workers > 0) {
+    // Don't prestart workers that would be killed as soon as they are idle.
+    num_desired_workers = std::min(num_desired_workers, max_idle_workers);
+  }
+
+  // Only workers of the same job and runtime env can run the task.
+  const JobID job_id = task_spec.JobId();
+  const int runtime_env_hash = task_spec.GetRuntimeEnvHash();
+  auto &state = GetStateForLanguage(task_spec.GetLanguage());
+  int64_t num_usable_workers = 0;
+  for (const auto &worker : state.idle) {
+    if (worker->GetAssignedJobId() == job_id &&
+        worker->GetRuntimeEnvHash() == runtime_env_hash) {
+      num_usable_workers++;
+    }
+  }
+  for (const auto &entry : state.starting_worker_processes) {
+    if (entry.second.job_id == job_id &&
+        entry.second.runtime_env_hash == runtime_env_hash &&
+        entry.second.worker_type == rpc::WorkerType::WORKER) {
+      num_usable_workers += entry.second.num_starting_workers;
+    }
+  }
+  auto job_it = num_prestarting_runtime_env_workers_.find(job_id);
+  if (job_it != num_prestarting_runtime_env_workers_.end()) {
+    auto it = job_it->second.find(runtime_env_hash);
+    if (it != job_it->second.end()) {
+      num_usable_workers += it->second;
+    }
+  }
+  if (num_usable_workers >= num_desired_workers) {
+    return;
+  }
+
+  int64_t num_needed = num_desired_workers - num_usable_workers;
+  RAY_LOG(DEBUG) << "Prestarting " << num_needed << " workers for job " << job_id
+                 << " with runtime env hash " << runtime_env_hash;
+  num_prestarting_runtime_env_workers_[job_id][runtime_env_hash] += num_needed;
+  for (int64_t i = 0; i < num_needed; i++) {
+    // Create the runtime env for each worker, as PopWorker does, so that the runtime
+    // env agent counts a reference for each of them.
+    CreateRuntimeEnv(
+        task_spec.SerializedRuntimeEnv(), job_id,
+        [this, task_spec, job_id, runtime_env_hash](
+            bool successful, const std::string &serialized_runtime_env_context) {
+          auto job_it = num_prestarting_runtime_env_workers_.find(job_id);
+          RAY_CHECK(job_it != num_prestarting_runtime_env_workers_.end());
+          auto it = job_it->second.find(runtime_env_hash);
+          RAY_CHECK(it != job_it->second.end());
+          if (--it->second == 0) {
+            job_it->second.erase(it);
+            if (job_it->second.empty()) {
+              num_prestarting_runtime_env_workers_.erase(job_it);
+            }
+          }
+          if (!successful || finished_jobs_.contains(job_id)) {
+            return;
+          }
+          PopWorkerStatus status;
+          StartWorkerProcess(task_spec.GetLanguage(), rpc::WorkerType::WORKER, job_id,
+                             &status, /*dynamic_options=*/{}, runtime_env_hash,
+                             serialized_runtime_env_context, "{}",
+                             task_spec.RuntimeEnvInfo());
+        });
+  }
+}
+
 bool WorkerPool::DisconnectWorker(const std::shared_ptr<WorkerInterface> &worker,
                                   rpc::WorkerExitType disconnect_type) {
   runtime_env_manager_.RemoveURIReference(worker->WorkerId().Hex());
+  RecordLeaseFinished(worker);
   auto &state = GetStateForLanguage(worker->GetLanguage());
   RAY_CHECK(RemoveWorker(state.registered_workers, worker));
   RAY_UNUSED(RemoveWorker(state.pending_disconnection_workers, worker));
@@ -1480,6 +1855,8 @@ std::string WorkerPool::DebugString() const {
            << entry.second.util_io_worker_state.pending_io_tasks.size();
   }
   result << "\n- num idle workers: " << idle_of_all_languages_.size();
+  result << "\n- num idle worker hits: " << num_idle_worker_hits_;
+  result << "\n- num idle worker misses: " << num_idle_worker_misses_;
   result << "\n" << runtime_env_manager_.DebugString();
   return result.str();
 }
@@ -34,6 +34,8 @@
 #include "ray/gcs/gcs_client/gcs_client.h"
 #include "ray/raylet/agent_manager.h"
 #include "ray/raylet/worker.h"
+#include "ray/raylet/worker_demand_estimator.h"
+#include "ray/raylet/worker_zygote.h"
 
 namespace ray {
 
@@ -96,6 +98,14 @@ class WorkerPoolInterface {
   virtual void PopWorker(
       const TaskSpecification &task_spec, const PopWorkerCallback &callback,
       const std::string &allocated_instances_serialized_json = "{}") = 0;
+
+  /// Get the number of idle workers that PopWorker could hand to the given task
+  /// without starting a new worker process.
+  ///
+  /// \param task_spec The task that the workers would be popped for.
+  /// \return The number of such idle workers.
+  virtual size_t NumIdleWorkersForTask(const TaskSpecification &task_spec) = 0;
+
   /// Add an idle worker to the pool.
   ///
   /// \param The idle worker to add.
@@ -324,6 +334,9 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   void PopWorker(const TaskSpecification &task_spec, const PopWorkerCallback &callback,
                  const std::string &allocated_instances_serialized_json = "{}");
 
+  /// See interface.
+  size_t NumIdleWorkersForTask(const TaskSpecification &task_spec);
+
   /// Try to prestart a number of workers suitable the given task spec. Prestarting
   /// is needed since core workers request one lease at a time, if starting is slow,
   /// then it means it takes a long time to scale up.
@@ -331,7 +344,9 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   /// \param task_spec The returned worker must be able to execute this task.
   /// \param backlog_size The number of tasks in the client backlog of this shape.
   /// \param num_available_cpus The number of CPUs that are currently unused.
-  /// We aim to prestart 1 worker per CPU, up to the the backlog size.
+  /// We aim to prestart 1 worker per CPU, up to the the backlog size. For tasks with a
+  /// runtime env, only workers of the same job and runtime env are counted, and at
+  /// most `max_idle_workers_per_runtime_env` workers are prestarted.
   void PrestartWorkers(const TaskSpecification &task_spec, int64_t backlog_size,
                        int64_t num_available_cpus);
 
@@ -385,6 +400,16 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   /// reasonable size.
   void TryKillingIdleWorkers();
 
+  /// How long the worker must have been idle before it can be killed. Without demand
+  /// prediction, this is `idle_worker_killing_time_threshold_ms`. With it, the idle
+  /// workers of jobs that are predicted to use more workers are kept longer.
+  int64_t IdleWorkerKillingThresholdMs(const WorkerInterface &worker) const;
+
+  /// Update the predicted demand of each job and prestart workers for the jobs whose
+  /// leased, idle and starting workers are fewer than the predicted demand. This is a
+  /// no-op unless `worker_demand_prediction_enabled` is set.
+  void MaintainWarmWorkerPools();
+
  protected:
   void update_worker_startup_token_counter();
 
@@ -468,6 +493,12 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
     std::chrono::high_resolution_clock::time_point start_time;
     /// The runtime env Info.
     rpc::RuntimeEnvInfo runtime_env_info;
+    /// The job that the worker process belongs to.
+    JobID job_id;
+    /// The hash of the runtime env of the worker process.
+    int runtime_env_hash;
+    /// Whether the worker process was forked from a zygote.
+    bool forked_from_zygote;
   };
 
   struct TaskWaitingForWorkerInfo {
@@ -533,13 +564,17 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   /// for a given language.
   State &GetStateForLanguage(const Language &language);
 
+  /// Whether an idle non-actor worker can be popped for the given task.
+  bool CanPopIdleWorker(const std::shared_ptr<WorkerInterface> &worker,
+                        const TaskSpecification &task_spec, const State &state) const;
+
   /// Start a timer to monitor the starting worker process.
   ///
   /// If any workers in this process don't register within the timeout
   /// (due to worker process crash or any other reasons), remove them
   /// from `starting_worker_processes`. Otherwise if we'll mistakenly
   /// think there are unregistered workers, and won't start new workers.
-  void MonitorStartingWorkerProcess(const Process &proc, StartupToken proc_startup_token,
+  void MonitorStartingWorkerProcess(StartupToken proc_startup_token,
                                     const Language &language,
                                     const rpc::WorkerType worker_type);
 
@@ -619,6 +654,13 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
       const PopWorkerStatus &status, bool *found /* output */,
       bool *worker_used /* output */, TaskID *task_id /* output */);
 
+  /// Record that a worker was leased to a task, for the demand prediction of its job.
+  /// Only workers without a runtime env are counted.
+  void RecordLeaseStarted(const std::shared_ptr<WorkerInterface> &worker);
+
+  /// Record that a worker counted by `RecordLeaseStarted` was returned or died.
+  void RecordLeaseFinished(const std::shared_ptr<WorkerInterface> &worker);
+
   /// Create runtime env asynchronously by runtime env agent.
   void CreateRuntimeEnv(
       const std::string &serialized_runtime_env, const JobID &job_id,
@@ -628,7 +670,44 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   void AddStartingWorkerProcess(
       State &state, const int workers_to_start, const rpc::WorkerType worker_type,
       const Process &proc, const std::chrono::high_resolution_clock::time_point &start,
-      const rpc::RuntimeEnvInfo &runtime_env_info);
+      const rpc::RuntimeEnvInfo &runtime_env_info, const JobID &job_id,
+      int runtime_env_hash, bool forked_from_zygote);
+
+  /// Prestart workers for a task with a runtime env, so that they are kept warm in
+  /// the idle pool of the task's job and runtime env.
+  ///
+  /// \param task_spec The task that the workers should be able to run.
+  /// \param num_desired_workers The number of workers that should be idle or starting
+  /// for the task's job and runtime env.
+  void PrestartRuntimeEnvWorkers(const TaskSpecification &task_spec,
+                                 int64_t num_desired_workers);
+
+  /// Ask the zygote of its job to fork the worker with the current startup token.
+  /// Starts the zygote on the first call for a job, with the same command as the
+  /// worker except for the startup token.
+  ///
+  /// \param job_id The job of the worker.
+  /// \param worker_command_args The command that would start the worker without a
+  /// zygote.
+  /// \param env The environment that would be set on the worker.
+  /// \return Whether the fork was requested. If not, because the zygote is not ready
+  /// or failed, the worker should be started without it.
+  bool ForkWorkerFromZygote(const JobID &job_id,
+                            const std::vector<std::string> &worker_command_args,
+                            const ProcessEnvironment &env);
+
+  /// Record the process of a worker that was forked from a zygote, or start the worker
+  /// from scratch if the fork failed.
+  ///
+  /// \param startup_token The startup token of the worker.
+  /// \param start When the fork was requested.
+  /// \param proc The forked process, or a null process if the fork failed.
+  /// \param worker_command_args The command to start the worker without a zygote.
+  /// \param env The environment to set on the worker without a zygote.
+  void OnWorkerForked(StartupToken startup_token,
+                      const std::chrono::high_resolution_clock::time_point &start,
+                      Process proc, const std::vector<std::string> &worker_command_args,
+                      const ProcessEnvironment &env);
 
   void RemoveStartingWorkerProcess(State &state, const StartupToken &proc_startup_token);
 
@@ -688,9 +767,25 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   absl::flat_hash_map<WorkerID, std::shared_ptr<WorkerInterface>>
       pending_exit_idle_workers_;
 
+  /// The number of prestarted workers whose runtime envs are still being created,
+  /// by job and runtime env hash.
+  absl::flat_hash_map<JobID, absl::flat_hash_map<int, int64_t>>
+      num_prestarting_runtime_env_workers_;
+
   /// The runner to run function periodically.
   PeriodicalRunner periodical_runner_;
 
+  /// The worker zygotes of Python jobs, if zygotes are enabled. A zygote that failed is
+  /// kept until its job finishes, so that it is not restarted.
+  absl::flat_hash_map<JobID, std::shared_ptr<WorkerZygote>> zygotes_;
+
+  /// The predicted demand for workers without a runtime env, by language and job. Null
+  /// if `worker_demand_prediction_enabled` is not set.
+  std::unique_ptr<WorkerDemandEstimator> demand_estimator_;
+
+  /// The leased workers that are counted in the demand of their job.
+  absl::flat_hash_set<WorkerID> demand_leased_workers_;
+
   /// A callback to get the current time.
   const std::function<double()> get_time_;
   /// Agent manager.
@@ -841,6 +936,8 @@ class WorkerPool : public WorkerPoolInterface, public IOWorkerPoolInterface {
   int64_t process_failed_rate_limited_ = 0;
   int64_t process_failed_pending_registration_ = 0;
   int64_t process_failed_runtime_env_setup_failed_ = 0;
+  int64_t num_idle_worker_hits_ = 0;
+  int64_t num_idle_worker_misses_ = 0;
 
   friend class WorkerPoolTest;
 };
@@ -30,6 +30,7 @@ int NUM_WORKERS_PER_PROCESS_JAVA = 3;
 int MAXIMUM_STARTUP_CONCURRENCY = 5;
 int MAX_IO_WORKER_SIZE = 2;
 int POOL_SIZE_SOFT_LIMIT = 5;
+int MAX_IDLE_WORKERS_PER_RUNTIME_ENV = 2;
 int WORKER_REGISTER_TIMEOUT_SECONDS = 3;
 JobID JOB_ID = JobID::FromInt(1);
 std::string BAD_RUNTIME_ENV = "bad runtime env";
@@ -363,7 +364,9 @@ class WorkerPoolTest : public ::testing::Test {
         R"({"worker_register_timeout_seconds": )" +
         std::to_string(WORKER_REGISTER_TIMEOUT_SECONDS) +
         R"(, "object_spilling_config": "dummy", "max_io_workers": )" +
-        std::to_string(MAX_IO_WORKER_SIZE) + "}");
+        std::to_string(MAX_IO_WORKER_SIZE) +
+        R"(, "max_idle_workers_per_runtime_env": )" +
+        std::to_string(MAX_IDLE_WORKERS_PER_RUNTIME_ENV) + "}");
     SetWorkerCommands({{Language::PYTHON, {"dummy_py_worker_command"}},
                        {Language::JAVA,
                         {"java", "RAY_WORKER_DYNAMIC_OPTION_PLACEHOLDER", "MainClass"}}});
@@ -622,6 +625,36 @@ TEST_F(WorkerPoolTest, TestPrestartingWorkers) {
   ASSERT_EQ(worker_pool_->NumWorkerProcessesStarting(), 5);
 }
 
+TEST_F(WorkerPoolTest, TestPrestartingWorkersWithRuntimeEnv) {
+  const auto task_spec =
+      ExampleTaskSpec(ActorID::Nil(), Language::PYTHON, JOB_ID, ActorID::Nil(), {},
+                      TaskID::FromRandom(JobID::Nil()), ExampleRuntimeEnvInfo({"XXX"}));
+  // Prestarts 1 worker with the runtime env.
+  worker_pool_->PrestartWorkers(task_spec, 1, /*num_available_cpus=*/5);
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 1);
+  // Capped by the number of idle workers to keep for each runtime env.
+  worker_pool_->PrestartWorkers(task_spec, 20, /*num_available_cpus=*/5);
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV);
+  // Workers with another runtime env are not counted.
+  const auto other_task_spec =
+      ExampleTaskSpec(ActorID::Nil(), Language::PYTHON, JOB_ID, ActorID::Nil(), {},
+                      TaskID::FromRandom(JobID::Nil()), ExampleRuntimeEnvInfo({"YYY"}));
+  worker_pool_->PrestartWorkers(other_task_spec, 1, /*num_available_cpus=*/5);
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV + 1);
+
+  // The prestarted workers can run tasks with the same runtime env without starting
+  // new workers.
+  worker_pool_->PushWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV + 1);
+  auto worker = worker_pool_->PopWorkerSync(task_spec, /*push_workers=*/false);
+  ASSERT_NE(worker, nullptr);
+  ASSERT_EQ(worker->GetRuntimeEnvHash(), task_spec.GetRuntimeEnvHash());
+  worker = worker_pool_->PopWorkerSync(other_task_spec, /*push_workers=*/false);
+  ASSERT_NE(worker, nullptr);
+  ASSERT_EQ(worker->GetRuntimeEnvHash(), other_task_spec.GetRuntimeEnvHash());
+  ASSERT_EQ(worker_pool_->GetProcessSize(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV + 1);
+}
+
 TEST_F(WorkerPoolTest, HandleWorkerPushPop) {
   std::shared_ptr<WorkerInterface> popped_worker;
   const auto task_spec = ExampleTaskSpec();
@@ -769,6 +802,29 @@ TEST_F(WorkerPoolTest, PopWorkerMultiTenancy) {
   }
 }
 
+TEST_F(WorkerPoolTest, NumIdleWorkersForTask) {
+  auto job_id2 = JobID::FromInt(2);
+  RegisterDriver(Language::PYTHON, job_id2);
+  for (int i = 0; i < 2; i++) {
+    worker_pool_->PushWorker(
+        worker_pool_->CreateWorker(Process::CreateNewDummy(), Language::PYTHON, JOB_ID));
+  }
+  worker_pool_->PushWorker(
+      worker_pool_->CreateWorker(Process::CreateNewDummy(), Language::PYTHON, job_id2));
+
+  auto task_spec = ExampleTaskSpec(ActorID::Nil(), Language::PYTHON, JOB_ID);
+  ASSERT_EQ(worker_pool_->NumIdleWorkersForTask(task_spec), 2);
+  auto task_spec2 = ExampleTaskSpec(ActorID::Nil(), Language::PYTHON, job_id2);
+  ASSERT_EQ(worker_pool_->NumIdleWorkersForTask(task_spec2), 1);
+  ASSERT_EQ(worker_pool_->NumIdleWorkersForTask(
+                ExampleTaskSpec(ActorID::Nil(), Language::JAVA, JOB_ID)),
+            0);
+
+  // Popped workers are no longer idle.
+  ASSERT_NE(worker_pool_->PopWorkerSync(task_spec), nullptr);
+  ASSERT_EQ(worker_pool_->NumIdleWorkersForTask(task_spec), 1);
+}
+
 TEST_F(WorkerPoolTest, MaximumStartupConcurrency) {
   auto task_spec = ExampleTaskSpec();
   std::vector<Process> started_processes;
@@ -1229,6 +1285,177 @@ TEST_F(WorkerPoolTest, TestWorkerCapping) {
   worker_pool_->ClearProcesses();
 }
 
+TEST_F(WorkerPoolTest, TestWorkerCappingWithRuntimeEnv) {
+  const auto task_spec =
+      ExampleTaskSpec(ActorID::Nil(), Language::PYTHON, JOB_ID, ActorID::Nil(), {},
+                      TaskID::FromRandom(JobID::Nil()), ExampleRuntimeEnvInfo({"XXX"}));
+  // Start fewer workers than the soft limit, but more than the number of idle workers
+  // to keep for the runtime env.
+  std::vector<std::shared_ptr<WorkerInterface>> workers;
+  int num_workers = POOL_SIZE_SOFT_LIMIT - 1;
+  for (int i = 0; i < num_workers; i++) {
+    auto worker = worker_pool_->PopWorkerSync(task_spec);
+    ASSERT_NE(worker, nullptr);
+    workers.push_back(worker);
+  }
+  for (const auto &worker : workers) {
+    worker_pool_->PushWorker(worker);
+  }
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), num_workers);
+
+  // The workers haven't been idle for long enough.
+  worker_pool_->TryKillingIdleWorkers();
+  for (const auto &worker : workers) {
+    ASSERT_FALSE(mock_worker_rpc_clients_[worker->WorkerId()]->ExitReplySucceed());
+  }
+
+  // The least recently used workers beyond the limit are killed, even though the
+  // soft limit is not reached.
+  worker_pool_->SetCurrentTimeMs(2000);
+  worker_pool_->TryKillingIdleWorkers();
+  for (int i = 0; i < num_workers; i++) {
+    ASSERT_EQ(mock_worker_rpc_clients_[workers[i]->WorkerId()]->ExitReplySucceed(),
+              i < num_workers - MAX_IDLE_WORKERS_PER_RUNTIME_ENV);
+  }
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV);
+
+  // The rest are kept warm.
+  worker_pool_->SetCurrentTimeMs(4000);
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), MAX_IDLE_WORKERS_PER_RUNTIME_ENV);
+  for (const auto &idle_pair : worker_pool_->GetIdleWorkers()) {
+    ASSERT_FALSE(
+        mock_worker_rpc_clients_[idle_pair.first->WorkerId()]->ExitReplySucceed());
+  }
+}
+
+TEST_F(WorkerPoolTest, TestWarmWorkerPoolFollowsPredictedDemand) {
+  RayConfig::instance().initialize(
+      R"({"worker_demand_prediction_enabled": true, )"
+      R"("worker_demand_estimation_interval_ms": 100000, )"
+      R"("worker_demand_ewma_alpha": 1})");
+  SetWorkerCommands({{Language::PYTHON, {"dummy_py_worker_command"}}});
+  const auto task_spec = ExampleTaskSpec();
+
+  // Two tasks lease workers at once. No idle workers are available for them.
+  std::vector<std::shared_ptr<WorkerInterface>> busy_workers;
+  for (int i = 0; i < 2; i++) {
+    auto worker = worker_pool_->PopWorkerSync(task_spec);
+    ASSERT_NE(worker, nullptr);
+    busy_workers.push_back(worker);
+  }
+  ASSERT_NE(worker_pool_->DebugString().find("num idle worker misses: 2"),
+            std::string::npos);
+
+  // The job is predicted to use 2 workers at once in the next interval. Both are
+  // leased already, so no worker is prestarted.
+  worker_pool_->SetCurrentTimeMs(100000);
+  worker_pool_->MaintainWarmWorkerPools();
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 0);
+
+  // One of the workers dies while leased and the other one is returned, so a worker is
+  // prestarted to replace the dead one.
+  worker_pool_->DisconnectWorker(
+      busy_workers[0], /*disconnect_type=*/rpc::WorkerExitType::SYSTEM_ERROR_EXIT);
+  worker_pool_->PushWorker(busy_workers[1]);
+  worker_pool_->MaintainWarmWorkerPools();
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 1);
+  worker_pool_->PushWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), 2);
+  worker_pool_->MaintainWarmWorkerPools();
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 0);
+
+  // The next request is served by a warm worker.
+  worker_pool_->SetCurrentTimeMs(200000);
+  worker_pool_->MaintainWarmWorkerPools();
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 0);
+  auto warm_worker = worker_pool_->PopWorkerSync(task_spec);
+  ASSERT_NE(warm_worker, nullptr);
+  ASSERT_NE(worker_pool_->DebugString().find("num idle worker hits: 1"),
+            std::string::npos);
+  worker_pool_->PushWorker(warm_worker);
+  std::shared_ptr<WorkerInterface> cold_worker;
+  for (const auto &idle_pair : worker_pool_->GetIdleWorkers()) {
+    if (idle_pair.first != warm_worker) {
+      cold_worker = idle_pair.first;
+    }
+  }
+  ASSERT_NE(cold_worker, nullptr);
+
+  // The job only used 1 worker at once in the last interval, so the idle workers
+  // beyond that are killed least recently used first, even though the soft limit is
+  // not reached.
+  worker_pool_->SetCurrentTimeMs(300000);
+  worker_pool_->MaintainWarmWorkerPools();
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_TRUE(mock_worker_rpc_clients_[cold_worker->WorkerId()]->ExitReplySucceed());
+  ASSERT_FALSE(mock_worker_rpc_clients_[warm_worker->WorkerId()]->ExitReplySucceed());
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), 1);
+
+  // Once the demand is gone, the rest of the idle workers are killed too.
+  worker_pool_->SetCurrentTimeMs(400000);
+  worker_pool_->MaintainWarmWorkerPools();
+  ASSERT_EQ(worker_pool_->NumWorkersStarting(), 0);
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_TRUE(mock_worker_rpc_clients_[warm_worker->WorkerId()]->ExitReplySucceed());
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), 0);
+
+  // Reset the global config.
+  RayConfig::instance().initialize(
+      R"({"worker_demand_prediction_enabled": false, )"
+      R"("worker_demand_estimation_interval_ms": 1000, )"
+      R"("worker_demand_ewma_alpha": 0.3})");
+}
+
+TEST_F(WorkerPoolTest, TestIdleWorkerKillingThresholdFollowsPredictedDemand) {
+  RayConfig::instance().initialize(
+      R"({"worker_demand_prediction_enabled": true, )"
+      R"("worker_demand_estimation_interval_ms": 100000, )"
+      R"("worker_demand_ewma_alpha": 0.5})");
+  SetWorkerCommands({{Language::PYTHON, {"dummy_py_worker_command"}}});
+  const auto task_spec = ExampleTaskSpec();
+
+  std::vector<std::shared_ptr<WorkerInterface>> workers;
+  for (int i = 0; i < 4; i++) {
+    auto worker = worker_pool_->PopWorkerSync(task_spec);
+    ASSERT_NE(worker, nullptr);
+    workers.push_back(worker);
+  }
+  // The predicted demand is 2 workers, so 2 of the 4 idle workers are kept warm.
+  worker_pool_->SetCurrentTimeMs(100000);
+  worker_pool_->MaintainWarmWorkerPools();
+  for (const auto &worker : workers) {
+    worker_pool_->PushWorker(worker);
+  }
+  const int64_t threshold_ms =
+      RayConfig::instance().idle_worker_killing_time_threshold_ms();
+
+  // The other 2 are only killed after 3 times the usual idle time, because the job
+  // still uses workers.
+  worker_pool_->SetCurrentTimeMs(100000 + 2 * threshold_ms);
+  worker_pool_->TryKillingIdleWorkers();
+  for (const auto &worker : workers) {
+    ASSERT_FALSE(mock_worker_rpc_clients_[worker->WorkerId()]->ExitReplySucceed());
+  }
+  worker_pool_->SetCurrentTimeMs(100000 + 3 * threshold_ms);
+  worker_pool_->TryKillingIdleWorkers();
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(mock_worker_rpc_clients_[workers[i]->WorkerId()]->ExitReplySucceed(),
+              i < 2);
+  }
+  worker_pool_->TryKillingIdleWorkers();
+  ASSERT_EQ(worker_pool_->GetIdleWorkerSize(), 2);
+
+  // Reset the global config.
+  RayConfig::instance().initialize(
+      R"({"worker_demand_prediction_enabled": false, )"
+      R"("worker_demand_estimation_interval_ms": 1000, )"
+      R"("worker_demand_ewma_alpha": 0.3})");
+}
+
 TEST_F(WorkerPoolTest, TestWorkerCappingLaterNWorkersNotOwningObjects) {
   ///
   /// When there are 2 * N idle workers where the first N workers own objects,
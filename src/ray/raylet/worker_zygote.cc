@@ -0,0 +1,233 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/worker_zygote.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+
+#include "absl/strings/numbers.h"
+#include "ray/util/logging.h"
+
+namespace ray {
+
+namespace raylet {
+
+namespace {
+
+/// The maximum length of a reply line, which only holds a pid.
+constexpr size_t kMaxReplyLength = 32;
+
+}  // namespace
+
+WorkerZygote::WorkerZygote(instrumented_io_context &io_service, Process process,
+                           std::string socket_name, int64_t timeout_ms)
+    : io_service_(io_service),
+      process_(std::move(process)),
+      socket_name_(std::move(socket_name)),
+      timeout_ms_(timeout_ms),
+      socket_(io_service),
+      reply_buffer_(kMaxReplyLength) {}
+
+WorkerZygote::~WorkerZygote() {
+  boost::system::error_code ec;
+  socket_.close(ec);
+  process_.Kill();
+}
+
+bool WorkerZygote::IsSupported() {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool WorkerZygote::IsReady() {
+  if (state_ == State::DISCONNECTED) {
+    Connect();
+  }
+  return state_ == State::READY;
+}
+
+void WorkerZygote::Connect() {
+#ifdef __linux__
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  RAY_CHECK(socket_name_.size() + 1 < sizeof(addr.sun_path));
+  // A leading null byte puts the socket in the abstract namespace, so there is no
+  // file to clean up.
+  memcpy(addr.sun_path + 1, socket_name_.data(), socket_name_.size());
+  boost::asio::generic::stream_protocol::endpoint endpoint(
+      &addr, offsetof(sockaddr_un, sun_path) + 1 + socket_name_.size());
+
+  state_ = State::CONNECTING;
+  std::weak_ptr<WorkerZygote> weak_this = weak_from_this();
+  socket_.async_connect(endpoint, [weak_this](const boost::system::error_code &ec) {
+    auto zygote = weak_this.lock();
+    if (!zygote || zygote->state_ != State::CONNECTING) {
+      return;
+    }
+    if (ec) {
+      boost::system::error_code close_ec;
+      zygote->socket_.close(close_ec);
+      if (!zygote->process_.IsAlive()) {
+        zygote->Fail("the zygote process died before it started listening");
+        return;
+      }
+      // The zygote is still importing its libraries. Try again on the next fork.
+      zygote->state_ = State::DISCONNECTED;
+      return;
+    }
+    if (!zygote->CheckPeer()) {
+      return;
+    }
+    RAY_LOG(INFO) << "Connected to worker zygote with pid " << zygote->process_.GetId();
+    zygote->state_ = State::READY;
+  });
+#else
+  state_ = State::FAILED;
+#endif
+}
+
+bool WorkerZygote::CheckPeer() {
+#ifdef __linux__
+  // Anyone can listen on an abstract socket name, so make sure that the workers are
+  // forked by the process that we started.
+  ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(socket_.native_handle(), SOL_SOCKET, SO_PEERCRED, &credentials,
+                 &length) != 0) {
+    Fail(std::string("failed to get the peer credentials: ") + strerror(errno));
+    return false;
+  }
+  if (credentials.pid != process_.GetId()) {
+    Fail("the socket is served by process " + std::to_string(credentials.pid) +
+         " instead of the zygote");
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+void WorkerZygote::ForkWorker(StartupToken startup_token,
+                              std::function<void(Process)> callback) {
+  RAY_CHECK(state_ == State::READY);
+  std::weak_ptr<WorkerZygote> weak_this = weak_from_this();
+  auto timer = std::make_shared<boost::asio::deadline_timer>(
+      io_service_, boost::posix_time::milliseconds(timeout_ms_));
+  timer->async_wait([weak_this](const boost::system::error_code &ec) {
+    auto zygote = weak_this.lock();
+    if (ec == boost::asio::error::operation_aborted || !zygote) {
+      return;
+    }
+    zygote->Fail("timed out waiting for a worker to be forked");
+  });
+  pending_forks_.push_back(PendingFork{std::move(callback), std::move(timer)});
+
+  requests_.push_back(std::to_string(startup_token) + "\n");
+  if (requests_.size() == 1) {
+    WriteNextRequest();
+  }
+  if (pending_forks_.size() == 1) {
+    ReadNextReply();
+  }
+}
+
+void WorkerZygote::WriteNextRequest() {
+  std::weak_ptr<WorkerZygote> weak_this = weak_from_this();
+  boost::asio::async_write(
+      socket_, boost::asio::buffer(requests_.front()),
+      [weak_this](const boost::system::error_code &ec, size_t bytes_transferred) {
+        auto zygote = weak_this.lock();
+        if (!zygote || zygote->state_ != State::READY) {
+          return;
+        }
+        if (ec) {
+          zygote->Fail("failed to send a request: " + ec.message());
+          return;
+        }
+        zygote->requests_.pop_front();
+        if (!zygote->requests_.empty()) {
+          zygote->WriteNextRequest();
+        }
+      });
+}
+
+void WorkerZygote::ReadNextReply() {
+  std::weak_ptr<WorkerZygote> weak_this = weak_from_this();
+  boost::asio::async_read_until(
+      socket_, reply_buffer_, '\n',
+      [weak_this](const boost::system::error_code &ec, size_t bytes_transferred) {
+        auto zygote = weak_this.lock();
+        if (!zygote || zygote->state_ != State::READY) {
+          return;
+        }
+        if (ec) {
+          zygote->Fail(ec == boost::asio::error::eof
+                           ? "the zygote closed the connection"
+                           : "failed to receive a reply: " + ec.message());
+          return;
+        }
+        std::string reply;
+        std::istream stream(&zygote->reply_buffer_);
+        std::getline(stream, reply);
+
+        pid_t pid;
+        if (!absl::SimpleAtoi(reply, &pid) || pid <= 0) {
+          zygote->Fail("failed to fork a worker, the reply was: " + reply);
+          return;
+        }
+        auto fork = std::move(zygote->pending_forks_.front());
+        zygote->pending_forks_.pop_front();
+        fork.timer->cancel();
+        if (!zygote->pending_forks_.empty()) {
+          zygote->ReadNextReply();
+        }
+        fork.callback(Process::FromPid(pid));
+      });
+}
+
+void WorkerZygote::Fail(const std::string &reason) {
+  RAY_LOG(WARNING) << "Worker zygote with pid " << process_.GetId()
+                   << " failed: " << reason
+                   << ". Workers will be started without the zygote.";
+  state_ = State::FAILED;
+  boost::system::error_code ec;
+  socket_.close(ec);
+  process_.Kill();
+  requests_.clear();
+  auto pending_forks = std::move(pending_forks_);
+  pending_forks_.clear();
+  for (auto &fork : pending_forks) {
+    fork.timer->cancel();
+    fork.callback(Process());
+  }
+}
+
+}  // namespace raylet
+
+}  // namespace ray
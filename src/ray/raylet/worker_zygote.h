@@ -0,0 +1,130 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "ray/common/asio/instrumented_io_context.h"
+#include "ray/util/process.h"
+
+namespace ray {
+
+namespace raylet {
+
+/// \class WorkerZygote
+///
+/// Client of a worker zygote: a worker process that has already started the
+/// interpreter and imported its libraries, and forks new workers on request so that
+/// they skip that startup cost.
+///
+/// The zygote listens on an abstract unix socket. The client only talks to the socket
+/// if its peer is the zygote process. For each worker, the client sends a line with
+/// the startup token of the worker, and the zygote replies with a line with the pid
+/// of the forked worker, or a non-positive number if the fork failed. The forked
+/// worker then registers with the raylet like any other worker. The zygote exits when
+/// the raylet closes the connection or dies.
+///
+/// All socket operations are asynchronous on the given io_service, so a slow zygote
+/// never blocks the raylet.
+class WorkerZygote : public std::enable_shared_from_this<WorkerZygote> {
+ public:
+  /// Create a client for a zygote process that was started with the given socket.
+  ///
+  /// \param io_service The event loop to run the socket operations on.
+  /// \param process The zygote process.
+  /// \param socket_name The name of the abstract unix socket the zygote listens on.
+  /// \param timeout_ms How long to wait for each fork before giving up on the zygote.
+  WorkerZygote(instrumented_io_context &io_service, Process process,
+               std::string socket_name, int64_t timeout_ms);
+
+  /// Kill the zygote process. Workers that it forked keep running. The callbacks of
+  /// forks that are still pending are not called.
+  ~WorkerZygote();
+
+  WorkerZygote(const WorkerZygote &) = delete;
+  WorkerZygote &operator=(const WorkerZygote &) = delete;
+
+  /// Whether zygotes are supported on this platform.
+  static bool IsSupported();
+
+  /// Whether the zygote is connected and verified, so that workers can be forked from
+  /// it. If not, this starts connecting to the zygote in the background, unless it is
+  /// connecting already or has failed.
+  bool IsReady();
+
+  /// Ask the zygote to fork a worker. Must only be called if the zygote is ready.
+  ///
+  /// \param startup_token The startup token of the new worker.
+  /// \param callback Called on the io_service with the forked worker process, or with
+  /// a null process if the zygote failed. In that case, the caller should start the
+  /// worker itself.
+  void ForkWorker(StartupToken startup_token, std::function<void(Process)> callback);
+
+  /// Whether the zygote died or misbehaved. A failed zygote won't fork any more
+  /// workers.
+  bool IsFailed() const { return state_ == State::FAILED; }
+
+  const Process &GetProcess() const { return process_; }
+
+  const std::string &GetSocketName() const { return socket_name_; }
+
+ private:
+  enum class State { DISCONNECTED, CONNECTING, READY, FAILED };
+
+  /// A fork request that hasn't been replied to yet.
+  struct PendingFork {
+    std::function<void(Process)> callback;
+    /// Fails the zygote if the reply doesn't arrive in time.
+    std::shared_ptr<boost::asio::deadline_timer> timer;
+  };
+
+  /// Start connecting to the zygote.
+  void Connect();
+
+  /// Verify that the peer of the connection is the zygote process.
+  bool CheckPeer();
+
+  /// Write the request at the front of the queue.
+  void WriteNextRequest();
+
+  /// Read the reply to the oldest pending fork.
+  void ReadNextReply();
+
+  /// Close the connection, kill the zygote and mark it as failed. The pending forks
+  /// are called back with a null process.
+  void Fail(const std::string &reason);
+
+  instrumented_io_context &io_service_;
+  Process process_;
+  const std::string socket_name_;
+  const int64_t timeout_ms_;
+  State state_ = State::DISCONNECTED;
+  boost::asio::generic::stream_protocol::socket socket_;
+  /// The requests that haven't been written yet. The front one is being written.
+  std::deque<std::string> requests_;
+  /// The forks that haven't been replied to, in the order of the requests.
+  std::deque<PendingFork> pending_forks_;
+  boost::asio::streambuf reply_buffer_;
+};
+
+}  // namespace raylet
+
+}  // namespace ray
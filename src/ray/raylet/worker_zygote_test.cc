@@ -0,0 +1,218 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/raylet/worker_zygote.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ray/util/util.h"
+
+namespace ray {
+
+namespace raylet {
+
+/// Listen on an abstract unix socket and return the listening socket.
+int ListenOnAbstractSocket(const std::string &socket_name) {
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  RAY_CHECK(listen_fd != -1);
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path + 1, socket_name.data(), socket_name.size());
+  socklen_t addr_len = offsetof(sockaddr_un, sun_path) + 1 + socket_name.size();
+  RAY_CHECK(bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+  RAY_CHECK(listen(listen_fd, 1) == 0);
+  return listen_fd;
+}
+
+/// Start a process that serves zygote requests on an abstract unix socket, replying
+/// with the given function of the startup token instead of forking. The process
+/// listens itself, so that it is the peer of the connection.
+Process StartFakeZygote(const std::string &socket_name,
+                        std::function<std::string(const std::string &)> reply) {
+  pid_t pid = fork();
+  RAY_CHECK(pid != -1);
+  if (pid != 0) {
+    return Process::FromPid(pid);
+  }
+  int listen_fd = ListenOnAbstractSocket(socket_name);
+  int fd = accept(listen_fd, nullptr, nullptr);
+  std::string line;
+  char c;
+  while (fd != -1 && recv(fd, &c, 1, 0) == 1) {
+    if (c != '\n') {
+      line.push_back(c);
+      continue;
+    }
+    std::string response = reply(line);
+    if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(response.size())) {
+      break;
+    }
+    line.clear();
+  }
+  _exit(0);
+}
+
+class WorkerZygoteTest : public ::testing::Test {
+ protected:
+  // Reap exited children like the raylet does, so that they don't stay alive as
+  // zombies.
+  void SetUp() override { signal(SIGCHLD, SIG_IGN); }
+
+  std::string SocketName() {
+    return "ray_worker_zygote_test_" + std::to_string(getpid()) + "_" +
+           ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+
+  std::shared_ptr<WorkerZygote> MakeZygote(Process process, int64_t timeout_ms) {
+    return std::make_shared<WorkerZygote>(io_service_, std::move(process), SocketName(),
+                                          timeout_ms);
+  }
+
+  /// Run the event loop until the condition holds or the time is up.
+  bool RunUntil(const std::function<bool()> &condition, int64_t timeout_ms = 5000) {
+    for (int64_t i = 0; i < timeout_ms / 10; i++) {
+      if (condition()) {
+        return true;
+      }
+      io_service_.restart();
+      io_service_.run_for(std::chrono::milliseconds(10));
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+  }
+
+  void WaitForDeath(const Process &process) {
+    for (int i = 0; i < 100 && process.IsAlive(); i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(process.IsAlive());
+  }
+
+  /// A live process that stands in for a zygote that doesn't listen.
+  Process StartIdleProcess() {
+    auto result = Process::Spawn({"sleep", "60"}, /*decouple=*/false);
+    RAY_CHECK(!result.second);
+    return result.first;
+  }
+
+  instrumented_io_context io_service_;
+};
+
+TEST_F(WorkerZygoteTest, TestForkWorker) {
+  ASSERT_TRUE(WorkerZygote::IsSupported());
+  auto reply = [](const std::string &startup_token) {
+    return std::to_string(10000 + std::stoi(startup_token)) + "\n";
+  };
+  auto zygote = MakeZygote(StartFakeZygote(SocketName(), reply), 1000);
+  ASSERT_TRUE(RunUntil([&]() { return zygote->IsReady(); }));
+
+  // Requests are pipelined and replied to in order.
+  std::vector<pid_t> pids;
+  for (StartupToken token = 0; token < 3; token++) {
+    zygote->ForkWorker(token, [&pids](Process worker) {
+      ASSERT_FALSE(worker.IsNull());
+      pids.push_back(worker.GetId());
+    });
+  }
+  ASSERT_TRUE(RunUntil([&]() { return pids.size() == 3; }));
+  ASSERT_EQ(pids, (std::vector<pid_t>{10000, 10001, 10002}));
+  ASSERT_FALSE(zygote->IsFailed());
+}
+
+TEST_F(WorkerZygoteTest, TestZygoteNotReady) {
+  // The zygote is alive but not listening yet, so the worker should be started
+  // without it.
+  auto zygote = MakeZygote(StartIdleProcess(), 1000);
+  ASSERT_FALSE(RunUntil([&]() { return zygote->IsReady(); }, 100));
+  ASSERT_FALSE(zygote->IsFailed());
+}
+
+TEST_F(WorkerZygoteTest, TestZygoteDied) {
+  auto result = Process::Spawn({"true"}, /*decouple=*/false);
+  ASSERT_FALSE(result.second);
+  WaitForDeath(result.first);
+  auto zygote = MakeZygote(result.first, 1000);
+  ASSERT_FALSE(zygote->IsReady());
+  ASSERT_TRUE(RunUntil([&]() { return zygote->IsFailed(); }));
+  ASSERT_FALSE(zygote->IsReady());
+}
+
+TEST_F(WorkerZygoteTest, TestForkFailed) {
+  Process process =
+      StartFakeZygote(SocketName(), [](const std::string &) { return "-1\n"; });
+  auto zygote = MakeZygote(process, 1000);
+  ASSERT_TRUE(RunUntil([&]() { return zygote->IsReady(); }));
+  bool called = false;
+  zygote->ForkWorker(0, [&called](Process worker) {
+    ASSERT_TRUE(worker.IsNull());
+    called = true;
+  });
+  ASSERT_TRUE(RunUntil([&]() { return called; }));
+  // A failed zygote is killed and not asked again.
+  ASSERT_TRUE(zygote->IsFailed());
+  ASSERT_FALSE(zygote->IsReady());
+  WaitForDeath(process);
+}
+
+TEST_F(WorkerZygoteTest, TestReplyTimeout) {
+  auto reply = [](const std::string &) {
+    // Hang longer than the timeout.
+    sleep(1);
+    return std::string("123\n");
+  };
+  auto zygote = MakeZygote(StartFakeZygote(SocketName(), reply), 100);
+  ASSERT_TRUE(RunUntil([&]() { return zygote->IsReady(); }));
+  bool called = false;
+  zygote->ForkWorker(0, [&called](Process worker) {
+    ASSERT_TRUE(worker.IsNull());
+    called = true;
+  });
+  ASSERT_TRUE(RunUntil([&]() { return called; }, 500));
+  ASSERT_TRUE(zygote->IsFailed());
+}
+
+TEST_F(WorkerZygoteTest, TestPeerIsNotTheZygote) {
+  // Another process listens on the socket name of the zygote.
+  int listen_fd = ListenOnAbstractSocket(SocketName());
+  Process process = StartIdleProcess();
+  auto zygote = MakeZygote(process, 1000);
+  ASSERT_TRUE(RunUntil([&]() {
+    zygote->IsReady();
+    return zygote->IsFailed();
+  }));
+  ASSERT_FALSE(zygote->IsReady());
+  WaitForDeath(process);
+  close(listen_fd);
+}
+
+}  // namespace raylet
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
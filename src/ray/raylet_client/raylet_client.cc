@@ -307,6 +307,23 @@ void raylet::RayletClient::RequestWorkerLease(
   grpc_client_->RequestWorkerLease(*request, callback);
 }
 
+void raylet::RayletClient::RequestWorkerLeases(
+    const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+    int64_t max_leases, const rpc::ClientCallback<rpc::RequestWorkerLeaseReply> &callback,
+    const int64_t backlog_size, uint64_t reservation_token) {
+  google::protobuf::Arena arena;
+  auto request =
+      google::protobuf::Arena::CreateMessage<rpc::RequestWorkerLeaseRequest>(&arena);
+  // See RequestWorkerLease for why the unsafe allocating is safe.
+  request->unsafe_arena_set_allocated_resource_spec(
+      const_cast<rpc::TaskSpec *>(&resource_spec.GetMessage()));
+  request->set_grant_or_reject(grant_or_reject);
+  request->set_backlog_size(backlog_size);
+  request->set_max_leases(max_leases);
+  request->set_reservation_token(reservation_token);
+  grpc_client_->RequestWorkerLease(*request, callback);
+}
+
 /// Spill objects to external storage.
 void raylet::RayletClient::RequestObjectSpillage(
     const ObjectID &object_id,
@@ -345,6 +362,24 @@ Status raylet::RayletClient::ReturnWorker(int worker_port, const WorkerID &worke
   return Status::OK();
 }
 
+Status raylet::RayletClient::ReturnWorkers(
+    const std::vector<std::pair<int, WorkerID>> &workers, bool disconnect_worker) {
+  rpc::ReturnWorkersRequest request;
+  for (const auto &worker : workers) {
+    auto worker_request = request.add_workers();
+    worker_request->set_worker_port(worker.first);
+    worker_request->set_worker_id(worker.second.Binary());
+    worker_request->set_disconnect_worker(disconnect_worker);
+  }
+  grpc_client_->ReturnWorkers(
+      request, [](const Status &status, const rpc::ReturnWorkersReply &reply) {
+        if (!status.ok()) {
+          RAY_LOG(INFO) << "Error returning workers: " << status;
+        }
+      });
+  return Status::OK();
+}
+
 void raylet::RayletClient::ReleaseUnusedWorkers(
     const std::vector<WorkerID> &workers_in_use,
     const rpc::ClientCallback<rpc::ReleaseUnusedWorkersReply> &callback) {
@@ -75,6 +75,23 @@ class WorkerLeaseInterface {
       const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
       const int64_t backlog_size = -1) = 0;
 
+  /// Requests up to `max_leases` workers from the raylet for tasks like the given one.
+  /// The raylet may grant fewer. The first worker is in the reply's worker address, and
+  /// the others in its additional leases.
+  /// \param resource_spec Resources that should be allocated for each worker.
+  /// \param grant_or_reject: True if we we should either grant or reject the request
+  ///                         but no spillback.
+  /// \param max_leases The maximum number of workers to lease.
+  /// \param callback: The callback to call when the request finishes.
+  /// \param backlog_size The queue length for the given shape on the CoreWorker.
+  /// \param reservation_token The token of the reply that spilled the request back to
+  ///                          this raylet, 0 if none.
+  virtual void RequestWorkerLeases(
+      const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+      int64_t max_leases,
+      const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
+      const int64_t backlog_size = -1, uint64_t reservation_token = 0) = 0;
+
   /// Returns a worker to the raylet.
   /// \param worker_port The local port of the worker on the raylet node.
   /// \param worker_id The unique worker id of the worker on the raylet node.
@@ -83,6 +100,13 @@ class WorkerLeaseInterface {
   virtual ray::Status ReturnWorker(int worker_port, const WorkerID &worker_id,
                                    bool disconnect_worker) = 0;
 
+  /// Returns multiple workers to the raylet in one request.
+  /// \param workers The local port and unique worker id of each worker.
+  /// \param disconnect_worker Whether the raylet should disconnect the workers.
+  /// \return ray::Status
+  virtual ray::Status ReturnWorkers(const std::vector<std::pair<int, WorkerID>> &workers,
+                                    bool disconnect_worker) = 0;
+
   /// Notify raylets to release unused workers.
   /// \param workers_in_use Workers currently in use.
   /// \param callback Callback that will be called after raylet completes the release of
@@ -379,10 +403,21 @@ class RayletClient : public RayletClientInterface {
       const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
       const int64_t backlog_size) override;
 
+  /// Implements WorkerLeaseInterface.
+  void RequestWorkerLeases(
+      const ray::TaskSpecification &resource_spec, bool grant_or_reject,
+      int64_t max_leases,
+      const ray::rpc::ClientCallback<ray::rpc::RequestWorkerLeaseReply> &callback,
+      const int64_t backlog_size, uint64_t reservation_token) override;
+
   /// Implements WorkerLeaseInterface.
   ray::Status ReturnWorker(int worker_port, const WorkerID &worker_id,
                            bool disconnect_worker) override;
 
+  /// Implements WorkerLeaseInterface.
+  ray::Status ReturnWorkers(const std::vector<std::pair<int, WorkerID>> &workers,
+                            bool disconnect_worker) override;
+
   /// Implements WorkerLeaseInterface.
   void ReportWorkerBacklog(
       const WorkerID &worker_id,
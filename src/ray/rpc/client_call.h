@@ -254,6 +254,9 @@ class ClientCallManager {
     return call;
   }
 
+  /// Get the main event loop, to which the callback functions are posted.
+  instrumented_io_context &GetMainService() { return main_service_; }
+
  private:
   /// This function runs in a background thread. It keeps polling events from the
   /// `CompletionQueue`, and dispatches the event to the callbacks via the `ClientCall`
@@ -91,6 +91,10 @@ class NodeManagerWorkerClient
   VOID_RPC_CLIENT_METHOD(NodeManagerService, ReturnWorker, grpc_client_,
                          /*method_timeout_ms*/ -1, )
 
+  /// Return multiple worker leases.
+  VOID_RPC_CLIENT_METHOD(NodeManagerService, ReturnWorkers, grpc_client_,
+                         /*method_timeout_ms*/ -1, )
+
   /// Release unused workers.
   VOID_RPC_CLIENT_METHOD(NodeManagerService, ReleaseUnusedWorkers, grpc_client_,
                          /*method_timeout_ms*/ -1, )
@@ -30,6 +30,7 @@ namespace rpc {
   RPC_SERVICE_HANDLER(NodeManagerService, RequestWorkerLease, -1)     \
   RPC_SERVICE_HANDLER(NodeManagerService, ReportWorkerBacklog, -1)    \
   RPC_SERVICE_HANDLER(NodeManagerService, ReturnWorker, -1)           \
+  RPC_SERVICE_HANDLER(NodeManagerService, ReturnWorkers, -1)          \
   RPC_SERVICE_HANDLER(NodeManagerService, ReleaseUnusedWorkers, -1)   \
   RPC_SERVICE_HANDLER(NodeManagerService, CancelWorkerLease, -1)      \
   RPC_SERVICE_HANDLER(NodeManagerService, PinObjectIDs, -1)           \
@@ -80,6 +81,10 @@ class NodeManagerServiceHandler {
                                   ReturnWorkerReply *reply,
                                   SendReplyCallback send_reply_callback) = 0;
 
+  virtual void HandleReturnWorkers(const ReturnWorkersRequest &request,
+                                   ReturnWorkersReply *reply,
+                                   SendReplyCallback send_reply_callback) = 0;
+
   virtual void HandleReleaseUnusedWorkers(const ReleaseUnusedWorkersRequest &request,
                                           ReleaseUnusedWorkersReply *reply,
                                           SendReplyCallback send_reply_callback) = 0;
@@ -29,10 +29,13 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/hash/hash.h"
+#include "ray/common/asio/asio_util.h"
+#include "ray/common/ray_config.h"
 #include "ray/common/status.h"
 #include "ray/pubsub/subscriber.h"
 #include "ray/rpc/grpc_client.h"
 #include "ray/util/logging.h"
+#include "ray/util/util.h"
 #include "src/ray/protobuf/core_worker.grpc.pb.h"
 #include "src/ray/protobuf/core_worker.pb.h"
 
@@ -117,6 +120,17 @@ class CoreWorkerClientInterface : public pubsub::SubscriberClientInterface {
   virtual void PushNormalTask(std::unique_ptr<PushTaskRequest> request,
                               const ClientCallback<PushTaskReply> &callback) {}
 
+  /// Push a batch of non-actor tasks directly to a worker. The worker executes them in
+  /// order and streams back their replies as they finish.
+  ///
+  /// \param[in] request The request message.
+  /// \param[in] callback Called with every reply to the batch, which holds the replies
+  /// of the tasks that finished since the previous one, tagged with their index in the
+  /// request. It is called until every task was replied to, or once with a non-OK
+  /// status, in which case the tasks that weren't replied to yet have failed.
+  virtual void PushNormalTasks(std::unique_ptr<PushTasksRequest> request,
+                               const ClientCallback<PushTasksReply> &callback) {}
+
   virtual void StealTasks(const StealTasksRequest &request,
                           const ClientCallback<StealTasksReply> &callback) {}
 
@@ -133,6 +147,12 @@ class CoreWorkerClientInterface : public pubsub::SubscriberClientInterface {
   virtual void GetObjectStatus(const GetObjectStatusRequest &request,
                                const ClientCallback<GetObjectStatusReply> &callback) {}
 
+  /// Ask the owner of a batch of objects about their current status. The owner replies
+  /// once some of the objects are ready.
+  virtual void GetObjectStatuses(
+      const GetObjectStatusesRequest &request,
+      const ClientCallback<GetObjectStatusesReply> &callback) {}
+
   /// Ask the actor's owner to reply when the actor has gone out of scope.
   virtual void WaitForActorOutOfScope(
       const WaitForActorOutOfScopeRequest &request,
@@ -214,7 +234,11 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
   /// \param[in] port Port of the worker server.
   /// \param[in] client_call_manager The `ClientCallManager` used for managing requests.
   CoreWorkerClient(const rpc::Address &address, ClientCallManager &client_call_manager)
-      : addr_(address) {
+      : addr_(address),
+        client_call_manager_(client_call_manager),
+        max_batch_size_(std::max<int64_t>(
+            ::RayConfig::instance().max_actor_tasks_per_push_task_batch(), 1)),
+        max_rpcs_in_flight_(::RayConfig::instance().actor_task_max_rpcs_in_flight()) {
     grpc_client_ = std::make_unique<GrpcClient<CoreWorkerService>>(
         addr_.ip_address(), addr_.port(), client_call_manager);
   };
@@ -227,6 +251,9 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
   VOID_RPC_CLIENT_METHOD(CoreWorkerService, GetObjectStatus, grpc_client_,
                          /*method_timeout_ms*/ -1, override)
 
+  VOID_RPC_CLIENT_METHOD(CoreWorkerService, GetObjectStatuses, grpc_client_,
+                         /*method_timeout_ms*/ -1, override)
+
   VOID_RPC_CLIENT_METHOD(CoreWorkerService, KillActor, grpc_client_,
                          /*method_timeout_ms*/ -1, override)
 
@@ -288,8 +315,7 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
       // processing this request. We could also set it to max_finished_seq_no_,
       // but we just set it to the default of -1 to avoid taking the lock.
       request->set_client_processed_up_to(-1);
-      INVOKE_RPC_CALL(CoreWorkerService, PushTask, *request, callback, grpc_client_,
-                      /*method_timeout_ms*/ -1);
+      InvokePushTask(*request, callback);
       return;
     }
 
@@ -310,16 +336,34 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
                     /*method_timeout_ms*/ -1);
   }
 
+  void PushNormalTasks(std::unique_ptr<PushTasksRequest> request,
+                       const ClientCallback<PushTasksReply> &callback) override {
+    for (auto &task_request : *request->mutable_requests()) {
+      task_request.set_sequence_number(-1);
+      task_request.set_client_processed_up_to(-1);
+    }
+    StreamPushTasks(*request, /*repoll_on_failure=*/false, callback);
+  }
+
   /// Send as many pending tasks as possible. This method is thread-safe.
   ///
   /// The client will guarantee no more than kMaxBytesInFlight bytes of RPCs are being
   /// sent at once. This prevents the server scheduling queue from being overwhelmed.
+  /// If batching is enabled, the tasks that are queued behind the RPCs in flight are
+  /// sent together in PushTasks RPCs, and the number of RPCs in flight is bounded.
+  /// The worker streams back the reply of each task of a batch as soon as it finishes,
+  /// so a task may wait for the caller to act on the result of an earlier task.
   /// See direct_actor.proto for a description of the ordering protocol.
   void SendRequests() {
     absl::MutexLock lock(&mutex_);
     auto this_ptr = this->shared_from_this();
 
-    while (!send_queue_.empty() && rpc_bytes_in_flight_ < kMaxBytesInFlight) {
+    while (!send_queue_.empty() && rpc_bytes_in_flight_ < kMaxBytesInFlight &&
+           (max_batch_size_ == 1 || num_rpcs_in_flight_ < max_rpcs_in_flight_)) {
+      if (max_batch_size_ > 1 && send_queue_.size() > 1) {
+        SendBatch(this_ptr);
+        continue;
+      }
       auto pair = std::move(*send_queue_.begin());
       send_queue_.pop_front();
 
@@ -328,6 +372,7 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
       int64_t seq_no = request->sequence_number();
       request->set_client_processed_up_to(max_finished_seq_no_);
       rpc_bytes_in_flight_ += task_size;
+      num_rpcs_in_flight_++;
 
       auto rpc_callback = [this, this_ptr, seq_no, task_size,
                            callback = std::move(pair.second)](
@@ -339,14 +384,13 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
           }
           rpc_bytes_in_flight_ -= task_size;
           RAY_CHECK(rpc_bytes_in_flight_ >= 0);
+          num_rpcs_in_flight_--;
         }
         SendRequests();
         callback(status, reply);
       };
 
-      RAY_UNUSED(INVOKE_RPC_CALL(CoreWorkerService, PushTask, *request,
-                                 std::move(rpc_callback), grpc_client_,
-                                 /*method_timeout_ms*/ -1));
+      InvokePushTask(*request, std::move(rpc_callback));
     }
 
     if (!send_queue_.empty()) {
@@ -360,13 +404,200 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
     return max_finished_seq_no_;
   }
 
+ protected:
+  /// Send a PushTask RPC for an actor task. This is virtual for testing.
+  virtual void InvokePushTask(const PushTaskRequest &request,
+                              const ClientCallback<PushTaskReply> &callback) {
+    RAY_UNUSED(INVOKE_RPC_CALL(CoreWorkerService, PushTask, request, callback,
+                               grpc_client_, /*method_timeout_ms*/ -1));
+  }
+
+  /// Send a PushTasks RPC for a batch of actor tasks. This is virtual for testing.
+  virtual void InvokePushTasks(const PushTasksRequest &request,
+                               const ClientCallback<PushTasksReply> &callback) {
+    RAY_UNUSED(INVOKE_RPC_CALL(CoreWorkerService, PushTasks, request, callback,
+                               grpc_client_, /*method_timeout_ms*/ -1));
+  }
+
  private:
+  /// Send the tasks at the front of the queue in one PushTasks RPC. Each task's callback
+  /// is called with its own status and reply as soon as it is received.
+  void SendBatch(const std::shared_ptr<CoreWorkerClient> &this_ptr)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    auto request = std::make_unique<PushTasksRequest>();
+    auto callbacks = std::make_shared<std::vector<ClientCallback<PushTaskReply>>>();
+    int64_t batch_size = 0;
+    int64_t max_seq_no = -1;
+    while (!send_queue_.empty() && callbacks->size() < max_batch_size_ &&
+           (callbacks->empty() ||
+            rpc_bytes_in_flight_ + batch_size < kMaxBytesInFlight)) {
+      auto pair = std::move(*send_queue_.begin());
+      send_queue_.pop_front();
+      auto &task_request = *pair.first;
+      batch_size += RequestSizeInBytes(task_request);
+      max_seq_no = std::max(max_seq_no, task_request.sequence_number());
+      task_request.set_client_processed_up_to(max_finished_seq_no_);
+      if (request->intended_worker_id().empty()) {
+        request->set_intended_worker_id(task_request.intended_worker_id());
+      }
+      request->add_requests()->Swap(&task_request);
+      callbacks->push_back(std::move(pair.second));
+    }
+    rpc_bytes_in_flight_ += batch_size;
+    num_rpcs_in_flight_++;
+
+    auto replied = std::make_shared<std::vector<bool>>(callbacks->size(), false);
+    auto num_unreplied = std::make_shared<size_t>(callbacks->size());
+    auto rpc_callback = [this, this_ptr, max_seq_no, batch_size, callbacks, replied,
+                         num_unreplied](const Status &status,
+                                        const rpc::PushTasksReply &reply) {
+      if (status.ok()) {
+        for (const auto &task_reply : reply.replies()) {
+          (*replied)[task_reply.index()] = true;
+          (*num_unreplied)--;
+          const auto &callback = (*callbacks)[task_reply.index()];
+          if (task_reply.task_canceled()) {
+            callback(Status::IOError("Task was canceled before it was executed"),
+                     task_reply.reply());
+            continue;
+          }
+          const auto code = static_cast<StatusCode>(task_reply.status_code());
+          callback(code == StatusCode::OK ? Status::OK()
+                                          : Status(code, task_reply.status_message()),
+                   task_reply.reply());
+        }
+      }
+      if (!status.ok() || *num_unreplied == 0) {
+        {
+          absl::MutexLock lock(&mutex_);
+          if (max_seq_no > max_finished_seq_no_) {
+            max_finished_seq_no_ = max_seq_no;
+          }
+          rpc_bytes_in_flight_ -= batch_size;
+          RAY_CHECK(rpc_bytes_in_flight_ >= 0);
+          num_rpcs_in_flight_--;
+        }
+        SendRequests();
+      }
+      if (!status.ok()) {
+        for (size_t i = 0; i < callbacks->size(); i++) {
+          if (!(*replied)[i]) {
+            (*callbacks)[i](status, rpc::PushTaskReply());
+          }
+        }
+      }
+    };
+
+    StreamPushTasks(*request, /*repoll_on_failure=*/true, std::move(rpc_callback));
+  }
+
+  /// The state of a batch of tasks whose replies are being received.
+  struct PushTasksStream {
+    /// The worker the tasks were pushed to.
+    std::string worker_id;
+    /// The ID of the batch at the worker, known once the first replies are received.
+    int64_t batch_id = 0;
+    /// Whether each task of the batch was replied to.
+    std::vector<bool> replied;
+    /// The number of tasks that weren't replied to yet.
+    size_t num_unreplied;
+    /// Whether to ask for the replies again when a request for them fails.
+    bool repoll_on_failure;
+    /// When to stop asking for the replies again after the requests for them failed, or
+    /// 0 if the last request succeeded.
+    int64_t repoll_deadline_ms = 0;
+    /// Called with each reply.
+    ClientCallback<PushTasksReply> callback;
+  };
+
+  /// Send a PushTasks RPC, and then keep waiting for more replies to the batch until
+  /// every task was replied to. The callback is called with each reply, after the
+  /// replies of unknown or duplicate tasks have been turned into an error.
+  ///
+  /// \param repoll_on_failure Whether to ask for the replies again when a request for
+  /// them fails, instead of failing the tasks that weren't replied to. This is for
+  /// actor tasks, whose failure on the death of the actor is up to the submitter.
+  void StreamPushTasks(const PushTasksRequest &request, bool repoll_on_failure,
+                       const ClientCallback<PushTasksReply> &callback) {
+    auto stream = std::make_shared<PushTasksStream>();
+    stream->worker_id = request.intended_worker_id();
+    stream->replied.resize(request.requests_size(), false);
+    stream->num_unreplied = request.requests_size();
+    stream->repoll_on_failure = repoll_on_failure;
+    stream->callback = callback;
+    InvokePushTasks(request, [this, this_ptr = shared_from_this(), stream](
+                                 const Status &status, const PushTasksReply &reply) {
+      OnPushTasksReply(stream, status, reply);
+    });
+  }
+
+  /// Send a PushTasks RPC that waits for more replies to the batch of the stream.
+  void PollPushTasks(const std::shared_ptr<PushTasksStream> &stream) {
+    PushTasksRequest request;
+    request.set_intended_worker_id(stream->worker_id);
+    request.set_batch_id(stream->batch_id);
+    InvokePushTasks(request, [this, this_ptr = shared_from_this(), stream](
+                                 const Status &status, const PushTasksReply &reply) {
+      OnPushTasksReply(stream, status, reply);
+    });
+  }
+
+  void OnPushTasksReply(const std::shared_ptr<PushTasksStream> &stream, Status status,
+                        const PushTasksReply &reply) {
+    if (!status.ok() && stream->repoll_on_failure && stream->batch_id != 0 &&
+        !status.IsInvalid()) {
+      // A request for more replies failed, but the tasks may still run at the actor, so
+      // failing them could run them twice. Ask again until the actor reports the batch
+      // as unknown, or would have forgotten it. If the actor died, the submitter fails
+      // the tasks once it learns about the death.
+      const int64_t now_ms = current_time_ms();
+      if (stream->repoll_deadline_ms == 0) {
+        stream->repoll_deadline_ms =
+            now_ms + 2 * ::RayConfig::instance().push_tasks_batch_poll_timeout_ms();
+      }
+      if (now_ms < stream->repoll_deadline_ms) {
+        RAY_LOG(DEBUG) << "Failed to wait for the replies to batch " << stream->batch_id
+                       << " of pushed tasks, asking again: " << status;
+        execute_after(
+            client_call_manager_.GetMainService(),
+            [this, this_ptr = shared_from_this(), stream]() { PollPushTasks(stream); },
+            ::RayConfig::instance().push_tasks_batch_repoll_delay_ms());
+        return;
+      }
+    }
+    if (status.ok() && reply.replies().empty()) {
+      status = Status::IOError("Received no replies to pushed tasks");
+    }
+    for (int i = 0; status.ok() && i < reply.replies_size(); i++) {
+      const int index = reply.replies(i).index();
+      if (index < 0 || index >= static_cast<int>(stream->replied.size()) ||
+          stream->replied[index]) {
+        status = Status::IOError("Received an unexpected reply to pushed tasks: " +
+                                 std::to_string(index));
+        break;
+      }
+      stream->replied[index] = true;
+    }
+    if (status.ok()) {
+      stream->num_unreplied -= reply.replies_size();
+      stream->batch_id = reply.batch_id();
+      stream->repoll_deadline_ms = 0;
+    }
+    if (status.ok() && stream->num_unreplied > 0) {
+      PollPushTasks(stream);
+    }
+    stream->callback(status, status.ok() ? reply : PushTasksReply());
+  }
+
   /// Protects against unsafe concurrent access from the callback thread.
   absl::Mutex mutex_;
 
   /// Address of the remote worker.
   rpc::Address addr_;
 
+  /// The `ClientCallManager` used for managing requests.
+  ClientCallManager &client_call_manager_;
+
   /// The RPC client.
   std::unique_ptr<GrpcClient<CoreWorkerService>> grpc_client_;
 
@@ -377,6 +608,15 @@ class CoreWorkerClient : public std::enable_shared_from_this<CoreWorkerClient>,
   /// The number of bytes currently in flight.
   int64_t rpc_bytes_in_flight_ GUARDED_BY(mutex_) = 0;
 
+  /// The maximum number of queued tasks sent in one RPC. 1 disables batching.
+  const size_t max_batch_size_;
+
+  /// The maximum number of RPCs in flight, enforced only if batching is enabled.
+  const int64_t max_rpcs_in_flight_;
+
+  /// The number of PushTask(s) RPCs currently in flight.
+  int64_t num_rpcs_in_flight_ GUARDED_BY(mutex_) = 0;
+
   /// The max sequence number we have processed responses for.
   int64_t max_finished_seq_no_ GUARDED_BY(mutex_) = -1;
 };
@@ -29,9 +29,11 @@ namespace rpc {
 /// NOTE: See src/ray/core_worker/core_worker.h on how to add a new grpc handler.
 #define RAY_CORE_WORKER_RPC_HANDLERS                                         \
   RPC_SERVICE_HANDLER(CoreWorkerService, PushTask, -1)                       \
+  RPC_SERVICE_HANDLER(CoreWorkerService, PushTasks, -1)                      \
   RPC_SERVICE_HANDLER(CoreWorkerService, StealTasks, -1)                     \
   RPC_SERVICE_HANDLER(CoreWorkerService, DirectActorCallArgWaitComplete, -1) \
   RPC_SERVICE_HANDLER(CoreWorkerService, GetObjectStatus, -1)                \
+  RPC_SERVICE_HANDLER(CoreWorkerService, GetObjectStatuses, -1)              \
   RPC_SERVICE_HANDLER(CoreWorkerService, WaitForActorOutOfScope, -1)         \
   RPC_SERVICE_HANDLER(CoreWorkerService, PubsubLongPolling, -1)              \
   RPC_SERVICE_HANDLER(CoreWorkerService, PubsubCommandBatch, -1)             \
@@ -52,9 +54,11 @@ namespace rpc {
 
 #define RAY_CORE_WORKER_DECLARE_RPC_HANDLERS                              \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(PushTask)                       \
+  DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(PushTasks)                      \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(StealTasks)                     \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(DirectActorCallArgWaitComplete) \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(GetObjectStatus)                \
+  DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(GetObjectStatuses)              \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(WaitForActorOutOfScope)         \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(PubsubLongPolling)              \
   DECLARE_VOID_RPC_SERVICE_HANDLER_METHOD(PubsubCommandBatch)             \
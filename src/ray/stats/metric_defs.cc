@@ -95,6 +95,26 @@ DEFINE_stats(scheduler_failed_worker_startup_total,
              "available. Labels are broken per reason {JobConfigMissing, "
              "RegistrationTimedOut, RateLimited}",
              ("Reason"), (), ray::stats::GAUGE);
+DEFINE_stats(scheduler_lease_request_latency_ms,
+             "Time from receiving a worker lease request to replying to it, broken per "
+             "result {Granted, SpilledBack, Rejected, Canceled}.",
+             ("Result"), ({1, 10, 100, 1000, 10000}, ), ray::stats::HISTOGRAM);
+DEFINE_stats(scheduler_lease_spillback_count,
+             "Number of times a worker lease was spilled back or rejected before it was "
+             "granted.",
+             (), ({1, 2, 4, 8, 16}, ), ray::stats::HISTOGRAM);
+DEFINE_stats(scheduler_job_queueing_delay_ms,
+             "Time from queueing a worker lease request to granting it, broken per job.",
+             ("JobId"), ({1, 10, 100, 1000, 10000, 100000}, ), ray::stats::HISTOGRAM);
+
+/// Actor Task Submitter
+DEFINE_stats(actor_task_submit_queue_depth,
+             "Number of a caller's pending tasks per actor, broken per state "
+             "{Queued, InFlight}.",
+             ("ActorId", "State"), (), ray::stats::GAUGE);
+DEFINE_stats(actor_task_submit_backpressure_wait_ms,
+             "Time an actor task submission waited for the actor's pending calls limit.",
+             ("ActorId"), ({1, 10, 100, 1000, 10000, 100000}, ), ray::stats::HISTOGRAM);
 
 /// Local Object Manager
 DEFINE_stats(
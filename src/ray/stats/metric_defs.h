@@ -74,6 +74,13 @@ DECLARE_stats(push_manager_chunks);
 DECLARE_stats(scheduler_failed_worker_startup_total);
 DECLARE_stats(scheduler_tasks);
 DECLARE_stats(scheduler_unscheduleable_tasks);
+DECLARE_stats(scheduler_lease_request_latency_ms);
+DECLARE_stats(scheduler_lease_spillback_count);
+DECLARE_stats(scheduler_job_queueing_delay_ms);
+
+/// Actor Task Submitter
+DECLARE_stats(actor_task_submit_queue_depth);
+DECLARE_stats(actor_task_submit_backpressure_wait_ms);
 
 /// Local Object Manager
 DECLARE_stats(spill_manager_objects);
@@ -0,0 +1,189 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "ray/util/logging.h"
+
+namespace ray {
+
+/// \class InternTable
+/// Maps values to small dense integer ids (starting at 1) and back.
+///
+/// Values are never removed. Looking up a value that is already interned, and looking
+/// up a value by id, are wait-free: they only do atomic loads on an open-addressing
+/// table. A mutex is taken only to insert a new value. Interned values are kept in
+/// stable storage, so references returned by `Get` stay valid for the lifetime of the
+/// table.
+///
+/// When the table grows, the old slot arrays are kept alive until the table is
+/// destroyed, because concurrent readers may still be probing them. Since the capacity
+/// doubles, this at most doubles the memory used by the slot arrays.
+///
+/// This class is thread safe.
+template <typename T, typename Hash = std::hash<T>, typename Equal = std::equal_to<T>>
+class InternTable {
+ public:
+  InternTable() {
+    tables_.emplace_back(new Table(kInitialCapacity));
+    table_.store(tables_.back().get(), std::memory_order_release);
+  }
+
+  InternTable(const InternTable &) = delete;
+  InternTable &operator=(const InternTable &) = delete;
+
+  /// Get the id of a value, interning it if it was not seen before.
+  ///
+  /// \param value The value to look up.
+  /// \param[out] inserted Optional. Set to whether this call interned the value.
+  /// \return The id of the value.
+  int64_t GetOrInsert(const T &value, bool *inserted = nullptr) {
+    const size_t hash = Hash()(value);
+    int64_t id = Find(*table_.load(std::memory_order_acquire), value, hash);
+    if (id == 0) {
+      id = Insert(value, hash, inserted);
+    } else if (inserted != nullptr) {
+      *inserted = false;
+    }
+    return id;
+  }
+
+  /// Get the id of a value without interning it. Wait-free.
+  ///
+  /// \param value The value to look up.
+  /// \return The id of the value, or 0 if it was never interned.
+  int64_t Find(const T &value) const {
+    return Find(*table_.load(std::memory_order_acquire), value, Hash()(value));
+  }
+
+  /// Get an interned value by id. Wait-free.
+  ///
+  /// \param id An id returned by `GetOrInsert`.
+  /// \return The interned value.
+  const T &Get(int64_t id) const {
+    const Table &table = *table_.load(std::memory_order_acquire);
+    RAY_CHECK(id > 0 && static_cast<size_t>(id) <= table.capacity / 2)
+        << "invalid id: " << id;
+    const Entry *entry = table.by_id[id - 1].load(std::memory_order_acquire);
+    RAY_CHECK(entry != nullptr) << "invalid id: " << id;
+    return entry->value;
+  }
+
+  /// Number of interned values.
+  size_t Size() const { return size_.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr size_t kInitialCapacity = 64;
+
+  struct Entry {
+    T value;
+    size_t hash;
+    int64_t id;
+  };
+
+  /// An open-addressing hash table with linear probing, plus the entries by id. The
+  /// table is kept at most half full, so probing always finds an empty slot quickly.
+  struct Table {
+    explicit Table(size_t capacity)
+        : capacity(capacity),
+          slots(new std::atomic<const Entry *>[capacity]),
+          by_id(new std::atomic<const Entry *>[capacity / 2]) {
+      for (size_t i = 0; i < capacity; i++) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < capacity / 2; i++) {
+        by_id[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    const size_t capacity;
+    std::unique_ptr<std::atomic<const Entry *>[]> slots;
+    std::unique_ptr<std::atomic<const Entry *>[]> by_id;
+  };
+
+  static int64_t Find(const Table &table, const T &value, size_t hash) {
+    const size_t mask = table.capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const Entry *entry = table.slots[i].load(std::memory_order_acquire);
+      if (entry == nullptr) {
+        return 0;
+      }
+      if (entry->hash == hash && Equal()(entry->value, value)) {
+        return entry->id;
+      }
+    }
+  }
+
+  static void Publish(Table *table, const Entry *entry) {
+    table->by_id[entry->id - 1].store(entry, std::memory_order_release);
+    const size_t mask = table->capacity - 1;
+    size_t i = entry->hash & mask;
+    while (table->slots[i].load(std::memory_order_relaxed) != nullptr) {
+      i = (i + 1) & mask;
+    }
+    table->slots[i].store(entry, std::memory_order_release);
+  }
+
+  int64_t Insert(const T &value, size_t hash, bool *inserted) {
+    absl::MutexLock lock(&mutex_);
+    Table *table = table_.load(std::memory_order_relaxed);
+    // Another thread may have interned the value since we last looked.
+    int64_t id = Find(*table, value, hash);
+    if (id != 0) {
+      if (inserted != nullptr) {
+        *inserted = false;
+      }
+      return id;
+    }
+
+    id = entries_.size() + 1;
+    if (static_cast<size_t>(id) > table->capacity / 2) {
+      // Readers keep using the old table until the new one is published, so all
+      // existing entries must be copied over first.
+      tables_.emplace_back(new Table(table->capacity * 2));
+      table = tables_.back().get();
+      for (const auto &entry : entries_) {
+        Publish(table, &entry);
+      }
+      table_.store(table, std::memory_order_release);
+    }
+    entries_.push_back(Entry{value, hash, id});
+    Publish(table, &entries_.back());
+    size_.store(entries_.size(), std::memory_order_release);
+    if (inserted != nullptr) {
+      *inserted = true;
+    }
+    return id;
+  }
+
+  /// The current table. Only replaced while holding the mutex.
+  std::atomic<Table *> table_;
+  /// Number of interned values.
+  std::atomic<size_t> size_{0};
+  /// Protects the fields below, which are only accessed on insertion.
+  absl::Mutex mutex_;
+  /// All interned values, in id order. A deque never moves its elements.
+  std::deque<Entry> entries_ GUARDED_BY(mutex_);
+  /// The current table and all the tables it replaced.
+  std::vector<std::unique_ptr<Table>> tables_ GUARDED_BY(mutex_);
+};
+
+}  // namespace ray
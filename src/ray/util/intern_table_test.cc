@@ -0,0 +1,129 @@
+// Copyright 2021 The Ray Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ray/util/intern_table.h"
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace ray {
+
+TEST(InternTableTest, TestBasic) {
+  InternTable<std::string> table;
+  bool inserted;
+  ASSERT_EQ(table.Find("a"), 0);
+  ASSERT_EQ(table.GetOrInsert("a", &inserted), 1);
+  ASSERT_TRUE(inserted);
+  ASSERT_EQ(table.GetOrInsert("b", &inserted), 2);
+  ASSERT_TRUE(inserted);
+  ASSERT_EQ(table.GetOrInsert("a", &inserted), 1);
+  ASSERT_FALSE(inserted);
+  ASSERT_EQ(table.Find("b"), 2);
+  ASSERT_EQ(table.Get(1), "a");
+  ASSERT_EQ(table.Get(2), "b");
+  ASSERT_EQ(table.Size(), 2);
+}
+
+TEST(InternTableTest, TestGrowth) {
+  InternTable<std::string> table;
+  const std::string &first = table.Get(table.GetOrInsert("0"));
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(table.GetOrInsert(std::to_string(i)), i + 1);
+  }
+  // References to interned values stay valid when the table grows.
+  ASSERT_EQ(&table.Get(1), &first);
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(table.Find(std::to_string(i)), i + 1);
+    ASSERT_EQ(table.Get(i + 1), std::to_string(i));
+  }
+  ASSERT_EQ(table.Size(), 10000);
+}
+
+TEST(InternTableTest, TestConcurrentInsert) {
+  const int num_threads = 32;
+  const int num_values = 1000;
+  InternTable<int> table;
+  std::vector<std::vector<int64_t>> ids(num_threads, std::vector<int64_t>(num_values));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&table, &ids, t]() {
+      // Each thread interns the values in a different order.
+      for (int i = 0; i < num_values; i++) {
+        int value = (i + t * 31) % num_values;
+        ids[t][value] = table.GetOrInsert(value);
+        ASSERT_EQ(table.Get(ids[t][value]), value);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(table.Size(), num_values);
+  std::vector<bool> seen(num_values + 1, false);
+  for (int value = 0; value < num_values; value++) {
+    const int64_t id = ids[0][value];
+    ASSERT_GE(id, 1);
+    ASSERT_LE(id, num_values);
+    ASSERT_FALSE(seen[id]);
+    seen[id] = true;
+    for (int t = 1; t < num_threads; t++) {
+      ASSERT_EQ(ids[t][value], id);
+    }
+  }
+}
+
+TEST(InternTableTest, TestLookupsDuringGrowth) {
+  // Look up already interned values from many threads while another thread keeps
+  // growing the table, as task submission does for scheduling classes.
+  const int num_threads = 8;
+  const int num_lookups = 10000;
+  const int num_values = 16;
+  const int num_inserts = 10000;
+  InternTable<std::string> table;
+  std::vector<std::string> values;
+  for (int i = 0; i < num_values; i++) {
+    values.push_back("function_" + std::to_string(i));
+    ASSERT_EQ(table.GetOrInsert(values.back()), i + 1);
+  }
+
+  std::vector<std::thread> threads;
+  threads.emplace_back([&table]() {
+    for (int i = 0; i < num_inserts; i++) {
+      table.GetOrInsert("other_" + std::to_string(i));
+    }
+  });
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&table, &values]() {
+      for (int i = 0; i < num_lookups; i++) {
+        const int64_t id = table.Find(values[i % num_values]);
+        ASSERT_EQ(id, i % num_values + 1);
+        ASSERT_EQ(table.Get(id), values[i % num_values]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(table.Size(), num_values + num_inserts);
+}
+
+}  // namespace ray
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}